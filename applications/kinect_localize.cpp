@@ -46,7 +46,7 @@ public:
 
       if(_reference)
       {
-        _nestimator->estimateNormals3DGrid(cols, rows, coords, mask, _normals);
+        _nestimator->estimateNormals3DGridIntegral(cols, rows, coords, mask, _normals);
         CartesianCloud3D*  scene = new CartesianCloud3D(size, coords, rgb,  _normals);
         scene->maskPoints(mask);
         scene->maskEmptyNormals();
@@ -92,7 +92,7 @@ void referenceCallback()
   unsigned char* rgb = _kinect->getRGB();
   bool* mask         = _kinect->getMask();
 
-  _nestimator->estimateNormals3DGrid(cols, rows, coords, mask, _normals);
+  _nestimator->estimateNormals3DGridIntegral(cols, rows, coords, mask, _normals);
   CartesianCloud3D*  model = new CartesianCloud3D(size, coords, rgb, _normals);
   model->maskPoints(mask);
   model->maskEmptyNormals();
@@ -1,6 +1,9 @@
 #include <iostream>
+#include <pthread.h>
+#include <unistd.h>
 #include "obgraphic/Obvious3D.h"
 #include "obdevice/Kinect.h"
+#include "obdevice/AsyncDevice3D.h"
 #include "obvision/normals/NormalsEstimator.h"
 #include "obcore/base/Timer.h"
 #include "obcore/base/CartesianCloudFactory.h"
@@ -10,6 +13,7 @@ using namespace obvious;
 Obvious3D*        _viewer;
 VtkCloud*         _cloud;
 Kinect*           _kinect;
+AsyncDevice3D<Kinect>* _async;
 NormalsEstimator* _nestimator;
 double*           _normals;
 bool              _pause       = false;
@@ -18,45 +22,39 @@ bool              _showNormals = false;
 void serializePLY();
 void serializeXML();
 
-class vtkTimerCallback : public vtkCommand
+/**
+ * Processing thread, the sensor is grabbed in the background by AsyncDevice3D and the viewer renders published clouds at its own frame rate
+ */
+void* processTask(void* arg)
 {
-public:
-  static vtkTimerCallback *New()
-  {
-    vtkTimerCallback *cb = new vtkTimerCallback;
-    return cb;
-  }
+  // Wait for render loop to be started
+  while(!_viewer->isRendering())
+    usleep(1000);
 
-  virtual void Execute(vtkObject *vtkNotUsed(caller), unsigned long eventId,  void *vtkNotUsed(callData))
+  while(_viewer->isRendering())
   {
+    Frame3D* frame = _async->getNextFrame(100);
+    if(!frame) continue;
+
     if(!_pause)
     {
-      if(_kinect->grab())
+      int rows = _async->getRows();
+      int cols = _async->getCols();
+      int size = rows * cols;
+      if(_showNormals)
       {
-        int rows           = _kinect->getRows();
-        int cols           = _kinect->getCols();
-        int size           = rows * cols;
-        double* coords     = _kinect->getCoords();
-        unsigned char* rgb = _kinect->getRGB();
-        bool* mask         = _kinect->getMask();
-        if(_showNormals)
-        {
-          _nestimator->estimateNormals3DGrid(cols, rows, coords, mask, _normals);
-          _cloud->setCoords(coords, size, 3, _normals);
-        }
-        else
-        {
-          _cloud->setCoords(coords, size, 3);
-        }
-        _cloud->setColors(rgb, size, 3);
-        _viewer->update();
+        _nestimator->estimateNormals3DGridIntegral(cols, rows, frame->coords, frame->mask, _normals);
+        _viewer->publishCloud(_cloud, frame->coords, frame->rgb, size, _normals);
+      }
+      else
+      {
+        _viewer->publishCloud(_cloud, frame->coords, frame->rgb, size);
       }
     }
+    _async->releaseFrame(frame);
   }
-
-private:
-
-};
+  return NULL;
+}
 
 static int cnt = 0;
 char filename[64];
@@ -73,7 +71,15 @@ void serializeXML()
   cout << "serializing " << filename << endl;
   _cloud->serialize(filename, VTKCloud_XML);
 
-  CartesianCloud3D* cloud = new CartesianCloud3D(640*480, _kinect->getCoords(), _kinect->getRGB(), NULL);
+  // Use displayed data, since the sensor is grabbed concurrently
+  unsigned int size     = _cloud->getSize();
+  double* coords        = new double[3*size];
+  unsigned char* colors = new unsigned char[3*size];
+  _cloud->copyCoords(coords);
+  _cloud->copyColors(colors);
+  CartesianCloud3D* cloud = new CartesianCloud3D(size, coords, colors, NULL);
+  delete [] coords;
+  delete [] colors;
   //for(int i=0; i<640*480; i++)
   //  if(fabs((*(cloud->getCoords()))(i,2))<1e-6) (cloud->getAttributes())[i] &= ~ePointAttrValid;
   //cloud->removeInvalidPoints();
@@ -86,10 +92,13 @@ void recordCallback()
 
   char filename[64] = "kinect.rec";
 
+  // The recording stream is written by grab in the acquisition thread
+  _async->lockDevice();
   if(!record)
     _kinect->startRecording(filename);
   else
     _kinect->stopRecording();
+  _async->unlockDevice();
 
   record = !record;
 }
@@ -103,6 +112,7 @@ int main(int argc, char* argv[])
   }
 
   _kinect     = new Kinect(argv[1]);
+  _async      = new AsyncDevice3D<Kinect>(_kinect);
   _nestimator = new NormalsEstimator();
   _normals    = new double[3*_kinect->getRows()*_kinect->getCols()];
   _cloud      = new VtkCloud();
@@ -111,19 +121,24 @@ int main(int argc, char* argv[])
 
   _viewer->addCloud(_cloud);
 
-  vtkSmartPointer<vtkTimerCallback> cb =  vtkSmartPointer<vtkTimerCallback>::New();
-  vtkSmartPointer<vtkRenderWindowInteractor> interactor = _viewer->getWindowInteractor();
-  interactor->AddObserver(vtkCommand::TimerEvent, cb);
-
-  interactor->CreateRepeatingTimer(30);
   _viewer->registerKeyboardCallback("y", serializePLY);
   _viewer->registerKeyboardCallback("x", serializeXML);
   _viewer->registerKeyboardCallback("w", recordCallback);
   _viewer->registerFlipVariable("space", &_pause);
   _viewer->registerFlipVariable("n",     &_showNormals);
 
-  _viewer->startRendering();
+  _async->start();
+
+  pthread_t thread;
+  pthread_create(&thread, NULL, processTask, NULL);
+
+  _viewer->startAsyncRendering(30);
+
+  pthread_join(thread, NULL);
+  _async->stop();
+  cout << "Grabbed frames: " << _async->getGrabbedFrames() << ", dropped: " << _async->getDroppedFrames() << endl;
 
+  delete _async;
   delete _cloud;
   delete _normals;
   delete _nestimator;
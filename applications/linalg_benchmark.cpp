@@ -0,0 +1,58 @@
+/**
+ * Benchmark of linear algebra backends
+ * Hot kernels are timed with GSL and Eigen for a range of problem sizes. Afterwards, the size-based dispatch is calibrated
+ * and the resulting thresholds are reported.
+ * @author Stefan May
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <climits>
+
+#include "obcore/math/linalg/LinalgBackend.h"
+#include "obcore/base/Logger.h"
+
+using namespace std;
+using namespace obvious;
+
+int main(int argc, char* argv[])
+{
+  LOGMSG_CONF("linalg_benchmark.log", Logger::file_off|Logger::screen_off, DBG_ERROR, DBG_ERROR);
+
+  const char* names[LINALG_OPERATIONS] = {"multiply", "invert", "svd", "pcaAnalysis"};
+  const unsigned int ladders = 5;
+  const unsigned int sizes[LINALG_OPERATIONS][ladders] = {{16, 256, 4096, 65536, 1048576},
+                                                          {3, 4, 16, 64, 256},
+                                                          {3, 4, 16, 64, 128},
+                                                          {64, 1024, 16384, 262144, 1048576}};
+
+  cout << setw(12) << "operation" << setw(10) << "size" << setw(14) << "GSL [ms]" << setw(14) << "Eigen [ms]" << endl;
+  for(unsigned int op=0; op<LINALG_OPERATIONS; op++)
+  {
+    for(unsigned int i=0; i<ladders; i++)
+    {
+      double tEigen = LinalgBackend::benchmark((EnumLinalgOperation)op, sizes[op][i], LINALG_EIGEN);
+      cout << setw(12) << names[op] << setw(10) << sizes[op][i] << setw(14);
+      if(LinalgBackend::isAvailable(LINALG_GSL))
+        cout << LinalgBackend::benchmark((EnumLinalgOperation)op, sizes[op][i], LINALG_GSL)*1000.0;
+      else
+        cout << "-";
+      cout << setw(14) << tEigen*1000.0 << endl;
+    }
+  }
+
+  LinalgBackend::calibrate();
+
+  cout << endl << "Calibrated thresholds (GSL from size on):" << endl;
+  for(unsigned int op=0; op<LINALG_OPERATIONS; op++)
+  {
+    unsigned int threshold = LinalgBackend::getThreshold((EnumLinalgOperation)op);
+    cout << setw(12) << names[op] << ": ";
+    if(threshold==UINT_MAX)
+      cout << "never" << endl;
+    else
+      cout << threshold << endl;
+  }
+
+  return 0;
+}
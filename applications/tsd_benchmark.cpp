@@ -0,0 +1,329 @@
+/**
+ * Replay benchmark of the reconstruction pipeline
+ * Frames of a Kinect recording (see KinectPlayback) or of a synthetic scene are passed through
+ * TSD integration (push), raycasting, ICP registration and meshing. Per-stage latency percentiles,
+ * throughput and peak memory are written in JSON format.
+ * @author Stefan May
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <sys/resource.h>
+
+#include "obdevice/KinectPlayback.h"
+#include "obvision/icp/icp_def.h"
+#include "obvision/mesh/TriangleMesh.h"
+#include "obvision/reconstruct/space/TsdSpace.h"
+#include "obvision/reconstruct/space/SensorProjective3D.h"
+#include "obvision/reconstruct/space/RayCast3D.h"
+#include "obcore/base/Timer.h"
+#include "obcore/base/Logger.h"
+#include "obcore/math/mathbase.h"
+
+using namespace std;
+using namespace obvious;
+
+#define VXLDIM 0.01
+#define LAYOUTPARTITION LAYOUT_8x8x8
+#define LAYOUTSPACE LAYOUT_256x256x256
+
+// Intrinsics of synthetic sensor, equal to tsd_kinect
+#define SU 575.81575
+#define SV 575.81575
+#define TU 320.0
+#define TV 240.0
+
+/**
+ * Collection of latencies of a pipeline stage
+ */
+struct Stage
+{
+  const char* name;
+  vector<double> samples;
+};
+
+/**
+ * Determine percentile of sorted samples (nearest rank)
+ */
+double percentile(const vector<double>& sorted, double p)
+{
+  if(sorted.empty()) return 0.0;
+  unsigned int idx = (unsigned int)(p * (double)(sorted.size()-1) + 0.5);
+  return sorted[idx];
+}
+
+/**
+ * Synthetic scene: box shaped room with a sphere in front of the initial sensor pose.
+ * Distances are determined analytically along the rays of a projective sensor located at pos.
+ */
+void renderSynthetic(TsdSpace* space, double pos[3], unsigned int cols, unsigned int rows, double maxRange, double* dist, double* coords, bool* mask, unsigned char* rgb)
+{
+  double bmin[3] = {space->getMinX()+0.2, space->getMinY()+0.2, space->getMinZ()+0.2};
+  double bmax[3] = {space->getMaxX()-0.2, space->getMaxY()-0.2, space->getMaxZ()-0.2};
+  double center[3] = {(bmin[0]+bmax[0])*0.5, (bmin[1]+bmax[1])*0.5, 1.5};
+  double radius = 0.4;
+
+  for(unsigned int v=0; v<rows; v++)
+  {
+    for(unsigned int u=0; u<cols; u++)
+    {
+      unsigned int i = v*cols+u;
+      double ray[3] = {((double)u-TU)/SU, ((double)v-TV)/SV, 1.0};
+      norm3<double>(ray);
+
+      // room walls
+      double t = 1e9;
+      for(unsigned int k=0; k<3; k++)
+      {
+        if(fabs(ray[k])<1e-9) continue;
+        double tk = ((ray[k] > 0.0 ? bmax[k] : bmin[k]) - pos[k]) / ray[k];
+        if(tk > 0.0 && tk < t) t = tk;
+      }
+
+      // sphere
+      double oc[3] = {pos[0]-center[0], pos[1]-center[1], pos[2]-center[2]};
+      double b = dot3<double>(oc, ray);
+      double c = dot3<double>(oc, oc) - radius*radius;
+      double disc = b*b - c;
+      bool hitSphere = false;
+      if(disc > 0.0)
+      {
+        double ts = -b - sqrt(disc);
+        if(ts > 0.0 && ts < t)
+        {
+          t = ts;
+          hitSphere = true;
+        }
+      }
+
+      dist[i]       = t;
+      mask[i]       = (t < maxRange);
+      coords[3*i]   = t*ray[0];
+      coords[3*i+1] = t*ray[1];
+      coords[3*i+2] = t*ray[2];
+      rgb[3*i]      = hitSphere ? 255 : (unsigned char)(u & 0xFF);
+      rgb[3*i+1]    = hitSphere ? 0   : (unsigned char)(v & 0xFF);
+      rgb[3*i+2]    = hitSphere ? 0   : 128;
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  LOGMSG_CONF("tsd_benchmark.log", Logger::file_off|Logger::screen_off, DBG_ERROR, DBG_ERROR);
+
+  if(argc>1 && (strcmp(argv[1], "-h")==0 || strcmp(argv[1], "--help")==0))
+  {
+    cout << "usage: " << argv[0] << " [synthetic|<playback.dat>] [frames] [output.json]" << endl;
+    return 0;
+  }
+
+  const char* source   = (argc>1) ? argv[1] : "synthetic";
+  unsigned int frames  = (argc>2) ? atoi(argv[2]) : 100;
+  const char* output   = (argc>3) ? argv[3] : NULL;
+  bool synthetic       = (strcmp(source, "synthetic")==0);
+
+  KinectPlayback* playback = NULL;
+  unsigned int cols = 640;
+  unsigned int rows = 480;
+  if(!synthetic)
+  {
+    playback = new KinectPlayback(source);
+    cols = playback->getCols();
+    rows = playback->getRows();
+  }
+  unsigned int size = cols*rows;
+
+  double Pdata[12] = {SU, 0.0, TU, 0.0, 0.0, SV, TV, 0.0, 0.0, 0.0, 1.0, 0.0};
+  double maxRange = 4.0;
+
+  TsdSpace space(VXLDIM, LAYOUTPARTITION, LAYOUTSPACE);
+  space.setMaxTruncation(3.0 * VXLDIM);
+
+  obfloat tr[3];
+  space.getCentroid(tr);
+  tr[2] = 0.0;
+  double tf[16]={1,  0, 0, tr[0],
+                 0,  1, 0, tr[1],
+                 0,  0, 1, tr[2],
+                 0,  0, 0, 1};
+  Matrix Tinit(4, 4);
+  Tinit.setData(tf);
+
+  SensorProjective3D sensor(cols, rows, Pdata, maxRange, 0.4);
+  sensor.transform(&Tinit);
+
+  // ICP configuration equal to tsd_kinect
+  unsigned int maxIterations = 25;
+  PairAssignment* assigner = (PairAssignment*)new FlannPairAssignment(3, 0.0, true);
+  IRigidEstimator* estimator = (IRigidEstimator*)new PointToPlaneEstimator3D();
+  OutOfBoundsFilter3D* filterBounds = new OutOfBoundsFilter3D(space.getMinX(), space.getMaxX(), space.getMinY(), space.getMaxY(), space.getMinZ(), space.getMaxZ());
+  filterBounds->setPose(&Tinit);
+  assigner->addPreFilter(filterBounds);
+  IPostAssignmentFilter* filterD = (IPostAssignmentFilter*)new DistanceFilter(0.5, 0.01, maxIterations-3);
+  IPostAssignmentFilter* filterR = (IPostAssignmentFilter*)new ReciprocalFilter();
+  assigner->addPostFilter(filterD);
+  assigner->addPostFilter(filterR);
+  Icp icp(assigner, estimator);
+  icp.setMaxRMS(0.0);
+  icp.setMaxIterations(maxIterations);
+  icp.setConvergenceCounter(maxIterations);
+
+  RayCast3D rayCaster;
+  TriangleMesh mesh(size);
+
+  double* dist          = new double[size];
+  double* coords        = new double[size*3];
+  bool* mask            = new bool[size];
+  unsigned char* rgb    = new unsigned char[size*3];
+  double* modelCoords   = new double[size*3];
+  double* modelNormals  = new double[size*3];
+  double* sceneCoords   = new double[size*3];
+
+  Stage stages[4] = {{"push", vector<double>()}, {"raycast", vector<double>()}, {"icp", vector<double>()}, {"mesh", vector<double>()}};
+  Stage& stPush    = stages[0];
+  Stage& stRaycast = stages[1];
+  Stage& stIcp     = stages[2];
+  Stage& stMesh    = stages[3];
+
+  Timer tTotal;
+  Timer t;
+  tTotal.start();
+  unsigned int processed = 0;
+
+  for(unsigned int f=0; f<frames; f++)
+  {
+    // Acquire frame (not part of measurements)
+    if(synthetic)
+    {
+      double pos[3] = {tr[0] + 0.002*f, tr[1] + 0.001*f, tr[2]};
+      renderSynthetic(&space, pos, cols, rows, maxRange, dist, coords, mask, rgb);
+    }
+    else
+    {
+      if(playback->eof() || !playback->grab()) break;
+      double* c = playback->getCoords();
+      unsigned char* m = playback->getMask();
+      memcpy(coords, c, size*3*sizeof(*coords));
+      memcpy(rgb, playback->getRGB(), size*3*sizeof(*rgb));
+      for(unsigned int i=0; i<size; i++)
+      {
+        mask[i] = m[i];
+        dist[i] = abs3D(&c[3*i]);
+      }
+    }
+
+    bool registered = (f==0);
+    if(f>0)
+    {
+      unsigned int modelSize = 0;
+      t.start();
+      rayCaster.calcCoordsFromCurrentPose(&space, &sensor, modelCoords, modelNormals, NULL, &modelSize);
+      stRaycast.samples.push_back(t.elapsed());
+
+      unsigned int idx = 0;
+      for(unsigned int i=0; i<size; i++)
+      {
+        if(mask[i])
+        {
+          memcpy(&sceneCoords[3*idx], &coords[3*i], 3*sizeof(*coords));
+          idx++;
+        }
+      }
+
+      if(modelSize>0 && idx>0)
+      {
+        t.start();
+        Matrix T = sensor.getTransformation();
+        filterBounds->setPose(&T);
+        icp.reset();
+        icp.setModel(modelCoords, modelNormals, modelSize/3, 0.1);
+        icp.setScene(sceneCoords, NULL, idx, 0.04);
+        double rms = 0.0;
+        unsigned int pairs = 0;
+        unsigned int iterations = 0;
+        EnumIcpState state = icp.iterate(&rms, &pairs, &iterations);
+        Matrix Ticp = icp.getFinalTransformation();
+        stIcp.samples.push_back(t.elapsed());
+
+        if(((state == ICP_SUCCESS) || (state == ICP_MAXITERATIONS)) && (rms < 0.1))
+        {
+          sensor.transform(&Ticp);
+          registered = true;
+        }
+      }
+    }
+
+    if(registered)
+    {
+      t.start();
+      sensor.setRealMeasurementData(dist);
+      sensor.setRealMeasurementMask(mask);
+      sensor.setRealMeasurementRGB(rgb);
+      space.push(&sensor);
+      stPush.samples.push_back(t.elapsed());
+    }
+
+    t.start();
+    mesh.createMeshFromOrganizedCloud(coords, rows, cols, rgb, mask);
+    stMesh.samples.push_back(t.elapsed());
+
+    processed++;
+  }
+
+  double total = tTotal.elapsed();
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  FILE* out = stdout;
+  if(output)
+  {
+    out = fopen(output, "w");
+    if(!out)
+    {
+      cout << "Cannot open " << output << endl;
+      out = stdout;
+    }
+  }
+
+  fprintf(out, "{\n");
+  fprintf(out, "  \"source\": \"%s\",\n", source);
+  fprintf(out, "  \"frames\": %u,\n", processed);
+  fprintf(out, "  \"cols\": %u,\n", cols);
+  fprintf(out, "  \"rows\": %u,\n", rows);
+  fprintf(out, "  \"voxel_size\": %f,\n", VXLDIM);
+  fprintf(out, "  \"stages\": {\n");
+  for(unsigned int s=0; s<4; s++)
+  {
+    vector<double> sorted = stages[s].samples;
+    sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for(unsigned int i=0; i<sorted.size(); i++)
+      sum += sorted[i];
+    double mean = sorted.empty() ? 0.0 : sum / sorted.size();
+    fprintf(out, "    \"%s\": {\"count\": %u, \"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f}%s\n",
+            stages[s].name, (unsigned int)sorted.size(), mean*1e3,
+            percentile(sorted, 0.5)*1e3, percentile(sorted, 0.9)*1e3, percentile(sorted, 0.99)*1e3,
+            (sorted.empty() ? 0.0 : sorted.back()*1e3), (s<3 ? "," : ""));
+  }
+  fprintf(out, "  },\n");
+  fprintf(out, "  \"total_s\": %.3f,\n", total);
+  fprintf(out, "  \"throughput_fps\": %.3f,\n", (total > 0.0 ? processed / total : 0.0));
+  fprintf(out, "  \"peak_rss_kb\": %ld\n", usage.ru_maxrss);
+  fprintf(out, "}\n");
+  if(out!=stdout) fclose(out);
+
+  delete [] dist;
+  delete [] coords;
+  delete [] mask;
+  delete [] rgb;
+  delete [] modelCoords;
+  delete [] modelNormals;
+  delete [] sceneCoords;
+  delete playback;
+
+  return 0;
+}
@@ -11,6 +11,7 @@
 #include "obvision/reconstruct/grid/TsdGrid.h"
 #include "obvision/reconstruct/grid/RayCastPolar2D.h"
 #include "obvision/reconstruct/grid/RayCastAxisAligned2D.h"
+#include "obvision/reconstruct/grid/TsdGridTracker.h"
 #include "obvision/icp/icp_def.h"
 
 #include "obgraphic/Obvious2D.h"
@@ -50,10 +51,12 @@ int main(int argc, char* argv[])
   // Initialization of TSD grid
   const double cellSize = 0.03;
 
-  // choose estimator type
-  enum Est{PTP, PTL};
+  // choose estimator type, "direct" aligns scans with the grid without raycasting
+  enum Est{PTP, PTL, DIRECT};
   Est estType;
-  if (argc >=1)
+  if (argc > 1 && string(argv[1]) == "direct")
+    estType = DIRECT;
+  else if (argc >=1)
     estType = PTL;
   else
     estType = PTP;
@@ -131,12 +134,21 @@ int main(int argc, char* argv[])
   icp->setConvergenceCounter(iterations);
   //icp->setAssignmentCallback(callbackAssignment);
 
+  // Downsampled grids are only needed for direct alignment
+  TsdGridTracker* tracker = NULL;
+  if(estType == DIRECT)
+  {
+    tracker = new TsdGridTracker(_grid);
+    tracker->setCoarseToFine(2);
+  }
+
   // Set first model
   lms.grab();
   sensor.setRealMeasurementData(lms.getRanges());
 
 
   _grid->push(&sensor);
+  if(tracker) tracker->updatePyramid();
 
   double lastPhi = 0;
   double lastX = 0;
@@ -147,10 +159,6 @@ int main(int argc, char* argv[])
   {
     lms.grab();
 
-    unsigned int mSize = 0;
-    rayCaster.calcCoordsFromCurrentView(_grid, &sensor, mCoords, mNormals, &mSize);
-    LOGMSG(DBG_DEBUG, "Raycast resulted in " << mSize << " coordinates");
-
     //double* coords = lms.getCoords();
     double* ranges = lms.getRanges();
 
@@ -171,26 +179,44 @@ int main(int argc, char* argv[])
     }
 
 
-    Matrix* M = new Matrix(mSize/2, 2, mCoords);
-    Matrix* N = new Matrix(mSize/2, 2, mNormals);
-    Matrix* S = new Matrix(sSize, 2, sCoords);
+    Matrix T(3, 3);
+    T.setIdentity();
+
+    sensor.setRealMeasurementData(ranges);
+    sensor.setRealMeasurementMask(sMask);
+
+    if(estType == DIRECT)
+    {
+      tracker->track(&sensor);
+    }
+    else
+    {
+      unsigned int mSize = 0;
+      rayCaster.calcCoordsFromCurrentView(_grid, &sensor, mCoords, mNormals, &mSize);
+      LOGMSG(DBG_DEBUG, "Raycast resulted in " << mSize << " coordinates");
+
+      Matrix* M = new Matrix(mSize/2, 2, mCoords);
+      Matrix* N = new Matrix(mSize/2, 2, mNormals);
+      Matrix* S = new Matrix(sSize, 2, sCoords);
 
-    icp->reset();
-    icp->setModel(M, N);
-    icp->setScene(S);
+      icp->reset();
+      icp->setModel(M, N);
+      icp->setScene(S);
 
-    double rms;
-    unsigned int pairs;
-    unsigned int it;
+      double rms;
+      unsigned int pairs;
+      unsigned int it;
 
-    icp->iterate(&rms, &pairs, &it);
-    LOGMSG(DBG_DEBUG, "ICP result - RMS: " << rms << " pairs: " << pairs << " iterations: " << it << endl;)
+      icp->iterate(&rms, &pairs, &it);
+      LOGMSG(DBG_DEBUG, "ICP result - RMS: " << rms << " pairs: " << pairs << " iterations: " << it << endl;)
 
-    Matrix T = icp->getFinalTransformation();
+      T = icp->getFinalTransformation();
+      sensor.transform(&T);
 
-    sensor.setRealMeasurementData(ranges);
-    sensor.setRealMeasurementMask(sMask);
-    sensor.transform(&T);
+      delete M;
+      delete N;
+      delete S;
+    }
 
 
     Matrix TSensor = sensor.getTransformation();
@@ -213,6 +239,7 @@ int main(int argc, char* argv[])
     {
       //sensor.setRealMeasurementAccuracy(sensor.getRealMeasurementAccuracy());
       _grid->push(&sensor);
+      if(tracker) tracker->updatePyramid();
       LastScanPose = T;
       //std::cout << "Pushed to grid" << std::endl;
       if(initCount < 5) initCount++;
@@ -280,10 +307,6 @@ int main(int argc, char* argv[])
     image[idx+5] = 255;
 
     viewer.draw(image, screen_width, screen_height, 3, 0, 0);
-
-    delete M;
-    delete N;
-    delete S;
   }
 
   //output for grayscale data
@@ -292,6 +315,7 @@ int main(int argc, char* argv[])
   delete [] image;
   delete [] mCoords;
   delete [] mNormals;
+  delete tracker;
 }
 
 
@@ -21,6 +21,7 @@
 #include "obvision/reconstruct/space/SensorPolar3D.h"
 #include "obvision/reconstruct/space/RayCast3D.h"
 #include "obvision/reconstruct/space/RayCastAxisAligned3D.h"
+#include "obvision/reconstruct/space/TsdSpaceTracker.h"
 
 using namespace obvious;
 
@@ -38,6 +39,7 @@ VtkCloud* _vModel;
 VtkCloud* _vScene;
 Obvious3D* _viewer3D;
 Icp* _icp;
+TsdSpaceTracker* _tracker;
 OutOfBoundsFilter3D* _filterBounds;
 
 void _cbStoreModel(void)
@@ -294,6 +296,41 @@ void _cbRegNewImage(void)
   LOGMSG(DBG_ERROR, ": time elapsed = " << tComplete.elapsed() << " s");
 }
 
+void _cbTrackNewImage(void)
+{
+  obvious::Timer tComplete;
+  tComplete.start();
+
+  unsigned int cols = _kinect->getCols();
+  unsigned int rows = _kinect->getRows();
+
+  // Acquire scene image
+  _kinect->grab();
+
+  double* coords = _kinect->getCoords();
+  double* dist = new double[cols*rows];
+  for(unsigned int i=0; i<cols*rows; i++)
+    dist[i] = abs3D(&coords[3*i]);
+  _sensor->setRealMeasurementData(dist);
+  _sensor->setRealMeasurementMask(_kinect->getMask());
+  _sensor->setRealMeasurementRGB(_kinect->getRGB());
+  delete[] dist;
+
+  // Align scene directly with signed distance field, neither raycasting nor a kd-tree is needed
+  if(_tracker->track(_sensor) && _tracker->getRMS() < 0.5)
+  {
+    obvious::Matrix Tmp = _sensor->getTransformation();
+    _viewer3D->showSensorPose(Tmp);
+    _space->push(_sensor);
+  }
+  else
+    LOGMSG(DBG_DEBUG, "Tracking failed, RMS " << _tracker->getRMS());
+
+  _viewer3D->update();
+
+  LOGMSG(DBG_ERROR, ": time elapsed = " << tComplete.elapsed() << " s");
+}
+
 void _cbReset(void)
 {
   _space->reset();
@@ -399,6 +436,7 @@ int main(void)
   delete [] dist;
 
   _rayCaster = new RayCast3D();
+  _tracker = new TsdSpaceTracker(_space);
 
   // Displaying stuff
   // ------------------------------------------------------------------
@@ -409,6 +447,7 @@ int main(void)
   _viewer3D->addAxisAlignedCube(0, _space->getMaxX(), 0, _space->getMaxY(), 0, _space->getMaxZ());
   //_viewer3D->addCloud(_vScene);
   _viewer3D->registerKeyboardCallback("space", _cbRegNewImage, "Register new image");
+  _viewer3D->registerKeyboardCallback("t", _cbTrackNewImage, "Track new image against TSD space");
   _viewer3D->registerKeyboardCallback("c", _cbGenPointCloud, "Generate point cloud");
   //_viewer3D->registerKeyboardCallback("d", _cbGenMesh, "Generate mesh");
   _viewer3D->registerKeyboardCallback("v", _cbBuildSliceViews, "Build slice views");
@@ -423,5 +462,6 @@ int main(void)
   delete _vScene;
   delete _viewer3D;
   delete _rayCaster;
+  delete _tracker;
   delete _space;
 }
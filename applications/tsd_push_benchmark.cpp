@@ -0,0 +1,144 @@
+/**
+ * Benchmark of TSD integration kernels
+ * Synthetic range images are pushed into a 256x256x256 space with the scalar reference kernel and with the SIMD kernel.
+ * Elapsed time and deviation of both reconstructions are reported.
+ * @author Stefan May
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+
+#include "obvision/reconstruct/space/TsdSpace.h"
+#include "obvision/reconstruct/space/SensorProjective3D.h"
+#include "obcore/base/Timer.h"
+#include "obcore/base/Logger.h"
+#include "obcore/math/mathbase.h"
+
+using namespace std;
+using namespace obvious;
+
+#define SU 575.81575
+#define SV 575.81575
+#define TU 320.0
+#define TV 240.0
+
+/**
+ * Synthetic scene: wavy wall in front of sensor
+ */
+void createRangeImage(unsigned int cols, unsigned int rows, unsigned int frame, double* dist, bool* mask, unsigned char* rgb)
+{
+  for(unsigned int v=0; v<rows; v++)
+  {
+    for(unsigned int u=0; u<cols; u++)
+    {
+      unsigned int i = v*cols+u;
+      double ray[3] = {((double)u-TU)/SU, ((double)v-TV)/SV, 1.0};
+      double depth = 1.5 + 0.2*sin(u*0.02 + frame*0.1) + 0.1*cos(v*0.03);
+      dist[i]    = depth * abs3D(ray);
+      mask[i]    = ((u+v+frame)%31) != 0;
+      rgb[3*i]   = u & 0xFF;
+      rgb[3*i+1] = v & 0xFF;
+      rgb[3*i+2] = (frame*10) & 0xFF;
+    }
+  }
+}
+
+double integrate(TsdSpace* space, unsigned int frames)
+{
+  unsigned int cols = 640;
+  unsigned int rows = 480;
+  double Pdata[12] = {SU, 0.0, TU, 0.0, 0.0, SV, TV, 0.0, 0.0, 0.0, 1.0, 0.0};
+  SensorProjective3D sensor(cols, rows, Pdata, 3.0, 0.3);
+
+  obfloat tr[3];
+  space->getCentroid(tr);
+  double tf[16]={1, 0, 0, tr[0],
+                 0, 1, 0, tr[1],
+                 0, 0, 1, 0.1,
+                 0, 0, 0, 1};
+  Matrix T(4, 4);
+  T.setData(tf);
+  sensor.transform(&T);
+
+  double* dist       = new double[cols*rows];
+  bool* mask         = new bool[cols*rows];
+  unsigned char* rgb = new unsigned char[cols*rows*3];
+
+  double elapsed = 0.0;
+  Timer timer;
+  for(unsigned int f=0; f<frames; f++)
+  {
+    createRangeImage(cols, rows, f, dist, mask, rgb);
+    sensor.setRealMeasurementData(dist);
+    sensor.setRealMeasurementMask(mask);
+    sensor.setRealMeasurementRGB(rgb);
+    double step[3] = {0.005, 0.002, 0.0};
+    sensor.translate(step);
+
+    timer.start();
+    space->push(&sensor);
+    elapsed += timer.elapsed();
+  }
+
+  delete [] dist;
+  delete [] mask;
+  delete [] rgb;
+
+  return elapsed;
+}
+
+int main(int argc, char* argv[])
+{
+  LOGMSG_CONF("tsd_push_benchmark.log", Logger::file_off|Logger::screen_off, DBG_ERROR, DBG_ERROR);
+
+  unsigned int frames = (argc>1) ? atoi(argv[1]) : 20;
+  double voxelSize = 0.01;
+
+  TsdSpace spaceScalar(voxelSize, LAYOUT_8x8x8, LAYOUT_256x256x256);
+  spaceScalar.setMaxTruncation(3.0*voxelSize);
+  spaceScalar.setIntegration(INTEGRATION_SCALAR);
+
+  TsdSpace spaceSIMD(voxelSize, LAYOUT_8x8x8, LAYOUT_256x256x256);
+  spaceSIMD.setMaxTruncation(3.0*voxelSize);
+  spaceSIMD.setIntegration(INTEGRATION_SIMD);
+
+  double tScalar = integrate(&spaceScalar, frames);
+  double tSIMD   = integrate(&spaceSIMD, frames);
+
+  // Compare reconstructions voxel-wise
+  unsigned int cells      = spaceScalar.getXDimension();
+  unsigned int compared   = 0;
+  unsigned int mismatches = 0;
+  double maxDeviation     = 0.0;
+  for(unsigned int z=0; z<cells; z++)
+  {
+    for(unsigned int y=0; y<cells; y++)
+    {
+      for(unsigned int x=0; x<cells; x++)
+      {
+        obfloat coord[3] = {(x+0.5)*voxelSize, (y+0.5)*voxelSize, (z+0.5)*voxelSize};
+        obfloat tsdScalar;
+        obfloat tsdSIMD;
+        bool validScalar = (spaceScalar.getTsd(coord, &tsdScalar)==INTERPOLATE_SUCCESS);
+        bool validSIMD   = (spaceSIMD.getTsd(coord, &tsdSIMD)==INTERPOLATE_SUCCESS);
+        if(validScalar != validSIMD)
+          mismatches++;
+        else if(validScalar)
+        {
+          compared++;
+          double deviation = fabs(tsdScalar-tsdSIMD);
+          if(deviation > maxDeviation) maxDeviation = deviation;
+        }
+      }
+    }
+  }
+
+  cout << "Frames: " << frames << ", space: " << cells << "x" << cells << "x" << cells << endl;
+  cout << "Scalar kernel: " << tScalar*1000.0/frames << " ms/frame" << endl;
+  cout << "SIMD kernel:   " << tSIMD*1000.0/frames << " ms/frame" << endl;
+  cout << "Speed-up:      " << tScalar/tSIMD << endl;
+  cout << "Voxels compared: " << compared << ", differing in initialization: " << mismatches << ", max. tsd deviation: " << maxDeviation << endl;
+
+  return 0;
+}
@@ -0,0 +1,464 @@
+#include "CompactCloud3D.h"
+#include "obcore/math/linalg/MatrixView.h"
+#include "obcore/base/Logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace obvious
+{
+
+// Component arrays are padded to multiples of this number of elements to keep them aligned
+#define COMPACTCLOUDPADDING 4
+
+template <typename T>
+CompactCloud3D<T>::CompactCloud3D(unsigned int size, bool withNormals, bool withColors)
+{
+  init(size, withNormals, withColors);
+}
+
+template <typename T>
+CompactCloud3D<T>::CompactCloud3D(T* coords, unsigned int size, T* normals, unsigned char* rgb)
+{
+  _buffer  = NULL;
+  _size    = size;
+  _stride  = 3;
+  _nstride = 3;
+  for(unsigned int i=0; i<3; i++)
+  {
+    _c[i] = &coords[i];
+    _n[i] = normals ? &normals[i] : NULL;
+  }
+  _rgb = rgb;
+}
+
+template <typename T>
+CompactCloud3D<T>::CompactCloud3D(CartesianCloud3D* cloud)
+{
+  Matrix* C = cloud->getCoords();
+  Matrix* N = cloud->hasNormals() ? cloud->getNormals() : NULL;
+  unsigned char* rgb = cloud->hasColors() ? cloud->getColors() : NULL;
+
+  if(sizeof(T)==sizeof(double))
+  {
+    _buffer = NULL;
+    _size   = cloud->size();
+    MatrixView vc(C);
+    for(unsigned int i=0; i<3; i++)
+      _c[i] = reinterpret_cast<T*>(vc.getColumn(i, &_stride));
+    _nstride = _stride;
+    if(N)
+    {
+      MatrixView vn(N);
+      for(unsigned int i=0; i<3; i++)
+        _n[i] = reinterpret_cast<T*>(vn.getColumn(i, &_nstride));
+    }
+    else
+    {
+      _n[0] = _n[1] = _n[2] = NULL;
+    }
+    _rgb = rgb;
+  }
+  else
+  {
+    init(cloud->size(), N!=NULL, rgb!=NULL);
+    for(unsigned int j=0; j<_size; j++)
+    {
+      for(unsigned int i=0; i<3; i++)
+      {
+        _c[i][j] = (T)(*C)(j, i);
+        if(N) _n[i][j] = (T)(*N)(j, i);
+      }
+    }
+    if(rgb) memcpy(_rgb, rgb, 3*_size*sizeof(unsigned char));
+  }
+}
+
+template <typename T>
+CompactCloud3D<T>::CompactCloud3D(PointCloud<Point>* cloud)
+{
+  const unsigned int size = cloud->size();
+  if(sizeof(T)==sizeof(obfloat))
+  {
+    _buffer  = NULL;
+    _size    = size;
+    _stride  = sizeof(Point) / sizeof(obfloat);
+    _nstride = _stride;
+    Point* p = size ? &((*cloud)[0]) : NULL;
+    _c[0] = p ? reinterpret_cast<T*>(&(p->x)) : NULL;
+    _c[1] = p ? reinterpret_cast<T*>(&(p->y)) : NULL;
+    _c[2] = p ? reinterpret_cast<T*>(&(p->z)) : NULL;
+    _n[0] = _n[1] = _n[2] = NULL;
+    _rgb = NULL;
+  }
+  else
+  {
+    init(size, false, false);
+    for(unsigned int j=0; j<size; j++)
+    {
+      const Point& p = (*cloud)[j];
+      _c[0][j] = (T)p.x;
+      _c[1][j] = (T)p.y;
+      _c[2][j] = (T)p.z;
+    }
+  }
+}
+
+template <typename T>
+CompactCloud3D<T>::~CompactCloud3D()
+{
+  if(_buffer) free(_buffer);
+}
+
+template <typename T>
+void CompactCloud3D<T>::init(unsigned int size, bool withNormals, bool withColors)
+{
+  _size    = size;
+  _stride  = 1;
+  _nstride = 1;
+
+  const unsigned int padded = ((size + COMPACTCLOUDPADDING - 1) / COMPACTCLOUDPADDING) * COMPACTCLOUDPADDING;
+  const unsigned int arrays = withNormals ? 6 : 3;
+  size_t bytes = arrays * padded * sizeof(T) + (withColors ? 3*padded : 0);
+  if(bytes==0) bytes = 16;
+
+  if(posix_memalign(&_buffer, 16, bytes)!=0)
+  {
+    LOGMSG(DBG_ERROR, "Allocation of " << bytes << " bytes failed");
+    abort();
+  }
+
+  T* base = (T*)_buffer;
+  for(unsigned int i=0; i<3; i++)
+  {
+    _c[i] = base + i*padded;
+    _n[i] = withNormals ? base + (3+i)*padded : NULL;
+  }
+  _rgb = withColors ? (unsigned char*)(base + arrays*padded) : NULL;
+}
+
+template <typename T>
+void CompactCloud3D<T>::copyFrom(const double* coords, const double* normals, const unsigned char* rgb)
+{
+  for(unsigned int j=0; j<_size; j++)
+  {
+    for(unsigned int i=0; i<3; i++)
+      _c[i][j*_stride] = (T)coords[3*j+i];
+  }
+
+  if(normals && _n[0])
+  {
+    for(unsigned int j=0; j<_size; j++)
+    {
+      for(unsigned int i=0; i<3; i++)
+        _n[i][j*_nstride] = (T)normals[3*j+i];
+    }
+  }
+
+  if(rgb && _rgb && _rgb!=rgb)
+    memcpy(_rgb, rgb, 3*_size*sizeof(unsigned char));
+}
+
+template <typename T>
+void CompactCloud3D<T>::copyTo(double* coords, double* normals, unsigned char* rgb)
+{
+  for(unsigned int j=0; j<_size; j++)
+  {
+    for(unsigned int i=0; i<3; i++)
+      coords[3*j+i] = (double)_c[i][j*_stride];
+  }
+
+  if(normals && _n[0])
+  {
+    for(unsigned int j=0; j<_size; j++)
+    {
+      for(unsigned int i=0; i<3; i++)
+        normals[3*j+i] = (double)_n[i][j*_nstride];
+    }
+  }
+
+  if(rgb && _rgb && _rgb!=rgb)
+    memcpy(rgb, _rgb, 3*_size*sizeof(unsigned char));
+}
+
+template <typename T>
+unsigned int CompactCloud3D<T>::compact(const bool* mask)
+{
+  const unsigned int s  = _stride;
+  const unsigned int ns = _nstride;
+  const bool normals    = (_n[0]!=NULL);
+
+  unsigned int cnt = 0;
+  for(unsigned int j=0; j<_size; j++)
+  {
+    if(!mask[j]) continue;
+    if(cnt!=j)
+    {
+      _c[0][cnt*s] = _c[0][j*s];
+      _c[1][cnt*s] = _c[1][j*s];
+      _c[2][cnt*s] = _c[2][j*s];
+      if(normals)
+      {
+        _n[0][cnt*ns] = _n[0][j*ns];
+        _n[1][cnt*ns] = _n[1][j*ns];
+        _n[2][cnt*ns] = _n[2][j*ns];
+      }
+      if(_rgb)
+      {
+        _rgb[3*cnt]   = _rgb[3*j];
+        _rgb[3*cnt+1] = _rgb[3*j+1];
+        _rgb[3*cnt+2] = _rgb[3*j+2];
+      }
+    }
+    cnt++;
+  }
+  _size = cnt;
+  return cnt;
+}
+
+/**
+ * Affine transformation of strided component arrays, starting at element offset
+ */
+template <typename T>
+static void transformScalar(T* x, T* y, T* z, unsigned int stride, unsigned int offset, unsigned int size, const double tf[16], bool translate)
+{
+  const T r[9] = {(T)tf[0], (T)tf[1], (T)tf[2], (T)tf[4], (T)tf[5], (T)tf[6], (T)tf[8], (T)tf[9], (T)tf[10]};
+  const T t[3] = {translate ? (T)tf[3] : (T)0, translate ? (T)tf[7] : (T)0, translate ? (T)tf[11] : (T)0};
+  for(unsigned int j=offset; j<size; j++)
+  {
+    T* px = &x[j*stride];
+    T* py = &y[j*stride];
+    T* pz = &z[j*stride];
+    const T vx = *px;
+    const T vy = *py;
+    const T vz = *pz;
+    *px = r[0]*vx + r[1]*vy + r[2]*vz + t[0];
+    *py = r[3]*vx + r[4]*vy + r[5]*vz + t[1];
+    *pz = r[6]*vx + r[7]*vy + r[8]*vz + t[2];
+  }
+}
+
+/**
+ * Projection of strided component arrays, starting at element offset
+ */
+template <typename T>
+static unsigned int projectScalar(const T* x, const T* y, const T* z, unsigned int stride, unsigned int offset, unsigned int size,
+                                  const double P[12], unsigned int width, unsigned int height, int* indices)
+{
+  const T p[12] = {(T)P[0], (T)P[1], (T)P[2], (T)P[3], (T)P[4], (T)P[5], (T)P[6], (T)P[7], (T)P[8], (T)P[9], (T)P[10], (T)P[11]};
+  const T w = (T)width;
+  const T h = (T)height;
+  unsigned int cnt = 0;
+  for(unsigned int j=offset; j<size; j++)
+  {
+    const T vx = x[j*stride];
+    const T vy = y[j*stride];
+    const T vz = z[j*stride];
+    const T hz = p[8]*vx + p[9]*vy + p[10]*vz + p[11];
+    indices[j] = -1;
+    if(!(hz > (T)0)) continue;
+    const T u = (p[0]*vx + p[1]*vy + p[2]*vz + p[3]) / hz + (T)0.5;
+    const T v = (p[4]*vx + p[5]*vy + p[6]*vz + p[7]) / hz + (T)0.5;
+    if(u >= (T)0 && u < w && v >= (T)0 && v < h)
+    {
+      indices[j] = ((int)v)*width + (int)u;
+      cnt++;
+    }
+  }
+  return cnt;
+}
+
+/**
+ * SIMD kernels for contiguous components, return number of elements processed
+ */
+template <typename T>
+static unsigned int transformSIMD(T* x, T* y, T* z, unsigned int size, const double tf[16], bool translate)
+{
+  return 0;
+}
+
+template <typename T>
+static unsigned int projectSIMD(const T* x, const T* y, const T* z, unsigned int size, const double P[12], unsigned int width, unsigned int height, int* indices, unsigned int* cnt)
+{
+  return 0;
+}
+
+#ifdef __SSE2__
+
+template <>
+unsigned int transformSIMD<float>(float* x, float* y, float* z, unsigned int size, const double tf[16], bool translate)
+{
+  const __m128 r0 = _mm_set1_ps((float)tf[0]);
+  const __m128 r1 = _mm_set1_ps((float)tf[1]);
+  const __m128 r2 = _mm_set1_ps((float)tf[2]);
+  const __m128 r3 = _mm_set1_ps((float)tf[4]);
+  const __m128 r4 = _mm_set1_ps((float)tf[5]);
+  const __m128 r5 = _mm_set1_ps((float)tf[6]);
+  const __m128 r6 = _mm_set1_ps((float)tf[8]);
+  const __m128 r7 = _mm_set1_ps((float)tf[9]);
+  const __m128 r8 = _mm_set1_ps((float)tf[10]);
+  const __m128 t0 = _mm_set1_ps(translate ? (float)tf[3] : 0.f);
+  const __m128 t1 = _mm_set1_ps(translate ? (float)tf[7] : 0.f);
+  const __m128 t2 = _mm_set1_ps(translate ? (float)tf[11] : 0.f);
+
+  unsigned int j = 0;
+  for(; j+4<=size; j+=4)
+  {
+    const __m128 vx = _mm_loadu_ps(&x[j]);
+    const __m128 vy = _mm_loadu_ps(&y[j]);
+    const __m128 vz = _mm_loadu_ps(&z[j]);
+    _mm_storeu_ps(&x[j], _mm_add_ps(_mm_add_ps(_mm_mul_ps(r0, vx), _mm_mul_ps(r1, vy)), _mm_add_ps(_mm_mul_ps(r2, vz), t0)));
+    _mm_storeu_ps(&y[j], _mm_add_ps(_mm_add_ps(_mm_mul_ps(r3, vx), _mm_mul_ps(r4, vy)), _mm_add_ps(_mm_mul_ps(r5, vz), t1)));
+    _mm_storeu_ps(&z[j], _mm_add_ps(_mm_add_ps(_mm_mul_ps(r6, vx), _mm_mul_ps(r7, vy)), _mm_add_ps(_mm_mul_ps(r8, vz), t2)));
+  }
+  return j;
+}
+
+template <>
+unsigned int transformSIMD<double>(double* x, double* y, double* z, unsigned int size, const double tf[16], bool translate)
+{
+  const __m128d r0 = _mm_set1_pd(tf[0]);
+  const __m128d r1 = _mm_set1_pd(tf[1]);
+  const __m128d r2 = _mm_set1_pd(tf[2]);
+  const __m128d r3 = _mm_set1_pd(tf[4]);
+  const __m128d r4 = _mm_set1_pd(tf[5]);
+  const __m128d r5 = _mm_set1_pd(tf[6]);
+  const __m128d r6 = _mm_set1_pd(tf[8]);
+  const __m128d r7 = _mm_set1_pd(tf[9]);
+  const __m128d r8 = _mm_set1_pd(tf[10]);
+  const __m128d t0 = _mm_set1_pd(translate ? tf[3] : 0.0);
+  const __m128d t1 = _mm_set1_pd(translate ? tf[7] : 0.0);
+  const __m128d t2 = _mm_set1_pd(translate ? tf[11] : 0.0);
+
+  unsigned int j = 0;
+  for(; j+2<=size; j+=2)
+  {
+    const __m128d vx = _mm_loadu_pd(&x[j]);
+    const __m128d vy = _mm_loadu_pd(&y[j]);
+    const __m128d vz = _mm_loadu_pd(&z[j]);
+    _mm_storeu_pd(&x[j], _mm_add_pd(_mm_add_pd(_mm_mul_pd(r0, vx), _mm_mul_pd(r1, vy)), _mm_add_pd(_mm_mul_pd(r2, vz), t0)));
+    _mm_storeu_pd(&y[j], _mm_add_pd(_mm_add_pd(_mm_mul_pd(r3, vx), _mm_mul_pd(r4, vy)), _mm_add_pd(_mm_mul_pd(r5, vz), t1)));
+    _mm_storeu_pd(&z[j], _mm_add_pd(_mm_add_pd(_mm_mul_pd(r6, vx), _mm_mul_pd(r7, vy)), _mm_add_pd(_mm_mul_pd(r8, vz), t2)));
+  }
+  return j;
+}
+
+template <>
+unsigned int projectSIMD<float>(const float* x, const float* y, const float* z, unsigned int size, const double P[12], unsigned int width, unsigned int height, int* indices, unsigned int* cnt)
+{
+  __m128 p[12];
+  for(unsigned int i=0; i<12; i++)
+    p[i] = _mm_set1_ps((float)P[i]);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 w    = _mm_set1_ps((float)width);
+  const __m128 h    = _mm_set1_ps((float)height);
+  const __m128i inv = _mm_set1_epi32(-1);
+
+  unsigned int j = 0;
+  for(; j+4<=size; j+=4)
+  {
+    const __m128 vx = _mm_loadu_ps(&x[j]);
+    const __m128 vy = _mm_loadu_ps(&y[j]);
+    const __m128 vz = _mm_loadu_ps(&z[j]);
+    const __m128 hx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p[0], vx), _mm_mul_ps(p[1], vy)), _mm_add_ps(_mm_mul_ps(p[2], vz), p[3]));
+    const __m128 hy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p[4], vx), _mm_mul_ps(p[5], vy)), _mm_add_ps(_mm_mul_ps(p[6], vz), p[7]));
+    const __m128 hz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p[8], vx), _mm_mul_ps(p[9], vy)), _mm_add_ps(_mm_mul_ps(p[10], vz), p[11]));
+    const __m128 u  = _mm_add_ps(_mm_div_ps(hx, hz), half);
+    const __m128 v  = _mm_add_ps(_mm_div_ps(hy, hz), half);
+    __m128 valid = _mm_cmpgt_ps(hz, zero);
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmplt_ps(u, w)));
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmplt_ps(v, h)));
+
+    // Pixel index is computed in single precision, which is exact for images with less than 2^24 pixels
+    const __m128 ui = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_and_ps(u, valid)));
+    const __m128 vi = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_and_ps(v, valid)));
+    const __m128i idx = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(vi, w), ui));
+    const __m128i m   = _mm_castps_si128(valid);
+    _mm_storeu_si128((__m128i*)&indices[j], _mm_or_si128(_mm_and_si128(m, idx), _mm_andnot_si128(m, inv)));
+
+    const int lanes = _mm_movemask_ps(valid);
+    *cnt += (lanes & 1) + ((lanes >> 1) & 1) + ((lanes >> 2) & 1) + ((lanes >> 3) & 1);
+  }
+  return j;
+}
+
+template <>
+unsigned int projectSIMD<double>(const double* x, const double* y, const double* z, unsigned int size, const double P[12], unsigned int width, unsigned int height, int* indices, unsigned int* cnt)
+{
+  __m128d p[12];
+  for(unsigned int i=0; i<12; i++)
+    p[i] = _mm_set1_pd(P[i]);
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d half = _mm_set1_pd(0.5);
+  const __m128d w    = _mm_set1_pd((double)width);
+  const __m128d h    = _mm_set1_pd((double)height);
+  const __m128i inv  = _mm_set1_epi32(-1);
+
+  unsigned int j = 0;
+  for(; j+2<=size; j+=2)
+  {
+    const __m128d vx = _mm_loadu_pd(&x[j]);
+    const __m128d vy = _mm_loadu_pd(&y[j]);
+    const __m128d vz = _mm_loadu_pd(&z[j]);
+    const __m128d hx = _mm_add_pd(_mm_add_pd(_mm_mul_pd(p[0], vx), _mm_mul_pd(p[1], vy)), _mm_add_pd(_mm_mul_pd(p[2], vz), p[3]));
+    const __m128d hy = _mm_add_pd(_mm_add_pd(_mm_mul_pd(p[4], vx), _mm_mul_pd(p[5], vy)), _mm_add_pd(_mm_mul_pd(p[6], vz), p[7]));
+    const __m128d hz = _mm_add_pd(_mm_add_pd(_mm_mul_pd(p[8], vx), _mm_mul_pd(p[9], vy)), _mm_add_pd(_mm_mul_pd(p[10], vz), p[11]));
+    const __m128d u  = _mm_add_pd(_mm_div_pd(hx, hz), half);
+    const __m128d v  = _mm_add_pd(_mm_div_pd(hy, hz), half);
+    __m128d valid = _mm_cmpgt_pd(hz, zero);
+    valid = _mm_and_pd(valid, _mm_and_pd(_mm_cmpge_pd(u, zero), _mm_cmplt_pd(u, w)));
+    valid = _mm_and_pd(valid, _mm_and_pd(_mm_cmpge_pd(v, zero), _mm_cmplt_pd(v, h)));
+
+    const __m128d ui  = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_and_pd(u, valid)));
+    const __m128d vi  = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_and_pd(v, valid)));
+    const __m128i idx = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(vi, w), ui));
+
+    // Reduce 64 bit lane mask to the two lower 32 bit lanes
+    const int lanes  = _mm_movemask_pd(valid);
+    const __m128i m  = _mm_set_epi32(0, 0, (lanes & 2) ? -1 : 0, (lanes & 1) ? -1 : 0);
+    _mm_storel_epi64((__m128i*)&indices[j], _mm_or_si128(_mm_and_si128(m, idx), _mm_andnot_si128(m, inv)));
+
+    *cnt += (lanes & 1) + ((lanes >> 1) & 1);
+  }
+  return j;
+}
+
+#endif
+
+template <typename T>
+void CompactCloud3D<T>::transform(const double tf[16])
+{
+  unsigned int offset = 0;
+  if(_stride==1)
+    offset = transformSIMD<T>(_c[0], _c[1], _c[2], _size, tf, true);
+  transformScalar<T>(_c[0], _c[1], _c[2], _stride, offset, _size, tf, true);
+
+  if(_n[0])
+  {
+    offset = 0;
+    if(_nstride==1)
+      offset = transformSIMD<T>(_n[0], _n[1], _n[2], _size, tf, false);
+    transformScalar<T>(_n[0], _n[1], _n[2], _nstride, offset, _size, tf, false);
+  }
+}
+
+template <typename T>
+unsigned int CompactCloud3D<T>::project(const double P[12], unsigned int width, unsigned int height, int* indices)
+{
+  unsigned int cnt = 0;
+  unsigned int offset = 0;
+  if(_stride==1)
+    offset = projectSIMD<T>(_c[0], _c[1], _c[2], _size, P, width, height, indices, &cnt);
+  cnt += projectScalar<T>(_c[0], _c[1], _c[2], _stride, offset, _size, P, width, height, indices);
+  return cnt;
+}
+
+template class CompactCloud3D<float>;
+template class CompactCloud3D<double>;
+
+}
@@ -0,0 +1,186 @@
+#ifndef COMPACTCLOUD3D_H
+#define COMPACTCLOUD3D_H
+
+#include "obcore/base/CartesianCloud.h"
+#include "obcore/base/PointCloud.h"
+
+/**
+ * @namespace obvious
+ */
+namespace obvious
+{
+
+/**
+ * @class CompactCloud3D
+ * @brief Point cloud with structure-of-arrays layout in single or double precision.
+ *
+ * Coordinates and normals are stored component-wise in contiguous, 16-byte aligned arrays, colors as rgb triples.
+ * Transformation and projection are processed with SIMD instructions, if available.
+ * Besides owning its memory, a cloud can act as zero-copy view on foreign buffers, i.e., interleaved coordinate arrays
+ * (layout x1y1z1x2...) as taken by ICP and TSD interfaces, CartesianCloud3D and PointCloud<Point>. Views access components
+ * with a stride, modifications (including compaction) are applied to the foreign buffers. Views on CartesianCloud3D and
+ * PointCloud<Point> are only possible if the precision matches, otherwise data is copied.
+ * @author Stefan May
+ */
+template <typename T>
+class CompactCloud3D
+{
+public:
+
+  /**
+   * Constructor, allocates owned memory
+   * @param size number of points
+   * @param withNormals allocate normals
+   * @param withColors allocate colors
+   */
+  CompactCloud3D(unsigned int size, bool withNormals=false, bool withColors=false);
+
+  /**
+   * Constructor of view on interleaved buffers
+   * @param coords coordinates (layout x1y1z1x2...)
+   * @param size number of points
+   * @param normals normals (layout x1y1z1x2..., may be NULL)
+   * @param rgb colors (layout r1g1b1r2..., may be NULL)
+   */
+  CompactCloud3D(T* coords, unsigned int size, T* normals=NULL, unsigned char* rgb=NULL);
+
+  /**
+   * Constructor of view on CartesianCloud3D (copies, if T is not double)
+   * @param cloud source cloud
+   */
+  CompactCloud3D(CartesianCloud3D* cloud);
+
+  /**
+   * Constructor of view on PointCloud (copies, if T is not obfloat)
+   * @param cloud source cloud
+   */
+  CompactCloud3D(PointCloud<Point>* cloud);
+
+  /**
+   * Destructor
+   */
+  ~CompactCloud3D();
+
+  /**
+   * Get number of points
+   * @return number of points
+   */
+  unsigned int size() { return _size; };
+
+  /**
+   * Query whether cloud is a view on foreign buffers
+   * @return true for views
+   */
+  bool isView() { return _buffer==NULL; };
+
+  /**
+   * Query presence of normals
+   * @return true if normals are present
+   */
+  bool hasNormals() { return _n[0]!=NULL; };
+
+  /**
+   * Query presence of colors
+   * @return true if colors are present
+   */
+  bool hasColors() { return _rgb!=NULL; };
+
+  /**
+   * Access coordinate component, element i is located at getCoords(axis)[i*getStride()]
+   * @param axis 0=x, 1=y, 2=z
+   * @return pointer to component array
+   */
+  T* getCoords(unsigned int axis) { return _c[axis]; };
+
+  /**
+   * Access normal component, element i is located at getNormals(axis)[i*getNormalStride()]
+   * @param axis 0=x, 1=y, 2=z
+   * @return pointer to component array or NULL
+   */
+  T* getNormals(unsigned int axis) { return _n[axis]; };
+
+  /**
+   * Access colors
+   * @return pointer to colors (layout r1g1b1r2...) or NULL
+   */
+  unsigned char* getColors() { return _rgb; };
+
+  /**
+   * Get stride of coordinate components
+   * @return stride (1 for owned memory)
+   */
+  unsigned int getStride() { return _stride; };
+
+  /**
+   * Get stride of normal components
+   * @return stride (1 for owned memory)
+   */
+  unsigned int getNormalStride() { return _nstride; };
+
+  /**
+   * Import interleaved data, the size of the cloud is kept
+   * @param coords coordinates (layout x1y1z1x2...)
+   * @param normals normals (layout x1y1z1x2..., ignored if NULL or cloud has no normals)
+   * @param rgb colors (layout r1g1b1r2..., ignored if NULL or cloud has no colors)
+   */
+  void copyFrom(const double* coords, const double* normals=NULL, const unsigned char* rgb=NULL);
+
+  /**
+   * Export interleaved data, e.g., for ICP and TSD interfaces
+   * @param coords coordinates (layout x1y1z1x2..., size 3*size())
+   * @param normals normals (layout x1y1z1x2..., may be NULL)
+   * @param rgb colors (layout r1g1b1r2..., may be NULL)
+   */
+  void copyTo(double* coords, double* normals=NULL, unsigned char* rgb=NULL);
+
+  /**
+   * Remove points in a single pass, the order of remaining points is kept
+   * @param mask validity mask (size size()), points with false entries are removed
+   * @return number of remaining points
+   */
+  unsigned int compact(const bool* mask);
+
+  /**
+   * Transform cloud, normals are rotated
+   * @param tf transformation matrix (row-major, size 16)
+   */
+  void transform(const double tf[16]);
+
+  /**
+   * Project points to image plane
+   * @param[in] P projection matrix (row-major, size 12)
+   * @param[in] width width of image
+   * @param[in] height height of image
+   * @param[out] indices pixel index v*width+u per point, -1 for points behind the camera or outside of the image
+   * @return number of points projected to image
+   */
+  unsigned int project(const double P[12], unsigned int width, unsigned int height, int* indices);
+
+private:
+
+  void init(unsigned int size, bool withNormals, bool withColors);
+
+  // coordinate components
+  T* _c[3];
+
+  // normal components
+  T* _n[3];
+
+  unsigned char* _rgb;
+
+  unsigned int _size;
+
+  unsigned int _stride;
+
+  unsigned int _nstride;
+
+  // owned memory, NULL for views
+  void* _buffer;
+};
+
+typedef CompactCloud3D<float> CompactCloud3Df;
+typedef CompactCloud3D<double> CompactCloud3Dd;
+
+}
+
+#endif /* COMPACTCLOUD3D_H */
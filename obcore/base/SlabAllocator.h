@@ -0,0 +1,109 @@
+#ifndef SLABALLOCATOR_H_
+#define SLABALLOCATOR_H_
+
+#include <vector>
+#include <omp.h>
+
+/**
+ * @namespace obvious
+ */
+namespace obvious
+{
+
+/**
+ * @class SlabAllocator
+ * @brief Pool of fixed-size blocks, e.g., the voxel data of partitions.
+ * Blocks are carved out of large contiguous slabs and recycled on release, memory is returned to the system on destruction only.
+ * Each OpenMP thread allocates from and releases to its own free list, slabs are shared under a lock.
+ * Free lists are selected by OpenMP thread number inside a non-nested parallel region only, calls outside of it,
+ * e.g., from the main thread or other non-OpenMP threads, and from nested regions take a shared list under the lock.
+ * Parallel regions started concurrently by different non-OpenMP threads must not use the same allocator,
+ * since their thread numbers coincide.
+ * @author Stefan May
+ */
+template <class T>
+class SlabAllocator
+{
+public:
+    /**
+     * Constructor
+     * @param blockSize number of elements per block
+     * @param blocksPerSlab number of blocks allocated at once
+     */
+    SlabAllocator(unsigned int blockSize, unsigned int blocksPerSlab=32);
+
+    /**
+     * Destructor, all slabs are freed, i.e., blocks must not be used anymore
+     */
+    ~SlabAllocator();
+
+    /**
+     * Get block, content is undefined
+     * @return block of getBlockSize() elements
+     */
+    T* allocate();
+
+    /**
+     * Return block to pool
+     * @param block block obtained by allocate
+     */
+    void release(T* block);
+
+    /**
+     * Get number of elements per block
+     * @return block size
+     */
+    unsigned int getBlockSize();
+
+    /**
+     * Get number of blocks in use
+     * @return number of blocks
+     */
+    unsigned int getBlocksInUse();
+
+    /**
+     * Get number of blocks held by slabs, i.e., blocks in use and free blocks
+     * @return number of blocks
+     */
+    unsigned int getBlocksReserved();
+
+private:
+
+    /**
+     * Get free list of calling thread
+     * @return index of list, -1 if the shared list needs to be used
+     */
+    int getListIndex();
+
+    /**
+     * Move free blocks from shared list to a thread's list, a new slab is allocated if the shared list is empty
+     * @param list free list of thread
+     */
+    void refill(std::vector<T*>& list);
+
+    /**
+     * Allocate new slab and add its blocks to a free list, caller needs to hold the lock
+     * @param list free list
+     */
+    void grow(std::vector<T*>& list);
+
+    unsigned int _blockSize;
+
+    unsigned int _blocksPerSlab;
+
+    std::vector<T*> _slabs;
+
+    // Free lists per thread
+    std::vector< std::vector<T*> > _freeLists;
+
+    // Free list for balancing between threads and for threads exceeding the number of lists
+    std::vector<T*> _shared;
+
+    int _blocksInUse;
+};
+
+#include "SlabAllocator.inl"
+
+}
+
+#endif /*SLABALLOCATOR_H_*/
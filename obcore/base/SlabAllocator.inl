@@ -0,0 +1,133 @@
+template <class T>
+SlabAllocator<T>::SlabAllocator(unsigned int blockSize, unsigned int blocksPerSlab)
+{
+    _blockSize     = blockSize;
+    _blocksPerSlab = blocksPerSlab;
+    _blocksInUse   = 0;
+    int threads = omp_get_max_threads();
+    if(omp_get_num_procs() > threads) threads = omp_get_num_procs();
+    _freeLists.resize(threads);
+}
+
+template <class T>
+SlabAllocator<T>::~SlabAllocator()
+{
+    for(unsigned int i=0; i<_slabs.size(); i++)
+        delete [] _slabs[i];
+}
+
+template <class T>
+T* SlabAllocator<T>::allocate()
+{
+    T* block;
+    const int t = getListIndex();
+    if(t >= 0)
+    {
+        std::vector<T*>& list = _freeLists[t];
+        if(list.empty()) refill(list);
+        block = list.back();
+        list.pop_back();
+    }
+    else
+    {
+#pragma omp critical(slaballocator)
+        {
+            if(_shared.empty()) grow(_shared);
+            block = _shared.back();
+            _shared.pop_back();
+        }
+    }
+#pragma omp atomic
+    _blocksInUse++;
+    return block;
+}
+
+template <class T>
+void SlabAllocator<T>::release(T* block)
+{
+    const int t = getListIndex();
+    if(t >= 0)
+    {
+        std::vector<T*>& list = _freeLists[t];
+        list.push_back(block);
+        // Surplus is handed over to other threads
+        if(list.size() >= 2*_blocksPerSlab)
+        {
+#pragma omp critical(slaballocator)
+            {
+                _shared.insert(_shared.end(), list.end()-_blocksPerSlab, list.end());
+            }
+            list.resize(list.size()-_blocksPerSlab);
+        }
+    }
+    else
+    {
+#pragma omp critical(slaballocator)
+        {
+            _shared.push_back(block);
+        }
+    }
+#pragma omp atomic
+    _blocksInUse--;
+}
+
+template <class T>
+unsigned int SlabAllocator<T>::getBlockSize()
+{
+    return _blockSize;
+}
+
+template <class T>
+unsigned int SlabAllocator<T>::getBlocksInUse()
+{
+    return _blocksInUse;
+}
+
+template <class T>
+unsigned int SlabAllocator<T>::getBlocksReserved()
+{
+    unsigned int blocks;
+#pragma omp critical(slaballocator)
+    {
+        blocks = _slabs.size() * _blocksPerSlab;
+    }
+    return blocks;
+}
+
+template <class T>
+int SlabAllocator<T>::getListIndex()
+{
+    // Thread numbers identify threads uniquely only within a single, non-nested team
+    if(!omp_in_parallel() || omp_get_level()!=1) return -1;
+    const unsigned int t = omp_get_thread_num();
+    if(t >= _freeLists.size()) return -1;
+    return t;
+}
+
+template <class T>
+void SlabAllocator<T>::refill(std::vector<T*>& list)
+{
+#pragma omp critical(slaballocator)
+    {
+        if(_shared.empty())
+        {
+            grow(list);
+        }
+        else
+        {
+            unsigned int n = _shared.size() < _blocksPerSlab ? _shared.size() : _blocksPerSlab;
+            list.insert(list.end(), _shared.end()-n, _shared.end());
+            _shared.resize(_shared.size()-n);
+        }
+    }
+}
+
+template <class T>
+void SlabAllocator<T>::grow(std::vector<T*>& list)
+{
+    T* slab = new T[_blockSize*_blocksPerSlab];
+    _slabs.push_back(slab);
+    // Blocks are handed out in ascending order
+    for(unsigned int i=_blocksPerSlab; i>0; i--)
+        list.push_back(&slab[(i-1)*_blockSize]);
+}
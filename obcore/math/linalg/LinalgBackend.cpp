@@ -0,0 +1,379 @@
+#include "LinalgBackend.h"
+
+#include <string.h>
+#include <limits.h>
+#include <stdlib.h>
+
+// Eigen is header-only and required by obcore, GSL kernels are available with the GSL storage backend only
+#if !EIGENUSED
+#include <gsl/gsl_blas.h>
+#include <gsl/gsl_linalg.h>
+#include <gsl/gsl_statistics_double.h>
+#endif
+#include <Eigen/Dense>
+
+#include "obcore/base/Timer.h"
+#include "obcore/base/Logger.h"
+
+namespace obvious
+{
+
+typedef Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> > RowMajorMap;
+typedef Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> > ConstRowMajorMap;
+
+EnumLinalgBackend LinalgBackend::_backend = LINALG_AUTO;
+
+// Eigen avoids the allocation overhead of GSL for small problems, large problems profit from an optimized BLAS linked to GSL.
+// By default, all sizes are processed with the storage backend of Matrix, call calibrate() to adapt thresholds to the target machine.
+#if EIGENUSED
+unsigned int LinalgBackend::_threshold[LINALG_OPERATIONS] = {UINT_MAX, UINT_MAX, UINT_MAX, UINT_MAX};
+#else
+unsigned int LinalgBackend::_threshold[LINALG_OPERATIONS] = {0, 0, 0, 0};
+#endif
+
+#if !EIGENUSED
+static void multiplyGSL(const double* M, double* array, unsigned int rows, unsigned int cols)
+{
+  gsl_matrix_const_view Mv = gsl_matrix_const_view_array(M, cols, cols);
+  gsl_matrix_view V = gsl_matrix_view_array(array, rows, cols);
+  gsl_matrix* work = gsl_matrix_alloc(rows, cols);
+  gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0, &(V.matrix), &(Mv.matrix), 0.0, work);
+  gsl_matrix_memcpy(&V.matrix, work);
+  gsl_matrix_free(work);
+}
+#endif
+
+static void multiplyEigen(const double* M, double* array, unsigned int rows, unsigned int cols)
+{
+  ConstRowMajorMap Mm(M, cols, cols);
+  RowMajorMap map(array, rows, cols);
+  map = map * Mm.transpose();
+}
+
+#if !EIGENUSED
+static void invertGSL(double* A, unsigned int dim)
+{
+  int sig;
+  gsl_matrix_view Av = gsl_matrix_view_array(A, dim, dim);
+  gsl_permutation* perm = gsl_permutation_alloc(dim);
+  gsl_matrix* work = gsl_matrix_alloc(dim, dim);
+  gsl_matrix_memcpy(work, &Av.matrix);
+  gsl_linalg_LU_decomp(work, perm, &sig);
+  gsl_linalg_LU_invert(work, perm, &Av.matrix);
+  gsl_matrix_free(work);
+  gsl_permutation_free(perm);
+}
+#endif
+
+static void invertEigen(double* A, unsigned int dim)
+{
+  RowMajorMap map(A, dim, dim);
+  Eigen::MatrixXd Ai = map.inverse();
+  map = Ai;
+}
+
+#if !EIGENUSED
+static void svdGSL(const double* A, unsigned int rows, unsigned int cols, double* U, double* s, double* V)
+{
+  memcpy(U, A, rows*cols*sizeof(double));
+  gsl_matrix_view Uv = gsl_matrix_view_array(U, rows, cols);
+  gsl_matrix_view Vv = gsl_matrix_view_array(V, cols, cols);
+  gsl_vector_view sv = gsl_vector_view_array(s, cols);
+  gsl_vector* work = gsl_vector_alloc(cols);
+  gsl_linalg_SV_decomp(&Uv.matrix, &Vv.matrix, &sv.vector, work);
+  gsl_vector_free(work);
+}
+#endif
+
+static void svdEigen(const double* A, unsigned int rows, unsigned int cols, double* U, double* s, double* V)
+{
+  Eigen::MatrixXd M = ConstRowMajorMap(A, rows, cols);
+  Eigen::JacobiSVD<Eigen::MatrixXd> svdOfM(M, Eigen::ComputeThinU | Eigen::ComputeThinV);
+  RowMajorMap(U, rows, cols) = svdOfM.matrixU();
+  RowMajorMap(V, cols, cols) = svdOfM.matrixV();
+  Eigen::VectorXd singular = svdOfM.singularValues();
+  for(unsigned int i=0; i<cols; i++)
+    s[i] = singular(i);
+}
+
+#if !EIGENUSED
+static void pcaGSL(const double* A, unsigned int rows, unsigned int dim, double* axes)
+{
+  gsl_matrix_const_view Av = gsl_matrix_const_view_array(A, rows, dim);
+  gsl_matrix* M = gsl_matrix_alloc(rows, dim);
+  gsl_matrix_memcpy(M, &Av.matrix);
+
+  // calculate centroid
+  double* cent = new double[dim];
+  for(unsigned int i=0; i<dim; i++)
+    cent[i] = gsl_stats_mean(A+i, dim, rows);
+
+  for(unsigned int i=0; i<dim; i++)
+  {
+    gsl_vector_view c = gsl_matrix_column(M, i);
+    gsl_vector_add_constant(&c.vector, -cent[i]);
+  }
+
+  gsl_matrix* MtM = gsl_matrix_alloc(dim, dim);
+  gsl_blas_dgemm(CblasTrans, CblasNoTrans, 1.0, M, M, 0.0, MtM);
+
+  gsl_matrix* V = gsl_matrix_alloc(dim, dim);
+  gsl_vector* s = gsl_vector_alloc(dim);
+  gsl_linalg_SV_decomp_jacobi(MtM, V, s);
+
+  gsl_matrix* P = gsl_matrix_alloc(dim, rows);
+  gsl_blas_dgemm(CblasTrans, CblasTrans, 1.0, V, M, 0.0, P);
+
+  for(unsigned int i=0; i<dim; i++)
+  {
+    // coordinates in coordinate system of eigenvectors
+    gsl_vector_view coord = gsl_matrix_row(P, i);
+
+    // align centroid to center of extends
+    double max = gsl_vector_max(&coord.vector);
+    double min = gsl_vector_min(&coord.vector);
+    double align = 0.0;
+    if(max - min > 1e-6)
+      align = (max + min)/2.0;
+
+    for(unsigned int j=0; j<dim; j++)
+      cent[j] += gsl_matrix_get(V, j, i)*align;
+  }
+
+  for(unsigned int i=0; i<dim; i++)
+  {
+    gsl_vector_view coord = gsl_matrix_row(P, i);
+
+    // extends of axis in orientation of eigenvector i
+    double ext = gsl_vector_max(&coord.vector) - gsl_vector_min(&coord.vector);
+
+    // axis coordinates with respect to center of original coordinate system
+    for(unsigned int j=0; j<dim; j++)
+    {
+      double e = gsl_matrix_get(V, j, i)*ext/2.0;
+      axes[i*2*dim+2*j]   = cent[j] - e;
+      axes[i*2*dim+2*j+1] = cent[j] + e;
+    }
+  }
+
+  gsl_matrix_free(P);
+  gsl_vector_free(s);
+  gsl_matrix_free(V);
+  gsl_matrix_free(MtM);
+  gsl_matrix_free(M);
+  delete [] cent;
+}
+#endif
+
+static void pcaEigen(const double* A, unsigned int rows, unsigned int dim, double* axes)
+{
+  Eigen::MatrixXd M = ConstRowMajorMap(A, rows, dim);
+
+  // calculate centroid
+  Eigen::RowVectorXd cent = M.colwise().mean();
+  M.rowwise() -= cent;
+
+  Eigen::MatrixXd MtM = M.transpose() * M;
+  Eigen::JacobiSVD<Eigen::MatrixXd> svdOfMtM(MtM, Eigen::ComputeFullV);
+  Eigen::MatrixXd V = svdOfMtM.matrixV();
+
+  // coordinates in coordinate system of eigenvectors
+  Eigen::MatrixXd P = V.transpose() * M.transpose();
+
+  // align centroid to center of extends
+  for(unsigned int i=0; i<dim; i++)
+  {
+    double max = P.row(i).maxCoeff();
+    double min = P.row(i).minCoeff();
+    if(max - min > 1e-6)
+      cent += V.col(i).transpose() * ((max + min)/2.0);
+  }
+
+  for(unsigned int i=0; i<dim; i++)
+  {
+    // extends of axis in orientation of eigenvector i
+    double ext = P.row(i).maxCoeff() - P.row(i).minCoeff();
+
+    // axis coordinates with respect to center of original coordinate system
+    for(unsigned int j=0; j<dim; j++)
+    {
+      double e = V(j, i)*ext/2.0;
+      axes[i*2*dim+2*j]   = cent(j) - e;
+      axes[i*2*dim+2*j+1] = cent(j) + e;
+    }
+  }
+}
+
+void LinalgBackend::setBackend(EnumLinalgBackend backend)
+{
+  _backend = backend;
+}
+
+EnumLinalgBackend LinalgBackend::getBackend()
+{
+  return _backend;
+}
+
+void LinalgBackend::setThreshold(EnumLinalgOperation op, unsigned int size)
+{
+  _threshold[op] = size;
+}
+
+unsigned int LinalgBackend::getThreshold(EnumLinalgOperation op)
+{
+  return _threshold[op];
+}
+
+bool LinalgBackend::isAvailable(EnumLinalgBackend backend)
+{
+#if EIGENUSED
+  return backend != LINALG_GSL;
+#else
+  return true;
+#endif
+}
+
+EnumLinalgBackend LinalgBackend::select(EnumLinalgOperation op, unsigned int size)
+{
+  if(_backend != LINALG_AUTO) return _backend;
+  return (size < _threshold[op]) ? LINALG_EIGEN : LINALG_GSL;
+}
+
+void LinalgBackend::multiply(const double* M, double* array, unsigned int rows, unsigned int cols, EnumLinalgBackend backend)
+{
+  if(backend == LINALG_AUTO) backend = select(LINALG_MULTIPLY, rows);
+#if !EIGENUSED
+  if(backend == LINALG_GSL)
+  {
+    multiplyGSL(M, array, rows, cols);
+    return;
+  }
+#endif
+  multiplyEigen(M, array, rows, cols);
+}
+
+void LinalgBackend::invert(double* A, unsigned int dim, EnumLinalgBackend backend)
+{
+  if(backend == LINALG_AUTO) backend = select(LINALG_INVERT, dim);
+#if !EIGENUSED
+  if(backend == LINALG_GSL)
+  {
+    invertGSL(A, dim);
+    return;
+  }
+#endif
+  invertEigen(A, dim);
+}
+
+void LinalgBackend::svd(const double* A, unsigned int rows, unsigned int cols, double* U, double* s, double* V, EnumLinalgBackend backend)
+{
+  if(rows < cols)
+  {
+    LOGMSG(DBG_ERROR, "Number of rows must not be smaller than number of columns");
+    return;
+  }
+  if(backend == LINALG_AUTO) backend = select(LINALG_SVD, rows);
+#if !EIGENUSED
+  if(backend == LINALG_GSL)
+  {
+    svdGSL(A, rows, cols, U, s, V);
+    return;
+  }
+#endif
+  svdEigen(A, rows, cols, U, s, V);
+}
+
+void LinalgBackend::pcaAnalysis(const double* A, unsigned int rows, unsigned int dim, double* axes, EnumLinalgBackend backend)
+{
+  if(backend == LINALG_AUTO) backend = select(LINALG_PCA, rows);
+#if !EIGENUSED
+  if(backend == LINALG_GSL)
+  {
+    pcaGSL(A, rows, dim, axes);
+    return;
+  }
+#endif
+  pcaEigen(A, rows, dim, axes);
+}
+
+double LinalgBackend::benchmark(EnumLinalgOperation op, unsigned int size, EnumLinalgBackend backend)
+{
+  const unsigned int cols = (op==LINALG_MULTIPLY || op==LINALG_PCA) ? 3 : size;
+  const unsigned int elements = size*cols;
+  double* A = new double[elements];
+  double* B = new double[elements];
+  double* s = new double[cols];
+  double* V = new double[cols*cols > 6*cols ? cols*cols : 6*cols];
+  double M[9] = {0.36, -0.48, 0.8, 0.8, 0.6, 0.0, -0.48, 0.64, 0.6};
+
+  srand(0);
+  for(unsigned int i=0; i<elements; i++)
+    A[i] = (double)rand() / RAND_MAX;
+  // diagonal dominance keeps matrices well-conditioned for inversion
+  if(op==LINALG_INVERT)
+    for(unsigned int i=0; i<size; i++)
+      A[i*size+i] += size;
+
+  double best = 1e9;
+  Timer timer;
+  for(unsigned int r=0; r<5; r++)
+  {
+    memcpy(B, A, elements*sizeof(double));
+    timer.start();
+    switch(op)
+    {
+    case LINALG_MULTIPLY:
+      LinalgBackend::multiply(M, B, size, cols, backend);
+      break;
+    case LINALG_INVERT:
+      LinalgBackend::invert(B, size, backend);
+      break;
+    case LINALG_SVD:
+      LinalgBackend::svd(A, size, cols, B, s, V, backend);
+      break;
+    default:
+      LinalgBackend::pcaAnalysis(A, size, cols, V, backend);
+      break;
+    }
+    double t = timer.elapsed();
+    if(t < best) best = t;
+  }
+
+  delete [] A;
+  delete [] B;
+  delete [] s;
+  delete [] V;
+  return best;
+}
+
+void LinalgBackend::calibrate()
+{
+  if(!isAvailable(LINALG_GSL))
+  {
+    LOGMSG(DBG_DEBUG, "GSL kernels are not available, Eigen is used for all sizes");
+    return;
+  }
+
+  const unsigned int ladders = 4;
+  const unsigned int sizes[LINALG_OPERATIONS][ladders] = {{64, 1024, 16384, 262144},
+                                                          {4, 16, 64, 256},
+                                                          {4, 16, 64, 128},
+                                                          {256, 4096, 65536, 262144}};
+
+  for(unsigned int op=0; op<LINALG_OPERATIONS; op++)
+  {
+    // GSL takes over from the smallest size on, from which it is faster for all larger sizes
+    unsigned int threshold = UINT_MAX;
+    for(int i=ladders-1; i>=0; i--)
+    {
+      double tGSL   = benchmark((EnumLinalgOperation)op, sizes[op][i], LINALG_GSL);
+      double tEigen = benchmark((EnumLinalgOperation)op, sizes[op][i], LINALG_EIGEN);
+      if(tGSL >= tEigen) break;
+      threshold = sizes[op][i];
+    }
+    _threshold[op] = threshold;
+    LOGMSG(DBG_DEBUG, "Threshold of operation " << op << ": " << threshold);
+  }
+}
+
+}
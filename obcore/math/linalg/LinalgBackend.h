@@ -0,0 +1,144 @@
+#ifndef LINALGBACKEND_H__
+#define LINALGBACKEND_H__
+
+/**
+ * @namespace obvious
+ */
+namespace obvious
+{
+
+/**
+ * Linear algebra backends, LINALG_AUTO selects by problem size
+ */
+enum EnumLinalgBackend { LINALG_AUTO  = 0,
+                         LINALG_GSL   = 1,
+                         LINALG_EIGEN = 2};
+
+/**
+ * Operations dispatched at runtime
+ */
+enum EnumLinalgOperation { LINALG_MULTIPLY   = 0,
+                           LINALG_INVERT     = 1,
+                           LINALG_SVD        = 2,
+                           LINALG_PCA        = 3,
+                           LINALG_OPERATIONS = 4};
+
+/**
+ * @class LinalgBackend
+ * @brief Runtime dispatch of hot linear algebra kernels to GSL or Eigen.
+ * With the GSL storage backend of Matrix, both backends are compiled side by side. The Eigen storage backend (USE_EIGEN) compiles
+ * Eigen kernels only, requests for GSL are processed with Eigen then.
+ * All data is passed as row-major arrays. Per operation, sizes below a threshold are processed with Eigen, larger ones with GSL.
+ * By default, all sizes are processed with the storage backend. Thresholds can be set explicitly or determined with calibrate() on the target machine.
+ * @author Stefan May
+ */
+class LinalgBackend
+{
+public:
+
+  /**
+   * Force backend for all operations
+   * @param backend backend, LINALG_AUTO restores size-based selection
+   */
+  static void setBackend(EnumLinalgBackend backend);
+
+  /**
+   * Get forced backend
+   * @return backend, LINALG_AUTO if selection is size-based
+   */
+  static EnumLinalgBackend getBackend();
+
+  /**
+   * Set size from which on GSL is used
+   * @param op operation
+   * @param size number of rows (multiply, pcaAnalysis) or dimension (invert, svd)
+   */
+  static void setThreshold(EnumLinalgOperation op, unsigned int size);
+
+  /**
+   * Get size from which on GSL is used
+   * @param op operation
+   * @return threshold
+   */
+  static unsigned int getThreshold(EnumLinalgOperation op);
+
+  /**
+   * Check whether kernels of backend are compiled
+   * @param backend backend
+   * @return availability
+   */
+  static bool isAvailable(EnumLinalgBackend backend);
+
+  /**
+   * Select backend for operation
+   * @param op operation
+   * @param size problem size
+   * @return backend (LINALG_GSL or LINALG_EIGEN)
+   */
+  static EnumLinalgBackend select(EnumLinalgOperation op, unsigned int size);
+
+  /**
+   * Time operation on random data, best out of several repetitions.
+   * Point sets (multiply, pcaAnalysis) are three-dimensional, matrices (invert, svd) are square.
+   * @param op operation
+   * @param size number of points or dimension of matrix
+   * @param backend backend
+   * @return elapsed time in seconds
+   */
+  static double benchmark(EnumLinalgOperation op, unsigned int size, EnumLinalgBackend backend);
+
+  /**
+   * Time both backends for a range of problem sizes and set thresholds accordingly
+   */
+  static void calibrate();
+
+  /**
+   * Multiply array with transposed matrix in place, i.e., array = array * M^T. Used to transform point sets.
+   * @param M matrix (size cols x cols)
+   * @param array data (size rows x cols)
+   * @param rows number of rows of array
+   * @param cols number of columns of array
+   * @param backend backend
+   */
+  static void multiply(const double* M, double* array, unsigned int rows, unsigned int cols, EnumLinalgBackend backend=LINALG_AUTO);
+
+  /**
+   * Invert matrix in place
+   * @param A matrix (size dim x dim)
+   * @param dim dimension
+   * @param backend backend
+   */
+  static void invert(double* A, unsigned int dim, EnumLinalgBackend backend=LINALG_AUTO);
+
+  /**
+   * Thin singular value decomposition A = U * diag(s) * V^T, rows must not be smaller than cols
+   * @param[in] A matrix (size rows x cols)
+   * @param[in] rows number of rows
+   * @param[in] cols number of columns
+   * @param[out] U left singular vectors (size rows x cols)
+   * @param[out] s singular values in descending order (size cols)
+   * @param[out] V right singular vectors (size cols x cols)
+   * @param[in] backend backend
+   */
+  static void svd(const double* A, unsigned int rows, unsigned int cols, double* U, double* s, double* V, EnumLinalgBackend backend=LINALG_AUTO);
+
+  /**
+   * Principal component analysis of point set, see Matrix::pcaAnalysis
+   * @param[in] A points (size rows x dim)
+   * @param[in] rows number of points
+   * @param[in] dim dimensionality
+   * @param[out] axes axes end points, row i holds axis i as (x1 x2 y1 y2 ...) (size dim x 2*dim)
+   * @param[in] backend backend
+   */
+  static void pcaAnalysis(const double* A, unsigned int rows, unsigned int dim, double* axes, EnumLinalgBackend backend=LINALG_AUTO);
+
+private:
+
+  static EnumLinalgBackend _backend;
+
+  static unsigned int _threshold[LINALG_OPERATIONS];
+};
+
+}
+
+#endif //LINALGBACKEND_H__
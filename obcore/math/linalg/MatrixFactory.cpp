@@ -89,27 +89,32 @@ Matrix MatrixFactory::TranslationMatrix44(obfloat tx, obfloat ty, obfloat tz)
 
 Matrix MatrixFactory::TransformationMatrix33(obfloat phi, obfloat tx, obfloat ty)
 {
-  Matrix M = MatrixFactory::TranslationMatrix33(tx, ty);
-  obfloat cphi   = cos(phi);
-  obfloat sphi   = sin(phi);
-  M(0,0) = cphi;     M(0,1) = -sphi;
-  M(1,0) = sphi;     M(1,1) = cphi;
-  return M;
+  return Transformation2D(phi, tx, ty).toMatrix();
 }
 
 Matrix MatrixFactory::TransformationMatrix44(obfloat phi, obfloat theta, obfloat psi, obfloat tx, obfloat ty, obfloat tz)
 {
-  Matrix M = MatrixFactory::TranslationMatrix44(tx, ty, tz);
+  return Transformation3D(phi, theta, psi, tx, ty, tz).toMatrix();
+}
+
+Transform2D MatrixFactory::Transformation2D(obfloat phi, obfloat tx, obfloat ty)
+{
+  return Transform2D(phi, tx, ty);
+}
+
+Transform3D MatrixFactory::Transformation3D(obfloat phi, obfloat theta, obfloat psi, obfloat tx, obfloat ty, obfloat tz)
+{
+  Transform3D T;
   obfloat cphi   = cos(phi);
   obfloat ctheta = cos(theta);
   obfloat cpsi   = cos(psi);
   obfloat sphi   = sin(phi);
   obfloat stheta = sin(theta);
   obfloat spsi   = sin(psi);
-  M(0,0) = cphi*ctheta;     M(0,1) = cphi*stheta*spsi-sphi*cpsi;    M(0,2) = cphi*stheta*cpsi + sphi*spsi;
-  M(1,0) = sphi*ctheta;     M(1,1) = sphi*stheta*spsi+cphi*cpsi;    M(1,2) = sphi*stheta*cpsi - cphi*spsi;
-  M(2,0) = -stheta;         M(2,1) = ctheta*spsi;                   M(2,2) = ctheta*cpsi;
-  return M;
+  T(0,0) = cphi*ctheta;     T(0,1) = cphi*stheta*spsi-sphi*cpsi;    T(0,2) = cphi*stheta*cpsi + sphi*spsi;    T(0,3) = tx;
+  T(1,0) = sphi*ctheta;     T(1,1) = sphi*stheta*spsi+cphi*cpsi;    T(1,2) = sphi*stheta*cpsi - cphi*spsi;    T(1,3) = ty;
+  T(2,0) = -stheta;         T(2,1) = ctheta*spsi;                   T(2,2) = ctheta*cpsi;                     T(2,3) = tz;
+  return T;
 }
 
 }
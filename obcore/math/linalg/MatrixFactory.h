@@ -4,6 +4,7 @@
 using namespace std;
 
 #include "obcore/base/types.h"
+#include "obcore/math/linalg/Transform.h"
 
 /**
  * @namespace obvious
@@ -84,6 +85,25 @@ public:
    */
   static Matrix TransformationMatrix44(obfloat phi, obfloat theta, obfloat psi, obfloat tx=0, obfloat ty=0, obfloat tz=0);
 
+  /**
+   * Instantiate a fixed-size 2D transformation, i.e., without heap allocation
+   * @param phi rotation angle
+   * @param tx x-component of translation
+   * @param ty y-component of translation
+   */
+  static Transform2D Transformation2D(obfloat phi, obfloat tx, obfloat ty);
+
+  /**
+   * Instantiate a fixed-size 3D transformation, i.e., without heap allocation
+   * @param phi rotation about z-axis
+   * @param theta rotation about y-axis
+   * @param psi rotation about x-axis
+   * @param tx x-component of translation
+   * @param ty y-component of translation
+   * @param tz z-component of translation
+   */
+  static Transform3D Transformation3D(obfloat phi, obfloat theta, obfloat psi, obfloat tx=0, obfloat ty=0, obfloat tz=0);
+
 private:
 
 };
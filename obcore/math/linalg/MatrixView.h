@@ -0,0 +1,55 @@
+#ifndef MATRIXVIEW_H_
+#define MATRIXVIEW_H_
+
+#include "obcore/math/linalg/linalg.h"
+
+/**
+ * @namespace obvious
+ */
+namespace obvious
+{
+
+/**
+ * @class MatrixView
+ * @brief Direct access to the element storage of a matrix, independent of the linear algebra backend.
+ * Columns are exposed as strided arrays, i.e., element (row, col) is located at getColumn(col, &stride)[row*stride].
+ * Pointers are invalidated, if the matrix is resized or destroyed.
+ * @author Stefan May
+ */
+class MatrixView
+{
+public:
+
+  /**
+   * Constructor
+   * @param M matrix to be accessed
+   */
+  MatrixView(Matrix* M) { _M = M; };
+
+  /**
+   * Access column of matrix
+   * @param[in] col column index
+   * @param[out] stride distance of consecutive elements of column
+   * @return pointer to first element of column
+   */
+  double* getColumn(unsigned int col, unsigned int* stride)
+  {
+#if EIGENUSED
+    // Eigen stores column major
+    *stride = 1;
+    return _M->_M.data() + col * _M->_M.rows();
+#else
+    // GSL stores row major with trailing dimension
+    *stride = _M->_M->tda;
+    return _M->_M->data + col;
+#endif
+  };
+
+private:
+
+  Matrix* _M;
+};
+
+}
+
+#endif /* MATRIXVIEW_H_ */
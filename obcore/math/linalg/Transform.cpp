@@ -0,0 +1,43 @@
+#include "Transform.h"
+#include "linalg.h"
+
+namespace obvious
+{
+
+Transform3D::Transform3D(Matrix& T)
+{
+  setIdentity();
+  const unsigned int cols = (T.getCols()>4) ? 4 : T.getCols();
+  for(unsigned int r=0; r<3; r++)
+    for(unsigned int c=0; c<cols; c++)
+      _m[r*4+c] = T(r,c);
+}
+
+Matrix Transform3D::toMatrix() const
+{
+  double T[16];
+  getData(T);
+  Matrix M(4, 4);
+  M.setData(T);
+  return M;
+}
+
+Transform2D::Transform2D(Matrix& T)
+{
+  // 3x3 homogeneous matrices carry translation in column 2, 4x4 matrices in column 3
+  const unsigned int tc = (T.getCols()==4) ? 3 : 2;
+  _m[0] = T(0,0); _m[1] = T(0,1); _m[2] = T(0,tc);
+  _m[3] = T(1,0); _m[4] = T(1,1); _m[5] = T(1,tc);
+}
+
+Matrix Transform2D::toMatrix() const
+{
+  double T[9] = {_m[0], _m[1], _m[2],
+                 _m[3], _m[4], _m[5],
+                 0.0,   0.0,   1.0};
+  Matrix M(3, 3);
+  M.setData(T);
+  return M;
+}
+
+}
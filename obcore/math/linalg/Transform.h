@@ -0,0 +1,394 @@
+#ifndef TRANSFORM_H__
+#define TRANSFORM_H__
+
+#include <math.h>
+
+/**
+ * @namespace obvious
+ */
+namespace obvious
+{
+
+class Matrix;
+
+/**
+ * @class Vec3
+ * @brief Fixed-size 3D vector living on the stack
+ * @author Stefan May
+ */
+class Vec3
+{
+public:
+
+  /**
+   * Constructor, zero vector
+   */
+  Vec3() { _v[0] = 0.0; _v[1] = 0.0; _v[2] = 0.0; };
+
+  /**
+   * Constructor
+   * @param x x-component
+   * @param y y-component
+   * @param z z-component
+   */
+  Vec3(double x, double y, double z) { _v[0] = x; _v[1] = y; _v[2] = z; };
+
+  /**
+   * Constructor
+   * @param v array of 3 components
+   */
+  Vec3(const double* v) { _v[0] = v[0]; _v[1] = v[1]; _v[2] = v[2]; };
+
+  double& operator [] (unsigned int i) { return _v[i]; };
+
+  double operator [] (unsigned int i) const { return _v[i]; };
+
+  Vec3 operator + (const Vec3& v) const { return Vec3(_v[0]+v._v[0], _v[1]+v._v[1], _v[2]+v._v[2]); };
+
+  Vec3 operator - (const Vec3& v) const { return Vec3(_v[0]-v._v[0], _v[1]-v._v[1], _v[2]-v._v[2]); };
+
+  Vec3 operator * (double s) const { return Vec3(_v[0]*s, _v[1]*s, _v[2]*s); };
+
+  Vec3& operator += (const Vec3& v) { _v[0] += v._v[0]; _v[1] += v._v[1]; _v[2] += v._v[2]; return *this; };
+
+  Vec3& operator -= (const Vec3& v) { _v[0] -= v._v[0]; _v[1] -= v._v[1]; _v[2] -= v._v[2]; return *this; };
+
+  Vec3& operator *= (double s) { _v[0] *= s; _v[1] *= s; _v[2] *= s; return *this; };
+
+  /**
+   * Dot product
+   * @param v second operand
+   * @return dot product
+   */
+  double dot(const Vec3& v) const { return _v[0]*v._v[0] + _v[1]*v._v[1] + _v[2]*v._v[2]; };
+
+  /**
+   * Cross product
+   * @param v second operand
+   * @return this x v
+   */
+  Vec3 cross(const Vec3& v) const { return Vec3(_v[1]*v._v[2]-_v[2]*v._v[1], _v[2]*v._v[0]-_v[0]*v._v[2], _v[0]*v._v[1]-_v[1]*v._v[0]); };
+
+  /**
+   * Euclidean norm
+   * @return length of vector
+   */
+  double norm() const { return sqrt(dot(*this)); };
+
+  /**
+   * Access data
+   * @return pointer to 3 components
+   */
+  double* data() { return _v; };
+
+  const double* data() const { return _v; };
+
+private:
+
+  double _v[3];
+};
+
+/**
+ * @class Transform3D
+ * @brief Fixed-size rigid 3D transformation living on the stack.
+ * Stored as 3x4 matrix [R|t] in row-major order, i.e., all arithmetic is inlined and free of heap allocations.
+ * Conversion from and to Matrix instances (4x4) is provided for interfacing.
+ * @author Stefan May
+ */
+class Transform3D
+{
+public:
+
+  /**
+   * Constructor, identity
+   */
+  Transform3D() { setIdentity(); };
+
+  /**
+   * Constructor
+   * @param T transformation matrix (row-major, 12 or 16 elements, last row is ignored)
+   */
+  Transform3D(const double* T) { for(unsigned int i=0; i<12; i++) _m[i] = T[i]; };
+
+  /**
+   * Constructor
+   * @param T homogeneous 4x4 matrix or 3x3 rotation matrix
+   */
+  Transform3D(Matrix& T);
+
+  /**
+   * Convert to homogeneous 4x4 matrix
+   * @return matrix instance
+   */
+  Matrix toMatrix() const;
+
+  /**
+   * Copy to homogeneous 4x4 array
+   * @param T destination (row-major, 16 elements)
+   */
+  void getData(double* T) const
+  {
+    for(unsigned int i=0; i<12; i++) T[i] = _m[i];
+    T[12] = 0.0; T[13] = 0.0; T[14] = 0.0; T[15] = 1.0;
+  };
+
+  /**
+   * Set identity
+   */
+  void setIdentity()
+  {
+    for(unsigned int i=0; i<12; i++) _m[i] = 0.0;
+    _m[0] = 1.0; _m[5] = 1.0; _m[10] = 1.0;
+  };
+
+  /**
+   * Access element
+   * @param row row index (0-2)
+   * @param col column index (0-3), column 3 is the translation
+   * @return element
+   */
+  double& operator () (unsigned int row, unsigned int col) { return _m[row*4+col]; };
+
+  double operator () (unsigned int row, unsigned int col) const { return _m[row*4+col]; };
+
+  /**
+   * Concatenation
+   * @param T right operand
+   * @return this * T
+   */
+  Transform3D operator * (const Transform3D& T) const
+  {
+    Transform3D C;
+    for(unsigned int r=0; r<3; r++)
+    {
+      const double* a = &_m[r*4];
+      for(unsigned int c=0; c<4; c++)
+        C._m[r*4+c] = a[0]*T._m[c] + a[1]*T._m[4+c] + a[2]*T._m[8+c];
+      C._m[r*4+3] += a[3];
+    }
+    return C;
+  };
+
+  Transform3D& operator *= (const Transform3D& T) { *this = *this * T; return *this; };
+
+  /**
+   * Transform point
+   * @param p point
+   * @return R*p+t
+   */
+  Vec3 operator * (const Vec3& p) const
+  {
+    Vec3 q;
+    transform(p.data(), q.data());
+    return q;
+  };
+
+  /**
+   * Transform point
+   * @param[in] src source coordinates (single or double precision)
+   * @param[out] dst destination coordinates (may equal src)
+   */
+  template<typename T>
+  void transform(const T* src, T* dst) const
+  {
+    const double x = src[0], y = src[1], z = src[2];
+    dst[0] = _m[0]*x + _m[1]*y + _m[2]*z  + _m[3];
+    dst[1] = _m[4]*x + _m[5]*y + _m[6]*z  + _m[7];
+    dst[2] = _m[8]*x + _m[9]*y + _m[10]*z + _m[11];
+  };
+
+  /**
+   * Rotate vector, e.g., a normal
+   * @param[in] src source vector
+   * @param[out] dst destination vector (may equal src)
+   */
+  template<typename T>
+  void rotate(const T* src, T* dst) const
+  {
+    const double x = src[0], y = src[1], z = src[2];
+    dst[0] = _m[0]*x + _m[1]*y + _m[2]*z;
+    dst[1] = _m[4]*x + _m[5]*y + _m[6]*z;
+    dst[2] = _m[8]*x + _m[9]*y + _m[10]*z;
+  };
+
+  /**
+   * Get inverse of rigid transformation, i.e., [R^T | -R^T*t]
+   * @return inverse transformation
+   */
+  Transform3D getInverse() const
+  {
+    Transform3D I;
+    for(unsigned int r=0; r<3; r++)
+      for(unsigned int c=0; c<3; c++)
+        I._m[r*4+c] = _m[c*4+r];
+    for(unsigned int r=0; r<3; r++)
+      I._m[r*4+3] = -(I._m[r*4]*_m[3] + I._m[r*4+1]*_m[7] + I._m[r*4+2]*_m[11]);
+    return I;
+  };
+
+  /**
+   * Invert rigid transformation
+   */
+  void invert() { *this = getInverse(); };
+
+  /**
+   * Get translation
+   * @return translation vector
+   */
+  Vec3 getTranslation() const { return Vec3(_m[3], _m[7], _m[11]); };
+
+  /**
+   * Access data
+   * @return pointer to 3x4 row-major elements
+   */
+  const double* data() const { return _m; };
+
+private:
+
+  double _m[12];
+};
+
+/**
+ * @class Transform2D
+ * @brief Fixed-size rigid 2D transformation living on the stack.
+ * Stored as 2x3 matrix [R|t] in row-major order.
+ * @author Stefan May
+ */
+class Transform2D
+{
+public:
+
+  /**
+   * Constructor, identity
+   */
+  Transform2D() { setIdentity(); };
+
+  /**
+   * Constructor
+   * @param phi rotation angle
+   * @param tx x-component of translation
+   * @param ty y-component of translation
+   */
+  Transform2D(double phi, double tx, double ty)
+  {
+    const double c = cos(phi);
+    const double s = sin(phi);
+    _m[0] = c; _m[1] = -s; _m[2] = tx;
+    _m[3] = s; _m[4] =  c; _m[5] = ty;
+  };
+
+  /**
+   * Constructor
+   * @param T homogeneous 3x3 matrix, or 4x4 matrix of which the x/y-part is taken (as used by Icp in 2D mode)
+   */
+  Transform2D(Matrix& T);
+
+  /**
+   * Convert to homogeneous 3x3 matrix
+   * @return matrix instance
+   */
+  Matrix toMatrix() const;
+
+  /**
+   * Set identity
+   */
+  void setIdentity()
+  {
+    _m[0] = 1.0; _m[1] = 0.0; _m[2] = 0.0;
+    _m[3] = 0.0; _m[4] = 1.0; _m[5] = 0.0;
+  };
+
+  /**
+   * Access element
+   * @param row row index (0-1)
+   * @param col column index (0-2), column 2 is the translation
+   * @return element
+   */
+  double& operator () (unsigned int row, unsigned int col) { return _m[row*3+col]; };
+
+  double operator () (unsigned int row, unsigned int col) const { return _m[row*3+col]; };
+
+  /**
+   * Concatenation
+   * @param T right operand
+   * @return this * T
+   */
+  Transform2D operator * (const Transform2D& T) const
+  {
+    Transform2D C;
+    C._m[0] = _m[0]*T._m[0] + _m[1]*T._m[3];
+    C._m[1] = _m[0]*T._m[1] + _m[1]*T._m[4];
+    C._m[2] = _m[0]*T._m[2] + _m[1]*T._m[5] + _m[2];
+    C._m[3] = _m[3]*T._m[0] + _m[4]*T._m[3];
+    C._m[4] = _m[3]*T._m[1] + _m[4]*T._m[4];
+    C._m[5] = _m[3]*T._m[2] + _m[4]*T._m[5] + _m[5];
+    return C;
+  };
+
+  Transform2D& operator *= (const Transform2D& T) { *this = *this * T; return *this; };
+
+  /**
+   * Transform point
+   * @param[in] src source coordinates (single or double precision)
+   * @param[out] dst destination coordinates (may equal src)
+   */
+  template<typename T>
+  void transform(const T* src, T* dst) const
+  {
+    const double x = src[0], y = src[1];
+    dst[0] = _m[0]*x + _m[1]*y + _m[2];
+    dst[1] = _m[3]*x + _m[4]*y + _m[5];
+  };
+
+  /**
+   * Rotate vector
+   * @param[in] src source vector
+   * @param[out] dst destination vector (may equal src)
+   */
+  template<typename T>
+  void rotate(const T* src, T* dst) const
+  {
+    const double x = src[0], y = src[1];
+    dst[0] = _m[0]*x + _m[1]*y;
+    dst[1] = _m[3]*x + _m[4]*y;
+  };
+
+  /**
+   * Get inverse of rigid transformation
+   * @return inverse transformation
+   */
+  Transform2D getInverse() const
+  {
+    Transform2D I;
+    I._m[0] = _m[0]; I._m[1] = _m[3];
+    I._m[3] = _m[1]; I._m[4] = _m[4];
+    I._m[2] = -(I._m[0]*_m[2] + I._m[1]*_m[5]);
+    I._m[5] = -(I._m[3]*_m[2] + I._m[4]*_m[5]);
+    return I;
+  };
+
+  /**
+   * Invert rigid transformation
+   */
+  void invert() { *this = getInverse(); };
+
+  /**
+   * Get rotation angle
+   * @return angle in radians
+   */
+  double getAngle() const { return atan2(_m[3], _m[0]); };
+
+  /**
+   * Access data
+   * @return pointer to 2x3 row-major elements
+   */
+  const double* data() const { return _m; };
+
+private:
+
+  double _m[6];
+};
+
+}
+
+#endif //TRANSFORM_H__
@@ -1,11 +1,14 @@
 #include "Matrix.h"
 #include "obcore/base/Logger.h"
+#include "obcore/math/linalg/LinalgBackend.h"
 
 #include <math.h>
 
 namespace obvious
 {
 
+typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrix;
+
 Matrix::Matrix(unsigned int rows, unsigned int cols, double* data)
 {
   if(data)
@@ -150,7 +153,8 @@ Matrix Matrix::getInverse()
 
 void Matrix::invert()
 {
-  _M = _M.inverse();
+  // Column-major storage read as row-major is the transpose, and inv(A^T) = inv(A)^T, i.e., inversion works in place
+  LinalgBackend::invert(_M.data(), _M.rows());
 }
 
 void Matrix::transpose()
@@ -172,8 +176,13 @@ double Matrix::trace()
 
 Matrix* Matrix::pcaAnalysis()
 {
-  cout << "WARNING: Matrix::pcaAnalysis Not implemented yet" << endl;
-  abort();
+  unsigned int dim = _M.cols();
+  RowMajorMatrix A = _M;
+  RowMajorMatrix axes(dim, 2*dim);
+  LinalgBackend::pcaAnalysis(A.data(), A.rows(), dim, axes.data());
+  Matrix* M = new Matrix(dim, 2*dim);
+  M->_M = axes;
+  return M;
 }
 
 void Matrix::svd(Matrix* U, double* s, Matrix* V)
@@ -184,12 +193,12 @@ void Matrix::svd(Matrix* U, double* s, Matrix* V)
     return;
   }
 
-  Eigen::JacobiSVD<Eigen::MatrixXd> svdOfM = _M.jacobiSvd(Eigen::ComputeFullU | Eigen::ComputeFullV);
-  U->_M = svdOfM.matrixU();
-  V->_M = svdOfM.matrixV();
-  Eigen::VectorXd singular = svdOfM.singularValues();
-  for(int i=0; i<singular.count(); i++)
-    s[i] = singular(i);
+  RowMajorMatrix A = _M;
+  RowMajorMatrix Ur(A.rows(), A.cols());
+  RowMajorMatrix Vr(A.cols(), A.cols());
+  LinalgBackend::svd(A.data(), A.rows(), A.cols(), Ur.data(), s, Vr.data());
+  U->_M = Ur;
+  V->_M = Vr;
 }
 
 void Matrix::solve(double* b, double* x)
@@ -283,11 +292,10 @@ Vector Matrix::multiply(const Matrix &M, const Vector &V, bool transpose)
   return V2;
 }
 
-typedef Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> > MapType;
 void Matrix::multiply(const Matrix &M1, double* array, unsigned int rows, unsigned int cols)
 {
-  MapType map(array, rows, cols);
-  map = map * M1._M.transpose();
+  RowMajorMatrix M = M1._M;
+  LinalgBackend::multiply(M.data(), array, rows, cols);
 }
 
 }
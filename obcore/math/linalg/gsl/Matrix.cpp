@@ -1,5 +1,6 @@
 #include "Matrix.h"
 #include "obcore/base/Logger.h"
+#include "obcore/math/linalg/LinalgBackend.h"
 
 #include <gsl/gsl_linalg.h>
 #include <gsl/gsl_blas.h>
@@ -177,15 +178,7 @@ Matrix Matrix::getInverse()
 
 void Matrix::invert()
 {
-  int r = _M->size1;
-  int sig;
-  gsl_permutation* perm = gsl_permutation_alloc(r);
-  gsl_matrix* work = gsl_matrix_alloc(_M->size1, _M->size2);
-  gsl_matrix_memcpy(work, _M);
-  gsl_linalg_LU_decomp (work, perm ,&sig);
-  gsl_linalg_LU_invert (work, perm, _M);
-  gsl_matrix_free(work);
-  gsl_permutation_free(perm);
+  LinalgBackend::invert(_M->data, _M->size1);
 }
 
 void Matrix::transpose()
@@ -236,103 +229,9 @@ double Matrix::trace()
 
 Matrix* Matrix::pcaAnalysis()
 {
-
-  gsl_matrix* M = gsl_matrix_alloc(_M->size1, _M->size2);
-  gsl_matrix_memcpy(M, _M);
-
-  size_t i;
-  // number of points
-  size_t rows = M->size1;
-  // dimensionality
-  size_t dim  = M->size2;
-
+  size_t dim = _M->size2;
   Matrix* axes = new Matrix(dim, 2*dim);
-
-  gsl_matrix* V = gsl_matrix_alloc(dim, dim);
-
-  // calculate centroid
-  gsl_vector* vcent = gsl_vector_alloc(_M->size2);
-  for(size_t i=0; i<_M->size2; i++)
-  {
-    gsl_vector_view col = gsl_matrix_column(_M, i);
-    double m = gsl_stats_mean(col.vector.data,_M->size2,_M->size1);
-    gsl_vector_set(vcent, i, m);
-  }
-
-  double* cent = vcent->data;
-
-  for(i=0; i<dim; i++)
-  {
-    gsl_vector_view c = gsl_matrix_column(M, i);
-    gsl_vector_add_constant(&c.vector, -cent[i]);
-  }
-
-  gsl_matrix* MtM = gsl_matrix_alloc(dim,dim);
-  gsl_blas_dgemm(CblasTrans, CblasNoTrans,
-                 1.0, M, M,
-                 0.0, MtM);
-
-  gsl_vector* s = gsl_vector_alloc(dim);
-
-  gsl_linalg_SV_decomp_jacobi(MtM, V, s);
-
-  gsl_matrix* P = gsl_matrix_alloc(dim, rows);
-  gsl_blas_dgemm (CblasTrans, CblasTrans,
-                  1.0, V, M,
-                  0.0, P);
-
-
-  for(i=0; i<dim; i++)
-  {
-    // coordinates in coordinate system of eigenvectors
-    gsl_vector_view coord = gsl_matrix_row(P, i);
-
-    // corresponding eigenvector in original coordinate system
-    double max = gsl_vector_max(&coord.vector);
-    double min = gsl_vector_min(&coord.vector);
-    double ext = max - min;
-    double align = 0.0;;
-    if(ext > 1e-6)
-    {
-      align = (max + min)/2.0;
-    }
-
-    gsl_vector_view eigen = gsl_matrix_column(V, i);
-
-    for(size_t j=0; j<dim; j++)
-    {
-      double e = gsl_vector_get(&eigen.vector,j)*align;
-      cent[j] += e;
-    }
-  }
-
-  for(i=0; i<dim; i++)
-  {
-    gsl_vector_view coord = gsl_matrix_row(P, i);
-
-    // extends of axis in orientation of eigenvector i
-    double ext = gsl_vector_max(&coord.vector) - gsl_vector_min(&coord.vector);
-
-    // corresponding eigenvector in original coordinate system
-    gsl_vector_view eigen = gsl_matrix_column(V, i);
-
-    // coordinates of axis j
-    for(size_t j=0; j<dim; j++)
-    {
-      double e = gsl_vector_get(&eigen.vector,j)*ext/2.0;
-      // axis coordinates with respect to center of original coordinate system
-      gsl_matrix_set(axes->_M, i, 2*j,   cent[j] - e);
-      gsl_matrix_set(axes->_M, i, 2*j+1, cent[j] + e);
-    }
-  }
-
-  gsl_matrix_free(P);
-  gsl_vector_free(s);
-  gsl_matrix_free(MtM);
-  gsl_vector_free(vcent);
-  gsl_matrix_free(V);
-  gsl_matrix_free(M);
-
+  LinalgBackend::pcaAnalysis(_M->data, _M->size1, dim, axes->_M->data);
   return axes;
 }
 
@@ -343,11 +242,7 @@ void Matrix::svd(Matrix* U, double* s, Matrix* V)
     LOGMSG(DBG_ERROR, "Matrix U must have same dimension");
     return;
   }
-  *U = *this;
-  gsl_vector* work = gsl_vector_alloc(getRows());
-  gsl_vector_view vs = gsl_vector_view_array(s, getRows());
-  gsl_linalg_SV_decomp(U->_M, V->_M, &vs.vector, work);
-  gsl_vector_free(work);
+  LinalgBackend::svd(_M->data, getRows(), getCols(), U->_M->data, s, V->_M->data);
 }
 
 void Matrix::solve(double* b, double* x)
@@ -488,11 +383,7 @@ Vector Matrix::multiply(const Matrix &M, const Vector &V, bool transpose)
 
 void Matrix::multiply(const Matrix &M1, double* array, unsigned int rows, unsigned int cols)
 {
-  gsl_matrix_view V = gsl_matrix_view_array(array, rows, cols);
-  gsl_matrix* work = gsl_matrix_alloc(rows, cols);
-  gsl_blas_dgemm(CblasNoTrans, CblasTrans, 1.0, &(V.matrix), M1._M, 0.0, work);
-  gsl_matrix_memcpy(&V.matrix, work);
-  gsl_matrix_free(work);
+  LinalgBackend::multiply(M1._M->data, array, rows, cols);
 }
 
 }
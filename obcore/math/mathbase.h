@@ -502,6 +502,92 @@ namespace obvious {
     return(angle);
   }
 
+  /**
+   * Closed-form eigen analysis of a symmetric 3x3 matrix. Eigenvalues are determined by the trigonometric
+   * solution of the characteristic polynomial, the eigenvector by cross products of the rows of (C - lambda*I).
+   * @param C symmetric matrix (row-major, 9 elements)
+   * @param lambda eigenvalues in ascending order
+   * @param v normalized eigenvector belonging to the smallest eigenvalue lambda[0]
+   */
+  template <class T>
+  inline void eigenSym3x3(const T* C, T* lambda, T* v)
+  {
+    // Scale matrix to avoid over- and underflow
+    T scale = fabs(C[0]);
+    for(unsigned int i=1; i<9; i++)
+      if(fabs(C[i]) > scale) scale = fabs(C[i]);
+
+    v[0] = 0.0; v[1] = 0.0; v[2] = 1.0;
+    if(scale < 1e-300)
+    {
+      lambda[0] = lambda[1] = lambda[2] = 0.0;
+      return;
+    }
+
+    T a00 = C[0]/scale, a01 = C[1]/scale, a02 = C[2]/scale;
+    T a11 = C[4]/scale, a12 = C[5]/scale, a22 = C[8]/scale;
+
+    T m   = (a00 + a11 + a22) / 3.0;
+    T b00 = a00 - m;
+    T b11 = a11 - m;
+    T b22 = a22 - m;
+    T p2  = (b00*b00 + b11*b11 + b22*b22 + 2.0*(a01*a01 + a02*a02 + a12*a12)) / 6.0;
+
+    if(p2 < 1e-30)
+    {
+      // isotropic matrix, every direction is an eigenvector
+      lambda[0] = lambda[1] = lambda[2] = m*scale;
+      return;
+    }
+
+    T p    = sqrt(p2);
+    T detB = b00*(b11*b22-a12*a12) - a01*(a01*b22-a12*a02) + a02*(a01*a12-b11*a02);
+    T r    = detB / (2.0*p2*p);
+    if(r < -1.0) r = -1.0;
+    else if(r > 1.0) r = 1.0;
+    T phi  = acos(r) / 3.0;
+
+    T l2 = m + 2.0*p*cos(phi);
+    T l0 = m + 2.0*p*cos(phi + (2.0*M_PI/3.0));
+    T l1 = 3.0*m - l0 - l2;
+
+    lambda[0] = l0*scale;
+    lambda[1] = l1*scale;
+    lambda[2] = l2*scale;
+
+    // Rows of (A - l0*I) span the plane perpendicular to the eigenvector
+    T r0[3] = {a00-l0, a01,    a02};
+    T r1[3] = {a01,    a11-l0, a12};
+    T r2[3] = {a02,    a12,    a22-l0};
+    T c[3][3];
+    cross3<T>(c[0], r0, r1);
+    cross3<T>(c[1], r0, r2);
+    cross3<T>(c[2], r1, r2);
+    T d[3] = {dot3<T>(c[0], c[0]), dot3<T>(c[1], c[1]), dot3<T>(c[2], c[2])};
+    unsigned int iMax = 0;
+    if(d[1] > d[iMax]) iMax = 1;
+    if(d[2] > d[iMax]) iMax = 2;
+
+    if(d[iMax] > 1e-30)
+    {
+      T len = sqrt(d[iMax]);
+      v[0] = c[iMax][0] / len;
+      v[1] = c[iMax][1] / len;
+      v[2] = c[iMax][2] / len;
+    }
+    else
+    {
+      // Two smallest eigenvalues coincide, take any vector perpendicular to the remaining row space
+      T* rMax = r0;
+      if(dot3<T>(r1, r1) > dot3<T>(rMax, rMax)) rMax = r1;
+      if(dot3<T>(r2, r2) > dot3<T>(rMax, rMax)) rMax = r2;
+      T e[3] = {0.0, 0.0, 0.0};
+      e[(fabs(rMax[0]) < fabs(rMax[1])) ? ((fabs(rMax[0]) < fabs(rMax[2])) ? 0 : 2) : ((fabs(rMax[1]) < fabs(rMax[2])) ? 1 : 2)] = 1.0;
+      cross3<T>(v, rMax, e);
+      norm3<T>(v);
+    }
+  }
+
 } // namespace
 
 #endif //OBVIOUSMATHBASE_H
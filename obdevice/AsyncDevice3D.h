@@ -0,0 +1,202 @@
+#ifndef ASYNCDEVICE3D_H_
+#define ASYNCDEVICE3D_H_
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <unistd.h>
+
+/**
+ * @namespace obvious
+ */
+namespace obvious
+{
+
+/**
+ * @struct Frame3D
+ * @brief Preallocated frame slot of AsyncDevice3D
+ */
+struct Frame3D
+{
+  // coordinates (layout x1y1z1x2...)
+  double* coords;
+  // z-buffer
+  double* z;
+  // mask of valid points
+  bool* mask;
+  // color data (layout r1g1b1r2...)
+  unsigned char* rgb;
+  // time stamp of acquisition in seconds (see Frame3D::getAge)
+  double timestamp;
+  // consecutive number of acquired frames
+  unsigned long sequence;
+
+  /**
+   * Age of frame, i.e., latency between acquisition and now
+   * @return age in seconds
+   */
+  double getAge() const
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return ((double)tv.tv_sec + (double)tv.tv_usec * 1e-6) - timestamp;
+  }
+};
+
+/**
+ * @class AsyncDevice3D
+ * @brief Background acquisition of 3D devices into a ring of preallocated frame buffers.
+ *
+ * The device is grabbed continuously in a separate thread, while processing threads access frames by
+ * getLatestFrame or getNextFrame. Frames handed out are locked until releaseFrame is called. Frames being
+ * overwritten before they were consumed, as well as sensor frames that could not be stored because all slots
+ * were locked, are counted as dropped.
+ * Devices need to provide grab(), getRows(), getCols(), getCoords(), getZ(), getMask() and getRGB(),
+ * e.g., ParentDevice3D, Kinect or KinectPlayback.
+ * @author Stefan May
+ */
+template <class T>
+class AsyncDevice3D
+{
+public:
+  /**
+   * Constructor
+   * @param device device instance (must be initialized and outlive this object)
+   * @param slots number of frame buffers in ring (at least 2)
+   */
+  AsyncDevice3D(T* device, unsigned int slots=3);
+
+  /**
+   * Destructor, stops acquisition
+   */
+  ~AsyncDevice3D();
+
+  /**
+   * Start acquisition thread
+   * @return success
+   */
+  bool start();
+
+  /**
+   * Stop acquisition thread. Frames already acquired remain accessible.
+   */
+  void stop();
+
+  /**
+   * Query acquisition state
+   * @return true if acquisition thread is running
+   */
+  bool isRunning();
+
+  /**
+   * Get most recent frame (non-blocking). The frame stays valid until releaseFrame is called.
+   * @return frame or NULL if no frame has been acquired so far
+   */
+  Frame3D* getLatestFrame();
+
+  /**
+   * Wait for a frame newer than the last one returned (blocking). The frame stays valid until releaseFrame is called.
+   * @param timeout maximum waiting time in milliseconds
+   * @return frame or NULL if timeout elapsed or acquisition was stopped
+   */
+  Frame3D* getNextFrame(unsigned int timeout=1000);
+
+  /**
+   * Give frame back to acquisition ring
+   * @param frame frame obtained by getLatestFrame or getNextFrame
+   */
+  void releaseFrame(Frame3D* frame);
+
+  /**
+   * Get number of frames grabbed from device
+   * @return number of frames
+   */
+  unsigned long getGrabbedFrames();
+
+  /**
+   * Get number of frames dropped, i.e., grabbed but never handed out
+   * @return number of frames
+   */
+  unsigned long getDroppedFrames();
+
+  /**
+   * Lock device against the acquisition thread, e.g., to change its configuration or to start recording.
+   * The device is locked while it is grabbed and while its data is copied to the ring.
+   */
+  void lockDevice();
+
+  /**
+   * Unlock device locked by lockDevice
+   */
+  void unlockDevice();
+
+  /**
+   * Get number of columns of images
+   * @return columns
+   */
+  unsigned int getCols() { return _cols; };
+
+  /**
+   * Get number of rows of images
+   * @return rows
+   */
+  unsigned int getRows() { return _rows; };
+
+private:
+
+  /**
+   * Acquisition loop
+   */
+  static void* task(void* arg);
+
+  /**
+   * Grab one frame from device and store it in ring
+   * @return success of grabbing
+   */
+  bool acquire();
+
+  /**
+   * Find newest frame that is ready, must be called with locked mutex
+   * @return slot index or -1
+   */
+  int findLatest();
+
+  T* _device;
+
+  unsigned int _rows;
+  unsigned int _cols;
+
+  Frame3D* _frames;
+
+  // number of slots
+  unsigned int _slots;
+
+  // number of consumers locking a slot
+  unsigned int* _locks;
+
+  // true if slot holds a frame not handed out yet
+  bool* _unread;
+
+  // true if slot holds a valid frame
+  bool* _valid;
+
+  // sequence number of last frame returned by getNextFrame
+  unsigned long _lastSequence;
+
+  unsigned long _grabbed;
+  unsigned long _dropped;
+
+  bool _run;
+  bool _threadActive;
+  pthread_t _thread;
+  pthread_mutex_t _mutex;
+  pthread_mutex_t _deviceMutex;
+  pthread_cond_t _cond;
+};
+
+#include "AsyncDevice3D.inl"
+
+}
+
+#endif /* ASYNCDEVICE3D_H_ */
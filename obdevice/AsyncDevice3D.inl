@@ -0,0 +1,283 @@
+template <class T>
+AsyncDevice3D<T>::AsyncDevice3D(T* device, unsigned int slots)
+{
+  _device       = device;
+  _rows         = device->getRows();
+  _cols         = device->getCols();
+  _slots        = (slots < 2 ? 2 : slots);
+  _frames       = new Frame3D[_slots];
+  _locks        = new unsigned int[_slots];
+  _unread       = new bool[_slots];
+  _valid        = new bool[_slots];
+  _lastSequence = 0;
+  _grabbed      = 0;
+  _dropped      = 0;
+  _run          = false;
+  _threadActive = false;
+
+  unsigned int size = _rows * _cols;
+  for(unsigned int i=0; i<_slots; i++)
+  {
+    _frames[i].coords    = new double[size*3];
+    _frames[i].z         = new double[size];
+    _frames[i].mask      = new bool[size];
+    _frames[i].rgb       = new unsigned char[size*3];
+    _frames[i].timestamp = 0.0;
+    _frames[i].sequence  = 0;
+    _locks[i]            = 0;
+    _unread[i]           = false;
+    _valid[i]            = false;
+  }
+
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_mutex_init(&_deviceMutex, NULL);
+  pthread_cond_init(&_cond, NULL);
+}
+
+template <class T>
+AsyncDevice3D<T>::~AsyncDevice3D()
+{
+  stop();
+
+  for(unsigned int i=0; i<_slots; i++)
+  {
+    delete [] _frames[i].coords;
+    delete [] _frames[i].z;
+    delete [] _frames[i].mask;
+    delete [] _frames[i].rgb;
+  }
+  delete [] _frames;
+  delete [] _locks;
+  delete [] _unread;
+  delete [] _valid;
+
+  pthread_cond_destroy(&_cond);
+  pthread_mutex_destroy(&_mutex);
+  pthread_mutex_destroy(&_deviceMutex);
+}
+
+template <class T>
+bool AsyncDevice3D<T>::start()
+{
+  if(_threadActive) return true;
+
+  _run = true;
+  if(pthread_create(&_thread, NULL, &AsyncDevice3D<T>::task, this) != 0)
+  {
+    _run = false;
+    return false;
+  }
+  _threadActive = true;
+  return true;
+}
+
+template <class T>
+void AsyncDevice3D<T>::stop()
+{
+  if(!_threadActive) return;
+
+  pthread_mutex_lock(&_mutex);
+  _run = false;
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+
+  pthread_join(_thread, NULL);
+  _threadActive = false;
+}
+
+template <class T>
+bool AsyncDevice3D<T>::isRunning()
+{
+  return _threadActive;
+}
+
+template <class T>
+void* AsyncDevice3D<T>::task(void* arg)
+{
+  AsyncDevice3D<T>* dev = (AsyncDevice3D<T>*)arg;
+  while(true)
+  {
+    pthread_mutex_lock(&dev->_mutex);
+    bool run = dev->_run;
+    pthread_mutex_unlock(&dev->_mutex);
+    if(!run) break;
+
+    if(!dev->acquire())
+      usleep(1000);
+  }
+  return NULL;
+}
+
+template <class T>
+bool AsyncDevice3D<T>::acquire()
+{
+  pthread_mutex_lock(&_deviceMutex);
+  if(!_device->grab())
+  {
+    pthread_mutex_unlock(&_deviceMutex);
+    return false;
+  }
+
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  double timestamp = (double)tv.tv_sec + (double)tv.tv_usec * 1e-6;
+
+  pthread_mutex_lock(&_mutex);
+  _grabbed++;
+
+  // Prefer empty slots, otherwise overwrite oldest frame not locked by a consumer
+  int slot = -1;
+  for(unsigned int i=0; i<_slots; i++)
+  {
+    if(_locks[i]==0 && !_valid[i])
+    {
+      slot = i;
+      break;
+    }
+  }
+  if(slot==-1)
+  {
+    for(unsigned int i=0; i<_slots; i++)
+    {
+      if(_locks[i]==0 && (slot==-1 || _frames[i].sequence < _frames[slot].sequence))
+        slot = i;
+    }
+  }
+
+  if(slot==-1)
+  {
+    // all slots are locked by consumers
+    _dropped++;
+    pthread_mutex_unlock(&_mutex);
+    pthread_mutex_unlock(&_deviceMutex);
+    return true;
+  }
+
+  if(_valid[slot] && _unread[slot])
+    _dropped++;
+
+  // Invalid slots are neither handed out nor locked, so they can be written without holding the mutex
+  _valid[slot] = false;
+  pthread_mutex_unlock(&_mutex);
+
+  unsigned int size = _rows * _cols;
+  Frame3D* frame = &_frames[slot];
+  memcpy(frame->coords, _device->getCoords(), size*3*sizeof(*frame->coords));
+  memcpy(frame->z,      _device->getZ(),      size*sizeof(*frame->z));
+  memcpy(frame->mask,   _device->getMask(),   size*sizeof(*frame->mask));
+  memcpy(frame->rgb,    _device->getRGB(),    size*3*sizeof(*frame->rgb));
+  pthread_mutex_unlock(&_deviceMutex);
+
+  pthread_mutex_lock(&_mutex);
+  frame->timestamp = timestamp;
+  frame->sequence  = _grabbed;
+  _valid[slot]     = true;
+  _unread[slot]    = true;
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+
+  return true;
+}
+
+template <class T>
+int AsyncDevice3D<T>::findLatest()
+{
+  int slot = -1;
+  for(unsigned int i=0; i<_slots; i++)
+  {
+    if(_valid[i] && (slot==-1 || _frames[i].sequence > _frames[slot].sequence))
+      slot = i;
+  }
+  return slot;
+}
+
+template <class T>
+Frame3D* AsyncDevice3D<T>::getLatestFrame()
+{
+  Frame3D* frame = NULL;
+  pthread_mutex_lock(&_mutex);
+  int slot = findLatest();
+  if(slot!=-1)
+  {
+    frame = &_frames[slot];
+    _locks[slot]++;
+    _unread[slot] = false;
+    if(frame->sequence > _lastSequence)
+      _lastSequence = frame->sequence;
+  }
+  pthread_mutex_unlock(&_mutex);
+  return frame;
+}
+
+template <class T>
+Frame3D* AsyncDevice3D<T>::getNextFrame(unsigned int timeout)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  struct timespec deadline;
+  unsigned long nsec = (tv.tv_usec + (timeout % 1000) * 1000) * 1000;
+  deadline.tv_sec  = tv.tv_sec + timeout / 1000 + nsec / 1000000000;
+  deadline.tv_nsec = nsec % 1000000000;
+
+  Frame3D* frame = NULL;
+  pthread_mutex_lock(&_mutex);
+  while(true)
+  {
+    int slot = findLatest();
+    if(slot!=-1 && _frames[slot].sequence > _lastSequence)
+    {
+      frame = &_frames[slot];
+      _locks[slot]++;
+      _unread[slot] = false;
+      _lastSequence = frame->sequence;
+      break;
+    }
+    if(!_run) break;
+    if(pthread_cond_timedwait(&_cond, &_mutex, &deadline) == ETIMEDOUT) break;
+  }
+  pthread_mutex_unlock(&_mutex);
+  return frame;
+}
+
+template <class T>
+void AsyncDevice3D<T>::releaseFrame(Frame3D* frame)
+{
+  if(frame==NULL) return;
+  unsigned int slot = frame - _frames;
+  if(slot >= _slots) return;
+
+  pthread_mutex_lock(&_mutex);
+  if(_locks[slot] > 0)
+    _locks[slot]--;
+  pthread_mutex_unlock(&_mutex);
+}
+
+template <class T>
+void AsyncDevice3D<T>::lockDevice()
+{
+  pthread_mutex_lock(&_deviceMutex);
+}
+
+template <class T>
+void AsyncDevice3D<T>::unlockDevice()
+{
+  pthread_mutex_unlock(&_deviceMutex);
+}
+
+template <class T>
+unsigned long AsyncDevice3D<T>::getGrabbedFrames()
+{
+  pthread_mutex_lock(&_mutex);
+  unsigned long grabbed = _grabbed;
+  pthread_mutex_unlock(&_mutex);
+  return grabbed;
+}
+
+template <class T>
+unsigned long AsyncDevice3D<T>::getDroppedFrames()
+{
+  pthread_mutex_lock(&_mutex);
+  unsigned long dropped = _dropped;
+  pthread_mutex_unlock(&_mutex);
+  return dropped;
+}
@@ -29,6 +29,11 @@ public:
    * Default destructor
    */
   virtual ~ParentDevice3D(void) = 0;
+  /**
+   * Grab new image, e.g., from background acquisition (see AsyncDevice3D)
+   * @return success
+   */
+  virtual bool grab(void) = 0;
   /**
    * Get number of rows of images
    * @return rows
@@ -5,6 +5,15 @@
 #include <libudev.h>
 #include <linux/videodev2.h>
 #include <string>
+#include <setjmp.h>
+#include <jpeglib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 
 #define DHT_SIZE 420
 
@@ -22,13 +31,30 @@ struct buffer
 
 #define CLEAR(x) memset (&(x), 0, sizeof (x))
 #define CLIP(color) (unsigned char)(((color)>0xFF)?0xff:(((color)<0)?0:(color)))
-#define R_FROMYV(y,v)  CLIP((y) + _LutRv[(v)])
-#define G_FROMYUV(y,u,v) CLIP((y) + _LutGu[(u)] + _LutGv[(v)])
-#define B_FROMYU(y,u) CLIP((y) + _LutBu[(u)])
-#define CoefRv 1402
-#define CoefGu 714 // 344
-#define CoefGv 344 // 714
-#define CoefBu 1772
+// Fixed point coefficients (scaled by 2^7), identical for scalar and SIMD conversion
+#define CoefRv 179 // 1.402
+#define CoefGu 91  // 0.714
+#define CoefGv 44  // 0.344
+#define CoefBu 227 // 1.772
+#define COEF(d, c) (((d) * (c) + 64) >> 7)
+#define R_FROMYV(y,v)  CLIP((y) + COEF((v)-128, CoefRv))
+#define G_FROMYUV(y,u,v) CLIP((y) + COEF(128-(u), CoefGu) + COEF(128-(v), CoefGv))
+#define B_FROMYU(y,u) CLIP((y) + COEF((u)-128, CoefBu))
+
+/**
+ * Error handler of libjpeg, corrupted frames are skipped instead of terminating the process
+ */
+struct JpegErrorManager
+{
+  struct jpeg_error_mgr pub;
+  jmp_buf jump;
+};
+
+static void jpegErrorExit(j_common_ptr cinfo)
+{
+  JpegErrorManager* err = (JpegErrorManager*)cinfo->err;
+  longjmp(err->jump, 1);
+}
 
 UvcCam::UvcCam(const char *dev, unsigned int width, unsigned int height)
 {
@@ -38,26 +64,23 @@ UvcCam::UvcCam(const char *dev, unsigned int width, unsigned int height)
   _width = width;
   _height = height;
   _colorMode = CAMRGB;
-  _LutRv = (int *)malloc(256 * sizeof(int));
-  _LutGu = (int *)malloc(256 * sizeof(int));
-  _LutGv = (int *)malloc(256 * sizeof(int));
-  _LutBu = (int *)malloc(256 * sizeof(int));
   _nb_buffers = NB_BUFFERS;
   _mem = NULL;
   _format = V4L2_PIX_FMT_YUYV;
 
-  for(int i = 0; i < 256; i++)
-  {
-    _LutRv[i] = (i - 128) * CoefRv / 1000;
-    _LutGu[i] = (128 - i) * CoefGu / 1000;
-    _LutGv[i] = (128 - i) * CoefGv / 1000;
-    _LutBu[i] = (i - 128) * CoefBu / 1000;
-  }
+  _backgroundDecoding = false;
+  _decodeRun          = false;
+  _decoded[0]         = NULL;
+  _decoded[1]         = NULL;
+  _decodedFront       = 0;
+  _decodedNew         = false;
+  pthread_mutex_init(&_decodeMutex, NULL);
 }
 
 UvcCam::~UvcCam()
 {
   disconnect();
+  pthread_mutex_destroy(&_decodeMutex);
   delete _dev;
 }
 
@@ -390,6 +413,25 @@ EnumCameraError UvcCam::startStreaming()
     exit(1);
   }
 
+  if(_backgroundDecoding && _format == V4L2_PIX_FMT_MJPEG)
+  {
+    _decoded[0]   = new unsigned char[_width*_height*3];
+    _decoded[1]   = new unsigned char[_width*_height*3];
+    _decodedFront = 0;
+    _decodedNew   = false;
+    _decodeRun    = true;
+    if(pthread_create(&_decodeThread, NULL, &UvcCam::decodeTask, this) != 0)
+    {
+      LOGMSG(DBG_DEBUG, "Unable to start decoding thread");
+      _decodeRun = false;
+      delete [] _decoded[0];
+      delete [] _decoded[1];
+      _decoded[0] = NULL;
+      _decoded[1] = NULL;
+      return CAMERRORINIT;
+    }
+  }
+
   return CAMSUCCESS;
 }
 
@@ -401,6 +443,17 @@ EnumCameraError UvcCam::stopStreaming()
     return CAMERRORINIT;
   }
 
+  pthread_mutex_lock(&_decodeMutex);
+  bool decoding = _decodeRun;
+  _decodeRun = false;
+  pthread_mutex_unlock(&_decodeMutex);
+  if(decoding)
+    pthread_join(_decodeThread, NULL);
+  delete [] _decoded[0];
+  delete [] _decoded[1];
+  _decoded[0] = NULL;
+  _decoded[1] = NULL;
+
   int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
   if(ioctl(_nDeviceHandle, VIDIOC_STREAMOFF, &type) < 0)
   {
@@ -419,42 +472,211 @@ EnumCameraError UvcCam::grab(unsigned char* image, unsigned int* bytes)
     return CAMERRORINIT;
   }
 
-  CLEAR(_buf);
-  _buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-  _buf.memory = V4L2_MEMORY_MMAP;
+  pthread_mutex_lock(&_decodeMutex);
+  if(_decodeRun)
+  {
+    EnumCameraError retval = CAMGRABBING;
+    if(_decodedNew)
+    {
+      memcpy(image, _decoded[_decodedFront], _width*_height*3);
+      _decodedNew = false;
+      if(bytes)
+        *bytes = _width*_height*3;
+      retval = CAMSUCCESS;
+    }
+    pthread_mutex_unlock(&_decodeMutex);
+    return retval;
+  }
+  pthread_mutex_unlock(&_decodeMutex);
+
+  UvcFrame frame;
+  EnumCameraError retval = dequeue(&frame);
+  if(retval != CAMSUCCESS)
+    return retval;
+
+  // LOGMSG(DBG_DEBUG, "Bytes used: " << frame.bytes);
 
-  if(ioctl(_nDeviceHandle, VIDIOC_DQBUF, &_buf) < 0)
+  if(bytes)
+    *bytes = frame.bytes;
+
+  // The buffer is converted before it is given back to the driver, so that it cannot be overwritten meanwhile
+  retval = CAMGRABBING;
+  if(frame.bytes > 0)
+  {
+    if(_format == V4L2_PIX_FMT_YUYV)
+    {
+      if(_colorMode == CAMRGB)
+        convertYUYVToRGB(frame.data, image, _width, _height);
+      else if(_colorMode == CAMGRAYSCALE)
+        convertYUYVToGray(frame.data, image, _width, _height);
+    }
+    else
+      memcpy(image, frame.data, frame.bytes + DHT_SIZE);
+    retval = CAMSUCCESS;
+  }
+
+  if(release(&frame) != CAMSUCCESS)
+    return CAMFAILURE;
+
+  return retval;
+}
+
+EnumCameraError UvcCam::lease(UvcFrame* frame)
+{
+  // Buffers are dequeued by the decoding thread
+  if(isDecoding())
+  {
+    LOGMSG(DBG_DEBUG, "Buffers cannot be leased while background decoding is active.");
+    return CAMERRORINIT;
+  }
+  return dequeue(frame);
+}
+
+EnumCameraError UvcCam::dequeue(UvcFrame* frame)
+{
+  if(_nDeviceHandle == -1 || _mem == NULL)
+  {
+    LOGMSG(DBG_DEBUG, "Trying to lease buffer of not streaming camera device.");
+    return CAMERRORINIT;
+  }
+
+  struct v4l2_buffer buf;
+  CLEAR(buf);
+  buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buf.memory = V4L2_MEMORY_MMAP;
+
+  if(ioctl(_nDeviceHandle, VIDIOC_DQBUF, &buf) < 0)
   {
     LOGMSG(DBG_DEBUG, "Unable to dequeue buffer");
     return CAMFAILURE;
   }
 
-  if(ioctl(_nDeviceHandle, VIDIOC_QBUF, &_buf) < 0)
+  frame->data      = (unsigned char*)_mem[buf.index].start;
+  frame->bytes     = buf.bytesused;
+  frame->index     = buf.index;
+  frame->sequence  = buf.sequence;
+  frame->timestamp = (double)buf.timestamp.tv_sec + (double)buf.timestamp.tv_usec * 1e-6;
+
+  return CAMSUCCESS;
+}
+
+EnumCameraError UvcCam::release(UvcFrame* frame)
+{
+  if(_nDeviceHandle == -1)
+  {
+    LOGMSG(DBG_DEBUG, "Trying to release buffer of not initialized camera device.");
+    return CAMERRORINIT;
+  }
+
+  struct v4l2_buffer buf;
+  CLEAR(buf);
+  buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  buf.memory = V4L2_MEMORY_MMAP;
+  buf.index = frame->index;
+
+  if(ioctl(_nDeviceHandle, VIDIOC_QBUF, &buf) < 0)
   {
     LOGMSG(DBG_DEBUG, "Unable to requeue buffer");
     return CAMFAILURE;
   }
 
-  // LOGMSG(DBG_DEBUG, "Bytes used: " << _buf.bytesused);
+  frame->data  = NULL;
+  frame->bytes = 0;
 
-  if(bytes)
-    *bytes = _buf.bytesused;
+  return CAMSUCCESS;
+}
+
+void UvcCam::setNumberOfBuffers(unsigned int buffers)
+{
+  if(_mem != NULL)
+  {
+    LOGMSG(DBG_DEBUG, "Number of buffers cannot be changed while streaming.");
+    return;
+  }
+  _nb_buffers = (buffers < 2 ? 2 : buffers);
+}
 
-  if(_buf.bytesused > 0)
+void UvcCam::setBackgroundDecoding(bool enable)
+{
+  if(_mem != NULL)
   {
-    if(_format == V4L2_PIX_FMT_YUYV)
+    LOGMSG(DBG_DEBUG, "Background decoding cannot be changed while streaming.");
+    return;
+  }
+  _backgroundDecoding = enable;
+}
+
+bool UvcCam::isDecoding()
+{
+  pthread_mutex_lock(&_decodeMutex);
+  bool decoding = _decodeRun;
+  pthread_mutex_unlock(&_decodeMutex);
+  return decoding;
+}
+
+void* UvcCam::decodeTask(void* arg)
+{
+  UvcCam* cam = (UvcCam*)arg;
+  while(cam->isDecoding())
+  {
+    UvcFrame frame;
+    if(cam->dequeue(&frame) != CAMSUCCESS)
     {
-      if(_colorMode == CAMRGB)
-        Pyuv422torgb24((unsigned char *)(_mem[_buf.index].start), image, _width, _height);
-      else if(_colorMode == CAMGRAYSCALE)
-        Pyuv422togray((unsigned char *)(_mem[_buf.index].start), image, _width, _height);
+      usleep(1000);
+      continue;
+    }
+
+    // The back buffer is only accessed by this thread
+    unsigned int back = 1 - cam->_decodedFront;
+    bool success = (frame.bytes > 0) && cam->decodeMJPEG(frame.data, frame.bytes, cam->_decoded[back]);
+    cam->release(&frame);
+
+    if(success)
+    {
+      pthread_mutex_lock(&cam->_decodeMutex);
+      cam->_decodedFront = back;
+      cam->_decodedNew   = true;
+      pthread_mutex_unlock(&cam->_decodeMutex);
     }
-    else
-      memcpy(image, _mem[_buf.index].start, _buf.bytesused + DHT_SIZE);
-    return CAMSUCCESS;
   }
+  return NULL;
+}
 
-  return CAMGRABBING;
+bool UvcCam::decodeMJPEG(unsigned char* src, unsigned int bytes, unsigned char* dst)
+{
+  struct jpeg_decompress_struct cinfo;
+  JpegErrorManager jerr;
+
+  cinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = jpegErrorExit;
+  if(setjmp(jerr.jump))
+  {
+    jpeg_destroy_decompress(&cinfo);
+    LOGMSG(DBG_DEBUG, "Corrupted MJPEG frame skipped");
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, src, bytes);
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_RGB;
+  if((cinfo.image_width != _width) || (cinfo.image_height != _height))
+  {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  jpeg_start_decompress(&cinfo);
+  unsigned int rowStride = cinfo.output_width * cinfo.output_components;
+  while(cinfo.output_scanline < cinfo.output_height)
+  {
+    JSAMPROW row = &dst[cinfo.output_scanline * rowStride];
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+
+  return true;
 }
 
 EnumCameraError UvcCam::printAvailableFormats()
@@ -527,6 +749,9 @@ EnumCameraError UvcCam::mapMemory()
     LOGMSG(DBG_DEBUG, "Unable to allocate buffers .");
     return CAMERRORINIT;
   }
+  // driver might provide less buffers than requested
+  if((int)_rb.count < _nb_buffers)
+    _nb_buffers = _rb.count;
   _mem = (buffer *)calloc(_nb_buffers, sizeof(*_mem));
 
   // map the buffers
@@ -560,6 +785,8 @@ void UvcCam::unmapMemory()
     {
       munmap(_mem[i].start, _mem[i].length);
     }
+    free(_mem);
+    _mem = NULL;
   }
 
   CLEAR(_rb);
@@ -570,50 +797,102 @@ void UvcCam::unmapMemory()
 }
 
 // aus lucview color.c util.c
-unsigned int UvcCam::Pyuv422torgb24(unsigned char * input_ptr, unsigned char * output_ptr, unsigned int image_width, unsigned int image_height)
-{
-  unsigned int i, size;
-  unsigned char Y, Y1, U, V;
-  unsigned char *buff = input_ptr;
-  unsigned char *output_pt = output_ptr;
-  size = image_width * image_height / 2;
-  for(i = size; i > 0; i--)
-  {
-    /* bgr instead rgb ?? */
-    Y = buff[0];
-    U = buff[1];
-    Y1 = buff[2];
-    V = buff[3];
+void UvcCam::convertYUYVToRGB(const unsigned char* src, unsigned char* dst, unsigned int width, unsigned int height)
+{
+  unsigned int pixels = width * height;
+  unsigned int i = 0;
+
+#ifdef __SSSE3__
+  // 16 pixels per iteration: 32 bytes YUYV -> 48 bytes RGB
+  const __m128i maskY  = _mm_set1_epi16(0x00FF);
+  const __m128i offset = _mm_set1_epi16(128);
+  const __m128i round  = _mm_set1_epi16(64);
+  const __m128i rv     = _mm_set1_epi16(CoefRv);
+  const __m128i gu     = _mm_set1_epi16(CoefGu);
+  const __m128i gv     = _mm_set1_epi16(CoefGv);
+  const __m128i bu     = _mm_set1_epi16(CoefBu);
+
+  // Shuffle masks interleaving planar R, G and B vectors to packed RGB
+  const __m128i shufR0 = _mm_setr_epi8(0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128, 5);
+  const __m128i shufG0 = _mm_setr_epi8(-128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128, -128);
+  const __m128i shufB0 = _mm_setr_epi8(-128, -128, 0, -128, -128, 1, -128, -128, 2, -128, -128, 3, -128, -128, 4, -128);
+  const __m128i shufR1 = _mm_setr_epi8(-128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10, -128);
+  const __m128i shufG1 = _mm_setr_epi8(5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128, 10);
+  const __m128i shufB1 = _mm_setr_epi8(-128, 5, -128, -128, 6, -128, -128, 7, -128, -128, 8, -128, -128, 9, -128, -128);
+  const __m128i shufR2 = _mm_setr_epi8(-128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128, -128);
+  const __m128i shufG2 = _mm_setr_epi8(-128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15, -128);
+  const __m128i shufB2 = _mm_setr_epi8(10, -128, -128, 11, -128, -128, 12, -128, -128, 13, -128, -128, 14, -128, -128, 15);
+
+  for(; i + 16 <= pixels; i += 16)
+  {
+    __m128i r[2], g[2], b[2];
+    for(unsigned int k = 0; k < 2; k++)
+    {
+      __m128i in = _mm_loadu_si128((const __m128i*)&src[2*i + 16*k]);
+      __m128i y  = _mm_and_si128(in, maskY);
+      __m128i uv = _mm_srli_epi16(in, 8);
+      // duplicate chroma values for both pixels of a pair: U0 U0 U1 U1 ... and V0 V0 V1 V1 ...
+      __m128i u  = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2,2,0,0)), _MM_SHUFFLE(2,2,0,0));
+      __m128i v  = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3,3,1,1)), _MM_SHUFFLE(3,3,1,1));
+      __m128i du = _mm_sub_epi16(u, offset);
+      __m128i dv = _mm_sub_epi16(v, offset);
+      __m128i nu = _mm_sub_epi16(offset, u);
+      __m128i nv = _mm_sub_epi16(offset, v);
+      r[k] = _mm_add_epi16(y, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(dv, rv), round), 7));
+      g[k] = _mm_add_epi16(y, _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(nu, gu), round), 7),
+                                            _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(nv, gv), round), 7)));
+      b[k] = _mm_add_epi16(y, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(du, bu), round), 7));
+    }
+    // saturate to [0, 255]
+    __m128i R = _mm_packus_epi16(r[0], r[1]);
+    __m128i G = _mm_packus_epi16(g[0], g[1]);
+    __m128i B = _mm_packus_epi16(b[0], b[1]);
+
+    unsigned char* out = &dst[3*i];
+    _mm_storeu_si128((__m128i*)&out[0],  _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(R, shufR0), _mm_shuffle_epi8(G, shufG0)), _mm_shuffle_epi8(B, shufB0)));
+    _mm_storeu_si128((__m128i*)&out[16], _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(R, shufR1), _mm_shuffle_epi8(G, shufG1)), _mm_shuffle_epi8(B, shufB1)));
+    _mm_storeu_si128((__m128i*)&out[32], _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(R, shufR2), _mm_shuffle_epi8(G, shufG2)), _mm_shuffle_epi8(B, shufB2)));
+  }
+#endif
+
+  // remaining pixels
+  const unsigned char* buff = &src[2*i];
+  unsigned char* output_pt = &dst[3*i];
+  for(; i + 2 <= pixels; i += 2)
+  {
+    int Y  = buff[0];
+    int U  = buff[1];
+    int Y1 = buff[2];
+    int V  = buff[3];
     buff += 4;
     *output_pt++ = R_FROMYV(Y, V);
-    *output_pt++ = G_FROMYUV(Y, U, V);  //b
-    *output_pt++ = B_FROMYU(Y, U);  //v
+    *output_pt++ = G_FROMYUV(Y, U, V);
+    *output_pt++ = B_FROMYU(Y, U);
 
     *output_pt++ = R_FROMYV(Y1, V);
-    *output_pt++ = G_FROMYUV(Y1, U, V);  //b
-    *output_pt++ = B_FROMYU(Y1, U);  //v
+    *output_pt++ = G_FROMYUV(Y1, U, V);
+    *output_pt++ = B_FROMYU(Y1, U);
   }
-
-  return 1;
 }
 
-unsigned int UvcCam::Pyuv422togray(unsigned char* input_ptr, unsigned char* output_ptr, unsigned int image_width, unsigned int image_height)
+void UvcCam::convertYUYVToGray(const unsigned char* src, unsigned char* dst, unsigned int width, unsigned int height)
 {
-  unsigned int i, size;
-  unsigned char Y, Y1;
-  unsigned char *buff = input_ptr;
-  unsigned char *output_pt = output_ptr;
-  size = image_width * image_height / 2;
-  for(i = size; i > 0; i--)
+  unsigned int pixels = width * height;
+  unsigned int i = 0;
+
+#ifdef __SSE2__
+  // 16 pixels per iteration, luminance is stored in every even byte
+  const __m128i maskY = _mm_set1_epi16(0x00FF);
+  for(; i + 16 <= pixels; i += 16)
   {
-    Y = buff[0];
-    Y1 = buff[2];
-    buff += 4;
-    *output_pt++ = Y;
-    *output_pt++ = Y1;
+    __m128i in0 = _mm_loadu_si128((const __m128i*)&src[2*i]);
+    __m128i in1 = _mm_loadu_si128((const __m128i*)&src[2*i+16]);
+    _mm_storeu_si128((__m128i*)&dst[i], _mm_packus_epi16(_mm_and_si128(in0, maskY), _mm_and_si128(in1, maskY)));
   }
+#endif
 
-  return 1;
+  for(; i < pixels; i++)
+    dst[i] = src[2*i];
 }
 
 /* return >= 0 ok otherwhise -1 */
@@ -13,6 +13,7 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 using namespace std;
 
@@ -23,7 +24,7 @@ namespace obvious
 {
 
 #define LIMITVALUE(x)  ((x)>0xffffff?0xff: ((x)<=0xffff?0:((x)>>16)))
-#define NB_BUFFERS 2
+#define NB_BUFFERS 4
 
 /**
  * @enum EnumCameraError
@@ -38,6 +39,24 @@ enum EnumCameraColorMode { CAMRGB, CAMGRAYSCALE };
  */
 enum EnumCameraPixelFormat {CAMMJPEG, CAMYUYV};
 
+/**
+ * @struct UvcFrame
+ * @brief Memory mapped driver buffer leased by UvcCam::lease. Data stays valid until UvcCam::release is called.
+ */
+struct UvcFrame
+{
+  // raw image data, i.e., YUYV or MJPEG
+  unsigned char* data;
+  // number of valid bytes
+  unsigned int bytes;
+  // driver buffer index
+  unsigned int index;
+  // frame counter of driver
+  unsigned int sequence;
+  // capture time stamp in seconds
+  double timestamp;
+};
+
 /**
  * @class UvcCam
  * @brief Class encapsulates local camera device handling with uvc chipset
@@ -112,6 +131,55 @@ public:
    */
   EnumCameraError grab(unsigned char* img, unsigned int* bytes = NULL);
 
+  /**
+   * Lease the next memory mapped driver buffer without copying (blocking).
+   * The buffer is not refilled by the driver until it is returned with UvcCam::release.
+   * Not available while background decoding is active.
+   * @param frame leased frame
+   * @return Grabbing state, CAMERRORINIT while background decoding is active
+   */
+  EnumCameraError lease(UvcFrame* frame);
+
+  /**
+   * Return a leased buffer to the driver
+   * @param frame frame obtained with UvcCam::lease
+   * @return Grabbing state
+   */
+  EnumCameraError release(UvcFrame* frame);
+
+  /**
+   * Set number of driver buffers. More buffers allow for more simultaneously leased frames.
+   * Must be called before UvcCam::startStreaming.
+   * @param buffers number of buffers (at least 2)
+   */
+  void setNumberOfBuffers(unsigned int buffers);
+
+  /**
+   * Decode MJPEG streams in a background thread. UvcCam::grab then returns the latest decoded RGB image
+   * or CAMGRABBING if no new image has been decoded since the last call.
+   * Must be called before UvcCam::startStreaming.
+   * @param enable enable flag
+   */
+  void setBackgroundDecoding(bool enable);
+
+  /**
+   * Convert an image in YUYV format to RGB format (SSSE3-accelerated if available)
+   * @param src source buffer with yuyv image
+   * @param dst destination buffer (3*width*height bytes)
+   * @param width image width
+   * @param height image height
+   */
+  static void convertYUYVToRGB(const unsigned char* src, unsigned char* dst, unsigned int width, unsigned int height);
+
+  /**
+   * Convert an image in YUYV format to grayscale format (SSE2-accelerated if available)
+   * @param src source buffer with yuyv image
+   * @param dst destination buffer (width*height bytes)
+   * @param width image width
+   * @param height image height
+   */
+  static void convertYUYVToGray(const unsigned char* src, unsigned char* dst, unsigned int width, unsigned int height);
+
   /**
    * Opens the connection to the UVC camera and initializes the device with
    * the settings specified in the constructor.
@@ -191,24 +259,31 @@ private:
   void unmapMemory();
 
   /**
-   * Convert an image in YUV format to RGB format
-   * @param input_ptr Source buffer with yuv image
-   * @param output_ptr Destination buffer to store rgb data (must be instantiated externally).
-   * @param image_width Width of source image
-   * @param image_height Height of source image
-   * @return Status of conversion. 0 if image could not be successfully converted.
+   * Dequeue next driver buffer, used by lease and the decoding thread
+   * @param frame leased frame
+   * @return Grabbing state
    */
-  unsigned int Pyuv422torgb24(unsigned char* input_ptr, unsigned char* output_ptr, unsigned int image_width, unsigned int image_height);
+  EnumCameraError dequeue(UvcFrame* frame);
 
   /**
-   * Convert an image in YUV format to grayscale format
-   * @param input_ptr Source buffer with yuv image
-   * @param output_ptr Destination buffer to store grayscale data (must be instantiated externally).
-   * @param image_width Width of source image
-   * @param image_height Height of source image
-   * @return Status of conversion. 0 if image could not be successfully converted.
+   * Check whether decoding thread is running
+   * @return state, read under lock
    */
-  unsigned int Pyuv422togray(unsigned char* input_ptr, unsigned char* output_ptr, unsigned int image_width, unsigned int image_height);
+  bool isDecoding();
+
+  /**
+   * Thread function of background MJPEG decoding
+   */
+  static void* decodeTask(void* arg);
+
+  /**
+   * Decode MJPEG data
+   * @param src compressed data
+   * @param bytes number of bytes of compressed data
+   * @param dst destination buffer (3*width*height bytes)
+   * @return success
+   */
+  bool decodeMJPEG(unsigned char* src, unsigned int bytes, unsigned char* dst);
 
   int isv4l2Control(int nHandle, int control, struct v4l2_queryctrl *queryctrl);
 
@@ -250,11 +325,18 @@ private:
   struct v4l2_buffer _buf;
   struct buffer* _mem;
   struct v4l2_requestbuffers _rb;
-  int* _LutRv;
-  int* _LutGu;
-  int* _LutGv;
-  int* _LutBu;
   unsigned int _format;
+
+  /**
+   * Background decoding of MJPEG streams, _decodeRun and the decoded buffers are guarded by _decodeMutex
+   */
+  bool _backgroundDecoding;
+  bool _decodeRun;
+  pthread_t _decodeThread;
+  pthread_mutex_t _decodeMutex;
+  unsigned char* _decoded[2];
+  unsigned int _decodedFront;
+  bool _decodedNew;
 };
 
 }
@@ -1,5 +1,9 @@
 #include "UvcVirtualCam.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace obvious
 {
 
@@ -12,10 +16,7 @@ UvcVirtualCam::UvcVirtualCam(const char* dev, unsigned int maxWidth, unsigned in
   _cam->startStreaming();
 
   _buf  = new unsigned char[maxWidth*maxHeight*3];
-  _bufR = new unsigned char[maxWidth*maxHeight];
-  _bufG = new unsigned char[maxWidth*maxHeight];
-  _bufB = new unsigned char[maxWidth*maxHeight];
-  _bufI = new unsigned int[maxWidth*maxHeight];
+  _bufI = new unsigned short[maxWidth*3];
 
   _maxWidth = maxWidth;
   _maxHeight = maxHeight;
@@ -25,9 +26,6 @@ UvcVirtualCam::UvcVirtualCam(const char* dev, unsigned int maxWidth, unsigned in
 UvcVirtualCam::~UvcVirtualCam()
 {
   delete [] _bufI;
-  delete [] _bufR;
-  delete [] _bufG;
-  delete [] _bufB;
   delete [] _buf;
   delete _cam;
 }
@@ -46,7 +44,13 @@ EnumCameraError UvcVirtualCam::setScale(unsigned int scale)
 {
   if(scale<1)
   {
-    cout << "UvcVirtualCam::grab(): Scale factor must be greater than 0." << endl;
+    cout << "UvcVirtualCam::setScale(): Scale factor must be greater than 0." << endl;
+    return CAMFAILURE;
+  }
+
+  if(scale>257)
+  {
+    cout << "UvcVirtualCam::setScale(): Scale factor must not exceed 257." << endl;
     return CAMFAILURE;
   }
 
@@ -58,7 +62,7 @@ EnumCameraError UvcVirtualCam::setScale(unsigned int scale)
 
   if(checkrows*scale != rows || checkcols*scale != cols)
   {
-    cout << "UvcVirtualCam::grab(): Width and height must be a multiple of the scale factor." << endl;
+    cout << "UvcVirtualCam::setScale(): Width and height must be a multiple of the scale factor." << endl;
     return CAMFAILURE;
   }
 
@@ -85,81 +89,60 @@ EnumCameraError UvcVirtualCam::grab(unsigned char* image)
   unsigned int channels = _cam->getChannels();
   unsigned int cols     = _cam->getWidth();
   unsigned int rows     = _cam->getHeight();
-  unsigned int ctr      = 0;
 
   EnumCameraError retval = _cam->grab(_buf);
 
   if(retval!=CAMSUCCESS) return retval;
 
-  if(channels==3)
-  {
-    for(unsigned int i=0;i<cols*rows*channels;i++)
-    {
-      _bufR[ctr]=_buf[i];
-      _bufG[ctr]=_buf[++i];
-      _bufB[ctr]=_buf[++i];
-      ctr++;
-    }
-
-    average(_bufR, cols, rows, _scale);
-    average(_bufG, cols, rows, _scale);
-    average(_bufB, cols, rows, _scale);
-
-    ctr=0;
-    for(unsigned int i=0;i<(rows/_scale)*(cols/_scale)*channels;i++)
-    {
-      image[i]  =_bufR[ctr];
-      image[++i]=_bufG[ctr];
-      image[++i]=_bufB[ctr];
-      ctr++;
-    }
-  }
+  if(_scale==1)
+    memcpy(image, _buf, cols*rows*channels*sizeof(*image));
   else
-  {
-    average(_buf, cols, rows, _scale);
-    memcpy(image, _buf, cols*rows/(_scale*_scale)*sizeof(*image));
-  }
+    average(_buf, image, cols, rows, channels, _scale);
 
   return retval;
 }
 
-void UvcVirtualCam::average(unsigned char* img, unsigned int cols, unsigned int rows, unsigned int scale)
+void UvcVirtualCam::average(const unsigned char* src, unsigned char* dst, unsigned int cols, unsigned int rows, unsigned int channels, unsigned int scale)
 {
-  // sum up column-wise
-  unsigned int iold = 0;
-  unsigned int inew = 0;
-  for(unsigned int r=0; r<rows; r++)
+  const unsigned int width = cols*channels;
+  const unsigned int area  = scale*scale;
+  const unsigned int colsNew = cols/scale;
+
+  for(unsigned int r=0; r+scale<=rows; r+=scale)
   {
-    for(unsigned int c=0; c<cols; c+=scale)
+    // sum up rows of block
+    memset(_bufI, 0, width*sizeof(*_bufI));
+    for(unsigned int i=0; i<scale; i++)
     {
-      _bufI[inew] = 0;
-      for(unsigned int i=0; i<scale; i++)
+      const unsigned char* row = &src[(r+i)*width];
+      unsigned int c = 0;
+#ifdef __SSE2__
+      const __m128i zero = _mm_setzero_si128();
+      for(; c+16<=width; c+=16)
       {
-        _bufI[inew] += img[iold];
-        iold++;
+        __m128i v  = _mm_loadu_si128((const __m128i*)&row[c]);
+        __m128i lo = _mm_loadu_si128((const __m128i*)&_bufI[c]);
+        __m128i hi = _mm_loadu_si128((const __m128i*)&_bufI[c+8]);
+        _mm_storeu_si128((__m128i*)&_bufI[c],   _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128((__m128i*)&_bufI[c+8], _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero)));
       }
-      inew++;
+#endif
+      for(; c<width; c++)
+        _bufI[c] += row[c];
     }
-  }
 
-  // sum up row-wise
-  unsigned int area = scale*scale;
-  cols/=scale;
-  inew = 0;
-  for(unsigned int c=0; c<cols; c++)
-  {
-    iold = c;
-    inew = c;
-    for(unsigned int r=0; r<rows; r+=scale)
+    // sum up columns of block
+    unsigned char* out = &dst[(r/scale)*colsNew*channels];
+    for(unsigned int c=0; c<colsNew; c++)
     {
-      unsigned int sum = 0;
-      for(unsigned int i=0; i<scale; i++)
+      for(unsigned int ch=0; ch<channels; ch++)
       {
-        sum += _bufI[iold];
-        iold+=cols;
+        unsigned int sum = 0;
+        const unsigned short* in = &_bufI[c*scale*channels + ch];
+        for(unsigned int i=0; i<scale; i++)
+          sum += in[i*channels];
+        out[c*channels+ch] = sum/area;
       }
-      img[inew] = sum/area;
-      inew+=cols;
     }
   }
 }
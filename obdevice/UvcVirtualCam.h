@@ -71,14 +71,21 @@ public:
 
 private:
 
-  void average(unsigned char* img, unsigned int cols, unsigned int rows, unsigned int scale);
+  /**
+   * Downscale image by averaging scale x scale blocks. Channels are processed interleaved.
+   * Rows are summed up with SSE2 (if available) before blocks are reduced column-wise.
+   * @param src source image
+   * @param dst destination image ((cols/scale)*(rows/scale)*channels bytes)
+   * @param cols number of columns of source image
+   * @param rows number of rows of source image
+   * @param channels number of channels
+   * @param scale downscaling factor (at most 257 to avoid overflow of row sums)
+   */
+  void average(const unsigned char* src, unsigned char* dst, unsigned int cols, unsigned int rows, unsigned int channels, unsigned int scale);
 
   UvcCam* _cam;
   unsigned char* _buf;
-  unsigned char* _bufR;
-  unsigned char* _bufG;
-  unsigned char* _bufB;
-  unsigned int* _bufI;
+  unsigned short* _bufI;
 
   unsigned int _maxWidth;
   unsigned int _maxHeight;
@@ -27,7 +27,9 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <vector>
 #include <ctime>
+#include <cstring>
 
 #include "obcore/math/mathbase.h"
 #include "obcore/base/Logger.h"
@@ -139,6 +141,12 @@ void cloudCallback (vtkObject* caller, long unsigned int eventId, void* clientDa
   }
 }
 
+void renderCallback(vtkObject* caller, long unsigned int eventId, void* clientData, void* callData)
+{
+  Obvious3D* viewer = static_cast<Obvious3D*>(clientData);
+  viewer->renderPublished();
+}
+
 Obvious3D::Obvious3D(const char* windowName, unsigned int sizx, unsigned int sizy, unsigned int posx, unsigned int posy, double rgb[])
 {
   _this = this;
@@ -171,11 +179,28 @@ Obvious3D::Obvious3D(const char* windowName, unsigned int sizx, unsigned int siz
 
   _mCallback.clear();
   _mDesc.clear();
+
+  _poseFront = 0;
+  _poseDirty = false;
+  _rendering = false;
+  pthread_mutex_init(&_sceneMutex, NULL);
 }
 
 Obvious3D::~Obvious3D()
 {
-
+  for(std::map<VtkCloud*, SceneSlot*>::iterator it=_slots.begin(); it!=_slots.end(); ++it)
+  {
+    SceneSlot* slot = it->second;
+    for(unsigned int i=0; i<2; i++)
+    {
+      delete [] slot->buffer[i].coords;
+      delete [] slot->buffer[i].normals;
+      delete [] slot->buffer[i].rgb;
+      delete [] slot->buffer[i].indices;
+    }
+    delete slot;
+  }
+  pthread_mutex_destroy(&_sceneMutex);
 }
 
 void Obvious3D::addCloud(VtkCloud* cloud, bool pickable, unsigned int pointsize, double opacity)
@@ -433,6 +458,171 @@ void Obvious3D::startRendering()
   _renderWindowInteractor->Start();
 }
 
+void Obvious3D::startAsyncRendering(unsigned int fps)
+{
+  if(fps==0) fps = 1;
+
+  vtkSmartPointer<vtkCallbackCommand> cb = vtkSmartPointer<vtkCallbackCommand>::New();
+  cb->SetCallback(renderCallback);
+  cb->SetClientData(this);
+  _renderWindowInteractor->AddObserver(vtkCommand::TimerEvent, cb);
+  _renderWindowInteractor->CreateRepeatingTimer(1000/fps);
+
+  pthread_mutex_lock(&_sceneMutex);
+  _rendering = true;
+  pthread_mutex_unlock(&_sceneMutex);
+
+  renderPublished();
+  update();
+  _renderWindowInteractor->Start();
+
+  pthread_mutex_lock(&_sceneMutex);
+  _rendering = false;
+  pthread_mutex_unlock(&_sceneMutex);
+}
+
+bool Obvious3D::isRendering()
+{
+  pthread_mutex_lock(&_sceneMutex);
+  bool rendering = _rendering;
+  pthread_mutex_unlock(&_sceneMutex);
+  return rendering;
+}
+
+SceneSlot* Obvious3D::getSlot(VtkCloud* cloud)
+{
+  std::map<VtkCloud*, SceneSlot*>::iterator it = _slots.find(cloud);
+  if(it!=_slots.end()) return it->second;
+
+  SceneSlot* slot = new SceneSlot;
+  memset(slot, 0, sizeof(SceneSlot));
+  _slots[cloud] = slot;
+  return slot;
+}
+
+SceneBuffer* Obvious3D::getBackBuffer(VtkCloud* cloud, unsigned int size, unsigned int triangles)
+{
+  pthread_mutex_lock(&_sceneMutex);
+  SceneSlot* slot = getSlot(cloud);
+  pthread_mutex_unlock(&_sceneMutex);
+
+  // The back buffer is never accessed by the render thread, i.e., it can be written without locking
+  SceneBuffer* back = &(slot->buffer[1-slot->front]);
+  if(size > back->capacity)
+  {
+    delete [] back->coords;
+    delete [] back->normals;
+    delete [] back->rgb;
+    back->coords   = new double[3*size];
+    back->normals  = new double[3*size];
+    back->rgb      = new unsigned char[3*size];
+    back->capacity = size;
+  }
+  if(triangles > back->capacityTriangles)
+  {
+    delete [] back->indices;
+    back->indices           = new unsigned int[3*triangles];
+    back->capacityTriangles = triangles;
+  }
+  back->size      = size;
+  back->triangles = triangles;
+  return back;
+}
+
+void Obvious3D::swapBuffers(VtkCloud* cloud)
+{
+  pthread_mutex_lock(&_sceneMutex);
+  SceneSlot* slot = getSlot(cloud);
+  slot->front = 1-slot->front;
+  slot->dirty = true;
+  pthread_mutex_unlock(&_sceneMutex);
+}
+
+void Obvious3D::publishCloud(VtkCloud* cloud, double* coords, unsigned char* rgb, unsigned int size, double* normals)
+{
+  SceneBuffer* back = getBackBuffer(cloud, size, 0);
+  memcpy(back->coords, coords, 3*size*sizeof(double));
+  back->hasNormals = (normals!=NULL);
+  if(normals)
+    memcpy(back->normals, normals, 3*size*sizeof(double));
+  back->hasColors = (rgb!=NULL);
+  if(rgb)
+    memcpy(back->rgb, rgb, 3*size*sizeof(unsigned char));
+
+  swapBuffers(cloud);
+}
+
+void Obvious3D::publishMesh(VtkCloud* cloud, double* coords, unsigned char* rgb, unsigned int points, unsigned int* indices, unsigned int triangles)
+{
+  SceneBuffer* back = getBackBuffer(cloud, points, triangles);
+  memcpy(back->coords, coords, 3*points*sizeof(double));
+  memcpy(back->rgb, rgb, 3*points*sizeof(unsigned char));
+  memcpy(back->indices, indices, 3*triangles*sizeof(unsigned int));
+  back->hasNormals = false;
+  back->hasColors  = true;
+
+  swapBuffers(cloud);
+}
+
+void Obvious3D::publishSensorPose(const double* T)
+{
+  // Only the producer modifies _poseFront, i.e., the back buffer can be written without locking
+  memcpy(_pose[1-_poseFront], T, 16*sizeof(double));
+
+  pthread_mutex_lock(&_sceneMutex);
+  _poseFront = 1-_poseFront;
+  _poseDirty = true;
+  pthread_mutex_unlock(&_sceneMutex);
+}
+
+void Obvious3D::renderPublished()
+{
+  bool modified = false;
+
+  pthread_mutex_lock(&_sceneMutex);
+  for(std::map<VtkCloud*, SceneSlot*>::iterator it=_slots.begin(); it!=_slots.end(); ++it)
+  {
+    SceneSlot* slot = it->second;
+    if(!slot->dirty) continue;
+
+    VtkCloud* cloud    = it->first;
+    SceneBuffer* front = &(slot->buffer[slot->front]);
+    if(front->triangles>0)
+    {
+      std::vector<double*> coords(front->size);
+      std::vector<unsigned char*> rgb(front->size);
+      std::vector<unsigned int*> indices(front->triangles);
+      for(unsigned int i=0; i<front->size; i++)
+      {
+        coords[i] = &(front->coords[3*i]);
+        rgb[i]    = &(front->rgb[3*i]);
+      }
+      for(unsigned int i=0; i<front->triangles; i++)
+        indices[i] = &(front->indices[3*i]);
+      cloud->setTriangles(&coords[0], &rgb[0], front->size, &indices[0], front->triangles);
+    }
+    else
+    {
+      cloud->setCoords(front->coords, front->size, 3, front->hasNormals ? front->normals : NULL);
+      if(front->hasColors)
+        cloud->setColors(front->rgb, front->size, 3);
+    }
+    slot->dirty = false;
+    modified = true;
+  }
+
+  if(_poseDirty)
+  {
+    showSensorPose(_pose[_poseFront]);
+    _poseDirty = false;
+    modified = true;
+  }
+  pthread_mutex_unlock(&_sceneMutex);
+
+  // Rendering is done without locking, producers can meanwhile fill their back buffers
+  if(modified) update();
+}
+
 void Obvious3D::showAxes(bool show)
 {
   vtkSmartPointer<vtkAxesActor> axes = vtkSmartPointer<vtkAxesActor>::New();
@@ -16,11 +16,59 @@
 
 #include "Obvious.h"
 
+#include <map>
+#include <pthread.h>
+
 namespace obvious
 {
 
+/**
+ * @struct SceneBuffer
+ * @brief One buffer of a double-buffered scene slot of Obvious3D
+ */
+struct SceneBuffer
+{
+  // coordinates (layout x1y1z1x2...)
+  double* coords;
+  // normals (layout x1y1z1x2...)
+  double* normals;
+  // colors (layout r1g1b1r2...)
+  unsigned char* rgb;
+  // triangle indices (layout a1b1c1a2..., only used for meshes)
+  unsigned int* indices;
+  // number of points
+  unsigned int size;
+  // number of triangles (0 for point clouds)
+  unsigned int triangles;
+  // allocated number of points
+  unsigned int capacity;
+  // allocated number of triangles
+  unsigned int capacityTriangles;
+  // true if normals were published
+  bool hasNormals;
+  // true if colors were published
+  bool hasColors;
+};
+
+/**
+ * @struct SceneSlot
+ * @brief Double-buffered state of a cloud or mesh. Producers fill the back buffer and swap it with the front buffer,
+ * the render thread uploads the front buffer.
+ */
+struct SceneSlot
+{
+  SceneBuffer buffer[2];
+  // index of front buffer
+  unsigned int front;
+  // true if front buffer has not been uploaded yet
+  bool dirty;
+};
+
 /**
  * VTK-based 3D viewer
+ * Besides synchronous rendering with update(), the viewer supports a decoupled mode (see startAsyncRendering):
+ * Processing threads publish clouds, meshes and sensor poses, while the render thread picks up the latest state at its own
+ * frame rate. Publishing only copies data into a double buffer, i.e., processing threads are never stalled by rendering.
  * @author Stefan May
  */
 class Obvious3D
@@ -97,6 +145,51 @@ public:
    */
   void startRendering();
 
+  /**
+   * Start rendering loop in decoupled mode. The calling thread becomes the render thread and is taken over by VTK.
+   * Scene updates published by other threads are displayed at the given frame rate.
+   * @param fps frame rate in Hz
+   */
+  void startAsyncRendering(unsigned int fps=30);
+
+  /**
+   * Query whether rendering loop is running, e.g., to terminate processing threads after the window was closed
+   * @return true if rendering loop is active
+   */
+  bool isRendering();
+
+  /**
+   * Publish point cloud for decoupled rendering (thread-safe, one producer per cloud). Data is copied.
+   * @param cloud cloud previously added with addCloud
+   * @param coords coordinates (layout x1y1z1x2...)
+   * @param rgb colors (layout r1g1b1r2..., may be NULL)
+   * @param size number of points
+   * @param normals normals (layout x1y1z1x2..., may be NULL)
+   */
+  void publishCloud(VtkCloud* cloud, double* coords, unsigned char* rgb, unsigned int size, double* normals=NULL);
+
+  /**
+   * Publish triangle mesh for decoupled rendering (thread-safe, one producer per cloud). Data is copied.
+   * @param cloud cloud previously added with addCloud
+   * @param coords vertex coordinates (layout x1y1z1x2...)
+   * @param rgb vertex colors (layout r1g1b1r2...)
+   * @param points number of vertices
+   * @param indices vertex indices of triangles (layout a1b1c1a2...)
+   * @param triangles number of triangles
+   */
+  void publishMesh(VtkCloud* cloud, double* coords, unsigned char* rgb, unsigned int points, unsigned int* indices, unsigned int triangles);
+
+  /**
+   * Publish sensor pose for decoupled rendering (thread-safe), see showSensorPose
+   * @param T transformation matrix (row-major, size 16)
+   */
+  void publishSensorPose(const double* T);
+
+  /**
+   * Upload published scene updates and render, called periodically by the render thread
+   */
+  void renderPublished();
+
   /**
    * Function to show coordinate axes in viewer
    * @param show set to TRUE for visualization (default:=TRUE)
@@ -191,11 +284,40 @@ private:
 
   bool checkVariableRegistration(std::string key);
 
+  /**
+   * Get scene slot of cloud, must be called with locked mutex
+   * @param cloud cloud
+   * @return slot
+   */
+  SceneSlot* getSlot(VtkCloud* cloud);
+
+  /**
+   * Get back buffer of cloud for writing and ensure its capacity
+   * @param cloud cloud
+   * @param size number of points
+   * @param triangles number of triangles
+   * @return back buffer
+   */
+  SceneBuffer* getBackBuffer(VtkCloud* cloud, unsigned int size, unsigned int triangles);
+
+  /**
+   * Swap back and front buffer of cloud
+   * @param cloud cloud
+   */
+  void swapBuffers(VtkCloud* cloud);
+
   vtkSmartPointer<vtkRenderer>                _renderer;
   vtkSmartPointer<vtkRenderWindow>            _renderWindow;
   vtkSmartPointer<vtkRenderWindowInteractor>  _renderWindowInteractor;
   vtkSmartPointer<vtkExtractSelectedFrustum>  _frust;
   vtkSmartPointer<vtkAxesActor>               _sensor_axes;
+
+  std::map<VtkCloud*, SceneSlot*>             _slots;
+  double                                      _pose[2][16];
+  unsigned int                                _poseFront;
+  bool                                        _poseDirty;
+  bool                                        _rendering;
+  pthread_mutex_t                             _sceneMutex;
 };
 
 }
@@ -24,17 +24,62 @@
 #include "obcore/base/Logger.h"
 
 #include <string>
+#include <vector>
+#include <cstring>
+#include <cmath>
 
 using namespace std;
 
 namespace obvious
 {
 
+/**
+ * Select first point of each occupied voxel by open addressing hash of voxel indices
+ * @param points point set
+ * @param voxelSize edge length of voxels
+ * @param indices indices of selected points
+ */
+static void subsampleVoxelGrid(vtkPoints* points, double voxelSize, vector<vtkIdType> &indices)
+{
+  const unsigned long long empty = ~0ULL;
+  vtkIdType size = points->GetNumberOfPoints();
+
+  unsigned int bits = 1;
+  while(((vtkIdType)1 << bits) < 2*size) bits++;
+  const unsigned long long mask = (1ULL << bits) - 1;
+  vector<unsigned long long> table(mask+1, empty);
+
+  const double invSize = 1.0 / voxelSize;
+  double p[3];
+  indices.clear();
+  for(vtkIdType i=0; i<size; i++)
+  {
+    points->GetPoint(i, p);
+    if(isnan(p[0]) || isnan(p[1]) || isnan(p[2]) || isinf(p[0]) || isinf(p[1]) || isinf(p[2])) continue;
+
+    // 21 bits per axis, voxel indices wrap around for very large extents
+    unsigned long long key = (((unsigned long long)(long long)floor(p[0]*invSize) & 0x1FFFFF) << 42) |
+                             (((unsigned long long)(long long)floor(p[1]*invSize) & 0x1FFFFF) << 21) |
+                              ((unsigned long long)(long long)floor(p[2]*invSize) & 0x1FFFFF);
+
+    unsigned long long slot = ((key * 0x9E3779B97F4A7C15ULL) >> (64-bits)) & mask;
+    while(table[slot]!=empty && table[slot]!=key)
+      slot = (slot+1) & mask;
+
+    if(table[slot]==empty)
+    {
+      table[slot] = key;
+      indices.push_back(i);
+    }
+  }
+}
+
 VtkCloud::VtkCloud()
 {
   _polyData = vtkSmartPointer<vtkPolyData>::New();
 
   _points   = vtkSmartPointer<vtkPoints>::New();
+  _points->SetDataTypeToDouble();
 
   _normals = vtkSmartPointer<vtkDoubleArray>::New();
   _normals->SetNumberOfComponents(3);
@@ -45,7 +90,15 @@ VtkCloud::VtkCloud()
 
   _triangles = vtkSmartPointer<vtkCellArray>::New();
 
+  _vertices = vtkSmartPointer<vtkCellArray>::New();
+
   _actor = NULL;
+
+  _shared = false;
+
+  _lodVoxelSize = 0.0;
+  _lodMinPoints = 100000;
+  _verticesSubsampled = false;
 }
 
 VtkCloud::~VtkCloud()
@@ -53,25 +106,108 @@ VtkCloud::~VtkCloud()
 
 }
 
+double* VtkCloud::allocateCoords(int points)
+{
+  if(_shared)
+  {
+    // Do not write into or reallocate caller buffers
+    _points = vtkSmartPointer<vtkPoints>::New();
+    _points->SetDataTypeToDouble();
+    _normals = vtkSmartPointer<vtkDoubleArray>::New();
+    _normals->SetNumberOfComponents(3);
+    _shared = false;
+  }
+  _points->SetNumberOfPoints(points);
+  return (double*)_points->GetVoidPointer(0);
+}
+
+void VtkCloud::copyNormalData(double* ndata, int size, int tda)
+{
+  if(_shared)
+  {
+    _normals = vtkSmartPointer<vtkDoubleArray>::New();
+    _normals->SetNumberOfComponents(3);
+  }
+
+  double* dst = _normals->WritePointer(0, 3*size);
+  if(tda==3)
+  {
+    memcpy(dst, ndata, 3*size*sizeof(double));
+  }
+  else
+  {
+    for(int i=0; i<size; i++)
+    {
+      dst[3*i]   = ndata[tda*i];
+      dst[3*i+1] = ndata[tda*i+1];
+      dst[3*i+2] = ndata[tda*i+2];
+    }
+  }
+  _normals->Modified();
+}
+
+void VtkCloud::updateVertices()
+{
+  vtkPoints* points = _polyData->GetPoints();
+  vtkIdType size = points ? points->GetNumberOfPoints() : 0;
+
+  if(_lodVoxelSize > 0.0 && size > (vtkIdType)_lodMinPoints)
+  {
+    vector<vtkIdType> indices;
+    subsampleVoxelGrid(points, _lodVoxelSize, indices);
+    vtkIdType cells = indices.size();
+    vtkIdType* dst = _vertices->WritePointer(cells, 2*cells);
+    for(vtkIdType i=0; i<cells; i++)
+    {
+      dst[2*i]   = 1;
+      dst[2*i+1] = indices[i];
+    }
+    _verticesSubsampled = true;
+  }
+  else if(_verticesSubsampled || _vertices->GetNumberOfCells() != size)
+  {
+    // Vertex cells only depend on the number of points, i.e., they are kept for clouds of constant size
+    vtkIdType* dst = _vertices->WritePointer(size, 2*size);
+    for(vtkIdType i=0; i<size; i++)
+    {
+      dst[2*i]   = 1;
+      dst[2*i+1] = i;
+    }
+    _verticesSubsampled = false;
+  }
+  _vertices->Modified();
+
+  _polyData->SetVerts(_vertices);
+  _polyData->DeleteCells();
+  _polyData->Modified();
+}
+
 void VtkCloud::setCoords(double* coords, int size, int tda, double* ndata)
 {
-  _polyData->Reset();
-  _points->Reset();
+  double* dst = allocateCoords(size);
 
-  for(int i=0; i<size*tda; i+=tda)
+  if(coords == NULL)
   {
-    if(coords != NULL)
-      _points->InsertNextPoint(coords[i], coords[i + 1], coords[i + 2]);
-    else
-      _points->InsertNextPoint(0, 0, 0);
+    memset(dst, 0, 3*size*sizeof(double));
+  }
+  else if(tda==3)
+  {
+    memcpy(dst, coords, 3*size*sizeof(double));
+  }
+  else
+  {
+    for(int i=0; i<size; i++)
+    {
+      dst[3*i]   = coords[tda*i];
+      dst[3*i+1] = coords[tda*i+1];
+      dst[3*i+2] = coords[tda*i+2];
+    }
   }
+  _points->Modified();
 
-  _normals->Reset();
   if(ndata)
   {
-    _normals->SetNumberOfTuples(size);
-    for(int i=0; i<size; i++)
-      _normals->SetTuple((vtkIdType)i, &ndata[tda*i]);
+    copyNormalData(ndata, size, tda);
     _polyData->GetPointData()->SetNormals(_normals);
   }
   else
@@ -80,21 +216,39 @@ void VtkCloud::setCoords(double* coords, int size, int tda, double* ndata)
   }
 
   _polyData->SetPoints(_points);
+  _polyData->SetPolys(NULL);
+  updateVertices();
+}
 
-  vtkSmartPointer<vtkVertexGlyphFilter> glyphFilter =  vtkSmartPointer<vtkVertexGlyphFilter>::New();
-  glyphFilter->SetInputConnection(_polyData->GetProducerPort());
-  glyphFilter->Update();
+void VtkCloud::setCoordsShared(double* coords, int size, double* ndata)
+{
+  vtkSmartPointer<vtkDoubleArray> array = vtkSmartPointer<vtkDoubleArray>::New();
+  array->SetNumberOfComponents(3);
+  array->SetArray(coords, 3*size, 1);
+  _points = vtkSmartPointer<vtkPoints>::New();
+  _points->SetData(array);
+
+  if(ndata)
+  {
+    _normals = vtkSmartPointer<vtkDoubleArray>::New();
+    _normals->SetNumberOfComponents(3);
+    _normals->SetArray(ndata, 3*size, 1);
+    _polyData->GetPointData()->SetNormals(_normals);
+  }
+  else
+  {
+    _polyData->GetPointData()->SetNormals(NULL);
+  }
+  _shared = true;
 
-  _polyData->ShallowCopy(glyphFilter->GetOutput());
+  _polyData->SetPoints(_points);
+  _polyData->SetPolys(NULL);
+  updateVertices();
 }
 
 void VtkCloud::setNormals(double* ndata, int size, int tda)
 {
-  _normals->Reset();
-
-  _normals->SetNumberOfTuples(size);
-  for(int i=0; i<size; i++)
-    _normals->SetTuple((vtkIdType)i, &ndata[tda*i]);
+  copyNormalData(ndata, size, tda);
 
   _polyData->GetPointData()->SetNormals(_normals);
 
@@ -163,22 +317,15 @@ void VtkCloud::addCoords(double* coords, unsigned char* rgb, int size, int tda)
     colors->InsertNextTupleValue(&rgb[i]);
   }
 
-  vtkSmartPointer<vtkVertexGlyphFilter> glyphFilter =  vtkSmartPointer<vtkVertexGlyphFilter>::New();
-  glyphFilter->SetInputConnection(_polyData->GetProducerPort());
-  glyphFilter->Update();
-
-  _polyData->ShallowCopy(glyphFilter->GetOutput());
+  updateVertices();
 }
 
 void VtkCloud::setColors(const unsigned char* data, int points, int channels)
 {
-  _colors->Reset();
   _colors->SetNumberOfComponents(channels);
-
-  for(int i=0; i<points*channels; i+=channels)
-  {
-    _colors->InsertNextTupleValue(&data[i]);
-  }
+  unsigned char* dst = _colors->WritePointer(0, points*channels);
+  memcpy(dst, data, points*channels*sizeof(unsigned char));
+  _colors->Modified();
 
   _polyData->GetPointData()->SetScalars(_colors);
   _points->Modified();
@@ -236,11 +383,22 @@ void VtkCloud::removeInvalidPoints()
   if(colors) colors->DeepCopy(newColors);
   normals->DeepCopy(newNormals);
 
-  vtkSmartPointer<vtkVertexGlyphFilter> glyphFilter =  vtkSmartPointer<vtkVertexGlyphFilter>::New();
-  glyphFilter->SetInputConnection(_polyData->GetProducerPort());
-  glyphFilter->Update();
+  updateVertices();
+}
 
-  _polyData->ShallowCopy(glyphFilter->GetOutput());
+void VtkCloud::setLevelOfDetail(double voxelSize, unsigned int minPoints)
+{
+  _lodVoxelSize = voxelSize;
+  _lodMinPoints = minPoints;
+
+  // Meshes are not subsampled
+  if(_polyData->GetNumberOfPolys()==0)
+    updateVertices();
+}
+
+unsigned int VtkCloud::getRenderedSize()
+{
+  return _polyData->GetNumberOfVerts();
 }
 
 unsigned int VtkCloud::getSize()
@@ -6,6 +6,8 @@
 #include <vtkActor.h>
 #include <vtkCommand.h>
 #include <vtkDoubleArray.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkCellArray.h>
 
 #include <vector>
 #include "obcore/base/CartesianCloud.h"
@@ -34,15 +36,32 @@ public:
   ~VtkCloud();
 
   /**
-   * Set coordinates
+   * Set coordinates. Data is copied in bulk, the rendering pipeline is reused between calls.
    * @param data Cartesian data set
    * @param points number of points
    * @param tda trailing dimension, i.e., size of row as laid out in memory
    *        e.g. 00 01 02 03 xx xx xx xx 10 11 12 13 xx xx xx xx
    *             => tda = 8
+   * @param normals normal vectors (same layout as data, may be NULL)
    */
   void setCoords(double* data, int points, int tda, double* normals=NULL);
 
+  /**
+   * Wrap coordinates without copying (zero-copy). The caller keeps ownership of the buffers,
+   * which must stay valid and unchanged in size until the next call of setCoords or setCoordsShared.
+   * After modifying the buffer content, call setCoordsShared again to trigger a redraw.
+   * @param data Cartesian data set (layout x1y1z1x2y2z2...)
+   * @param points number of points
+   * @param normals normal vectors (layout x1y1z1x2y2z2..., may be NULL)
+   */
+  void setCoordsShared(double* data, int points, double* normals=NULL);
+
+  /**
+   * Set normal vectors
+   * @param ndata normal vectors
+   * @param size number of normals
+   * @param tda trailing dimension (see setCoords)
+   */
   void setNormals(double* ndata, int size, int tda);
 
   void setTriangles(double** coords, unsigned char** rgb, unsigned int points, unsigned int** indices, unsigned int triangles);
@@ -59,6 +78,20 @@ public:
 
   void removeInvalidPoints();
 
+  /**
+   * Set level of detail for rendering. Clouds with more than minPoints points are subsampled by a voxel grid,
+   * i.e., only the first point falling into a voxel is drawn. Data access methods are not affected.
+   * @param voxelSize edge length of voxels (0 disables subsampling)
+   * @param minPoints minimum size of cloud to apply subsampling
+   */
+  void setLevelOfDetail(double voxelSize, unsigned int minPoints=100000);
+
+  /**
+   * Get number of points being drawn
+   * @return number of vertices
+   */
+  unsigned int getRenderedSize();
+
   /**
    * Get size of point cloud, i.e., the number of points
    * @return size of point cloud
@@ -160,12 +193,42 @@ public:
 
 private:
 
+  /**
+   * Create vertex cells for points, replaces vtkVertexGlyphFilter
+   */
+  void updateVertices();
+
+  /**
+   * Get writable coordinate array of size points x 3, detaches from shared buffers
+   * @param points number of points
+   * @return pointer to coordinate array
+   */
+  double* allocateCoords(int points);
+
+  /**
+   * Copy normals into owned array
+   * @param ndata normal vectors
+   * @param size number of normals
+   * @param tda trailing dimension
+   */
+  void copyNormalData(double* ndata, int size, int tda);
+
   vtkSmartPointer<vtkPolyData> _polyData;
   vtkSmartPointer<vtkPoints> _points;
   vtkSmartPointer<vtkDoubleArray> _normals;
   vtkSmartPointer<vtkUnsignedCharArray> _colors;
   vtkSmartPointer<vtkActor> _actor;
   vtkSmartPointer<vtkCellArray> _triangles;
+  vtkSmartPointer<vtkCellArray> _vertices;
+
+  // true, if coordinates or normals wrap caller buffers
+  bool _shared;
+
+  double _lodVoxelSize;
+  unsigned int _lodMinPoints;
+
+  // true, if vertex cells refer to a subsampled set of points
+  bool _verticesSubsampled;
 
 };
 
@@ -25,6 +25,7 @@ FlannPairAssignment::~FlannPairAssignment()
 void FlannPairAssignment::init(double eps)
 {
   _dataset = NULL;
+  _index   = NULL;
   _eps     = eps;
 }
 
@@ -46,6 +46,24 @@ public:
    * @param size nr of points in scene
    */
 	void determinePairs(double** scene, bool* msk, int size);
+
+	/**
+	 * Access kd-tree built in setModel, e.g., for normal estimation of the model (see NormalsEstimator)
+	 * @return search index or NULL if no model has been set
+	 */
+	flann::Index<flann::L2<double> >* getIndex() { return _index; };
+
+	/**
+	 * Access model data passed with setModel
+	 * @return model data
+	 */
+	double** getModel() { return _model; };
+
+	/**
+	 * Get number of model points
+	 * @return number of points
+	 */
+	unsigned int getModelSize() { return _dataset ? _dataset->rows : 0; };
 	
 private:
 
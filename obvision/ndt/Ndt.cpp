@@ -3,6 +3,7 @@
 #include "obcore/base/tools.h"
 #include "obcore/base/Timer.h"
 #include "obcore/math/mathbase.h"
+#include "obcore/math/linalg/Transform.h"
 
 namespace obvious
 {
@@ -201,38 +202,23 @@ unsigned int Ndt::getMaxIterations()
 
 void Ndt::applyTransformation(double** data, unsigned int size, unsigned int dim, Matrix* T)
 {
-  // Apply rotation
-  Matrix R(*T, 0, 0, dim, dim);
-  Matrix::multiply(R, *data, size, dim);
-
-  // Apply translation
+  // Rotation and translation are applied in a single pass with a stack-allocated transformation
   if(_dim < 3)
   {
+    Transform2D T2(*T);
 
-#pragma omp parallel
-{
-#pragma omp for
-  for(unsigned int i=0; i<size; i++)
-  {
-    data[i][0] += (*T)(0,3);
-    data[i][1] += (*T)(1,3);
-  }
-}
+#pragma omp parallel for
+    for(unsigned int i=0; i<size; i++)
+      T2.transform(data[i], data[i]);
 
   }
   else
   {
+    Transform3D T3(*T);
 
-#pragma omp parallel
-{
-#pragma omp for
-  for(unsigned int i=0; i<size; i++)
-  {
-    data[i][0] += (*T)(0,3);
-    data[i][1] += (*T)(1,3);
-    data[i][2] += (*T)(2,3);
-  }
-}
+#pragma omp parallel for
+    for(unsigned int i=0; i<size; i++)
+      T3.transform(data[i], data[i]);
 
   } // end if
 
@@ -2,21 +2,40 @@
 #include <obcore/math/mathbase.h>
 #include <string.h>
 #include <cmath>
-#include <flann/flann.hpp>
 #include <ANN/ANN.h>
 
 
 namespace obvious
 {
 
-NormalsEstimator::NormalsEstimator()
+// number of channels of integral images: count, x, y, z
+#define CHANNELS_FAST 4
+// number of channels of integral images: count, x, y, z, xx, xy, xz, yy, yz, zz
+#define CHANNELS_ACCURATE 10
+
+/**
+ * Sum of a rectangular image region [r0, r1) x [c0, c1) determined from an integral image with K channels
+ */
+template<unsigned int K>
+static inline void boxSum(const double* integral, unsigned int stride, unsigned int r0, unsigned int c0, unsigned int r1, unsigned int c1, double* sum)
 {
+  const double* i00 = &integral[r0*stride + c0*K];
+  const double* i01 = &integral[r0*stride + c1*K];
+  const double* i10 = &integral[r1*stride + c0*K];
+  const double* i11 = &integral[r1*stride + c1*K];
+  for(unsigned int k=0; k<K; k++)
+    sum[k] = i11[k] - i01[k] - i10[k] + i00[k];
+}
 
+NormalsEstimator::NormalsEstimator()
+{
+  _integral     = NULL;
+  _integralSize = 0;
 }
 		 
 NormalsEstimator::~NormalsEstimator()
 {
-
+  delete [] _integral;
 }
 	
 /**
@@ -89,6 +108,169 @@ void NormalsEstimator::estimateNormals3DGrid(unsigned int cols, unsigned int row
   }
 }
 
+void NormalsEstimator::buildIntegralImages(unsigned int cols, unsigned int rows, double* coords, bool* mask, unsigned int channels)
+{
+  unsigned int size = (rows+1)*(cols+1)*channels;
+  if(size > _integralSize)
+  {
+    delete [] _integral;
+    _integral     = new double[size];
+    _integralSize = size;
+  }
+
+  // Coordinates are shifted by a reference point to reduce cancellation errors of second order moments
+  double offset[3] = {0.0, 0.0, 0.0};
+  for(unsigned int i=0; i<rows*cols; i++)
+  {
+    if(mask[i])
+    {
+      offset[0] = coords[3*i];
+      offset[1] = coords[3*i+1];
+      offset[2] = coords[3*i+2];
+      break;
+    }
+  }
+
+  const unsigned int stride = (cols+1)*channels;
+  memset(_integral, 0, stride*sizeof(*_integral));
+
+  // Horizontal pass: running sums of each row
+#pragma omp parallel for schedule(static)
+  for(int r=0; r<(int)rows; r++)
+  {
+    double acc[CHANNELS_ACCURATE];
+    memset(acc, 0, channels*sizeof(*acc));
+    double* row = &_integral[(r+1)*stride];
+    memset(row, 0, channels*sizeof(*row));
+    for(unsigned int c=0; c<cols; c++)
+    {
+      unsigned int idx = r*cols + c;
+      if(mask[idx])
+      {
+        double x = coords[3*idx]   - offset[0];
+        double y = coords[3*idx+1] - offset[1];
+        double z = coords[3*idx+2] - offset[2];
+        acc[0] += 1.0;
+        acc[1] += x;
+        acc[2] += y;
+        acc[3] += z;
+        if(channels==CHANNELS_ACCURATE)
+        {
+          acc[4] += x*x;
+          acc[5] += x*y;
+          acc[6] += x*z;
+          acc[7] += y*y;
+          acc[8] += y*z;
+          acc[9] += z*z;
+        }
+      }
+      memcpy(&row[(c+1)*channels], acc, channels*sizeof(*acc));
+    }
+  }
+
+  // Vertical pass: accumulate rows, each thread works on a contiguous block of columns
+#pragma omp parallel for schedule(static)
+  for(int i=channels; i<(int)stride; i++)
+  {
+    for(unsigned int r=1; r<=rows; r++)
+      _integral[r*stride + i] += _integral[(r-1)*stride + i];
+  }
+}
+
+void NormalsEstimator::estimateNormals3DGridIntegral(unsigned int cols, unsigned int rows, double* coords, bool* mask, double* normals, bool* maskNormals,
+                                                     unsigned int radius, EnumNormalsQuality quality)
+{
+  const unsigned int channels = (quality==NORMALS_ACCURATE ? CHANNELS_ACCURATE : CHANNELS_FAST);
+  buildIntegralImages(cols, rows, coords, mask, channels);
+
+  const unsigned int stride = (cols+1)*channels;
+  const double* integral = _integral;
+  const int rad = (int)radius;
+
+#pragma omp parallel for schedule(dynamic)
+  for(int r=0; r<(int)rows; r++)
+  {
+    const unsigned int r0 = (unsigned int)max<int>(r-rad, 0);
+    const unsigned int r1 = (unsigned int)min<int>(r+rad+1, (int)rows);
+    for(int c=0; c<(int)cols; c++)
+    {
+      unsigned int idx = r*cols + c;
+      double* n = &normals[3*idx];
+      n[0] = 0.0; n[1] = 0.0; n[2] = 0.0;
+      bool valid = false;
+
+      if(mask[idx])
+      {
+        const unsigned int c0 = (unsigned int)max<int>(c-rad, 0);
+        const unsigned int c1 = (unsigned int)min<int>(c+rad+1, (int)cols);
+
+        if(quality==NORMALS_ACCURATE)
+        {
+          double s[CHANNELS_ACCURATE];
+          boxSum<CHANNELS_ACCURATE>(integral, stride, r0, c0, r1, c1, s);
+          if(s[0] >= 3.0)
+          {
+            double inv = 1.0 / s[0];
+            double mean[3] = {s[1]*inv, s[2]*inv, s[3]*inv};
+            double C[9];
+            C[0] = s[4]*inv - mean[0]*mean[0];
+            C[1] = s[5]*inv - mean[0]*mean[1];
+            C[2] = s[6]*inv - mean[0]*mean[2];
+            C[4] = s[7]*inv - mean[1]*mean[1];
+            C[5] = s[8]*inv - mean[1]*mean[2];
+            C[8] = s[9]*inv - mean[2]*mean[2];
+            C[3] = C[1];
+            C[6] = C[2];
+            C[7] = C[5];
+            double lambda[3];
+            eigenSym3x3<double>(C, lambda, n);
+            valid = (lambda[1] > 0.0);
+          }
+        }
+        else
+        {
+          // tangents are determined by the difference of mean coordinates of opposing half windows
+          double sl[CHANNELS_FAST], sr[CHANNELS_FAST], su[CHANNELS_FAST], sd[CHANNELS_FAST];
+          boxSum<CHANNELS_FAST>(integral, stride, r0, c0, r1, c+1, sl);
+          boxSum<CHANNELS_FAST>(integral, stride, r0, c,  r1, c1,  sr);
+          boxSum<CHANNELS_FAST>(integral, stride, r0, c0, r+1, c1, su);
+          boxSum<CHANNELS_FAST>(integral, stride, r,  c0, r1, c1,  sd);
+          if(sl[0]>0.0 && sr[0]>0.0 && su[0]>0.0 && sd[0]>0.0)
+          {
+            double th[3], tv[3];
+            for(unsigned int k=0; k<3; k++)
+            {
+              th[k] = sr[k+1]/sr[0] - sl[k+1]/sl[0];
+              tv[k] = sd[k+1]/sd[0] - su[k+1]/su[0];
+            }
+            cross3<double>(n, th, tv);
+            double len = sqrt(dot3<double>(n, n));
+            if(len > 1e-12)
+            {
+              n[0] /= len; n[1] /= len; n[2] /= len;
+              valid = true;
+            }
+          }
+        }
+
+        // test facing, normals point towards the sensor
+        if(valid && dot3<double>(n, &coords[3*idx]) > 0.0)
+        {
+          n[0] = -n[0];
+          n[1] = -n[1];
+          n[2] = -n[2];
+        }
+        else if(!valid)
+        {
+          n[0] = 0.0; n[1] = 0.0; n[2] = 0.0;
+        }
+      }
+
+      if(maskNormals) maskNormals[idx] = valid;
+    }
+  }
+}
+
 void NormalsEstimator::estimateNormalsReverseMapping(Matrix* coords, Matrix* P, int w, int h, Matrix* normals)
 {
   int *buf = (int*) malloc(w * h * sizeof(int));
@@ -199,7 +381,7 @@ void NormalsEstimator::estimateNormalsReverseMapping(Matrix* coords, Matrix* P,
   }
 }
 
-void NormalsEstimator::estimateNormalsFLANN(Matrix* coords, Matrix* normals)
+void NormalsEstimator::estimateNormalsFLANN(Matrix* coords, Matrix* normals, unsigned int k, double radius)
 {
   unsigned int size = coords->getRows();
   unsigned int dim  = coords->getCols();
@@ -227,92 +409,118 @@ void NormalsEstimator::estimateNormalsFLANN(Matrix* coords, Matrix* normals)
   flann::Index<flann::L2<double> >* index = new flann::Index<flann::L2<double> >(*dataset, p);
   index->buildIndex();
 
-  int nn = 150; // number of closest points to use for local covariance estimate
+  double* n = new double[3*cnt];
+  estimateNormalsFLANN(buf, cnt, index, n, k, radius);
 
-  flann::Matrix<int> indices(new int[1*nn], 1, nn);
-  flann::Matrix<double> dists(new double[1*nn], 1, nn);
-
-  double mean[3];
-
-  Matrix C(dim, dim);
-
-  // determine covariance matrix
   for(unsigned int i=0; i<cnt; i++)
   {
-    flann::Matrix<double> query(&buf[i][0], 1, dim);
-    flann::SearchParams sp;
-    index->knnSearch(query, indices, dists, nn, sp);
-
-    C.setZero();
-    mean[0] = 0.0; mean[1] = 0.0; mean[2] = 0.0;
-    for(int j=0; j<nn; j++)
-    {
-      int idx  = indices[0][j];
-
-      double x = buf[idx][0];
-      double y = buf[idx][1];
-      double z = buf[idx][2];;
+    (*normals)(map[i],0) = n[3*i];
+    (*normals)(map[i],1) = n[3*i+1];
+    (*normals)(map[i],2) = n[3*i+2];
+  }
 
-      mean[0] += x;
-      mean[1] += y;
-      mean[2] += z;
+  delete [] n;
+  delete index;
+  delete dataset;
 
-      C(0,0) += x*x;
+  System<double>::deallocate(buf);
+  delete [] map;
+}
 
-      C(1,0) += y*x;
-      C(1,1) += y*y;
+void NormalsEstimator::estimateNormalsFLANN(double** coords, unsigned int size, flann::Index<flann::L2<double> >* index, double* normals, unsigned int k, double radius)
+{
+  // number of queries passed to the kd-tree at once
+  const unsigned int batch = 256;
+  const unsigned int batches = (size + batch - 1) / batch;
+  const unsigned int dim = 3;
 
-      C(2,0) += z*x;
-      C(2,1) += z*y;
-      C(2,2) += z*z;
-    }
+#pragma omp parallel
+{
+  // buffers are allocated once per thread and reused for all batches
+  flann::Matrix<int> indices(new int[batch*k], batch, k);
+  flann::Matrix<double> dists(new double[batch*k], batch, k);
+  vector< vector<int> > vIndices;
+  vector< vector<double> > vDists;
+  flann::SearchParams sp;
+  sp.max_neighbors = k;
+  sp.sorted        = false;
+
+#pragma omp for schedule(dynamic)
+  for(int b=0; b<(int)batches; b++)
+  {
+    unsigned int offset  = b*batch;
+    unsigned int queries = min<unsigned int>(batch, size-offset);
+    flann::Matrix<double> query(&coords[offset][0], queries, dim);
 
-    mean[0] /= (double)nn;
-    mean[1] /= (double)nn;
-    mean[2] /= (double)nn;
+    if(radius > 0.0)
+      index->radiusSearch(query, vIndices, vDists, (float)(radius*radius), sp);
+    else
+      index->knnSearch(query, indices, dists, k, sp);
 
-    for(int k = 0; k < 3; k++)
+    for(unsigned int q=0; q<queries; q++)
     {
-      for(int l = 0; l <= k; l++)
+      const unsigned int i = offset + q;
+      int* idx = indices[q];
+      unsigned int nn = k;
+      if(radius > 0.0)
       {
-        C(k,l) /= (double)nn;
-        C(k,l) -= mean[k]*mean[l];
-        C(l,k) = C(k,l);
+        idx = vIndices[q].empty() ? NULL : &vIndices[q][0];
+        nn  = vIndices[q].size();
       }
-    }
 
-    Matrix U(dim, dim);
-    Matrix V(3, 3);
-    double s[3];
-    C.svd(&U, s, &V);
+      double* normal = &normals[3*i];
+      normal[0] = 0.0; normal[1] = 0.0; normal[2] = 0.0;
+      if(nn < 3) continue;
 
-    double normal[3];
-    normal[0] = V(0,2);
-    normal[1] = V(1,2);
-    normal[2] = V(2,2);
-    norm3<double>(normal);
+      // accumulate moments relative to query point to reduce cancellation errors
+      const double* p = coords[i];
+      double s[9] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+      for(unsigned int j=0; j<nn; j++)
+      {
+        const double* pj = coords[idx[j]];
+        double x = pj[0] - p[0];
+        double y = pj[1] - p[1];
+        double z = pj[2] - p[2];
+        s[0] += x;
+        s[1] += y;
+        s[2] += z;
+        s[3] += x*x;
+        s[4] += x*y;
+        s[5] += x*z;
+        s[6] += y*y;
+        s[7] += y*z;
+        s[8] += z*z;
+      }
 
-    // test facing
-    double tf[3];
-    tf[0] = buf[i][0] + normal[0];
-    tf[1] = buf[i][1] + normal[1];
-    tf[2] = buf[i][2] + normal[2];
-    if(distSqr3D(origin, tf) > distSqr3D(origin, buf[i]))
-    {
-      normal[0] = -normal[0];
-      normal[1] = -normal[1];
-      normal[2] = -normal[2];
+      double inv = 1.0 / (double)nn;
+      double mean[3] = {s[0]*inv, s[1]*inv, s[2]*inv};
+      double C[9];
+      C[0] = s[3]*inv - mean[0]*mean[0];
+      C[1] = s[4]*inv - mean[0]*mean[1];
+      C[2] = s[5]*inv - mean[0]*mean[2];
+      C[4] = s[6]*inv - mean[1]*mean[1];
+      C[5] = s[7]*inv - mean[1]*mean[2];
+      C[8] = s[8]*inv - mean[2]*mean[2];
+      C[3] = C[1];
+      C[6] = C[2];
+      C[7] = C[5];
+
+      double lambda[3];
+      eigenSym3x3<double>(C, lambda, normal);
+
+      // test facing, normals point towards the origin
+      if(dot3<double>(normal, p) > 0.0)
+      {
+        normal[0] = -normal[0];
+        normal[1] = -normal[1];
+        normal[2] = -normal[2];
+      }
     }
-    (*normals)(map[i],0) = normal[0];
-    (*normals)(map[i],1) = normal[1];
-    (*normals)(map[i],2) = normal[2];
   }
 
-  delete index;
-  delete dataset;
-
-  System<double>::deallocate(buf);
-  delete [] map;
+  delete [] indices.ptr();
+  delete [] dists.ptr();
+}
 }
 
 void NormalsEstimator::estimateNormalsANN(Matrix* coords, Matrix* normals)
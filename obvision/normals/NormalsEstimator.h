@@ -9,11 +9,20 @@ using namespace std;
 
 #include "obcore/math/linalg/linalg.h"
 
+#include <flann/flann.hpp>
+
 using namespace obvious;
 
 namespace obvious
 {
 
+/**
+ * @enum EnumNormalsQuality
+ * NORMALS_FAST: cross product of smoothed horizontal and vertical tangents
+ * NORMALS_ACCURATE: eigenvector of local covariance (PCA)
+ */
+enum EnumNormalsQuality { NORMALS_FAST = 0, NORMALS_ACCURATE = 1 };
+
 /**
  * @class NormalsEstimator
  * @brief Estimation of normals of a point cloud
@@ -37,19 +46,60 @@ public:
    */
 	void estimateNormals3DGrid(unsigned int cols, unsigned int rows, double* coords, bool* mask, double* normals);
 
+	/**
+	 * Normal estimation for organized clouds based on integral images. The effort per pixel is independent of the window size.
+	 * Normals are oriented towards the sensor origin. Invalid pixels get zero normals and a false entry in maskNormals.
+	 * @param cols number of columns
+	 * @param rows number of rows
+	 * @param coords organized coordinates (xyz interleaved, row-major)
+	 * @param mask validity mask of coordinates
+	 * @param normals resulting normals (xyz interleaved, must be allocated with 3*rows*cols elements)
+	 * @param maskNormals validity mask of normals (may be NULL)
+	 * @param radius half window size in pixels
+	 * @param quality NORMALS_FAST (averaged tangents) or NORMALS_ACCURATE (covariance analysis)
+	 */
+	void estimateNormals3DGridIntegral(unsigned int cols, unsigned int rows, double* coords, bool* mask, double* normals, bool* maskNormals=NULL,
+	                                   unsigned int radius=5, EnumNormalsQuality quality=NORMALS_FAST);
+
 	/**
    *
    */
 	void estimateNormalsReverseMapping(Matrix* coords, Matrix* P, int w, int h, Matrix* normals);
 
 	/**
-	 *
+	 * Normal estimation for unorganized clouds. A kd-tree is built internally, see overloaded method for reusing an existing one.
+	 * @param coords coordinates (n x 3)
+	 * @param normals resulting normals (n x 3)
+	 * @param k number of nearest neighbors used for local covariance estimate (maximum number in case of radius search)
+	 * @param radius search radius, a value > 0 selects radius search instead of kNN search
+	 */
+	void estimateNormalsFLANN(Matrix* coords, Matrix* normals, unsigned int k=150, double radius=0.0);
+
+	/**
+	 * Parallel normal estimation for unorganized clouds with a kd-tree built by the caller, e.g., FlannPairAssignment::getIndex()
+	 * @param coords coordinates the index was built from (size x 3, contiguous memory as allocated by System<double>::allocate)
+	 * @param size number of points
+	 * @param index search index built on coords
+	 * @param normals resulting normals (xyz interleaved, must be allocated with 3*size elements)
+	 * @param k number of nearest neighbors used for local covariance estimate (maximum number in case of radius search)
+	 * @param radius search radius, a value > 0 selects radius search instead of kNN search
 	 */
-	void estimateNormalsFLANN(Matrix* coords, Matrix* normals);
+	void estimateNormalsFLANN(double** coords, unsigned int size, flann::Index<flann::L2<double> >* index, double* normals, unsigned int k=150, double radius=0.0);
+
 	void estimateNormalsANN(Matrix* coords, Matrix* normals);
 
 private:
 
+	/**
+	 * Build integral images of point count, coordinates and (for NORMALS_ACCURATE) outer products
+	 */
+	void buildIntegralImages(unsigned int cols, unsigned int rows, double* coords, bool* mask, unsigned int channels);
+
+	// integral images, channels are interleaved per pixel
+	double* _integral;
+
+	// number of allocated elements of _integral
+	unsigned int _integralSize;
 };
 
 }
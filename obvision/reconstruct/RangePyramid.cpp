@@ -0,0 +1,148 @@
+#include "RangePyramid.h"
+#include <math.h>
+#include <limits>
+
+namespace obvious
+{
+
+// Maximum number of cells per axis being combined during query
+#define PYRAMIDSPAN 4
+
+static inline void merge(RangeStatistics* dst, const RangeStatistics* src)
+{
+  if(src->minFinite < dst->minFinite) dst->minFinite = src->minFinite;
+  if(src->maxValid > dst->maxValid) dst->maxValid = src->maxValid;
+  dst->invalid         += src->invalid;
+  dst->infinite        += src->infinite;
+  dst->invalidInfinite += src->invalidInfinite;
+}
+
+static inline void clear(RangeStatistics* s)
+{
+  s->minFinite       = std::numeric_limits<double>::infinity();
+  s->maxValid        = -std::numeric_limits<double>::infinity();
+  s->invalid         = 0;
+  s->infinite        = 0;
+  s->invalidInfinite = 0;
+}
+
+RangePyramid::RangePyramid(unsigned int width, unsigned int height)
+{
+  _levels = 1;
+  unsigned int w = width;
+  unsigned int h = height;
+  while(w>1 || h>1)
+  {
+    w = (w+1)/2;
+    h = (h+1)/2;
+    _levels++;
+  }
+
+  _widths  = new unsigned int[_levels];
+  _heights = new unsigned int[_levels];
+  _cells   = new RangeStatistics*[_levels];
+
+  w = width;
+  h = height;
+  for(unsigned int l=0; l<_levels; l++)
+  {
+    _widths[l]  = w;
+    _heights[l] = h;
+    _cells[l]   = new RangeStatistics[w*h];
+    w = (w+1)/2;
+    h = (h+1)/2;
+  }
+}
+
+RangePyramid::~RangePyramid()
+{
+  for(unsigned int l=0; l<_levels; l++)
+    delete [] _cells[l];
+  delete [] _cells;
+  delete [] _widths;
+  delete [] _heights;
+}
+
+unsigned int RangePyramid::getLevels()
+{
+  return _levels;
+}
+
+void RangePyramid::build(double* data, bool* mask)
+{
+  int size = _widths[0]*_heights[0];
+  RangeStatistics* base = _cells[0];
+
+#pragma omp parallel for
+  for(int i=0; i<size; i++)
+  {
+    RangeStatistics* c = &base[i];
+    clear(c);
+    bool inf = isinf(data[i]);
+    if(mask[i])
+    {
+      c->maxValid = data[i];
+      if(!inf) c->minFinite = data[i];
+    }
+    else
+    {
+      c->invalid = 1;
+      if(inf) c->invalidInfinite = 1;
+    }
+    if(inf) c->infinite = 1;
+  }
+
+  for(unsigned int l=1; l<_levels; l++)
+  {
+    RangeStatistics* src = _cells[l-1];
+    RangeStatistics* dst = _cells[l];
+    unsigned int ws = _widths[l-1];
+    unsigned int hs = _heights[l-1];
+    int w = _widths[l];
+    int h = _heights[l];
+#pragma omp parallel for
+    for(int y=0; y<h; y++)
+    {
+      unsigned int y0 = 2*y;
+      unsigned int y1 = (y0+1<hs) ? y0+1 : y0;
+      for(int x=0; x<w; x++)
+      {
+        unsigned int x0 = 2*x;
+        unsigned int x1 = (x0+1<ws) ? x0+1 : x0;
+        RangeStatistics* c = &dst[y*w+x];
+        clear(c);
+        merge(c, &src[y0*ws+x0]);
+        if(x1!=x0) merge(c, &src[y0*ws+x1]);
+        if(y1!=y0)
+        {
+          merge(c, &src[y1*ws+x0]);
+          if(x1!=x0) merge(c, &src[y1*ws+x1]);
+        }
+      }
+    }
+  }
+}
+
+void RangePyramid::query(int xMin, int xMax, int yMin, int yMax, RangeStatistics* stats)
+{
+  clear(stats);
+
+  if(xMin<0) xMin = 0;
+  if(yMin<0) yMin = 0;
+  if(xMax>=(int)_widths[0])  xMax = _widths[0]-1;
+  if(yMax>=(int)_heights[0]) yMax = _heights[0]-1;
+  if(xMin>xMax || yMin>yMax) return;
+
+  // Find finest level, at which the region is covered by at most PYRAMIDSPAN x PYRAMIDSPAN cells
+  unsigned int l = 0;
+  while((((xMax>>l)-(xMin>>l)) >= PYRAMIDSPAN || ((yMax>>l)-(yMin>>l)) >= PYRAMIDSPAN) && l<_levels-1)
+    l++;
+
+  RangeStatistics* cells = _cells[l];
+  int w = _widths[l];
+  for(int y=(yMin>>l); y<=(yMax>>l); y++)
+    for(int x=(xMin>>l); x<=(xMax>>l); x++)
+      merge(stats, &cells[y*w+x]);
+}
+
+}
@@ -0,0 +1,87 @@
+#ifndef RANGEPYRAMID_H_
+#define RANGEPYRAMID_H_
+
+namespace obvious
+{
+
+/**
+ * @struct RangeStatistics
+ * @brief Summary of measurements within an image region
+ */
+struct RangeStatistics
+{
+  // minimum of valid and finite measurements (infinity if there are none)
+  double minFinite;
+  // maximum of valid measurements (-infinity if there are none)
+  double maxValid;
+  // number of masked out measurements
+  unsigned int invalid;
+  // number of infinite measurements
+  unsigned int infinite;
+  // number of masked out measurements being infinite
+  unsigned int invalidInfinite;
+};
+
+/**
+ * @class RangePyramid
+ * @brief Min/max pyramid of a range image.
+ * Each level halves the resolution of the level below and summarizes a 2x2 block by RangeStatistics.
+ * Regions of the range image can be tested with a constant number of lookups, since a rectangle
+ * is always covered by at most 4x4 cells of an appropriate level. The result is conservative, i.e.,
+ * the region tested might be enlarged to the cell borders of that level.
+ * One-dimensional measurement arrays are handled with a height of 1.
+ * @author Stefan May
+ */
+class RangePyramid
+{
+public:
+
+  /**
+   * Constructor
+   * @param width width of range image
+   * @param height height of range image
+   */
+  RangePyramid(unsigned int width, unsigned int height);
+
+  /**
+   * Destructor
+   */
+  ~RangePyramid();
+
+  /**
+   * Build pyramid from range image
+   * @param data measurements (size width*height)
+   * @param mask validity mask (size width*height)
+   */
+  void build(double* data, bool* mask);
+
+  /**
+   * Summarize rectangular region of range image (bounds are inclusive and get clipped to image)
+   * @param[in] xMin minimum column
+   * @param[in] xMax maximum column
+   * @param[in] yMin minimum row
+   * @param[in] yMax maximum row
+   * @param[out] stats statistics of region
+   */
+  void query(int xMin, int xMax, int yMin, int yMax, RangeStatistics* stats);
+
+  /**
+   * Get number of levels
+   * @return number of levels, level 0 has full resolution
+   */
+  unsigned int getLevels();
+
+private:
+
+  unsigned int _levels;
+
+  unsigned int* _widths;
+
+  unsigned int* _heights;
+
+  RangeStatistics** _cells;
+};
+
+}
+
+#endif /* RANGEPYRAMID_H_ */
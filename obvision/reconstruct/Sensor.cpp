@@ -8,6 +8,9 @@
 namespace obvious
 {
 
+// Size of lookup table for distance-dependent weights
+#define NOISELUTSIZE 2048
+
 Sensor::Sensor(unsigned int dim, double maxRange, double minRange, double lowReflectivityRange)
 {
   _dim = dim;
@@ -19,6 +22,20 @@ Sensor::Sensor(unsigned int dim, double maxRange, double minRange, double lowRef
   _accuracy = NULL;
 
   _rayNorm = 1.0;
+  _raysDirty = true;
+
+  _pyramid = NULL;
+  _pyramidDirty = true;
+
+  _weighting = WEIGHTING_CONSTANT;
+  _weights = NULL;
+  _weightsDirty = true;
+  _noiseLut = NULL;
+  _noiseLutScale = 0.0;
+  _noise[0] = 0.0012;
+  _noise[1] = 0.0019;
+  _noise[2] = 0.4;
+  _accuracyReference = 0.01;
 
   _T = new Matrix(_dim+1, _dim+1);
   _T->setIdentity();
@@ -29,27 +46,51 @@ Sensor::~Sensor()
   delete _T;
   if(_rgb) delete [] _rgb;
   if(_accuracy) delete [] _accuracy;
+  if(_pyramid) delete _pyramid;
+  if(_weights) delete [] _weights;
+  if(_noiseLut) delete [] _noiseLut;
 }
 
 Matrix* Sensor::getNormalizedRayMap(double norm)
 {
-  if(norm != _rayNorm)
+  // Rays in world coordinate frame are derived from the immutable local rays on demand,
+  // i.e., pose updates are cheap and rounding errors do not accumulate
+  if(_raysDirty || norm != _rayNorm)
   {
-    for(unsigned int i=0; i<_size; i++)
-    {
-      for(unsigned int j=0; j<_dim; j++)
-        (*_rays)(j, i) *= (norm/_rayNorm);
-    }
+    Matrix R(*_T, 0, 0, _dim, _dim);
+    for(unsigned int r=0; r<_dim; r++)
+      for(unsigned int c=0; c<_dim; c++)
+        R(r, c) *= norm;
+    (*_rays) = R * (*_raysLocal);
     _rayNorm = norm;
+    _raysDirty = false;
   }
   return _rays;
 }
 
-void Sensor::transform(Matrix* T)
+Matrix Sensor::getRayPattern(unsigned int step)
 {
-  Matrix R(*T, 0, 0, _dim, _dim);
+  if(step==0) step = 1;
+  unsigned int width  = (_dim<3) ? _size : _width;
+  unsigned int height = (_dim<3) ? 1 : _height;
+  unsigned int cols = (width + step - 1) / step;
+  unsigned int rows = (height + step - 1) / step;
+  Matrix R(_dim, cols*rows);
+  unsigned int i = 0;
+  for(unsigned int row=0; row<height; row+=step)
+  {
+    for(unsigned int col=0; col<width; col+=step, i++)
+    {
+      for(unsigned int r=0; r<_dim; r++)
+        R(r, i) = (*_raysLocal)(r, row*width+col);
+    }
+  }
+  return R;
+}
 
-  (*_rays) = R * (*_rays);
+void Sensor::transform(Matrix* T)
+{
+  _raysDirty = true;
 
   // Transform sensor in his own coordinate system
   // P' = P T = [Rp | tp] [R | t] = [Rp R | Rp t + tp]
@@ -101,11 +142,13 @@ Matrix Sensor::getTransformation()
 
 void Sensor::setTransformation(Matrix T)
 {
+  _raysDirty = true;
   *_T = T;
 }
 
 void Sensor::resetTransformation()
 {
+  _raysDirty = true;
   _T->setIdentity();
 }
 
@@ -122,6 +165,7 @@ unsigned int Sensor::getRealMeasurementSize()
 
 void Sensor::setRealMeasurementData(double* data, double scale)
 {
+  invalidateMeasurements();
   if(scale==1.0)
     memcpy(_data, data, _size*sizeof(*data));
   else
@@ -133,6 +177,7 @@ void Sensor::setRealMeasurementData(double* data, double scale)
 
 void Sensor::setRealMeasurementData(vector<float> data, float scale)
 {
+  invalidateMeasurements();
   if(data.size()!=_size)
   {
     LOGMSG(DBG_WARN, "Size of measurement array wrong, expected " << _size << " obtained: " << data.size());
@@ -177,6 +222,7 @@ Matrix Sensor::dataToHomogeneousCoordMatrix()
 
 void Sensor::setRealMeasurementAccuracy(double* accuracy)
 {
+  _weightsDirty = true;
   if(!_accuracy) _accuracy = new double[_size];
   memcpy(_accuracy, accuracy, _size*sizeof(*accuracy));
 }
@@ -193,11 +239,13 @@ bool Sensor::hasRealMeasurmentAccuracy()
 
 void Sensor::setRealMeasurementMask(bool* mask)
 {
+  invalidateMeasurements();
   memcpy(_mask, mask, _size*sizeof(*mask));
 }
 
 void Sensor::setRealMeasurementMask(vector<unsigned char> mask)
 {
+  invalidateMeasurements();
   for(unsigned int i=0; i<mask.size(); i++)
     _mask[i] = mask[i];
 }
@@ -207,6 +255,170 @@ bool* Sensor::getRealMeasurementMask()
   return _mask;
 }
 
+void Sensor::invalidateMeasurements()
+{
+  _pyramidDirty = true;
+  _weightsDirty = true;
+}
+
+RangePyramid* Sensor::getRangePyramid()
+{
+  if(_pyramidDirty)
+  {
+    // One-dimensional measurement arrays are represented by a single row
+    unsigned int width  = (_dim<3) ? _size : _width;
+    unsigned int height = (_dim<3) ? 1 : _height;
+    if(!_pyramid) _pyramid = new RangePyramid(width, height);
+    _pyramid->build(_data, _mask);
+    _pyramidDirty = false;
+  }
+  return _pyramid;
+}
+
+void Sensor::setWeighting(int weighting)
+{
+  _weighting = weighting;
+  _weightsDirty = true;
+}
+
+int Sensor::getWeighting()
+{
+  return _weighting;
+}
+
+void Sensor::setDepthNoiseModel(double a, double b, double c)
+{
+  _noise[0] = a;
+  _noise[1] = b;
+  _noise[2] = c;
+  if(_noiseLut)
+  {
+    delete [] _noiseLut;
+    _noiseLut = NULL;
+  }
+  _weightsDirty = true;
+}
+
+void Sensor::setAccuracyReference(double sigma)
+{
+  _accuracyReference = sigma;
+  _weightsDirty = true;
+}
+
+double* Sensor::getRealMeasurementWeights()
+{
+  if(_weighting==WEIGHTING_CONSTANT) return NULL;
+
+  if(!_weightsDirty) return _weights;
+
+  if(!_weights) _weights = new double[_size];
+
+  for(unsigned int i=0; i<_size; i++)
+    _weights[i] = TSDINC;
+
+  if(_weighting & WEIGHTING_DEPTHNOISE)
+  {
+    if(!_noiseLut)
+    {
+      // Table covers measurement range, distances beyond are clamped to last entry
+      double range = isinf(_maxRange) ? 20.0 : _maxRange;
+      _noiseLutScale = ((double)(NOISELUTSIZE-1)) / range;
+      _noiseLut = new double[NOISELUTSIZE];
+      for(unsigned int i=0; i<NOISELUTSIZE; i++)
+      {
+        double d = ((double)i) / _noiseLutScale;
+        double sigma = _noise[0] + _noise[1] * (d-_noise[2]) * (d-_noise[2]);
+        double ratio = _noise[0] / sigma;
+        _noiseLut[i] = ratio * ratio;
+      }
+    }
+
+#pragma omp parallel for
+    for(int i=0; i<(int)_size; i++)
+    {
+      if(isinf(_data[i]) || _data[i]<0.0) continue;
+      unsigned int idx = (unsigned int)(_data[i] * _noiseLutScale + 0.5);
+      if(idx>=NOISELUTSIZE) idx = NOISELUTSIZE-1;
+      _weights[i] *= _noiseLut[idx];
+    }
+  }
+
+  if(_weighting & WEIGHTING_INCIDENCE)
+    calcIncidenceWeights();
+
+  if((_weighting & WEIGHTING_ACCURACY) && _accuracy)
+  {
+    double ref2 = _accuracyReference * _accuracyReference;
+#pragma omp parallel for
+    for(int i=0; i<(int)_size; i++)
+    {
+      double var = _accuracy[i] * _accuracy[i];
+      _weights[i] *= (var > ref2) ? ref2 / var : 1.0;
+    }
+  }
+
+  _weightsDirty = false;
+  return _weights;
+}
+
+void Sensor::calcIncidenceWeights()
+{
+  unsigned int width  = (_dim<3) ? _size : _width;
+  unsigned int height = (_dim<3) ? 1 : _height;
+  if(width*height != _size) return;
+
+#pragma omp parallel for
+  for(int i=0; i<(int)_size; i++)
+  {
+    if(!_mask[i] || isinf(_data[i])) continue;
+
+    unsigned int u = i % width;
+    unsigned int v = i / width;
+
+    // Neighbor indices, forward differences with backward differences at image borders
+    int iu = (u+1<width)  ? i+1 : i-1;
+    int iv = (v+1<height) ? i+width : i-width;
+    if(iu<0 || !_mask[iu] || isinf(_data[iu])) continue;
+
+    double ray[3] = {0.0, 0.0, 0.0};
+    double p[3]   = {0.0, 0.0, 0.0};
+    double pu[3]  = {0.0, 0.0, 0.0};
+    for(unsigned int j=0; j<_dim; j++)
+    {
+      ray[j] = (*_raysLocal)(j, i);
+      p[j]   = ray[j] * _data[i];
+      pu[j]  = (*_raysLocal)(j, iu) * _data[iu] - p[j];
+    }
+
+    double c;
+    if(_dim<3)
+    {
+      // Tangent of 2D contour
+      double len = sqrt(pu[0]*pu[0] + pu[1]*pu[1]) * sqrt(ray[0]*ray[0] + ray[1]*ray[1]);
+      if(len<=0.0) continue;
+      c = fabs(pu[0]*ray[1] - pu[1]*ray[0]) / len;
+    }
+    else
+    {
+      if(iv<0 || iv>=(int)_size || !_mask[iv] || isinf(_data[iv])) continue;
+      double pv[3];
+      for(unsigned int j=0; j<3; j++)
+        pv[j] = (*_raysLocal)(j, iv) * _data[iv] - p[j];
+      double n[3] = {pu[1]*pv[2] - pu[2]*pv[1], pu[2]*pv[0] - pu[0]*pv[2], pu[0]*pv[1] - pu[1]*pv[0]};
+      double len = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]) * sqrt(ray[0]*ray[0] + ray[1]*ray[1] + ray[2]*ray[2]);
+      if(len<=0.0) continue;
+      c = fabs(n[0]*ray[0] + n[1]*ray[1] + n[2]*ray[2]) / len;
+    }
+    _weights[i] *= c;
+  }
+}
+
+bool Sensor::getFrustum(vector<double> &vertices)
+{
+  vertices.clear();
+  return false;
+}
+
 bool Sensor::hasRealMeasurmentRGB()
 {
   return (_rgb!=NULL);
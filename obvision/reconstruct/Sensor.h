@@ -3,12 +3,25 @@
 
 #include "obcore/math/linalg/linalg.h"
 #include "obvision/reconstruct/reconstruct_defs.h"
+#include "obvision/reconstruct/RangePyramid.h"
 #include <vector>
 #include <cmath>
 
 namespace obvious
 {
 
+/**
+ * Weighting of measurements for integration, flags can be combined (factors are multiplied)
+ * WEIGHTING_CONSTANT: constant weight TSDINC for all measurements
+ * WEIGHTING_DEPTHNOISE: inverse variance of distance-dependent noise model sigma(d) = a + b (d-c)^2, normalized to sigma(c)
+ * WEIGHTING_INCIDENCE: cosine of incidence angle between beam and surface normal estimated from neighboring measurements
+ * WEIGHTING_ACCURACY: inverse variance of per-measurement accuracy (see setRealMeasurementAccuracy), normalized to reference accuracy
+ */
+enum EnumSensorWeighting { WEIGHTING_CONSTANT=0,
+  WEIGHTING_DEPTHNOISE=1,
+  WEIGHTING_INCIDENCE=2,
+  WEIGHTING_ACCURACY=4};
+
 /**
  * @class Sensor
  * @brief Abstract class for 2D and 3D measurement units
@@ -63,12 +76,21 @@ public:
   virtual double getLowReflectivityRange();
 
   /**
-   * Access matrix of measurement rays with parameterizable normalization
+   * Access matrix of measurement rays in world coordinate frame with parameterizable normalization.
+   * The matrix is rebuilt from the local rays on first access after the pose or normalization changed.
+   * Call this method once before accessing the matrix concurrently.
    * @param norm normalization value
    * @return Ray matrix, i.e. R(dimensionality, measurement size)
    */
   virtual Matrix* getNormalizedRayMap(double norm);
 
+  /**
+   * Get subsampled pattern of measurement rays in sensor coordinate frame, e.g., for rendering virtual images of reduced resolution
+   * @param step every step-th ray is taken in each image dimension
+   * @return Ray matrix, i.e. R(dimensionality, ceil(width/step)*ceil(height/step)), rays are of unit length
+   */
+  Matrix getRayPattern(unsigned int step);
+
   /**
    * Transform current sensor pose in his own coordinate system
    * P' = P T = [Rp | tp] [R | t] = [Rp R | Rp t + tp], where P is the old and P' is the new pose
@@ -154,6 +176,46 @@ public:
    */
   virtual bool* getRealMeasurementMask();
 
+  /**
+   * Get min/max pyramid of measurement data. The pyramid is rebuilt on first access after measurement data or mask changed.
+   * Call this method once before accessing the pyramid concurrently.
+   * @return range pyramid
+   */
+  RangePyramid* getRangePyramid();
+
+  /**
+   * Set weighting of measurements for integration
+   * @param weighting combination of EnumSensorWeighting flags
+   */
+  void setWeighting(int weighting);
+
+  /**
+   * Get weighting of measurements
+   * @return combination of EnumSensorWeighting flags
+   */
+  int getWeighting();
+
+  /**
+   * Set parameters of distance-dependent noise model sigma(d) = a + b (d-c)^2 (default: Kinect, a=0.0012, b=0.0019, c=0.4)
+   * @param a constant noise
+   * @param b quadratic coefficient
+   * @param c distance of lowest noise
+   */
+  void setDepthNoiseModel(double a, double b, double c);
+
+  /**
+   * Set reference accuracy, measurements of this standard deviation or better obtain full weight (default: 0.01)
+   * @param sigma standard deviation
+   */
+  void setAccuracyReference(double sigma);
+
+  /**
+   * Get weights of measurements. The weights are rebuilt on first access after measurement data changed.
+   * Call this method once before accessing weights concurrently.
+   * @return weight vector or NULL for constant weighting (TSDINC)
+   */
+  double* getRealMeasurementWeights();
+
   /**
    * @return flag indicate availability of RGB data
    */
@@ -171,6 +233,13 @@ public:
    */
   virtual unsigned char* getRealMeasurementRGB();
 
+  /**
+   * Get vertices of a convex hull enclosing the field of view up to the maximum range
+   * @param[out] vertices vertex coordinates in world coordinate frame (layout x1y1z1x2...)
+   * @return true if sensor provides a bounded convex hull, false for omnidirectional or unbounded sensors
+   */
+  virtual bool getFrustum(vector<double> &vertices);
+
   /**
    * Project coordinate back to sensor index
    * @param[in] M matrix of coordinates (homogeneous)
@@ -181,6 +250,12 @@ public:
 
 protected:
 
+  /**
+   * Mark caches derived from measurement data and mask as outdated, i.e., range pyramid and weights.
+   * Call after modifying _data or _mask in place.
+   */
+  void invalidateMeasurements();
+
   Matrix* _T;
 
   unsigned int _dim;
@@ -207,12 +282,49 @@ protected:
 
   double _rayNorm;
 
-  // Ray matrix in world coordinate frame
+  // Ray matrix in world coordinate frame, cache built from _raysLocal and current pose
   Matrix* _rays;
 
-  // Ray matrix in sensor coordinate frame
+  // Ray matrix in sensor coordinate frame, immutable after construction
   Matrix* _raysLocal;
 
+  // Flag indicating that ray matrix in world coordinate frame needs to be rebuilt
+  bool _raysDirty;
+
+  // Min/max pyramid of measurement data
+  RangePyramid* _pyramid;
+
+  // Flag indicating that pyramid needs to be rebuilt
+  bool _pyramidDirty;
+
+private:
+
+  /**
+   * Determine weight factors of incidence angle
+   */
+  void calcIncidenceWeights();
+
+  // Combination of EnumSensorWeighting flags
+  int _weighting;
+
+  // Weights of measurements
+  double* _weights;
+
+  // Flag indicating that weights need to be rebuilt
+  bool _weightsDirty;
+
+  // Lookup table of distance-dependent weights
+  double* _noiseLut;
+
+  // Number of lookup table entries per meter
+  double _noiseLutScale;
+
+  // Parameters of noise model
+  double _noise[3];
+
+  // Reference standard deviation
+  double _accuracyReference;
+
 };
 
 }
@@ -6,6 +6,7 @@
 #include "obcore/math/mathbase.h"
 #include "obcore/base/Timer.h"
 #include "obcore/base/Logger.h"
+#include "obcore/math/linalg/Transform.h"
 
 namespace obvious
 {
@@ -26,87 +27,28 @@ RayCastPolar2D::~RayCastPolar2D()
 
 void RayCastPolar2D::calcCoordsFromCurrentView(TsdGrid* grid, SensorPolar2D* sensor, double* coords, double* normals, unsigned int* cnt)
 {
-  Timer t;
-  t.start();
-  *cnt = 0;
-
-  Matrix T = sensor->getTransformation();
-  T.invert();
-
-  Matrix* R = sensor->getNormalizedRayMap(grid->getCellSize());
   unsigned int count = sensor->getRealMeasurementSize();
+  bool* mask = new bool[count];
 
-  obfloat tr[2];
-  sensor->getPosition(tr);
-
-  if(grid->isInsideGrid(sensor))
-  {
-    _xmin   = -10e9;
-    _ymin   = -10e9;
-
-    _xmax   = 10e9;
-    _ymax   = 10e9;
-  }
-  else
-  {
-    // prevent rays to be casted parallel to a plane outside of space
-    _xmin   = 10e9;
-    _ymin   = 10e9;
-
-    _xmax   = -10e9;
-    _ymax   = -10e9;
-
-    LOGMSG(DBG_WARN, "Sensor is outside of grid");
-  }
-
-  _idxMin = sensor->getMinimumRange() / grid->getCellSize();
-  _idxMax = sensor->getMaximumRange() / grid->getCellSize();
+  calcCoordsFromCurrentViewMask(grid, sensor, coords, normals, mask);
 
-#pragma omp parallel
-{
-  obfloat c[2];
-  obfloat n[2];
-  Matrix M(3,1);
-  Matrix N(3,1);
-  M(2,0) = 1.0;
-  N(2,0) = 0.0; // no translation for normals
-  unsigned int size_tmp = 0;
-  double* c_tmp         = new double[count*2];
-  double* n_tmp         = new double[count*2];
-
-#pragma omp for schedule(dynamic)
-  for (unsigned int beam = 0; beam < count; beam++)
+  // Compact valid beams in place, order of beams is preserved
+  *cnt = 0;
+  for(unsigned int beam=0; beam<count; beam++)
   {
-    obfloat ray[2];
-    ray[0] = (*R)(0, beam);
-    ray[1] = (*R)(1, beam);
-    if (rayCastFromCurrentView(grid, tr, ray, c, n))
+    if(!mask[beam]) continue;
+    coords[*cnt]    = coords[2*beam];
+    coords[*cnt+1]  = coords[2*beam+1];
+    if(normals)
     {
-      M(0,0)  = c[0];
-      M(1,0)  = c[1];
-      N(0,0)  = n[0];
-      N(1,0)  = n[1];
-      M       = T * M;
-      N       = T * N;
-      for (unsigned int i = 0; i < 2; i++)
-      {
-        c_tmp[size_tmp] = M(i,0);
-        n_tmp[size_tmp++] = N(i,0);
-      }
+      normals[*cnt]   = normals[2*beam];
+      normals[*cnt+1] = normals[2*beam+1];
     }
+    *cnt += 2;
   }
 
-#pragma omp critical
-  {
-      memcpy(&coords[*cnt],  c_tmp, size_tmp*sizeof(double));
-      memcpy(&normals[*cnt], n_tmp, size_tmp*sizeof(double));
-      *cnt += size_tmp;
-  }
-    delete[] c_tmp;     c_tmp = NULL;
-    delete[] n_tmp;     n_tmp = NULL;
-}
+  delete [] mask;
 
-  LOGMSG(DBG_DEBUG, "Elapsed TSDF projection: " << t.elapsed() << "s");
   LOGMSG(DBG_DEBUG, "Ray casting finished! Found " << *cnt << " coordinates");
 }
 
@@ -116,9 +58,11 @@ void RayCastPolar2D::calcCoordsFromCurrentViewMask(TsdGrid* grid, SensorPolar2D*
   t.start();
 
   Matrix T = sensor->getTransformation();
-  T.invert();
+  Transform2D Tinv(T);
+  Tinv.invert();
 
   Matrix* R = sensor->getNormalizedRayMap(grid->getCellSize());
+  int count = sensor->getRealMeasurementSize();
 
   obfloat tr[2];
   sensor->getPosition(tr);
@@ -146,33 +90,20 @@ void RayCastPolar2D::calcCoordsFromCurrentViewMask(TsdGrid* grid, SensorPolar2D*
   _idxMin = sensor->getMinimumRange() / grid->getCellSize();
   _idxMax = sensor->getMaximumRange() / grid->getCellSize();
 
-#pragma omp parallel
-{
-  obfloat c[2];
-  obfloat n[2];
-  Matrix M(3,1);
-  Matrix N(3,1);
-  M(2,0) = 1.0;
-  N(2,0) = 0.0; // no translation for normals
-
-#pragma omp for schedule (dynamic)
-  for (unsigned int beam = 0; beam < sensor->getRealMeasurementSize(); beam++)
+  // Each beam writes to its own slot. Neighboring beams traverse similar partitions, they are scheduled in batches.
+#pragma omp parallel for schedule(dynamic, 16)
+  for (int beam = 0; beam < count; beam++)
   {
     obfloat ray[2];
+    obfloat c[2];
+    obfloat n[2];
     ray[0] = (*R)(0, beam);
     ray[1] = (*R)(1, beam);
     if (rayCastFromCurrentView(grid, tr, ray, c, n))
     {
-      M(0,0)            = c[0];
-      M(1,0)            = c[1];
-      N(0,0)            = n[0];
-      N(1,0)            = n[1];
-      M                 = T * M;
-      N                 = T * N;
-      coords[2*beam]    = M(0,0);
-      coords[2*beam+1]  = M(1,0);
-      normals[2*beam]   = N(0,0);
-      normals[2*beam+1] = N(1,0);
+      // Transform to sensor coordinate system, no translation for normals
+      Tinv.transform(c, &coords[2*beam]);
+      if(normals) Tinv.rotate(n, &normals[2*beam]);
       mask[beam] = true;
     }
     else
@@ -180,10 +111,8 @@ void RayCastPolar2D::calcCoordsFromCurrentViewMask(TsdGrid* grid, SensorPolar2D*
       mask[beam] = false;
     }
   }
-}
 
   LOGMSG(DBG_DEBUG, "Elapsed TSDF projection: " << t.elapsed() << "s");
-  LOGMSG(DBG_DEBUG, "Ray casting finished!");
 }
 
 bool RayCastPolar2D::rayCastFromCurrentView(TsdGrid* grid, obfloat tr[2], obfloat ray[2], obfloat coordinates[2], obfloat normal[2])
@@ -192,11 +121,6 @@ bool RayCastPolar2D::rayCastFromCurrentView(TsdGrid* grid, obfloat tr[2], obfloa
   int yDim = grid->getCellsY();
   double cellSize = grid->getCellSize();
 
-  obfloat position[2];
-
-  // Interpolation weight
-  obfloat interp;
-
   obfloat xmin   = _xmin;
   obfloat ymin   = _ymin;
   if(fabs(ray[0])>10e-6) xmin = ((obfloat)(ray[0] > 0.0 ? 0 : (xDim-1)*cellSize) - tr[0]) / ray[0];
@@ -215,36 +139,64 @@ bool RayCastPolar2D::rayCastFromCurrentView(TsdGrid* grid, obfloat tr[2], obfloa
 
   if (idxMin >= idxMax) return false;
 
-  // Traverse partitions roughly to clip minimum index
-  obfloat partitionSize = grid->getPartitionSize();
-  for(obfloat i=idxMin; i<idxMax; i+=partitionSize)
+  // March in units of cells relative to cell centers, i.e., floor(u), floor(v) is the base cell of bilinear interpolation.
+  // Samples are taken directly from the partition they fall into, instead of resolving the partition for each step.
+  const obfloat invCellSize = 1.0 / cellSize;
+  const obfloat u0 = tr[0] * invCellSize - 0.5;
+  const obfloat v0 = tr[1] * invCellSize - 0.5;
+  const obfloat du = ray[0] * invCellSize;
+  const obfloat dv = ray[1] * invCellSize;
+
+  const int dim = grid->getPartitionSize();
+  TsdGridPartition*** partitions = grid->getPartitions();
+  TsdGridPartition* part = NULL;
+
+  // Index of first cell of current partition
+  int x0 = -dim;
+  int y0 = -dim;
+
+  obfloat tsd_prev = NAN;
+  obfloat interp = 0.0;
+  obfloat i;
+  bool found = false;
+  for(i=idxMin; i<=idxMax; i+=1.0)
   {
-    obfloat tsd_tmp;
-    position[0] = tr[0] + i * ray[0];
-    position[1] = tr[1] + i * ray[1];
-    EnumTsdGridInterpolate retval = grid->interpolateBilinear(position, &tsd_tmp);
-    if(retval!=INTERPOLATE_EMPTYPARTITION && retval!=INTERPOLATE_INVALIDINDEX)
-      break;
-    else
-      idxMin = i;
-  }
+    const obfloat u = u0 + i * du;
+    const obfloat v = v0 + i * dv;
+    const int x = (int)floor(u);
+    const int y = (int)floor(v);
 
-  obfloat tsd_prev;
-  position[0] = tr[0] + idxMin * ray[0];
-  position[1] = tr[1] + idxMin * ray[1];
-  if(grid->interpolateBilinear(position, &tsd_prev)!=INTERPOLATE_SUCCESS)
-    tsd_prev = NAN;
+    if(x<0 || x>=xDim || y<0 || y>=yDim)
+    {
+      tsd_prev = NAN;
+      continue;
+    }
 
-  bool found = false;
-  for(obfloat i=idxMin; i<=idxMax; i+=1.0)
-  {
-    position[0] += ray[0];
-    position[1] += ray[1];
+    if(x<x0 || x>=x0+dim || y<y0 || y>=y0+dim)
+    {
+      x0 = (x / dim) * dim;
+      y0 = (y / dim) * dim;
+      part = partitions[y0/dim][x0/dim];
+    }
 
-    obfloat tsd;
-    if (grid->interpolateBilinear(position, &tsd)!=INTERPOLATE_SUCCESS)
+    if(!part->isInitialized())
     {
-      tsd_prev = tsd;
+      // Uninitialized partitions (including empty ones) cannot contain a zero crossing: skip partition, i.e., continue with first step behind the exit point (2D DDA)
+      obfloat exit = idxMax + 1.0;
+      if(du > 0.0)      exit = min(exit, ((obfloat)(x0+dim) - u0) / du);
+      else if(du < 0.0) exit = min(exit, ((obfloat)x0 - u0) / du);
+      if(dv > 0.0)      exit = min(exit, ((obfloat)(y0+dim) - v0) / dv);
+      else if(dv < 0.0) exit = min(exit, ((obfloat)y0 - v0) / dv);
+      obfloat next = idxMin + ceil(exit - idxMin);
+      if(next > i + 1.0) i = next - 1.0;
+      tsd_prev = NAN;
+      continue;
+    }
+
+    const obfloat tsd = part->interpolateBilinear(x-x0, y-y0, u-(obfloat)x, v-(obfloat)y);
+    if(isnan(tsd))
+    {
+      tsd_prev = NAN;
       continue;
     }
 
@@ -257,7 +209,6 @@ bool RayCastPolar2D::rayCastFromCurrentView(TsdGrid* grid, obfloat tr[2], obfloa
     }
     else if(tsd_prev < 0 && tsd > 0)
     {
-      found = false;
       break;
     }
 
@@ -269,11 +220,11 @@ bool RayCastPolar2D::rayCastFromCurrentView(TsdGrid* grid, obfloat tr[2], obfloa
     return false;
   }
 
-  coordinates[0] = position[0] + ray[0] * (interp-1.0);
-  coordinates[1] = position[1] + ray[1] * (interp-1.0);
+  // Zero crossing lies between previous and current step
+  coordinates[0] = tr[0] + ray[0] * (i - 1.0 + interp);
+  coordinates[1] = tr[1] + ray[1] * (i - 1.0 + interp);
 
   return grid->interpolateNormal(coordinates, normal);
 }
 
 }
-
@@ -56,6 +56,7 @@ void SensorPolar2D::resetMask()
 {
   for(int i=0; i<_size; i++)
     _mask[i] = true;
+  invalidateMeasurements();
 }
 
 void SensorPolar2D::maskDepthDiscontinuity(double thresh)
@@ -88,6 +89,7 @@ void SensorPolar2D::maskDepthDiscontinuity(double thresh)
     if(betamin<thresh)
       _mask[i] = false;
   }
+  invalidateMeasurements();
 }
 
 int SensorPolar2D::backProject(double data[2])
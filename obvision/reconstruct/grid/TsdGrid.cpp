@@ -75,14 +75,15 @@ TsdGrid::TsdGrid(const std::string& path)
       else if(id == CONTENT)
       {
         curPart->init();
+        curPart->_modifications++;
         for(unsigned int py=0; py < curPart->getHeight(); py++)
         {
           for(unsigned int px = 0; px < curPart->getWidth(); px++)
           {
             inFile.getline(buffer, 1000);
-            curPart->_grid[py][px].tsd = std::atof(buffer);
+            curPart->at(py, px).tsd = std::atof(buffer);
             inFile.getline(buffer, 1000);
-            curPart->_grid[py][px].weight = std::atof(buffer);
+            curPart->at(py, px).weight = std::atof(buffer);
           }
         }
       }
@@ -109,6 +110,8 @@ void TsdGrid::init(const double cellSize, const EnumTsdGridLayout layoutPartitio
 
   _dimPartition = (unsigned int)pow(2.0,layoutPartition);
 
+  _pool = NULL;
+
   if(_dimPartition > _cellsX)
   {
     LOGMSG(DBG_ERROR, "Insufficient partition size : " << _dimPartition << "x" << _dimPartition << " in "
@@ -134,11 +137,16 @@ void TsdGrid::init(const double cellSize, const EnumTsdGridLayout layoutPartitio
   LOGMSG(DBG_DEBUG, "Allocating " << _partitionsInX << "x" << _partitionsInY << " partitions");
   System<TsdGridPartition*>::allocate(_partitionsInY, _partitionsInX, _partitions);
 
+  // Cell blocks of partitions including ghost borders, slabs of about 1MB
+  unsigned int blockSize = (_dimPartition+1)*(_dimPartition+1);
+  unsigned int blocksPerSlab = max(1u, (unsigned int)((1<<20) / (blockSize*sizeof(TsdCell))));
+  _pool = new SlabAllocator<TsdCell>(blockSize, blocksPerSlab);
+
   for(int py=0; py<_partitionsInY; py++)
   {
     for(int px=0; px<_partitionsInX; px++)
     {
-      _partitions[py][px] = new TsdGridPartition(px*_dimPartition, py*_dimPartition, _dimPartition, _dimPartition, cellSize);
+      _partitions[py][px] = new TsdGridPartition(px*_dimPartition, py*_dimPartition, _dimPartition, _dimPartition, cellSize, _pool);
     }
   }
 
@@ -160,6 +168,7 @@ TsdGrid::~TsdGrid(void)
 {
   delete _tree;
   System<TsdGridPartition*>::deallocate(_partitions);
+  delete _pool;
 }
 
 obfloat& TsdGrid::operator () (unsigned int y, unsigned int x)
@@ -243,11 +252,15 @@ void TsdGrid::push(SensorPolar2D* sensor)
   t.start();
   double* data     = sensor->getRealMeasurementData();
   bool* mask       = sensor->getRealMeasurementMask();
+  double* weights  = sensor->getRealMeasurementWeights();
   obfloat tr[2];
   sensor->getPosition(tr);
 
   unsigned int partSize = (_partitions[0][0])->getSize();
 
+  // Build range pyramid once, partitions query it concurrently
+  sensor->getRangePyramid();
+
 #pragma omp parallel
   {
     int* idx = new int[partSize];
@@ -258,6 +271,7 @@ void TsdGrid::push(SensorPolar2D* sensor)
       if(!part->isInRange(tr, sensor, _maxTruncation)) continue;
 
       part->init();
+      part->_modifications++;
 
       Matrix* partCoords = part->getPartitionCoords();
       Matrix* cellCoordsHom = part->getCellCoordsHom();
@@ -269,7 +283,8 @@ void TsdGrid::push(SensorPolar2D* sensor)
         // Index of laser beam
         int index = idx[c];
 
-        if(index>=0)
+        // Measurements without weight are skipped, they would lead to a division by zero in the running average
+        if(index>=0 && (!weights || weights[index] > 0.0))
         {
           if(mask[index])
           {
@@ -278,13 +293,13 @@ void TsdGrid::push(SensorPolar2D* sensor)
               // calculate signed distance, i.e. measurement minus distance of current cell to sensor
               double sd = data[index] - sqrt( ((*cellCoordsHom)(c,0)-tr[0]) * ((*cellCoordsHom)(c,0)-tr[0]) + ((*cellCoordsHom)(c,1)-tr[1]) * ((*cellCoordsHom)(c,1)-tr[1]));
 
-              part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), sd, _maxTruncation);
+              part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), sd, _maxTruncation, weights ? weights[index] : TSDINC);
             }
             else
             {
               double dist = sqrt( ((*cellCoordsHom)(c,0)-tr[0]) * ((*cellCoordsHom)(c,0)-tr[0]) + ((*cellCoordsHom)(c,1)-tr[1]) * ((*cellCoordsHom)(c,1)-tr[1]));
               if(dist<lowReflectivityRange)
-                part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), _maxTruncation, _maxTruncation);
+                part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), _maxTruncation, _maxTruncation, weights ? weights[index] : TSDINC);
             }
           }
         }
@@ -303,10 +318,13 @@ void TsdGrid::pushTree(SensorPolar2D* sensor)
   Timer t;
   t.start();
   double* data     = sensor->getRealMeasurementData();
+  double* weights  = sensor->getRealMeasurementWeights();
 
   obfloat tr[2];
   sensor->getPosition(tr);
 
+  sensor->getRangePyramid();
+
   TsdGridComponent* comp = _tree;
   vector<TsdGridPartition*> partitionsToCheck;
   pushRecursion(sensor, tr, comp, partitionsToCheck);
@@ -322,6 +340,7 @@ void TsdGrid::pushTree(SensorPolar2D* sensor)
     {
       TsdGridPartition* part = partitionsToCheck[i];
       part->init();
+      part->_modifications++;
 
       Matrix* partCoords = part->getPartitionCoords();
       Matrix* cellCoordsHom = part->getCellCoordsHom();
@@ -332,20 +351,21 @@ void TsdGrid::pushTree(SensorPolar2D* sensor)
         // Index of laser beam
         int index = idx[c];
 
-        if(index>=0)
+        // Measurements without weight are skipped, they would lead to a division by zero in the running average
+        if(index>=0 && (!weights || weights[index] > 0.0))
         {
           if(!isinf(data[index]))
           {
             // calculate signed distance, i.e. measurement minus distance of current cell to sensor
             double sd = data[index] - sqrt( ((*cellCoordsHom)(c,0)-tr[0]) * ((*cellCoordsHom)(c,0)-tr[0]) + ((*cellCoordsHom)(c,1)-tr[1]) * ((*cellCoordsHom)(c,1)-tr[1]));
 
-            part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), sd, _maxTruncation);
+            part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), sd, _maxTruncation, weights ? weights[index] : TSDINC);
           }
           else
           {
             double dist = sqrt( ((*cellCoordsHom)(c,0)-tr[0]) * ((*cellCoordsHom)(c,0)-tr[0]) + ((*cellCoordsHom)(c,1)-tr[1]) * ((*cellCoordsHom)(c,1)-tr[1]));
             if(dist<sensor->getLowReflectivityRange())
-              part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), _maxTruncation, _maxTruncation);
+              part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), _maxTruncation, _maxTruncation, weights ? weights[index] : TSDINC);
           }
         }
       }
@@ -396,8 +416,8 @@ void TsdGrid::propagateBorders()
           // Copy right border
           for(unsigned int i=0; i<height; i++)
           {
-            partCur->_grid[i][width].tsd = partRight->_grid[i][0].tsd;
-            partCur->_grid[i][width].weight = partRight->_grid[i][0].weight;
+            partCur->at(i, width).tsd = partRight->at(i, 0).tsd;
+            partCur->at(i, width).weight = partRight->at(i, 0).weight;
           }
         }
       }
@@ -410,8 +430,8 @@ void TsdGrid::propagateBorders()
           // Copy upper border
           for(unsigned int i=0; i<width; i++)
           {
-            partCur->_grid[height][i].tsd = partUp->_grid[0][i].tsd;
-            partCur->_grid[height][i].weight = partUp->_grid[0][i].weight;
+            partCur->at(height, i).tsd = partUp->at(0, i).tsd;
+            partCur->at(height, i).weight = partUp->at(0, i).weight;
           }
         }
       }
@@ -422,8 +442,8 @@ void TsdGrid::propagateBorders()
         if(partUpRight->isInitialized())
         {
           // Copy upper right corner
-          partCur->_grid[height][width].tsd = partUpRight->_grid[0][0].tsd;
-          partCur->_grid[height][width].weight = partUpRight->_grid[0][0].weight;
+          partCur->at(height, width).tsd = partUpRight->at(0, 0).tsd;
+          partCur->at(height, width).weight = partUpRight->at(0, 0).weight;
         }
       }
     }
@@ -455,7 +475,7 @@ void TsdGrid::grid2ColorImage(unsigned char* image, unsigned int width, unsigned
       if(coord2Cell(coord, &p, &x, &y, &dx, &dy))
       {
         if(_partitions[0][p]->isInitialized())
-          tsd = _partitions[0][p]->_grid[y][x].tsd;
+          tsd = _partitions[0][p]->at(y, x).tsd;
 
         isEmpty = _partitions[0][p]->isEmpty();
       }
@@ -513,7 +533,7 @@ void TsdGrid::getData(std::vector<double>& data)
       if(this->coord2Cell(coordVar, &p, &x, &y, &dx, &dy))
       {
         if(_partitions[0][p]->isInitialized())
-          tsd = _partitions[0][p]->_grid[y][x].tsd;
+          tsd = _partitions[0][p]->at(y, x).tsd;
         else
           tsd = NAN;
       }
@@ -526,29 +546,13 @@ void TsdGrid::getData(std::vector<double>& data)
 
 bool TsdGrid::interpolateNormal(const obfloat* coord, obfloat* normal)
 {
-  obfloat neighbor[3];
-  obfloat depthInc = 0;
-  obfloat depthDec = 0;
-
-  neighbor[0] = coord[0] + _cellSize;
-  neighbor[1] = coord[1];
-  if(interpolateBilinear(neighbor, &depthInc)!=INTERPOLATE_SUCCESS) return false;
+  obfloat c[2] = {coord[0], coord[1]};
+  obfloat tsd;
 
-  neighbor[0] = coord[0] - _cellSize;
-  // neighbor[1] = coord[1];
-  if(interpolateBilinear(neighbor, &depthDec)!=INTERPOLATE_SUCCESS) return false;
+  // Analytic gradient of bilinear interpolation, i.e., a single lookup of the cell neighborhood
+  if(interpolateBilinear(c, &tsd, normal)!=INTERPOLATE_SUCCESS) return false;
 
-  normal[0] = depthInc - depthDec;
-
-  neighbor[0] = coord[0];
-  neighbor[1] = coord[1] + _cellSize;
-  if(interpolateBilinear(neighbor, &depthInc)!=INTERPOLATE_SUCCESS) return false;
-
-  // neighbor[0] = coord[0];
-  neighbor[1] = coord[1] - _cellSize;
-  if(interpolateBilinear(neighbor, &depthDec)!=INTERPOLATE_SUCCESS) return false;
-
-  normal[1] = depthInc - depthDec;
+  if(normal[0]==0.0 && normal[1]==0.0) return false;
 
   norm2<obfloat>(normal);
 
@@ -577,6 +581,43 @@ EnumTsdGridInterpolate TsdGrid::interpolateBilinear(obfloat coord[2], obfloat* t
   return INTERPOLATE_SUCCESS;
 }
 
+EnumTsdGridInterpolate TsdGrid::interpolateBilinear(obfloat coord[2], obfloat* tsd, obfloat gradient[2])
+{
+  int p;
+  int x;
+  int y;
+  obfloat dx;
+  obfloat dy;
+
+  if(!coord2Cell(coord, &p, &x, &y, &dx, &dy)) return INTERPOLATE_INVALIDINDEX;
+  if(!_partitions[0][p]->isInitialized()) return INTERPOLATE_EMPTYPARTITION;
+
+  const obfloat wx = (coord[0] - dx) * _invCellSize;
+  const obfloat wy = (coord[1] - dy) * _invCellSize;
+
+  *tsd = _partitions[0][p]->interpolateBilinear(x, y, wx, wy, gradient);
+
+  if(isnan(*tsd))
+    return INTERPOLATE_ISNAN;
+
+  gradient[0] *= _invCellSize;
+  gradient[1] *= _invCellSize;
+
+  return INTERPOLATE_SUCCESS;
+}
+
+void TsdGrid::interpolateBilinear(obfloat* coords, unsigned int size, obfloat* tsd, obfloat* gradients, EnumTsdGridInterpolate* retval)
+{
+#pragma omp parallel for
+  for(int i=0; i<(int)size; i++)
+  {
+    if(gradients)
+      retval[i] = interpolateBilinear(&coords[2*i], &tsd[i], &gradients[2*i]);
+    else
+      retval[i] = interpolateBilinear(&coords[2*i], &tsd[i]);
+  }
+}
+
 bool TsdGrid::coord2Cell(obfloat coord[2], int* p, int* x, int* y, obfloat* dx, obfloat* dy)
 {
   // Get cell indices
@@ -659,8 +700,8 @@ bool TsdGrid::storeGrid(const std::string& path)
         {
           for(unsigned int px = 0; px < curPart->getWidth(); px++)
           {
-            outFile << curPart->_grid[py][px].tsd << "\n";
-            outFile << curPart->_grid[py][px].weight << "\n";
+            outFile << curPart->at(py, px).tsd << "\n";
+            outFile << curPart->at(py, px).weight << "\n";
           }
         }
       }
@@ -712,6 +753,7 @@ bool TsdGrid::freeFootprint(const obfloat centerCoords[2], const obfloat width,
       unsigned int cy = rows % dimPartition;
       unsigned int cx = cols % dimPartition;
       (*_partitions[py][px])(cy, cx) = TSDINC;
+      _partitions[py][px]->_modifications++;
     }
   }
   return true;
@@ -156,7 +156,7 @@ enum EnumTsdGridPartitionIdentifier{ UNINITIALIZED = 0,
   void getData(std::vector<double>& data);
 
   /**
-   * Calculates normal of plain element hit by a ray caster
+   * Calculates normal of plain element hit by a ray caster, i.e., the normalized TSD gradient
    * @param[out] coordinates
    * @param[out] normal vector
    */
@@ -169,6 +169,25 @@ enum EnumTsdGridPartitionIdentifier{ UNINITIALIZED = 0,
    */
   EnumTsdGridInterpolate interpolateBilinear(obfloat coord[2], obfloat* tsd);
 
+  /**
+   * Interpolate bilinear, including gradient of TSD
+   * @param[in] coord query coordinates
+   * @param[out] tsd interpolated TSD value
+   * @param[out] gradient partial derivatives of TSD with respect to x and y (per meter)
+   * @return success or reason of failure
+   */
+  EnumTsdGridInterpolate interpolateBilinear(obfloat coord[2], obfloat* tsd, obfloat gradient[2]);
+
+  /**
+   * Batched variant of bilinear interpolation, points are processed in parallel
+   * @param[in] coords query coordinates (size: 2*size)
+   * @param[in] size number of query points
+   * @param[out] tsd interpolated TSD values (size: size)
+   * @param[out] gradients partial derivatives of TSD (size: 2*size), may be NULL
+   * @param[out] retval result of interpolation per point (size: size)
+   */
+  void interpolateBilinear(obfloat* coords, unsigned int size, obfloat* tsd, obfloat* gradients, EnumTsdGridInterpolate* retval);
+
   /**
    * Convert arbitrary coordinate to grid coordinates
    * @param[in] coord 2D query coordinates
@@ -249,6 +268,9 @@ enum EnumTsdGridPartitionIdentifier{ UNINITIALIZED = 0,
 
   EnumTsdGridLayout _layoutGrid;
 
+  // Allocator for cell blocks of partitions
+  SlabAllocator<TsdCell>* _pool;
+
  };
 
 }
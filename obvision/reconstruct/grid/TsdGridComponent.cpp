@@ -59,9 +59,6 @@ bool TsdGridComponent::isInRange(obfloat pos[2], Sensor* sensor, obfloat maxTrun
 
   if(_isLeaf)
   {
-    double* data = sensor->getRealMeasurementData();
-    bool* mask = sensor->getRealMeasurementMask();
-
     int idxEdge[4];
     sensor->backProject(_edgeCoordsHom, idxEdge);
 
@@ -74,24 +71,20 @@ bool TsdGridComponent::isInRange(obfloat pos[2], Sensor* sensor, obfloat maxTrun
 
     if(minIdx<0) minIdx = 0;
 
+    // Summarize measurements within the projection range
+    RangeStatistics stats;
+    sensor->getRangePyramid()->query(minIdx, maxIdx, 0, 0, &stats);
+
     // Check if any cell comes closer than the truncation radius
-    bool isVisible = false;
-    for(int j=minIdx; j<=maxIdx; j++)
-    {
-        isVisible = isVisible || ((data[j] > closestVoxelDist) && mask[j]);
-    }
+    bool isVisible = (stats.maxValid > closestVoxelDist);
 
     if(!isVisible) return false;
 
-    bool isEmpty = true;
-    for(int j=minIdx; j<=maxIdx; j++)
-    {
-      //isEmpty = isEmpty && (data[j] > farthestVoxelDist) && mask[j];
-      if(isinf(data[j]))
-        isEmpty = isEmpty && (distance < sensor->getLowReflectivityRange());
-      else
-        isEmpty = isEmpty && (data[j] > farthestVoxelDist) && mask[j];
-    }
+    // Infinite measurements (no echo) are considered to be empty space within the range of low reflectivity,
+    // all other measurements need to be valid and behind the partition.
+    bool isEmpty = ((stats.invalid-stats.invalidInfinite)==0) && (stats.minFinite > farthestVoxelDist);
+    if(stats.infinite>0)
+      isEmpty = isEmpty && (distance < sensor->getLowReflectivityRange());
 
     if(isEmpty)
     {
@@ -16,9 +16,11 @@ TsdGridPartition::TsdGridPartition(const unsigned int x,
     const unsigned int y,
     const unsigned int cellsX,
     const unsigned int cellsY,
-    const obfloat cellSize) : TsdGridComponent(true)
+    const obfloat cellSize,
+    SlabAllocator<TsdCell>* pool) : TsdGridComponent(true)
 {
   _initialized = false;
+  _modifications = 0;
 
   _x = x;
   _y = y;
@@ -71,11 +73,26 @@ TsdGridPartition::TsdGridPartition(const unsigned int x,
 
   _cellsX = cellsX;
   _cellsY = cellsY;
+
+  _strideY = _cellsX+1;
+
+  _pool = pool;
+  if(_pool && _pool->getBlockSize()!=getBlockSize())
+  {
+    LOGMSG(DBG_ERROR, "Block size of allocator does not match partition size, falling back to heap allocation");
+    _pool = NULL;
+  }
 }
 
 TsdGridPartition::~TsdGridPartition()
 {
-  if(_grid) System<TsdCell>::deallocate(_grid);
+  if(_grid)
+  {
+    if(_pool)
+      _pool->release(_grid);
+    else
+      delete [] _grid;
+  }
   if(_cellCoordsHom) delete [] _cellCoordsHom;
   delete [] _edgeCoordsHom;
   if(_partCoords)
@@ -87,35 +104,20 @@ TsdGridPartition::~TsdGridPartition()
 
 obfloat& TsdGridPartition::operator () (unsigned int y, unsigned int x)
 {
-  return _grid[y][x].tsd;
+  return at(y, x).tsd;
 }
 
 void TsdGridPartition::init()
 {
   if(_initialized) return;
 
-  System<TsdCell>::allocate(_cellsY+1, _cellsX+1, _grid);
-  if(_initWeight>0.0)
+  _grid = _pool ? _pool->allocate() : new TsdCell[getBlockSize()];
+  const obfloat tsd = (_initWeight>0.0) ? 1.0 : NAN;
+  const unsigned int size = getBlockSize();
+  for(unsigned int i=0; i<size; i++)
   {
-    for (unsigned int iy = 0; iy <= _cellsY; iy++)
-    {
-      for (unsigned int ix = 0; ix <= _cellsX; ix++)
-      {
-        _grid[iy][ix].tsd    = 1.0;
-        _grid[iy][ix].weight = _initWeight;
-      }
-    }
-  }
-  else
-  {
-    for (unsigned int iy = 0; iy <= _cellsY; iy++)
-    {
-      for (unsigned int ix = 0; ix <= _cellsX; ix++)
-      {
-        _grid[iy][ix].tsd    = NAN;
-        _grid[iy][ix].weight = _initWeight;
-      }
-    }
+    _grid[i].tsd    = tsd;
+    _grid[i].weight = _initWeight;
   }
 
   _cellCoordsHom = new Matrix(_cellsX*_cellsY, 3);
@@ -178,24 +180,29 @@ unsigned int TsdGridPartition::getSize()
   return _cellsX*_cellsY;
 }
 
-void TsdGridPartition::addTsd(const unsigned int x, const unsigned int y, const obfloat sdf, const obfloat maxTruncation)
+unsigned int TsdGridPartition::getBlockSize()
+{
+  return (_cellsY+1)*(_cellsX+1);
+}
+
+void TsdGridPartition::addTsd(const unsigned int x, const unsigned int y, const obfloat sdf, const obfloat maxTruncation, const obfloat weight)
 {
   // Factor avoids thin objects to be removed when seen from two sides
   if(sdf >= -2.0*maxTruncation)
   {
-    TsdCell* cell = &_grid[y][x];
+    TsdCell* cell = &at(y, x);
 
     obfloat tsdf = min(sdf / maxTruncation, TSDINC);
 
     if(isnan(cell->tsd))
     {
       cell->tsd = tsdf;
-      cell->weight += TSDINC;
+      cell->weight += weight;
     }
     else
     {
-      cell->weight = min(cell->weight+TSDINC, TSDGRIDMAXWEIGHT);
-      cell->tsd   = (cell->tsd * (cell->weight - TSDINC) + tsdf) / cell->weight;
+      cell->weight = min(cell->weight+weight, TSDGRIDMAXWEIGHT);
+      cell->tsd   = (cell->tsd * (cell->weight - weight) + tsdf * weight) / cell->weight;
     }
   }
 }
@@ -208,7 +215,7 @@ void TsdGridPartition::increaseEmptiness()
     {
       for(unsigned int x=0; x<=_cellsX; x++)
       {
-        TsdCell* cell = &_grid[y][x];
+        TsdCell* cell = &at(y, x);
 
         if(isnan(cell->tsd))
         {
@@ -222,6 +229,7 @@ void TsdGridPartition::increaseEmptiness()
         }
       }
     }
+    _modifications++;
   }
   else
   {
@@ -230,13 +238,38 @@ void TsdGridPartition::increaseEmptiness()
   }
 }
 
+unsigned int TsdGridPartition::getModifications()
+{
+  return _modifications;
+}
+
 obfloat TsdGridPartition::interpolateBilinear(int x, int y, obfloat dx, obfloat dy)
 {
   // Interpolate
-  return _grid[y][x].tsd         * (1. - dy) * (1. - dx)
-       + _grid[y + 1][x + 0].tsd *       dy  * (1. - dx)
-       + _grid[y + 0][x + 1].tsd * (1. - dy) *       dx
-       + _grid[y + 1][x + 1].tsd *       dy  *       dx;
+  const TsdCell* c = &at(y, x);
+  const unsigned int sy = _strideY;
+  return c[0].tsd    * (1. - dy) * (1. - dx)
+       + c[sy].tsd   *       dy  * (1. - dx)
+       + c[1].tsd    * (1. - dy) *       dx
+       + c[sy+1].tsd *       dy  *       dx;
+}
+
+obfloat TsdGridPartition::interpolateBilinear(int x, int y, obfloat dx, obfloat dy, obfloat gradient[2])
+{
+  const TsdCell* c = &at(y, x);
+  const obfloat c00 = c[0].tsd;
+  const obfloat c01 = c[1].tsd;
+  const obfloat c10 = c[_strideY].tsd;
+  const obfloat c11 = c[_strideY+1].tsd;
+
+  // collapse x-direction
+  const obfloat c0 = c00 + (c01-c00) * dx;
+  const obfloat c1 = c10 + (c11-c10) * dx;
+
+  gradient[0] = (c01-c00) + ((c11-c10) - (c01-c00)) * dy;
+  gradient[1] = c1 - c0;
+
+  return c0 + (c1-c0) * dy;
 }
 
 }
@@ -4,6 +4,7 @@
 #include "obcore/math/linalg/linalg.h"
 #include "obvision/reconstruct/grid/SensorPolar2D.h"
 #include "obvision/reconstruct/grid/TsdGridComponent.h"
+#include "obcore/base/SlabAllocator.h"
 
 namespace obvious
 {
@@ -38,8 +39,9 @@ public:
    * @param[in] dimX Number of cells in x-dimension
    * @param[in] dimY Number of cells in y-dimension
    * @param[in] cellSize Size of cell in meters
+   * @param[in] pool allocator for cell blocks of getBlockSize() cells, shared among partitions (heap is used if NULL)
    */
-  TsdGridPartition(const unsigned int x, const unsigned int y, const unsigned int dimX, const unsigned int dimY, const obfloat cellSize);
+  TsdGridPartition(const unsigned int x, const unsigned int y, const unsigned int dimX, const unsigned int dimY, const obfloat cellSize, SlabAllocator<TsdCell>* pool=NULL);
 
   ~TsdGridPartition();
 
@@ -65,15 +67,62 @@ public:
 
   unsigned int getSize();
 
-  void addTsd(const unsigned int x, const unsigned int y, const obfloat sdf, const obfloat maxTruncation);
+  /**
+   * Get number of cells allocated per partition, including ghost borders
+   * @return size of cell block
+   */
+  unsigned int getBlockSize();
+
+  /**
+   * Add signed distance to cell by weighted running average
+   * @param x x-index of cell
+   * @param y y-index of cell
+   * @param sdf signed distance
+   * @param maxTruncation truncation radius
+   * @param weight weight of measurement (see Sensor::getRealMeasurementWeights)
+   */
+  void addTsd(const unsigned int x, const unsigned int y, const obfloat sdf, const obfloat maxTruncation, const obfloat weight=TSDINC);
 
   virtual void increaseEmptiness();
 
+  /**
+   * Get number of modifications of cell content, e.g., by pushing measurements or loading from file
+   * @return counter, consumers compare it with the value seen before in order to detect changes
+   */
+  unsigned int getModifications();
+
   obfloat interpolateBilinear(int x, int y, obfloat dx, obfloat dy);
 
+  /**
+   * Bilinear interpolation of tsd and its gradient
+   * @param[in] x x-index of base cell
+   * @param[in] y y-index of base cell
+   * @param[in] dx interpolation weight in x-direction
+   * @param[in] dy interpolation weight in y-direction
+   * @param[out] gradient partial derivatives with respect to x and y (per cell)
+   * @return interpolated tsd
+   */
+  obfloat interpolateBilinear(int x, int y, obfloat dx, obfloat dy, obfloat gradient[2]);
+
 private:
 
-  TsdCell** _grid;
+  /**
+   * Access cell by flat index arithmetic, cells are stored contiguously in order y, x
+   * @param y y-index
+   * @param x x-index
+   * @return cell
+   */
+  inline TsdCell& at(unsigned int y, unsigned int x)
+  {
+    return _grid[y*_strideY + x];
+  };
+
+  TsdCell* _grid;
+
+  // Offset between consecutive rows of _grid
+  unsigned int _strideY;
+
+  SlabAllocator<TsdCell>* _pool;
 
   obfloat _cellSize;
 
@@ -90,6 +139,8 @@ private:
   obfloat _initWeight;
 
   bool _initialized;
+
+  unsigned int _modifications;
 };
 
 }
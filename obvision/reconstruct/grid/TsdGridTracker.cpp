@@ -0,0 +1,379 @@
+#include "TsdGridTracker.h"
+
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+
+#include "obcore/base/Logger.h"
+#include "obcore/base/Timer.h"
+#include "obcore/math/linalg/LinalgBackend.h"
+
+namespace obvious
+{
+
+TsdGridTracker::TsdGridTracker(TsdGrid* grid)
+{
+  _grid          = grid;
+  _fine.tsd      = NULL;
+  _maxIterations = 20;
+  _eps           = 1e-4;
+  _subsampling   = 1;
+  _huber         = 0.3;
+  _minValid      = 50;
+  _damping       = 1e-4;
+  _iterations    = 0;
+  _valid         = 0;
+  _rms           = 0.0;
+}
+
+TsdGridTracker::~TsdGridTracker()
+{
+  clearPyramid();
+}
+
+void TsdGridTracker::setMaxIterations(unsigned int iterations)
+{
+  _maxIterations = iterations;
+}
+
+void TsdGridTracker::setConvergenceThreshold(double eps)
+{
+  _eps = eps;
+}
+
+void TsdGridTracker::setSubsampling(unsigned int step)
+{
+  _subsampling = (step > 0) ? step : 1;
+}
+
+void TsdGridTracker::setHuberThreshold(double threshold)
+{
+  _huber = threshold;
+}
+
+void TsdGridTracker::setDamping(double lambda)
+{
+  _damping = lambda;
+}
+
+void TsdGridTracker::setMinValidPoints(unsigned int points)
+{
+  _minValid = points;
+}
+
+void TsdGridTracker::setCoarseToFine(unsigned int levels)
+{
+  clearPyramid();
+  if(levels==0) return;
+
+  // Cells of uninitialized partitions are undefined, they are ignored when averaging
+  _fine.cellsX      = _grid->getCellsX();
+  _fine.cellsY      = _grid->getCellsY();
+  _fine.cellSize    = _grid->getCellSize();
+  _fine.invCellSize = 1.0 / _fine.cellSize;
+  _fine.tsd         = new obfloat[_fine.cellsX * _fine.cellsY];
+  for(int i=0; i<_fine.cellsX*_fine.cellsY; i++)
+    _fine.tsd[i] = NAN;
+
+  _pyramid.resize(levels);
+  const TsdGridLevel* src = &_fine;
+  for(unsigned int l=0; l<levels; l++)
+  {
+    TsdGridLevel& dst = _pyramid[l];
+    dst.cellsX      = src->cellsX / 2;
+    dst.cellsY      = src->cellsY / 2;
+    dst.cellSize    = src->cellSize * 2.0;
+    dst.invCellSize = 1.0 / dst.cellSize;
+    dst.tsd         = new obfloat[dst.cellsX * dst.cellsY];
+    for(int i=0; i<dst.cellsX*dst.cellsY; i++)
+      dst.tsd[i] = NAN;
+    src = &dst;
+  }
+
+  // Partitions are resampled as soon as they have been modified once
+  const int dim = _grid->getPartitionSize();
+  _modifications.assign((_fine.cellsX/dim) * (_fine.cellsY/dim), 0);
+
+  updatePyramid();
+}
+
+void TsdGridTracker::clearPyramid()
+{
+  delete [] _fine.tsd;
+  _fine.tsd = NULL;
+  for(unsigned int l=0; l<_pyramid.size(); l++)
+    delete [] _pyramid[l].tsd;
+  _pyramid.clear();
+  _modifications.clear();
+}
+
+void TsdGridTracker::updatePyramid()
+{
+  if(_pyramid.size()==0) return;
+
+  Timer t;
+  t.start();
+
+  TsdGridPartition*** partitions = _grid->getPartitions();
+  const int dim = _grid->getPartitionSize();
+  const int partitionsInX = _fine.cellsX / dim;
+
+  std::vector<int> modified;
+  for(unsigned int i=0; i<_modifications.size(); i++)
+  {
+    unsigned int m = partitions[i/partitionsInX][i%partitionsInX]->getModifications();
+    if(m != _modifications[i])
+    {
+      _modifications[i] = m;
+      modified.push_back(i);
+    }
+  }
+
+  // Regions of partitions do not overlap on any level, if partitions are divisible by the downsampling factor
+  const bool disjoint = (dim % (1 << _pyramid.size())) == 0;
+
+#pragma omp parallel for schedule(dynamic) if(disjoint)
+  for(int i=0; i<(int)modified.size(); i++)
+  {
+    const int py = modified[i] / partitionsInX;
+    const int px = modified[i] % partitionsInX;
+    TsdGridPartition* part = partitions[py][px];
+    for(int y=0; y<dim; y++)
+    {
+      obfloat* row = &_fine.tsd[(py*dim+y)*_fine.cellsX + px*dim];
+      for(int x=0; x<dim; x++)
+        row[x] = (*part)(y, x);
+    }
+    resample(px*dim, py*dim, (px+1)*dim, (py+1)*dim);
+  }
+
+  LOGMSG(DBG_DEBUG, "Elapsed resampling of " << modified.size() << " partitions in " << _pyramid.size() << " pyramid levels: " << t.elapsed() << "s");
+}
+
+void TsdGridTracker::resample(int x0, int y0, int x1, int y1)
+{
+  // Each level averages defined cells of 2x2 blocks of the level below
+  const TsdGridLevel* src = &_fine;
+  for(unsigned int l=0; l<_pyramid.size(); l++)
+  {
+    TsdGridLevel& dst = _pyramid[l];
+    x0 = x0 / 2;
+    y0 = y0 / 2;
+    x1 = std::min((x1+1) / 2, dst.cellsX);
+    y1 = std::min((y1+1) / 2, dst.cellsY);
+
+    for(int y=y0; y<y1; y++)
+    {
+      for(int x=x0; x<x1; x++)
+      {
+        const obfloat* s0 = &src->tsd[(2*y)*src->cellsX + 2*x];
+        const obfloat* s1 = s0 + src->cellsX;
+        const obfloat c[4] = {s0[0], s0[1], s1[0], s1[1]};
+        obfloat sum = 0.0;
+        unsigned int cnt = 0;
+        for(unsigned int i=0; i<4; i++)
+        {
+          if(!isnan(c[i]))
+          {
+            sum += c[i];
+            cnt++;
+          }
+        }
+        dst.tsd[y*dst.cellsX+x] = (cnt>0) ? sum / (obfloat)cnt : NAN;
+      }
+    }
+    src = &dst;
+  }
+}
+
+unsigned int TsdGridTracker::getIterations()
+{
+  return _iterations;
+}
+
+unsigned int TsdGridTracker::getValidPoints()
+{
+  return _valid;
+}
+
+double TsdGridTracker::getRMS()
+{
+  return _rms;
+}
+
+EnumTsdGridInterpolate TsdGridTracker::interpolateBilinear(const TsdGridLevel& level, obfloat coord[2], obfloat* tsd, obfloat gradient[2])
+{
+  // Cell centers are located at (i+0.5)*cellSize, shift to base cell of 2x2 neighborhood
+  const obfloat fx = coord[0] * level.invCellSize - 0.5;
+  const obfloat fy = coord[1] * level.invCellSize - 0.5;
+  const int x = floor(fx);
+  const int y = floor(fy);
+
+  if((x < 0) || (x+1 >= level.cellsX) || (y < 0) || (y+1 >= level.cellsY))
+    return INTERPOLATE_INVALIDINDEX;
+
+  const obfloat dx = fx - (obfloat)x;
+  const obfloat dy = fy - (obfloat)y;
+
+  const obfloat* row = &level.tsd[y*level.cellsX + x];
+  const obfloat c00 = row[0];
+  const obfloat c01 = row[1];
+  const obfloat c10 = row[level.cellsX];
+  const obfloat c11 = row[level.cellsX+1];
+
+  const obfloat c0 = c00 + (c01-c00) * dx;
+  const obfloat c1 = c10 + (c11-c10) * dx;
+
+  *tsd = c0 + (c1-c0) * dy;
+  if(isnan(*tsd))
+    return INTERPOLATE_ISNAN;
+
+  gradient[0] = ((c01-c00) + ((c11-c10) - (c01-c00)) * dy) * level.invCellSize;
+  gradient[1] = (c1 - c0) * level.invCellSize;
+
+  return INTERPOLATE_SUCCESS;
+}
+
+unsigned int TsdGridTracker::accumulate(unsigned int level, const Transform2D& T, double* coords, unsigned int size, double A[9], double b[3], double* err)
+{
+  unsigned int valid = 0;
+  memset(A, 0, 9*sizeof(double));
+  memset(b, 0, 3*sizeof(double));
+  *err = 0.0;
+
+  // A single scan comprises a few hundred beams, threading would not pay off
+  for(unsigned int i=0; i<size; i++)
+  {
+    obfloat q[2];
+    T.transform(&coords[2*i], q);
+
+    obfloat r;
+    obfloat g[2];
+    EnumTsdGridInterpolate retval;
+    if(level==0)
+      retval = _grid->interpolateBilinear(q, &r, g);
+    else
+      retval = interpolateBilinear(_pyramid[level-1], q, &r, g);
+    if(retval!=INTERPOLATE_SUCCESS) continue;
+
+    // Saturated values lie outside of the truncation band and carry no gradient information
+    if(fabs(r) > 0.99) continue;
+
+    // Derivative of r(R(theta) * q + t) at (t, theta)=0: [g, g x q]
+    double J[3];
+    J[0] = g[0];
+    J[1] = g[1];
+    J[2] = q[0]*g[1] - q[1]*g[0];
+
+    const double w = (fabs(r) <= _huber) ? 1.0 : _huber / fabs(r);
+
+    for(unsigned int j=0; j<3; j++)
+    {
+      const double wJ = w * J[j];
+      for(unsigned int k=j; k<3; k++)
+        A[j*3+k] += wJ * J[k];
+      b[j] += wJ * r;
+    }
+    *err += r*r;
+    valid++;
+  }
+
+  // Normal equations are symmetric, only the upper triangle has been accumulated
+  A[3] = A[1];
+  A[6] = A[2];
+  A[7] = A[5];
+
+  return valid;
+}
+
+bool TsdGridTracker::track(SensorPolar2D* sensor)
+{
+  Timer t;
+  t.start();
+
+  _iterations = 0;
+  _valid      = 0;
+  _rms        = 0.0;
+
+  // Beam end points in sensor coordinate system
+  double* coords = new double[sensor->getRealMeasurementSize()*2];
+  unsigned int size = sensor->dataToCartesianVector(coords) / 2;
+
+  // Subsample in place, skip undefined measurements
+  unsigned int points = 0;
+  for(unsigned int i=0; i<size; i+=_subsampling)
+  {
+    if(isnan(coords[2*i]) || isnan(coords[2*i+1])) continue;
+    coords[2*points]   = coords[2*i];
+    coords[2*points+1] = coords[2*i+1];
+    points++;
+  }
+
+  Matrix Tsensor = sensor->getTransformation();
+  Transform2D T0(Tsensor);
+  Transform2D T = T0;
+
+  bool success = true;
+  double A[9];
+  double b[3];
+  double err;
+  for(int level=_pyramid.size(); level>=0; level--)
+  {
+    for(unsigned int i=0; i<_maxIterations; i++)
+    {
+      _valid = accumulate(level, T, coords, points, A, b, &err);
+      if(_valid < _minValid)
+      {
+        LOGMSG(DBG_DEBUG, "Too few valid points for tracking on level " << level << ": " << _valid);
+        // Coarse levels are optional, failure on the finest level is decisive
+        if(level==0) success = false;
+        break;
+      }
+      _rms = sqrt(err / (double)_valid);
+      _iterations++;
+
+      // Directions without any constraint, e.g., when observing a single line, render the normal equations singular.
+      // Such directions need not be axis-aligned, hence the smallest eigenvalue is checked, i.e., singular value of symmetric A.
+      double U[9], s[3], V[9];
+      LinalgBackend::svd(A, 3, 3, U, s, V);
+      if(s[2] <= 1e-12 * s[0])
+      {
+        LOGMSG(DBG_DEBUG, "Pose is not constrained by scene on level " << level);
+        if(level==0) success = false;
+        break;
+      }
+
+      // Solve (A + lambda*diag(A)) x = -b, Levenberg-Marquardt damping shortens steps along weakly constrained directions
+      for(unsigned int j=0; j<3; j++)
+      {
+        A[j*3+j] += _damping * A[j*3+j];
+        b[j] = -b[j];
+      }
+      Matrix M(3, 3, A);
+      double x[3];
+      M.solve(b, x);
+
+      // Increment is applied in world coordinate system
+      Transform2D dT(x[2], x[0], x[1]);
+      T = dT * T;
+
+      if(sqrt(x[0]*x[0] + x[1]*x[1] + x[2]*x[2]) < _eps) break;
+    }
+  }
+
+  delete [] coords;
+
+  if(success)
+  {
+    // Correct sensor pose with increment in sensor coordinate system, i.e., P' = P * (P^-1 * T)
+    Transform2D dT = T0.getInverse() * T;
+    Matrix Tinc = dT.toMatrix();
+    sensor->transform(&Tinc);
+  }
+
+  LOGMSG(DBG_DEBUG, "Elapsed tracking: " << t.elapsed() << "s, iterations: " << _iterations << ", valid points: " << _valid << ", rms: " << _rms);
+
+  return success;
+}
+
+}
@@ -0,0 +1,178 @@
+#ifndef TSDGRIDTRACKER_H
+#define TSDGRIDTRACKER_H
+
+#include "obcore/math/linalg/linalg.h"
+#include "obcore/math/linalg/Transform.h"
+#include "obvision/reconstruct/grid/SensorPolar2D.h"
+#include "TsdGrid.h"
+
+#include <vector>
+
+namespace obvious
+{
+
+/**
+ * @class TsdGridTracker
+ * @brief Direct scan-to-grid localization, i.e., without raycasting a model scan and without explicit correspondences.
+ * Beam end points of a laser scanner are transformed with its current pose and aligned with the zero crossing of the grid.
+ * The sum of squared bilinearly interpolated TSD values is minimized with Gauss-Newton iterations over (x, y, theta).
+ * Optionally, alignment starts on downsampled copies of the grid (coarse-to-fine), which widens the basin of convergence.
+ * @author Stefan May
+ */
+class TsdGridTracker
+{
+public:
+
+  /**
+   * Constructor
+   * @param grid grid to localize in
+   */
+  TsdGridTracker(TsdGrid* grid);
+
+  /**
+   * Destructor
+   */
+  virtual ~TsdGridTracker();
+
+  /**
+   * Set maximum number of Gauss-Newton iterations per pyramid level
+   * @param iterations maximum number of iterations (default: 20)
+   */
+  void setMaxIterations(unsigned int iterations);
+
+  /**
+   * Set convergence threshold, iterations stop if the norm of the pose update falls below
+   * @param eps threshold (default: 1e-4)
+   */
+  void setConvergenceThreshold(double eps);
+
+  /**
+   * Set subsampling of beams
+   * @param step use every step-th valid beam (default: 1)
+   */
+  void setSubsampling(unsigned int step);
+
+  /**
+   * Set threshold of robust weighting
+   * @param threshold residuals above are down-weighted, residuals are normalized by the truncation radius (default: 0.3)
+   */
+  void setHuberThreshold(double threshold);
+
+  /**
+   * Set Levenberg-Marquardt damping, i.e., lambda*diag(A) is added to the normal equations A
+   * @param lambda damping factor, larger values result in shorter but more robust steps (default: 1e-4)
+   */
+  void setDamping(double lambda);
+
+  /**
+   * Set minimum number of beams with valid TSD needed for a pose update
+   * @param points number of beams (default: 50)
+   */
+  void setMinValidPoints(unsigned int points);
+
+  /**
+   * Enable coarse-to-fine alignment. Level l has a cell size of 2^l times the cell size of the grid.
+   * Downsampled grids are created immediately, call updatePyramid when the grid has changed.
+   * @param levels number of downsampled levels, 0 disables coarse-to-fine alignment (default: 0)
+   */
+  void setCoarseToFine(unsigned int levels);
+
+  /**
+   * Resample downsampled grids from current content of grid. Only regions of partitions modified since the last call are resampled.
+   */
+  void updatePyramid();
+
+  /**
+   * Align current scan of sensor to grid. On success, the sensor pose is corrected with Sensor::transform.
+   * @param sensor sensor providing measurements and initial pose
+   * @return success, i.e., enough valid beams on the finest level
+   */
+  bool track(SensorPolar2D* sensor);
+
+  /**
+   * Get number of iterations performed in last call of track, summed up over all levels
+   * @return number of iterations
+   */
+  unsigned int getIterations();
+
+  /**
+   * Get number of beams with valid TSD in last iteration
+   * @return number of beams
+   */
+  unsigned int getValidPoints();
+
+  /**
+   * Get root mean square of TSD residuals in last iteration
+   * @return rms (normalized by truncation radius)
+   */
+  double getRMS();
+
+private:
+
+  /**
+   * Downsampled copy of grid, cells are stored row by row
+   */
+  struct TsdGridLevel
+  {
+    obfloat* tsd;
+    int cellsX;
+    int cellsY;
+    obfloat cellSize;
+    obfloat invCellSize;
+  };
+
+  /**
+   * Interpolate TSD and its gradient in downsampled grid, analog to TsdGrid::interpolateBilinear
+   */
+  EnumTsdGridInterpolate interpolateBilinear(const TsdGridLevel& level, obfloat coord[2], obfloat* tsd, obfloat gradient[2]);
+
+  /**
+   * Accumulate normal equations of Gauss-Newton step for beam end points transformed with pose T
+   * @param level pyramid level, 0 is the grid itself
+   * @return number of points with valid TSD
+   */
+  unsigned int accumulate(unsigned int level, const Transform2D& T, double* coords, unsigned int size, double A[9], double b[3], double* err);
+
+  /**
+   * Resample region of fine copy of grid up to the coarsest level
+   * @param x0 first column of region in fine copy
+   * @param y0 first row of region in fine copy
+   * @param x1 column behind region
+   * @param y1 row behind region
+   */
+  void resample(int x0, int y0, int x1, int y1);
+
+  void clearPyramid();
+
+  TsdGrid* _grid;
+
+  // Flat copy of grid, source of first downsampled level
+  TsdGridLevel _fine;
+
+  std::vector<TsdGridLevel> _pyramid;
+
+  // Modification counters of partitions at last resampling
+  std::vector<unsigned int> _modifications;
+
+  unsigned int _maxIterations;
+
+  double _eps;
+
+  unsigned int _subsampling;
+
+  double _huber;
+
+  unsigned int _minValid;
+
+  double _damping;
+
+  unsigned int _iterations;
+
+  unsigned int _valid;
+
+  double _rms;
+};
+
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include "obcore/math/mathbase.h"
 #include "obcore/base/Timer.h"
 #include "obcore/base/Logger.h"
+#include "obcore/math/linalg/Transform.h"
 
 namespace obvious
 {
@@ -42,7 +43,8 @@ void RayCast3D::calcCoordsFromCurrentPose(TsdSpace* space, Sensor* sensor, doubl
   t.start();
   *size = 0;
 
-  Matrix Tinv = sensor->getTransformation();
+  Matrix T = sensor->getTransformation();
+  Transform3D Tinv(T);
   Tinv.invert();
 
   obfloat tr[3];
@@ -93,10 +95,6 @@ void RayCast3D::calcCoordsFromCurrentPose(TsdSpace* space, Sensor* sensor, doubl
     double* n_tmp            = new double[count*3];
     unsigned char* color_tmp = new unsigned char[count*3];
     unsigned int size_tmp     = 0;
-    Matrix M(4,1);
-    Matrix N(4,1);
-    M(3,0) = 1.0;
-    N(3,0) = 0.0; // no translation for normals
 
 #pragma omp for schedule(dynamic)
     for(unsigned int i=0; i<count; i++)
@@ -109,20 +107,14 @@ void RayCast3D::calcCoordsFromCurrentPose(TsdSpace* space, Sensor* sensor, doubl
       // Raycast returns with coordinates in world coordinate system
       if(rayCastFromSensorPose(space, tr, ray, c, n, color, &depth)) // Ray returned with coordinates
       {
-        M(0,0) = c[0];
-        M(1,0) = c[1];
-        M(2,0) = c[2];
-        N(0,0) = n[0];
-        N(1,0) = n[1];
-        N(2,0) = n[2];
-        // Transform data to sensor coordinate system
-        M = Tinv * M;
-        N = Tinv * N;
+        // Transform data to sensor coordinate system, no translation for normals
+        Tinv.transform(c, c);
+        Tinv.rotate(n, n);
         for (unsigned int i = 0; i < 3; i++)
         {
-          c_tmp[size_tmp]      = M(i,0);
+          c_tmp[size_tmp]      = c[i];
           color_tmp[size_tmp]  = color[i];
-          n_tmp[size_tmp++]    = N(i,0);
+          n_tmp[size_tmp++]    = n[i];
         }
       }
     }
@@ -151,15 +143,12 @@ void RayCast3D::calcCoordsFromCurrentPoseMask(TsdSpace* space, Sensor* sensor, d
   Timer t;
   t.start();
 
-  Matrix Tinv = sensor->getTransformation();
+  Matrix T = sensor->getTransformation();
+  Transform3D Tinv(T);
   Tinv.invert();
 
   obfloat tr[3];
   sensor->getPosition(tr);
-  unsigned int ctr = 0;
-
-  unsigned int width = sensor->getWidth();
-  unsigned int height = sensor->getHeight();
 
   Matrix* R = sensor->getNormalizedRayMap(space->getVoxelSize());
   unsigned int count = sensor->getWidth() * sensor->getHeight();
@@ -195,21 +184,13 @@ void RayCast3D::calcCoordsFromCurrentPoseMask(TsdSpace* space, Sensor* sensor, d
   _idxMin = sensor->getMinimumRange() / space->getVoxelSize();
   _idxMax = sensor->getMaximumRange() / space->getVoxelSize();
 
+  // Each ray writes to its own pixel slot, i.e., no temporary buffers and no merging of thread results is needed
 #pragma omp parallel
   {
     obfloat depth = 0.0;
     obfloat c[3];
     obfloat n[3];
     unsigned char color[3]   = {255, 255, 255};
-    double* c_tmp            = new double[width*height*3];
-    double* n_tmp            = new double[width*height*3];
-    unsigned char* color_tmp = new unsigned char[width*height*3];
-    bool* mask_tmp           = new bool[width*height];
-    Matrix M(4,1);
-    Matrix N(4,1);
-    M(3,0) = 1.0;
-    N(3,0) = 0.0; // no translation for normals
-    unsigned int cnt_tmp = 0;
 
 #pragma omp for schedule(dynamic)
     for (unsigned int i=0; i<count; i++)
@@ -219,58 +200,111 @@ void RayCast3D::calcCoordsFromCurrentPoseMask(TsdSpace* space, Sensor* sensor, d
       ray[1] = (*R)(1, i);
       ray[2] = (*R)(2, i);
 
+      const unsigned int idx = 3*i;
       if(rayCastFromSensorPose(space, tr, ray, c, n, color, &depth)) // Ray returned with coordinates
       {
-        M(0,0) = c[0];
-        M(1,0) = c[1];
-        M(2,0) = c[2];
-        N(0,0) = n[0];
-        N(1,0) = n[1];
-        N(2,0) = n[2];
-        M       = Tinv * M;
-        N       = Tinv * N;
-        mask_tmp[cnt_tmp/3] = true;
-        for (unsigned int i = 0; i < 3; i++)
+        Tinv.transform(c, c);
+        Tinv.rotate(n, n);
+        mask[i] = true;
+        for (unsigned int j = 0; j < 3; j++)
         {
-          c_tmp[cnt_tmp]      = M(i,0);
-          color_tmp[cnt_tmp]  = color[i];
-          n_tmp[cnt_tmp++]    = N(i,0);
+          coords[idx+j] = c[j];
+          if(normals) normals[idx+j] = n[j];
+          if(rgb)     rgb[idx+j]     = color[j];
         }
       }
       else
       {
-        mask_tmp[cnt_tmp/3] = false;
-        for (unsigned int i = 0; i < 3; i++)
+        mask[i] = false;
+        for (unsigned int j = 0; j < 3; j++)
         {
-          c_tmp[cnt_tmp]      = 0;
-          color_tmp[cnt_tmp]  = 0;
-          n_tmp[cnt_tmp++]    = 0;
+          coords[idx+j] = 0.0;
+          if(normals) normals[idx+j] = 0.0;
+          if(rgb)     rgb[idx+j]     = 0;
         }
       }
     }
-#pragma omp critical
-    {
-      memcpy(&coords[ctr],  c_tmp,     cnt_tmp*sizeof(double));
-      memcpy(&normals[ctr], n_tmp,     cnt_tmp*sizeof(double));
-      memcpy(&rgb[ctr],     color_tmp, cnt_tmp*sizeof(unsigned char));
-      memcpy(&mask[ctr/3],  mask_tmp,  cnt_tmp/3*sizeof(bool));
-      ctr += cnt_tmp;
-    }
-    delete[] c_tmp;
-    delete[] n_tmp;
-    delete[] color_tmp;
-    delete[] mask_tmp;
   }
 
-  *size = ctr;
+  *size = 3*count;
   LOGMSG(DBG_DEBUG, "Elapsed TSDF projection: " << t.elapsed() << "ms");
-  LOGMSG(DBG_DEBUG, "Raycasting finished! Found " << ctr << " coordinates");
+  LOGMSG(DBG_DEBUG, "Raycasting finished! Organized " << count << " pixels");
 
 #if PRINTSTATISTICS
   LOGMSG(DBG_DEBUG, "Traversed: " << _traversed << ", skipped: " << _skipped);
 #endif
 }
 
+void RayCast3D::calcDepthFromPoses(TsdSpace* space, Matrix* rays, const Transform3D* poses, unsigned int poseCount, double minRange, double maxRange, double* depth)
+{
+  Timer t;
+  t.start();
+
+  const unsigned int rayCount = rays->getCols();
+
+  // Initialization of partitions does not change during rendering, gather it once for all poses.
+  // Uniform partitions are constant up to their ghost borders, which are not accessed without synchronization of borders.
+  const int partitionsX = space->getPartitionsInX();
+  const int partitionsY = space->getPartitionsInY();
+  const int partitionsZ = space->getPartitionsInZ();
+  const bool uniformSkip = (space->getBorderMode()!=BORDER_NONE);
+  TsdSpacePartition**** partitions = space->getPartitions();
+  const unsigned int partitionCount = partitionsX*partitionsY*partitionsZ;
+  bool* initialized = new bool[partitionCount];
+  obfloat* uniform  = new obfloat[partitionCount];
+  for(int pz=0; pz<partitionsZ; pz++)
+  {
+    for(int py=0; py<partitionsY; py++)
+    {
+      for(int px=0; px<partitionsX; px++)
+      {
+        TsdSpacePartition* part = partitions[pz][py][px];
+        const unsigned int i = (pz*partitionsY+py)*partitionsX+px;
+        initialized[i] = part->isInitialized();
+        // Any non-NAN value marks a uniform partition
+        uniform[i] = (uniformSkip && part->isUniform()) ? (*part)(0, 0, 0) : NAN;
+      }
+    }
+  }
+
+  // Unit directions and lengths of ray pattern
+  obfloat* dirs = new obfloat[3*rayCount];
+  obfloat* lens = new obfloat[rayCount];
+  for(unsigned int r=0; r<rayCount; r++)
+  {
+    const obfloat x = (*rays)(0, r);
+    const obfloat y = (*rays)(1, r);
+    const obfloat z = (*rays)(2, r);
+    lens[r] = sqrt(x*x + y*y + z*z);
+    dirs[3*r]   = x / lens[r];
+    dirs[3*r+1] = y / lens[r];
+    dirs[3*r+2] = z / lens[r];
+  }
+
+  // Poses and rays are processed in one loop, i.e., threads are utilized for few poses as well as for small ray patterns
+  const int count = poseCount * rayCount;
+#pragma omp parallel for schedule(dynamic, 64)
+  for(int k=0; k<count; k++)
+  {
+    const unsigned int p = k / rayCount;
+    const unsigned int r = k % rayCount;
+    const Transform3D& T = poses[p];
+
+    const obfloat pos[3] = {T(0,3), T(1,3), T(2,3)};
+    obfloat dir[3];
+    T.rotate(&dirs[3*r], dir);
+
+    depth[k] = rayCastDepth(space, initialized, uniform, pos, dir, minRange*lens[r], maxRange*lens[r]) / lens[r];
+  }
+
+  delete [] initialized;
+  delete [] uniform;
+  delete [] dirs;
+  delete [] lens;
+
+  LOGMSG(DBG_DEBUG, "Elapsed rendering of " << poseCount << " range images: " << t.elapsed() << "s");
+}
+
 /*bool RayCast3D::calcCoordsFromCurrentPose(TsdSpace* space, Sensor* sensor, double* coords, double* normals, unsigned char* rgb, const std::vector<TsdSpace*>& spaces,
     const std::vector<double>& offsets, const unsigned int u, const unsigned int v)
 {
@@ -506,12 +540,122 @@ obfloat tsd_prev;
   coordinates[1] = position[1] + ray[1] * (interp-1.0);
   coordinates[2] = position[2] + ray[2] * (interp-1.0);
 
-  if(!space->interpolateNormal(coordinates, normal))
+  if(!space->interpolateNormal(coordinates, normal, rgb))
     return false;
 
-  space->interpolateTrilinearRGB(coordinates, rgb);
-
   return true;
 }
 
+obfloat RayCast3D::rayCastDepth(TsdSpace* space, const bool* initialized, const obfloat* uniform, const obfloat pos[3], const obfloat dir[3], obfloat sMin, obfloat sMax)
+{
+  const obfloat voxelSize    = space->getVoxelSize();
+  const obfloat invVoxelSize = 1.0 / voxelSize;
+  const int dim              = space->getPartitionSize();
+  const int partitionsX      = space->getPartitionsInX();
+  const int partitionsY      = space->getPartitionsInY();
+  const int cells[3]         = {(int)space->getXDimension(), (int)space->getYDimension(), (int)space->getZDimension()};
+
+  // Clip ray to space, leave out outmost cells in order to prevent access to invalid neighbors
+  for(unsigned int i=0; i<3; i++)
+  {
+    const obfloat minCoord = 1.5*voxelSize;
+    const obfloat maxCoord = (((obfloat)cells[i])-1.5)*voxelSize;
+    if(fabs(dir[i])>10e-6)
+    {
+      obfloat s0 = (minCoord - pos[i]) / dir[i];
+      obfloat s1 = (maxCoord - pos[i]) / dir[i];
+      if(s0 > s1) swap(s0, s1);
+      sMin = max(sMin, s0);
+      sMax = min(sMax, s1);
+    }
+    else if(pos[i] < minCoord || pos[i] > maxCoord)
+    {
+      return NAN;
+    }
+  }
+
+  if(sMin >= sMax) return NAN;
+
+  // Positions in index space of trilinear interpolation, i.e., floor(u) is the base voxel of an 8-neighborhood
+  obfloat u0[3];
+  for(unsigned int i=0; i<3; i++)
+    u0[i] = pos[i] * invVoxelSize - 0.5;
+
+  obfloat tsd_prev = NAN;
+  bool near = false;
+  obfloat s;
+  for(s=sMin; s<=sMax; s+=voxelSize)
+  {
+    obfloat u[3];
+    int p[3];
+    for(unsigned int i=0; i<3; i++)
+    {
+      u[i] = u0[i] + s * dir[i] * invVoxelSize;
+      p[i] = ((int)floor(u[i])) / dim;
+    }
+
+    const unsigned int part = (p[2]*partitionsY+p[1])*partitionsX+p[0];
+    const bool skip = !initialized[part];
+    const obfloat tsdUniform = uniform[part];
+    if(!isnan(tsdUniform))
+    {
+      // Samples within uniform partition are constant, i.e., only the first one needs to be checked
+      if(near || fabs(tsdUniform)<1.0)
+      {
+        near = true;
+        if(tsd_prev > 0 && tsdUniform < 0)
+          return s - voxelSize + voxelSize * tsd_prev / (tsd_prev - tsdUniform);
+        tsd_prev = tsdUniform;
+      }
+    }
+
+    if(skip || !isnan(tsdUniform))
+    {
+      // Continue with first step behind the exit point of partition
+      obfloat exit = sMax + voxelSize;
+      for(unsigned int i=0; i<3; i++)
+      {
+        if(dir[i] > 10e-6)       exit = min(exit, ((obfloat)((p[i]+1)*dim) - u0[i]) * voxelSize / dir[i]);
+        else if(dir[i] < -10e-6) exit = min(exit, ((obfloat)(p[i]*dim) - u0[i]) * voxelSize / dir[i]);
+      }
+      obfloat next = sMin + ceil((exit - sMin) * invVoxelSize) * voxelSize;
+      if(next > s + voxelSize) s = next - voxelSize;
+      if(skip)
+      {
+        tsd_prev = NAN;
+        near = false;
+      }
+      continue;
+    }
+
+    obfloat position[3];
+    for(unsigned int i=0; i<3; i++)
+      position[i] = pos[i] + s * dir[i];
+
+    obfloat tsd;
+
+    // Quick test with nearest voxel until the truncation band is reached, analog to rayCastFromSensorPose
+    if(!near)
+    {
+      if(space->getTsd(position, &tsd)!=INTERPOLATE_SUCCESS || fabs(tsd)>=1.0)
+        continue;
+      near = true;
+    }
+
+    if(space->interpolateTrilinear(position, &tsd)!=INTERPOLATE_SUCCESS)
+    {
+      tsd_prev = NAN;
+      continue;
+    }
+
+    // Check sign change, zero crossing lies between previous and current step
+    if(tsd_prev > 0 && tsd < 0)
+      return s - voxelSize + voxelSize * tsd_prev / (tsd_prev - tsd);
+
+    tsd_prev = tsd;
+  }
+
+  return NAN;
+}
+
 }
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include "obcore/math/linalg/linalg.h"
+#include "obcore/math/linalg/Transform.h"
 #include "TsdSpace.h"
 
 namespace obvious
@@ -36,8 +37,35 @@ public:
 
 	virtual void calcCoordsFromCurrentPose(TsdSpace* space, Sensor* sensor, double* coords, double* normals, unsigned char* rgb, unsigned int* size);
 
+  /**
+   * Raycast into organized images, i.e., the result of ray i is stored at pixel slot i in the order of the sensor's ray map.
+   * Output is deterministic and can be passed directly to projective association or TriangleMesh::createMeshFromOrganizedCloud.
+   * Pixels without hit are zero and masked out.
+   * @param space space to be raycasted
+   * @param sensor sensor providing pose and rays
+   * @param[out] coords vertex image in sensor coordinate system (size: 3*width*height)
+   * @param[out] normals normal image in sensor coordinate system (size: 3*width*height), may be NULL
+   * @param[out] rgb color image (size: 3*width*height), may be NULL
+   * @param[out] mask validity of pixels (size: width*height)
+   * @param[out] size number of elements in vertex image, i.e., 3*width*height
+   */
   virtual void calcCoordsFromCurrentPoseMask(TsdSpace* space, Sensor* sensor, double* coords, double* normals, unsigned char* rgb, bool* mask, unsigned int* size);
 
+  /**
+   * Render range images of many virtual sensor poses at once, e.g., for scoring pose hypotheses in (re-)localization.
+   * The occupancy of partitions is gathered once per call and shared by all rays, uninitialized partitions are skipped as a whole.
+   * Rays of all poses are processed in parallel.
+   * @param space space to be raycasted
+   * @param rays ray pattern in sensor coordinate system, i.e., R(3, rayCount), see Sensor::getRayPattern
+   * @param poses sensor poses in world coordinate system (size: poseCount)
+   * @param poseCount number of poses
+   * @param minRange minimum range
+   * @param maxRange maximum range
+   * @param[out] depth range images, ray r of pose p is stored at depth[p*rayCount+r] in units of the ray's length, i.e.,
+   * metric distances for rays of unit length (size: poseCount*rayCount). Rays without hit are set to NAN.
+   */
+  void calcDepthFromPoses(TsdSpace* space, Matrix* rays, const Transform3D* poses, unsigned int poseCount, double minRange, double maxRange, double* depth);
+
 	/**
 	 * Overloaded method to cast a single ray trough several spaces. The method returns in case of a found coordinate or at
 	 * the end of the TsdSpace input vector.
@@ -59,6 +87,18 @@ private:
 
   bool rayCastFromSensorPose(TsdSpace* space, obfloat pos[3], obfloat ray[3], obfloat coordinates[3], obfloat normal[3], unsigned char rgb[3], obfloat* depth);
 
+  /**
+   * Find first zero crossing of TSD along ray, thread-safe, i.e., independent from the state of the instance
+   * @param initialized initialization flags of partitions, stored in order z, y, x
+   * @param uniform tsd of uniform partitions, NAN for partitions to be sampled, stored in order z, y, x
+   * @param pos ray origin
+   * @param dir ray direction of unit length
+   * @param sMin minimum distance along ray
+   * @param sMax maximum distance along ray
+   * @return distance of zero crossing along ray, NAN if not found
+   */
+  obfloat rayCastDepth(TsdSpace* space, const bool* initialized, const obfloat* uniform, const obfloat pos[3], const obfloat dir[3], obfloat sMin, obfloat sMax);
+
   obfloat _xmin;
   obfloat _ymin;
   obfloat _zmin;
@@ -68,8 +68,8 @@ void RayCastAxisAligned3D::calcCoords(TsdSpace* space, obfloat* coords, obfloat*
                     coords[(*cnt)+1] = py*cellSize + (y * p->getHeight()) * cellSize;
                     coords[(*cnt)+2] = pz*cellSize + (z * p->getDepth()) * cellSize;
                     if(normals)
-                      space->interpolateNormal(&coords[*cnt], &(normals[*cnt]));
-                    if(rgb)
+                      space->interpolateNormal(&coords[*cnt], &(normals[*cnt]), rgb ? &(rgb[*cnt]) : NULL);
+                    else if(rgb)
                       space->interpolateTrilinearRGB(&coords[*cnt], &(rgb[*cnt]));
                     (*cnt)+=3;
                     zeroCrossing[pz][py][px] = true;
@@ -102,8 +102,8 @@ void RayCastAxisAligned3D::calcCoords(TsdSpace* space, obfloat* coords, obfloat*
                     coords[(*cnt)+1] = py*cellSize + (y * p->getHeight()) * cellSize + cellSize * (interp-1.0);
                     coords[(*cnt)+2] = pz*cellSize + (z * p->getDepth()) * cellSize;
                     if(normals)
-                      space->interpolateNormal(&coords[*cnt], &(normals[*cnt]));
-                    if(rgb)
+                      space->interpolateNormal(&coords[*cnt], &(normals[*cnt]), rgb ? &(rgb[*cnt]) : NULL);
+                    else if(rgb)
                       space->interpolateTrilinearRGB(&coords[*cnt], &(rgb[*cnt]));
                     (*cnt)+=3;
                     zeroCrossing[pz][py][px] = true;
@@ -136,8 +136,8 @@ void RayCastAxisAligned3D::calcCoords(TsdSpace* space, obfloat* coords, obfloat*
                     coords[(*cnt)+1] = py*cellSize + (y * p->getHeight()) * cellSize;
                     coords[(*cnt)+2] = pz*cellSize + (z * p->getDepth()) * cellSize + cellSize * (interp-1.0);
                     if(normals)
-                      space->interpolateNormal(&coords[*cnt], &(normals[*cnt]));
-                    if(rgb)
+                      space->interpolateNormal(&coords[*cnt], &(normals[*cnt]), rgb ? &(rgb[*cnt]) : NULL);
+                    else if(rgb)
                       space->interpolateTrilinearRGB(&coords[*cnt], &(rgb[*cnt]));
                     (*cnt)+=3;
 }
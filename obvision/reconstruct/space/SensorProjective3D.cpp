@@ -2,6 +2,8 @@
 
 #include "obcore/base/System.h"
 #include "obcore/math/mathbase.h"
+#include "obcore/math/linalg/MatrixView.h"
+#include "obcore/math/linalg/Transform.h"
 
 namespace obvious
 {
@@ -39,7 +41,8 @@ void SensorProjective3D::init(unsigned int cols, unsigned int rows, double PData
     for(unsigned int col=0; col<_width; col++, i++)
     {
       Matrix ray(3, 1);
-      project2Space(col, row, 1.0, &ray);
+      // Rows are stored bottom-up, i.e., consistent with the indexing of backProject
+      project2Space(col, (_height-1)-row, 1.0, &ray);
       // Normalize ray to 1.0
       double len = sqrt(ray(0,0)*ray(0,0) + ray(1,0)*ray(1,0) + ray(2,0)*ray(2,0));
       (*_rays)(0, i) = ray(0, 0) / len;
@@ -77,30 +80,53 @@ void SensorProjective3D::project2Space(const unsigned int col, const unsigned in
   (*coord)(2, 0) = depth;
 }
 
+Matrix SensorProjective3D::getProjectionMatrix()
+{
+  Matrix P = *_P;
+  return P;
+}
+
 void SensorProjective3D::backProject(Matrix* M, int* indices, Matrix* T)
 {
-  //Matrix PoseInv = (*_Pose);
-  Matrix PoseInv = getTransformation();
+  Matrix Pose = getTransformation();
+  Transform3D PoseInv(Pose);
   PoseInv.invert();
 
   // Provide temporary transformation of voxelCoords, i.e. shift of coordinate system (partitioning)
   if(T)
-    PoseInv *= *T;
+    PoseInv *= Transform3D(*T);
 
-  Matrix Pgen(3, 4);
-  Pgen = (*_P) * PoseInv;
+  // Pgen = P * Tinv * Ttmp, accumulated on the stack
+  double P[12];
+  _P->getData(P);
+  double Pgen[12];
+  for(unsigned int r=0; r<3; r++)
+  {
+    for(unsigned int c=0; c<4; c++)
+      Pgen[r*4+c] = P[r*4]*PoseInv(0,c) + P[r*4+1]*PoseInv(1,c) + P[r*4+2]*PoseInv(2,c);
+    Pgen[r*4+3] += P[r*4+3];
+  }
 
-  // coords2D = P * Tinv * Ttmp * voxelCoords
-  Matrix coords2D = Matrix::multiply(Pgen, *M, false, true);
+  // Homogeneous voxel coordinates are accessed in place, i.e., without intermediate matrix of 2D coordinates
+  MatrixView view(M);
+  unsigned int stride;
+  const double* x = view.getColumn(0, &stride);
+  const double* y = view.getColumn(1, &stride);
+  const double* z = view.getColumn(2, &stride);
+  const double* w = view.getColumn(3, &stride);
 
   for(unsigned int i=0; i<M->getRows(); i++)
   {
+    const unsigned int k = i*stride;
     indices[i] = -1;
-    if(coords2D(2,i) > 0.0)
+    const double dw = Pgen[8]*x[k] + Pgen[9]*y[k] + Pgen[10]*z[k] + Pgen[11]*w[k];
+    if(dw > 0.0)
     {
-      const double inv_dw = 1.0 / coords2D(2,i);
-      const unsigned int u = static_cast<unsigned int>(coords2D(0,i)*inv_dw + 0.5);
-      const unsigned int v = static_cast<unsigned int>(coords2D(1,i)*inv_dw + 0.5);
+      const double inv_dw = 1.0 / dw;
+      const double du = Pgen[0]*x[k] + Pgen[1]*y[k] + Pgen[2]*z[k] + Pgen[3]*w[k];
+      const double dv = Pgen[4]*x[k] + Pgen[5]*y[k] + Pgen[6]*z[k] + Pgen[7]*w[k];
+      const unsigned int u = static_cast<unsigned int>(du*inv_dw + 0.5);
+      const unsigned int v = static_cast<unsigned int>(dv*inv_dw + 0.5);
 
       if(u < _width && v < _height && _mask[((_height - 1) - v) * _width + u])
       {
@@ -111,4 +137,36 @@ void SensorProjective3D::backProject(Matrix* M, int* indices, Matrix* T)
   }
 }
 
+bool SensorProjective3D::getFrustum(vector<double> &vertices)
+{
+  vertices.clear();
+  if(isinf(_maxRange)) return false;
+
+  double fx = (*_P)(0,0);
+  double fy = (*_P)(1,1);
+  double tx = (*_P)(0,2);
+  double ty = (*_P)(1,2);
+
+  // Points are distant at least by their depth, i.e., depth = maximum range bounds the field of view.
+  // Image borders are extended by half a pixel due to rounding in backProject.
+  double depth = _maxRange;
+  double xMin = depth * (-0.5 - tx) / fx;
+  double xMax = depth * ((double)_width - 0.5 - tx) / fx;
+  double yMin = depth * (-0.5 - ty) / fy;
+  double yMax = depth * ((double)_height - 0.5 - ty) / fy;
+
+  double local[5][3] = {{0.0,  0.0,  0.0},
+                        {xMin, yMin, depth},
+                        {xMax, yMin, depth},
+                        {xMin, yMax, depth},
+                        {xMax, yMax, depth}};
+
+  for(unsigned int i=0; i<5; i++)
+  {
+    for(unsigned int r=0; r<3; r++)
+      vertices.push_back((*_T)(r,0)*local[i][0] + (*_T)(r,1)*local[i][1] + (*_T)(r,2)*local[i][2] + (*_T)(r,3));
+  }
+  return true;
+}
+
 }
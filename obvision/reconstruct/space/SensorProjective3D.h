@@ -45,6 +45,12 @@ public:
    */
   void project2Space(const unsigned int col, const unsigned int row, const double depth, Matrix* coord);
 
+  /**
+   * Accessor to projection matrix
+   * @return 3x4 projection matrix
+   */
+  Matrix getProjectionMatrix();
+
   /**
    * Parallel version of back projection
    * @param[in] M matrix of homogeneous 3D coordinates
@@ -53,6 +59,13 @@ public:
    */
   void backProject(Matrix* M, int* indices, Matrix* T=NULL);
 
+  /**
+   * Get viewing pyramid, i.e., sensor position and corners of image plane at the depth of maximum range
+   * @param[out] vertices 5 vertices in world coordinate frame (layout x1y1z1x2...)
+   * @return true if maximum range is finite
+   */
+  bool getFrustum(vector<double> &vertices);
+
 private:
 
   void init(unsigned int cols, unsigned int rows, double PData[12]);
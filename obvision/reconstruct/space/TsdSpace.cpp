@@ -9,6 +9,10 @@
 #include <cstring>
 #include <cmath>
 #include <omp.h>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace obvious
 {
@@ -42,6 +46,8 @@ TsdSpace::TsdSpace(const double voxelSize, const EnumTsdSpaceLayout layoutPartit
 
   unsigned int dimPartition = (unsigned int)pow(2.0, layoutPartition);
 
+  _pool = NULL;
+
   if(dimPartition > _cellsX)
   {
     LOGMSG(DBG_ERROR, "Insufficient partition size : " << dimPartition << "x" << dimPartition << "x" << dimPartition << " in "
@@ -63,6 +69,13 @@ TsdSpace::TsdSpace(const double voxelSize, const EnumTsdSpaceLayout layoutPartit
 
   _maxTruncation = 2.0*voxelSize;
 
+  _borderMode = BORDER_FULL;
+
+  _integration = INTEGRATION_SIMD;
+
+  _cache = NULL;
+  _budgetPartitions = 0;
+
   LOGMSG(DBG_DEBUG, "Dimensions are (x/y/z) (" << _cellsX << "/" << _cellsY << "/" << _cellsZ << ")");
   LOGMSG(DBG_DEBUG, "Creating TsdVoxel Space...");
 
@@ -77,13 +90,18 @@ TsdSpace::TsdSpace(const double voxelSize, const EnumTsdSpaceLayout layoutPartit
   LOGMSG(DBG_DEBUG, "Spanning area: " << _maxX << " " << _maxY << " " << _maxZ << endl;)
   System<TsdSpacePartition*>::allocate(_partitionsInZ, _partitionsInY, _partitionsInX, _partitions);
 
+  // Voxel blocks of partitions including ghost borders, slabs of about 4MB
+  unsigned int blockSize = (dimPartition+1)*(dimPartition+1)*(dimPartition+1);
+  unsigned int blocksPerSlab = max(1u, (unsigned int)((1<<22) / (blockSize*sizeof(TsdVoxel))));
+  _pool = new SlabAllocator<TsdVoxel>(blockSize, blocksPerSlab);
+
   for(int pz=0; pz<_partitionsInZ; pz++)
   {
     for(int py=0; py<_partitionsInY; py++)
     {
       for(int px=0; px<_partitionsInX; px++)
       {
-        _partitions[pz][py][px] = new TsdSpacePartition(px*dimPartition, py*dimPartition, pz*dimPartition, dimPartition, dimPartition, dimPartition, voxelSize);
+        _partitions[pz][py][px] = new TsdSpacePartition(px*dimPartition, py*dimPartition, pz*dimPartition, dimPartition, dimPartition, dimPartition, voxelSize, _pool);
       }
     }
   }
@@ -104,6 +122,8 @@ TsdSpace::~TsdSpace(void)
 {
   delete _tree;
   System<TsdSpacePartition*>::deallocate(_partitions);
+  delete _pool;
+  delete _cache;
   delete [] _lutIndex2Partition;
   delete [] _lutIndex2Cell;
 }
@@ -144,12 +164,12 @@ int TsdSpace::getPartitionsInX()
 
 int TsdSpace::getPartitionsInY()
 {
-  return _partitionsInX;
+  return _partitionsInY;
 }
 
 int TsdSpace::getPartitionsInZ()
 {
-  return _partitionsInX;
+  return _partitionsInZ;
 }
 
 obfloat TsdSpace::getVoxelSize()
@@ -215,6 +235,109 @@ double TsdSpace::getMaxTruncation()
   return _maxTruncation;
 }
 
+void TsdSpace::setBorderMode(const EnumTsdSpaceBorder mode)
+{
+  _borderMode = mode;
+}
+
+EnumTsdSpaceBorder TsdSpace::getBorderMode()
+{
+  return _borderMode;
+}
+
+void TsdSpace::setIntegration(const EnumTsdSpaceIntegration integration)
+{
+  _integration = integration;
+}
+
+EnumTsdSpaceIntegration TsdSpace::getIntegration()
+{
+  return _integration;
+}
+
+static bool compareLastAccess(TsdSpacePartition* p1, TsdSpacePartition* p2)
+{
+  return p1->getLastAccess() < p2->getLastAccess();
+}
+
+void TsdSpace::setMemoryBudget(size_t bytes, const char* filename)
+{
+  // Reload evicted partitions before the cache is replaced
+  for(int pz=0; pz<_partitionsInZ; pz++)
+    for(int py=0; py<_partitionsInY; py++)
+      for(int px=0; px<_partitionsInX; px++)
+        _partitions[pz][py][px]->setCache(NULL);
+  delete _cache;
+  _cache = NULL;
+  _budgetPartitions = 0;
+
+  if(bytes==0) return;
+
+  _cache = new TsdSpaceCache(filename);
+  if(!_cache->isOpen())
+  {
+    delete _cache;
+    _cache = NULL;
+    return;
+  }
+
+  for(int pz=0; pz<_partitionsInZ; pz++)
+    for(int py=0; py<_partitionsInY; py++)
+      for(int px=0; px<_partitionsInX; px++)
+        _partitions[pz][py][px]->setCache(_cache);
+
+  const unsigned int dim = getPartitionSize() + 1;
+  _budgetPartitions = max((size_t)1, bytes / (dim*dim*dim*sizeof(TsdVoxel)));
+  LOGMSG(DBG_DEBUG, "Memory budget: " << _budgetPartitions << " partitions");
+
+  enforceMemoryBudget();
+}
+
+void TsdSpace::enforceMemoryBudget()
+{
+  if(!_cache) return;
+
+  vector<TsdSpacePartition*> resident;
+  for(int pz=0; pz<_partitionsInZ; pz++)
+  {
+    for(int py=0; py<_partitionsInY; py++)
+    {
+      for(int px=0; px<_partitionsInX; px++)
+      {
+        TsdSpacePartition* part = _partitions[pz][py][px];
+        if(part->_space) resident.push_back(part);
+      }
+    }
+  }
+
+  if(resident.size() > _budgetPartitions)
+  {
+    // Least recently touched partitions are evicted first
+    std::stable_sort(resident.begin(), resident.end(), compareLastAccess);
+    for(size_t i=0; i<resident.size()-_budgetPartitions; i++)
+      resident[i]->evict();
+    LOGMSG(DBG_DEBUG, "Evicted partitions: " << resident.size()-_budgetPartitions << ", cache hits/misses/evictions: "
+           << _cache->getHits() << "/" << _cache->getMisses() << "/" << _cache->getEvictions());
+  }
+
+  _cache->advance();
+}
+
+unsigned long TsdSpace::getCacheHits()
+{
+  return _cache ? _cache->getHits() : 0;
+}
+
+unsigned long TsdSpace::getCacheMisses()
+{
+  return _cache ? _cache->getMisses() : 0;
+}
+
+unsigned long TsdSpace::getCacheEvictions()
+{
+  return _cache ? _cache->getEvictions() : 0;
+}
+
 TsdSpacePartition**** TsdSpace::getPartitions()
 {
   return _partitions;
@@ -279,77 +402,106 @@ void TsdSpace::push(Sensor* sensor)
   bool* mask = sensor->getRealMeasurementMask();
   unsigned char* rgb = sensor->getRealMeasurementRGB();
 
+  // Weights are computed once per frame, NULL for constant weighting
+  double* weights = sensor->getRealMeasurementWeights();
+
   obfloat tr[3];
   sensor->getPosition(tr);
 
   Matrix* partCoords = TsdSpacePartition::getPartitionCoords();
   Matrix* cellCoordsHom = TsdSpacePartition::getCellCoordsHom();
 
+  // Build range pyramid once, partitions query it concurrently
+  sensor->getRangePyramid();
+
+  vector<TsdSpacePartition*> partitionsInView;
+  enumeratePartitions(sensor, partitionsInView);
+
+  // Projection of world coordinates to image for SIMD kernel
+  double Pgen[12];
+  bool simd = initProjective(sensor, Pgen);
+
 #pragma omp parallel
   {
     unsigned int partSize = (_partitions[0][0][0])->getSize();
     int* idx = new int[partSize];
+    vector<TsdSpacePartition*> modified;
 #pragma omp for schedule(dynamic)
-    for(int pz=0; pz<_partitionsInZ; pz++)
+    for(unsigned int i=0; i<partitionsInView.size(); i++)
     {
-      for(int py=0; py<_partitionsInY; py++)
+      TsdSpacePartition* part = partitionsInView[i];
+      if(!part->isInRange(tr, sensor, _maxTruncation))
       {
-        for(int px=0; px<_partitionsInX; px++)
-        {
-          TsdSpacePartition* part = _partitions[pz][py][px];
-          if(!part->isInRange(tr, sensor, _maxTruncation)) continue;
+        // Emptiness might have been increased
+        if(part->_modified) modified.push_back(part);
+        continue;
+      }
 
-          obfloat t[3];
-          part->getCellCoordsOffset(t);
-          Matrix T = MatrixFactory::TranslationMatrix44(t[0], t[1], t[2]);
-          sensor->backProject(cellCoordsHom, idx, &T);
+      if(simd)
+      {
+        pushProjective(part, Pgen, tr, sensor);
+        if(part->_modified) modified.push_back(part);
+        continue;
+      }
 
-          for(unsigned int c=0; c<partSize; c++)
+      obfloat t[3];
+      part->getCellCoordsOffset(t);
+      Matrix T = MatrixFactory::TranslationMatrix44(t[0], t[1], t[2]);
+      sensor->backProject(cellCoordsHom, idx, &T);
+
+      for(unsigned int c=0; c<partSize; c++)
+      {
+        // Measurement index
+        int index = idx[c];
+
+        if(index>=0)
+        {
+          if(mask[index])
           {
-            // Measurement index
-            int index = idx[c];
+            // calculate distance of current cell to sensor
+            obfloat crd[3];
+            crd[0] = (*cellCoordsHom)(c,0) + t[0];
+            crd[1] = (*cellCoordsHom)(c,1) + t[1];
+            crd[2] = (*cellCoordsHom)(c,2) + t[2];
+            obfloat distance = euklideanDistance<obfloat>(tr, crd, 3);
+            obfloat sd = data[index] - distance;
+
+            // Test with distance-related weighting
+            /*double weight = 1.0 - (10.0 - distance);
+          weight = max(weight, 0.1);*/
 
-            if(index>=0)
+            unsigned char* color = NULL;
+            if(rgb) color = &(rgb[3*index]);
+            obfloat w = weights ? weights[index] : TSDINC;
+            if(sd >= -_maxTruncation && w > 0.0)
             {
-              if(mask[index])
-              {
-                // calculate distance of current cell to sensor
-                obfloat crd[3];
-                crd[0] = (*cellCoordsHom)(c,0) + t[0];
-                crd[1] = (*cellCoordsHom)(c,1) + t[1];
-                crd[2] = (*cellCoordsHom)(c,2) + t[2];
-                obfloat distance = euklideanDistance<obfloat>(tr, crd, 3);
-                obfloat sd = data[index] - distance;
-
-                // Test with distance-related weighting
-                /*double weight = 1.0 - (10.0 - distance);
-              weight = max(weight, 0.1);*/
-
-                unsigned char* color = NULL;
-                if(rgb) color = &(rgb[3*index]);
-                if(sd >= -_maxTruncation)
-                {
-                  part->init();
-                  part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), (*partCoords)(c, 2), sd, _maxTruncation, color);
+              part->init();
+              part->_modified = true;
+              part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), (*partCoords)(c, 2), sd, _maxTruncation, color, w);
 
 #if PRINTSTATISTICS
 #pragma omp critical
-                  {
-                    _distancesPushed++;
-                  }
-#endif
-                }
+              {
+                _distancesPushed++;
               }
+#endif
             }
           }
         }
       }
+      if(part->_modified) modified.push_back(part);
     }
     delete [] idx;
+#pragma omp critical
+    {
+      _partitionsModified.insert(_partitionsModified.end(), modified.begin(), modified.end());
+    }
   }
 
   propagateBorders();
 
+  enforceMemoryBudget();
+
 #if PRINTSTATISTICS
   LOGMSG(DBG_DEBUG, "Distances pushed: " << _distancesPushed);
 #endif
@@ -366,9 +518,14 @@ void TsdSpace::pushTree(Sensor* sensor)
   bool* mask = sensor->getRealMeasurementMask();
   unsigned char* rgb = sensor->getRealMeasurementRGB();
 
+  // Weights are computed once per frame, NULL for constant weighting
+  double* weights = sensor->getRealMeasurementWeights();
+
   obfloat tr[3];
   sensor->getPosition(tr);
 
+  sensor->getRangePyramid();
+
   TsdSpaceComponent* comp = _tree;
   vector<TsdSpacePartition*> partitionsToCheck;
   pushRecursion(sensor, tr, comp, partitionsToCheck);
@@ -378,15 +535,26 @@ void TsdSpace::pushTree(Sensor* sensor)
   Matrix* partCoords = TsdSpacePartition::getPartitionCoords();
   Matrix* cellCoordsHom = TsdSpacePartition::getCellCoordsHom();
 
+  double Pgen[12];
+  bool simd = initProjective(sensor, Pgen);
+
 #pragma omp parallel
   {
     unsigned int partSize = (_partitions[0][0][0])->getSize();
     int* idx = new int[partSize];
+    vector<TsdSpacePartition*> modified;
 #pragma omp for schedule(dynamic)
     for(unsigned int i=0; i<partitionsToCheck.size(); i++)
     {
       TsdSpacePartition* part = partitionsToCheck[i];
 
+      if(simd)
+      {
+        pushProjective(part, Pgen, tr, sensor);
+        if(part->_modified) modified.push_back(part);
+        continue;
+      }
+
       obfloat t[3];
       part->getCellCoordsOffset(t);
       Matrix T = MatrixFactory::TranslationMatrix44(t[0], t[1], t[2]);
@@ -415,10 +583,12 @@ void TsdSpace::pushTree(Sensor* sensor)
 
             unsigned char* color = NULL;
             if(rgb) color = &(rgb[3*index]);
-            if(sd >= -_maxTruncation)
+            obfloat w = weights ? weights[index] : TSDINC;
+            if(sd >= -_maxTruncation && w > 0.0)
             {
               part->init();
-              part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), (*partCoords)(c, 2), sd, _maxTruncation, color);
+              part->_modified = true;
+              part->addTsd((*partCoords)(c, 0), (*partCoords)(c, 1), (*partCoords)(c, 2), sd, _maxTruncation, color, w);
 
 #if PRINTSTATISTICS
 #pragma omp critical
@@ -431,12 +601,19 @@ void TsdSpace::pushTree(Sensor* sensor)
           }
         }
       }
+      if(part->_modified) modified.push_back(part);
     }
     delete [] idx;
+#pragma omp critical
+    {
+      _partitionsModified.insert(_partitionsModified.end(), modified.begin(), modified.end());
+    }
   }
 
   propagateBorders();
 
+  enforceMemoryBudget();
+
 #if PRINTSTATISTICS
   LOGMSG(DBG_DEBUG, "Distances pushed: " << _distancesPushed);
 #endif
@@ -444,216 +621,613 @@ void TsdSpace::pushTree(Sensor* sensor)
   LOGMSG(DBG_DEBUG, "Elapsed push: " << timer.elapsed() << "s, Initialized partitions: " << TsdSpacePartition::getInitializedPartitionSize());
 }
 
-void TsdSpace::pushRecursion(Sensor* sensor, obfloat pos[3], TsdSpaceComponent* comp, vector<TsdSpacePartition*> &partitionsToCheck)
+bool TsdSpace::initProjective(Sensor* sensor, double Pgen[12])
 {
-  if(comp->isInRange(pos, sensor, _maxTruncation))
+#ifdef __SSE2__
+  if(_integration!=INTEGRATION_SIMD) return false;
+
+  SensorProjective3D* projective = dynamic_cast<SensorProjective3D*>(sensor);
+  if(!projective) return false;
+
+  Matrix Tinv = sensor->getTransformation();
+  Tinv.invert();
+  Matrix P = projective->getProjectionMatrix() * Tinv;
+  P.getData(Pgen);
+  return true;
+#else
+  return false;
+#endif
+}
+
+#ifdef __SSE2__
+
+/**
+ * Weighted running average of voxel, equal to TsdSpacePartition::addTsd
+ */
+static inline void updateVoxel(TsdVoxel* voxel, const obfloat tsd, const unsigned char* rgb, const obfloat weight)
+{
+  voxel->weight += weight;
+  if(isnan(voxel->tsd))
   {
-    if(comp->isLeaf())
-      partitionsToCheck.push_back((TsdSpacePartition*)comp);
-    else
+    voxel->tsd = tsd;
+    if(rgb)
     {
-      vector<TsdSpaceComponent*> children = ((TsdSpaceBranch*)comp)->getChildren();
-      for(unsigned int i=0; i<children.size(); i++)
-        pushRecursion(sensor, pos, children[i], partitionsToCheck);
+      voxel->rgb[0] = rgb[0];
+      voxel->rgb[1] = rgb[1];
+      voxel->rgb[2] = rgb[2];
+    }
+  }
+  else
+  {
+    voxel->weight = min(voxel->weight, TSDSPACEMAXWEIGHT);
+    voxel->tsd    = (voxel->tsd * (voxel->weight - weight) + tsd * weight) / voxel->weight;
+    if(rgb)
+    {
+      voxel->rgb[0] = (voxel->rgb[0] * (voxel->weight - weight) + rgb[0] * weight) / voxel->weight;
+      voxel->rgb[1] = (voxel->rgb[1] * (voxel->weight - weight) + rgb[1] * weight) / voxel->weight;
+      voxel->rgb[2] = (voxel->rgb[2] * (voxel->weight - weight) + rgb[2] * weight) / voxel->weight;
     }
   }
 }
 
-void TsdSpace::propagateBorders()
+#if _OBVIOUS_DOUBLE_PRECISION_
+/**
+ * Weighted running average of two voxels in SSE2 lanes, equal to two calls of updateVoxel
+ */
+static inline void updateVoxels(TsdVoxel* a, TsdVoxel* b, const double tsdA, const double tsdB, const unsigned char* rgbA, const unsigned char* rgbB,
+                                const double weightA, const double weightB)
 {
-  unsigned int width  = _partitions[0][0][0]->getWidth();
-  unsigned int height = _partitions[0][0][0]->getHeight();
-  unsigned int depth = _partitions[0][0][0]->getDepth();
-
-  // Copy valid tsd values of neighbors to borders of each partition.
-  for(int pz=0; pz<_partitionsInZ; pz++)
+  const __m128d inc = _mm_set_pd(weightB, weightA);
+  __m128d tsdOld  = _mm_set_pd(b->tsd, a->tsd);
+  __m128d tsdNew  = _mm_set_pd(tsdB, tsdA);
+  __m128d weight  = _mm_add_pd(_mm_set_pd(b->weight, a->weight), inc);
+  __m128d isNan   = _mm_cmpunord_pd(tsdOld, tsdOld);
+  __m128d wClip   = _mm_min_pd(weight, _mm_set1_pd(TSDSPACEMAXWEIGHT));
+  __m128d average = _mm_div_pd(_mm_add_pd(_mm_mul_pd(tsdOld, _mm_sub_pd(wClip, inc)), _mm_mul_pd(tsdNew, inc)), wClip);
+  __m128d tsd     = _mm_or_pd(_mm_and_pd(isNan, tsdNew), _mm_andnot_pd(isNan, average));
+  weight          = _mm_or_pd(_mm_and_pd(isNan, weight), _mm_andnot_pd(isNan, wClip));
+
+  double t[2];
+  double w[2];
+  _mm_storeu_pd(t, tsd);
+  _mm_storeu_pd(w, weight);
+  int nanMask = _mm_movemask_pd(isNan);
+
+  TsdVoxel* voxel[2] = {a, b};
+  const unsigned char* rgb[2] = {rgbA, rgbB};
+  const double wInc[2] = {weightA, weightB};
+  for(unsigned int i=0; i<2; i++)
   {
-    for(int py=0; py<_partitionsInY; py++)
+    voxel[i]->tsd    = t[i];
+    voxel[i]->weight = w[i];
+    if(rgb[i])
     {
-      for(int px=0; px<_partitionsInX; px++)
+      if(nanMask & (1<<i))
+      {
+        voxel[i]->rgb[0] = rgb[i][0];
+        voxel[i]->rgb[1] = rgb[i][1];
+        voxel[i]->rgb[2] = rgb[i][2];
+      }
+      else
       {
-        TsdSpacePartition* partCur       = _partitions[pz][py][px];
+        voxel[i]->rgb[0] = (voxel[i]->rgb[0] * (w[i] - wInc[i]) + rgb[i][0] * wInc[i]) / w[i];
+        voxel[i]->rgb[1] = (voxel[i]->rgb[1] * (w[i] - wInc[i]) + rgb[i][1] * wInc[i]) / w[i];
+        voxel[i]->rgb[2] = (voxel[i]->rgb[2] * (w[i] - wInc[i]) + rgb[i][2] * wInc[i]) / w[i];
+      }
+    }
+  }
+}
+#endif
+
+void TsdSpace::pushProjective(TsdSpacePartition* part, const double Pgen[12], const obfloat tr[3], Sensor* sensor)
+{
+  double* data       = sensor->getRealMeasurementData();
+  bool* mask         = sensor->getRealMeasurementMask();
+  unsigned char* rgb = sensor->getRealMeasurementRGB();
+  double* weights    = sensor->getRealMeasurementWeights();
+  const int width    = sensor->getWidth();
+  const int height   = sensor->getHeight();
+
+  const unsigned int cellsX = part->getWidth();
+  const unsigned int cellsY = part->getHeight();
+  const unsigned int cellsZ = part->getDepth();
+
+  part->touch();
+
+  obfloat t[3];
+  part->getCellCoordsOffset(t);
+
+  const double s = _voxelSize;
+
+  // Lane constants, computations are carried out in double precision like in SensorProjective3D::backProject,
+  // i.e., voxels close to pixel boundaries are assigned to the same measurement as by the scalar kernel
+  const __m128d lane     = _mm_set_pd(1.0, 0.0);
+  const __m128d zero     = _mm_setzero_pd();
+  const __m128d one      = _mm_set1_pd(1.0);
+  const __m128d half     = _mm_set1_pd(0.5);
+  const __m128d minusOne = _mm_set1_pd(-1.0);
+  const __m128d w        = _mm_set1_pd((double)width);
+  const __m128d h        = _mm_set1_pd((double)height);
+  const __m128d hMinus1  = _mm_set1_pd((double)(height-1));
+  const __m128d cells    = _mm_set1_pd((double)cellsX);
+  const __m128d dhx      = _mm_set1_pd(Pgen[0]*s);
+  const __m128d dhy      = _mm_set1_pd(Pgen[4]*s);
+  const __m128d dhz      = _mm_set1_pd(Pgen[8]*s);
+  const __m128d ds       = _mm_set1_pd(s);
+  const __m128d negTrunc = _mm_set1_pd(-_maxTruncation);
+  const __m128d trunc    = _mm_set1_pd(_maxTruncation);
+  const __m128d tsdMax   = _mm_set1_pd(TSDINC);
+
+  int idx[4];
+  double sdIn[2];
+  double tsdOut[2];
+
+  for(unsigned int iz=0; iz<cellsZ; iz++)
+  {
+    const double cz = t[2] + ((double)iz + 0.5) * s;
+    for(unsigned int iy=0; iy<cellsY; iy++)
+    {
+      const double cy  = t[1] + ((double)iy + 0.5) * s;
+      const double cx0 = t[0] + 0.5 * s;
 
-        if(!partCur->isInitialized()) continue;
+      // Homogeneous image coordinates are affine along the row of voxels
+      const __m128d h0x = _mm_set1_pd(Pgen[0]*cx0 + Pgen[1]*cy + Pgen[2]*cz  + Pgen[3]);
+      const __m128d h0y = _mm_set1_pd(Pgen[4]*cx0 + Pgen[5]*cy + Pgen[6]*cz  + Pgen[7]);
+      const __m128d h0z = _mm_set1_pd(Pgen[8]*cx0 + Pgen[9]*cy + Pgen[10]*cz + Pgen[11]);
+      const __m128d dx0 = _mm_set1_pd(cx0 - tr[0]);
+      const __m128d dyz = _mm_set1_pd((cy - tr[1])*(cy - tr[1]) + (cz - tr[2])*(cz - tr[2]));
 
-        if(px<_partitionsInX-1)
+      TsdVoxel* row = part->_space ? &part->at(iz, iy, 0) : NULL;
+
+      for(unsigned int ix=0; ix<cellsX; ix+=2)
+      {
+        __m128d i  = _mm_add_pd(_mm_set1_pd((double)ix), lane);
+        __m128d hx = _mm_add_pd(h0x, _mm_mul_pd(i, dhx));
+        __m128d hy = _mm_add_pd(h0y, _mm_mul_pd(i, dhy));
+        __m128d hz = _mm_add_pd(h0z, _mm_mul_pd(i, dhz));
+
+        // Projection test, equal to SensorProjective3D::backProject (truncation of rounded coordinates)
+        __m128d valid = _mm_and_pd(_mm_cmpgt_pd(hz, zero), _mm_cmplt_pd(i, cells));
+        __m128d invZ  = _mm_div_pd(one, hz);
+        __m128d u = _mm_add_pd(_mm_mul_pd(hx, invZ), half);
+        __m128d v = _mm_add_pd(_mm_mul_pd(hy, invZ), half);
+        valid = _mm_and_pd(valid, _mm_and_pd(_mm_cmpgt_pd(u, minusOne), _mm_cmplt_pd(u, w)));
+        valid = _mm_and_pd(valid, _mm_and_pd(_mm_cmpgt_pd(v, minusOne), _mm_cmplt_pd(v, h)));
+        int lanes = _mm_movemask_pd(valid);
+        if(!lanes) continue;
+
+        // Measurement index ((height-1)-v)*width+u
+        __m128d ui = _mm_cvtepi32_pd(_mm_cvttpd_epi32(u));
+        __m128d vi = _mm_cvtepi32_pd(_mm_cvttpd_epi32(v));
+        __m128d index = _mm_add_pd(_mm_mul_pd(_mm_sub_pd(hMinus1, vi), w), ui);
+        _mm_storeu_si128((__m128i*)idx, _mm_cvtpd_epi32(_mm_and_pd(index, valid)));
+
+        // Distance of voxel centers to sensor
+        __m128d dx = _mm_add_pd(dx0, _mm_mul_pd(i, ds));
+        __m128d distance = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), dyz));
+
+        // Gather measurements
+        for(unsigned int l=0; l<2; l++)
         {
-          TsdSpacePartition* partRight      = _partitions[pz][py][px+1];
-          if(partRight->isInitialized())
+          if((lanes & (1<<l)) && mask[idx[l]] && (!weights || weights[idx[l]] > 0.0))
+            sdIn[l] = data[idx[l]];
+          else
           {
-            for(unsigned int d=0; d<depth; d++)
-            {
-              for(unsigned int h=0; h<height; h++)
-              {
-                partCur->_space[d][h][width].tsd = partRight->_space[d][h][0].tsd;
-                partCur->_space[d][h][width].weight = partRight->_space[d][h][0].weight;
-                partCur->_space[d][h][width].rgb[0] = partRight->_space[d][h][0].rgb[0];
-                partCur->_space[d][h][width].rgb[1] = partRight->_space[d][h][0].rgb[1];
-                partCur->_space[d][h][width].rgb[2] = partRight->_space[d][h][0].rgb[2];
-              }
-            }
+            lanes &= ~(1<<l);
+            sdIn[l] = 0.0;
           }
         }
+        if(!lanes) continue;
 
-        if(py<_partitionsInY-1)
+        // Signed distance, truncation mask and normalization
+        __m128d sd = _mm_sub_pd(_mm_loadu_pd(sdIn), distance);
+        valid = _mm_cmpge_pd(sd, negTrunc);
+        lanes &= _mm_movemask_pd(valid);
+        if(!lanes) continue;
+        _mm_storeu_pd(tsdOut, _mm_min_pd(_mm_div_pd(sd, trunc), tsdMax));
+
+        if(!row)
         {
-          TsdSpacePartition* partUp      = _partitions[pz][py+1][px];
-          if(partUp->isInitialized())
-          {
-            for(unsigned int d=0; d<depth; d++)
-            {
-              for(unsigned int w=0; w<width; w++)
-              {
-                partCur->_space[d][height][w].tsd = partUp->_space[d][0][w].tsd;
-                partCur->_space[d][height][w].weight = partUp->_space[d][0][w].weight;
-                partCur->_space[d][height][w].rgb[0] = partUp->_space[d][0][w].rgb[0];
-                partCur->_space[d][height][w].rgb[1] = partUp->_space[d][0][w].rgb[1];
-                partCur->_space[d][height][w].rgb[2] = partUp->_space[d][0][w].rgb[2];
-              }
-            }
-          }
+          part->init();
+          row = &part->at(iz, iy, 0);
         }
+        part->_modified = true;
 
-        if(pz<_partitionsInZ-1)
+        // Weighted running average
+#if _OBVIOUS_DOUBLE_PRECISION_
+        if(lanes==3)
         {
-          TsdSpacePartition* partBack      = _partitions[pz+1][py][px];
-          if(partBack->isInitialized())
-          {
-            for(unsigned int h=0; h<height; h++)
-            {
-              for(unsigned int w=0; w<width; w++)
-              {
-                partCur->_space[depth][h][w].tsd = partBack->_space[0][h][w].tsd;
-                partCur->_space[depth][h][w].weight = partBack->_space[0][h][w].weight;
-                partCur->_space[depth][h][w].rgb[0] = partBack->_space[0][h][w].rgb[0];
-                partCur->_space[depth][h][w].rgb[1] = partBack->_space[0][h][w].rgb[1];
-                partCur->_space[depth][h][w].rgb[2] = partBack->_space[0][h][w].rgb[2];
-              }
-            }
-          }
+          updateVoxels(&row[ix], &row[ix+1], tsdOut[0], tsdOut[1],
+                       rgb ? &rgb[3*idx[0]] : NULL, rgb ? &rgb[3*idx[1]] : NULL,
+                       weights ? weights[idx[0]] : TSDINC, weights ? weights[idx[1]] : TSDINC);
+          continue;
         }
-
-        if(px<_partitionsInX-1 && pz<_partitionsInZ-1)
+#endif
+        for(unsigned int l=0; l<2; l++)
         {
-          TsdSpacePartition* partRightBack      = _partitions[pz+1][py][px+1];
-          if(partRightBack->isInitialized())
-          {
-            for(unsigned int h=0; h<height; h++)
-            {
-              partCur->_space[depth][h][width].tsd = partRightBack->_space[0][h][0].tsd;
-              partCur->_space[depth][h][width].weight = partRightBack->_space[0][h][0].weight;
-              partCur->_space[depth][h][width].rgb[0] = partRightBack->_space[0][h][0].rgb[0];
-              partCur->_space[depth][h][width].rgb[1] = partRightBack->_space[0][h][0].rgb[1];
-              partCur->_space[depth][h][width].rgb[2] = partRightBack->_space[0][h][0].rgb[2];
-            }
-          }
+          if(lanes & (1<<l))
+            updateVoxel(&row[ix+l], tsdOut[l], rgb ? &rgb[3*idx[l]] : NULL, weights ? weights[idx[l]] : TSDINC);
         }
+      }
+    }
+  }
+}
+
+#else
+
+void TsdSpace::pushProjective(TsdSpacePartition* part, const double Pgen[12], const obfloat tr[3], Sensor* sensor)
+{
+  LOGMSG(DBG_ERROR, "SIMD integration not available on this platform");
+}
+
+#endif
+
+void TsdSpace::enumeratePartitions(Sensor* sensor, vector<TsdSpacePartition*> &partitions)
+{
+  partitions.clear();
+
+  obfloat tr[3];
+  sensor->getPosition(tr);
+
+  double range = sensor->getMaximumRange();
 
-        if(px<_partitionsInX-1 && py<_partitionsInY-1)
+  vector<double> vertices;
+  if(!sensor->getFrustum(vertices))
+  {
+    if(isinf(range))
+    {
+      // Unbounded sensor, all partitions need to be checked
+      for(int pz=0; pz<_partitionsInZ; pz++)
+        for(int py=0; py<_partitionsInY; py++)
+          for(int px=0; px<_partitionsInX; px++)
+            partitions.push_back(_partitions[pz][py][px]);
+      return;
+    }
+
+    // Omnidirectional sensor, use bounding box of sphere with maximum range
+    for(unsigned int i=0; i<8; i++)
+    {
+      vertices.push_back(tr[0] + ((i&1) ? range : -range));
+      vertices.push_back(tr[1] + ((i&2) ? range : -range));
+      vertices.push_back(tr[2] + ((i&4) ? range : -range));
+    }
+  }
+
+  // Cells within the truncation radius behind measurements at maximum range are updated as well
+  double scale = (range + _maxTruncation) / range;
+  unsigned int size = vertices.size() / 3;
+  double zMin = INFINITY;
+  double zMax = -INFINITY;
+  for(unsigned int i=0; i<size; i++)
+  {
+    for(unsigned int j=0; j<3; j++)
+      vertices[3*i+j] = tr[j] + (vertices[3*i+j] - tr[j]) * scale;
+    zMin = min(zMin, vertices[3*i+2]);
+    zMax = max(zMax, vertices[3*i+2]);
+  }
+
+  obfloat partSize = _partitions[0][0][0]->getComponentSize();
+  int pzMin = max((int)floor(zMin / partSize), 0);
+  int pzMax = min((int)floor(zMax / partSize), _partitionsInZ-1);
+
+  // Rasterize convex hull slice-wise: The section of a slab with the hull is bounded by the vertices inside the slab
+  // and the intersections of edges with the slab planes. Clipping all connections of vertex pairs covers both.
+  for(int pz=pzMin; pz<=pzMax; pz++)
+  {
+    double za = ((double)pz) * partSize;
+    double zb = za + partSize;
+    double xMin = INFINITY;
+    double xMax = -INFINITY;
+    double yMin = INFINITY;
+    double yMax = -INFINITY;
+
+    for(unsigned int i=0; i<size; i++)
+    {
+      double* p = &vertices[3*i];
+      for(unsigned int j=i; j<size; j++)
+      {
+        double* q = &vertices[3*j];
+        double dz = q[2] - p[2];
+        double t0 = 0.0;
+        double t1 = 1.0;
+        if(fabs(dz) < 1e-12)
         {
-          TsdSpacePartition* partRightUp      = _partitions[pz][py+1][px+1];
-          if(partRightUp->isInitialized())
-          {
-            for(unsigned int d=0; d<depth; d++)
-            {
-              partCur->_space[d][height][width].tsd = partRightUp->_space[d][0][0].tsd;
-              partCur->_space[d][height][width].weight = partRightUp->_space[d][0][0].weight;
-              partCur->_space[d][height][width].rgb[0] = partRightUp->_space[d][0][0].rgb[0];
-              partCur->_space[d][height][width].rgb[1] = partRightUp->_space[d][0][0].rgb[1];
-              partCur->_space[d][height][width].rgb[2] = partRightUp->_space[d][0][0].rgb[2];
-            }
-          }
+          if(p[2] < za || p[2] > zb) continue;
         }
-
-        if(py<_partitionsInY-1 && pz<_partitionsInZ-1)
+        else
         {
-          TsdSpacePartition* partBackUp      = _partitions[pz+1][py+1][px];
-          if(partBackUp->isInitialized())
-          {
-            for(unsigned int w=0; w<width; w++)
-            {
-              partCur->_space[depth][height][w].tsd = partBackUp->_space[0][0][w].tsd;
-              partCur->_space[depth][height][w].weight = partBackUp->_space[0][0][w].weight;
-              partCur->_space[depth][height][w].rgb[0] = partBackUp->_space[0][0][w].rgb[0];
-              partCur->_space[depth][height][w].rgb[1] = partBackUp->_space[0][0][w].rgb[1];
-              partCur->_space[depth][height][w].rgb[2] = partBackUp->_space[0][0][w].rgb[2];
-            }
-          }
+          double ta = (za - p[2]) / dz;
+          double tb = (zb - p[2]) / dz;
+          t0 = max(t0, min(ta, tb));
+          t1 = min(t1, max(ta, tb));
+          if(t0 > t1) continue;
         }
+        double x0 = p[0] + t0 * (q[0] - p[0]);
+        double x1 = p[0] + t1 * (q[0] - p[0]);
+        double y0 = p[1] + t0 * (q[1] - p[1]);
+        double y1 = p[1] + t1 * (q[1] - p[1]);
+        xMin = min(xMin, min(x0, x1));
+        xMax = max(xMax, max(x0, x1));
+        yMin = min(yMin, min(y0, y1));
+        yMax = max(yMax, max(y0, y1));
+      }
+    }
+
+    if(xMin > xMax) continue;
+
+    int pxMin = max((int)floor(xMin / partSize), 0);
+    int pxMax = min((int)floor(xMax / partSize), _partitionsInX-1);
+    int pyMin = max((int)floor(yMin / partSize), 0);
+    int pyMax = min((int)floor(yMax / partSize), _partitionsInY-1);
+
+    for(int py=pyMin; py<=pyMax; py++)
+      for(int px=pxMin; px<=pxMax; px++)
+        partitions.push_back(_partitions[pz][py][px]);
+  }
+}
+
+void TsdSpace::pushRecursion(Sensor* sensor, obfloat pos[3], TsdSpaceComponent* comp, vector<TsdSpacePartition*> &partitionsToCheck)
+{
+  if(comp->isInRange(pos, sensor, _maxTruncation))
+  {
+    if(comp->isLeaf())
+      partitionsToCheck.push_back((TsdSpacePartition*)comp);
+    else
+    {
+      vector<TsdSpaceComponent*> children = ((TsdSpaceBranch*)comp)->getChildren();
+      for(unsigned int i=0; i<children.size(); i++)
+        pushRecursion(sensor, pos, children[i], partitionsToCheck);
+    }
+  }
+  else if(comp->isLeaf())
+  {
+    // Emptiness might have been increased
+    TsdSpacePartition* part = (TsdSpacePartition*)comp;
+    if(part->_modified) _partitionsModified.push_back(part);
+  }
+}
+
+void TsdSpace::propagateBorders()
+{
+  if(_borderMode==BORDER_NONE)
+  {
+    // Ghost borders are not accessed
+#pragma omp parallel for schedule(dynamic)
+    for(unsigned int i=0; i<_partitionsModified.size(); i++)
+      _partitionsModified[i]->collapse(false, false);
+
+    for(unsigned int i=0; i<_partitionsModified.size(); i++)
+      _partitionsModified[i]->_modified = false;
+    _partitionsModified.clear();
+    return;
+  }
 
-        if(px<_partitionsInX-1 && py<_partitionsInY-1 && pz<_partitionsInZ-1 )
+  // Borders need to be updated for modified partitions (newly initialized ones lack all borders)
+  // and for their lower neighbors, which hold copies of the modified voxels.
+  vector<TsdSpacePartition*> partitionsToUpdate;
+  unsigned int dimPartition = _partitions[0][0][0]->getWidth();
+  for(unsigned int i=0; i<_partitionsModified.size(); i++)
+  {
+    TsdSpacePartition* part = _partitionsModified[i];
+    int px = part->getX() / dimPartition;
+    int py = part->getY() / dimPartition;
+    int pz = part->getZ() / dimPartition;
+    for(int z=max(pz-1, 0); z<=pz; z++)
+    {
+      for(int y=max(py-1, 0); y<=py; y++)
+      {
+        for(int x=max(px-1, 0); x<=px; x++)
         {
-          TsdSpacePartition* partBackRightUp      = _partitions[pz+1][py+1][px+1];
-          if(partBackRightUp->isInitialized())
+          TsdSpacePartition* neighbor = _partitions[z][y][x];
+          if(!neighbor->_borderPending && neighbor->isInitialized())
           {
-            partCur->_space[depth][height][width].tsd = partBackRightUp->_space[0][0][0].tsd;
-            partCur->_space[depth][height][width].weight = partBackRightUp->_space[0][0][0].weight;
-            partCur->_space[depth][height][width].rgb[0] = partBackRightUp->_space[0][0][0].rgb[0];
-            partCur->_space[depth][height][width].rgb[1] = partBackRightUp->_space[0][0][0].rgb[1];
-            partCur->_space[depth][height][width].rgb[2] = partBackRightUp->_space[0][0][0].rgb[2];
+            neighbor->_borderPending = true;
+            partitionsToUpdate.push_back(neighbor);
           }
         }
       }
     }
   }
+
+  // Uniform partitions are expanded only if neighbors differ. Expansion changes the voxel storage read by neighbors,
+  // hence it is decided and performed before borders are copied concurrently.
+  vector<TsdSpacePartition*> partitionsToCopy;
+  partitionsToCopy.reserve(partitionsToUpdate.size());
+  for(unsigned int i=0; i<partitionsToUpdate.size(); i++)
+  {
+    TsdSpacePartition* part = partitionsToUpdate[i];
+    part->touch();
+    if(!part->isUniform() || !isUniformNeighborhood(part))
+      partitionsToCopy.push_back(part);
+  }
+  for(unsigned int i=0; i<partitionsToCopy.size(); i++)
+  {
+    if(partitionsToCopy[i]->isUniform())
+      partitionsToCopy[i]->expand();
+  }
+
+  // Each partition writes its own borders only and reads inner voxels of neighbors
+#pragma omp parallel for schedule(dynamic)
+  for(unsigned int i=0; i<partitionsToCopy.size(); i++)
+    propagateBorders(partitionsToCopy[i]);
+
+  // Partitions of identical voxels, e.g., in free space, are reduced to a single voxel
+  const bool borderAll = (_borderMode==BORDER_FULL);
+#pragma omp parallel for schedule(dynamic)
+  for(unsigned int i=0; i<partitionsToUpdate.size(); i++)
+    partitionsToUpdate[i]->collapse(true, borderAll);
+
+  for(unsigned int i=0; i<partitionsToUpdate.size(); i++)
+    partitionsToUpdate[i]->_borderPending = false;
+  for(unsigned int i=0; i<_partitionsModified.size(); i++)
+    _partitionsModified[i]->_modified = false;
+  _partitionsModified.clear();
+}
+
+/**
+ * Copy voxel content to border of neighboring partition
+ */
+static inline void copyVoxel(TsdVoxel* dst, const TsdVoxel* src, const bool tsdOnly)
+{
+  dst->tsd = src->tsd;
+  if(tsdOnly) return;
+  dst->weight = src->weight;
+  dst->rgb[0] = src->rgb[0];
+  dst->rgb[1] = src->rgb[1];
+  dst->rgb[2] = src->rgb[2];
 }
 
-bool TsdSpace::interpolateNormal(const obfloat* coord, obfloat* normal)
+bool TsdSpace::isUniformNeighborhood(TsdSpacePartition* part)
 {
-  obfloat neighbor[3];
-  obfloat depthVarInc = 0;
-  obfloat depthVarDec = 0;
+  int px = part->getX() / part->getWidth();
+  int py = part->getY() / part->getHeight();
+  int pz = part->getZ() / part->getDepth();
 
-  //interpolate around Voxel in x+1 direction
-  neighbor[0] = coord[0] + _voxelSize;
-  neighbor[1] = coord[1];
-  neighbor[2] = coord[2];
-  if(interpolateTrilinear(neighbor, &depthVarInc)!=INTERPOLATE_SUCCESS)
-    return false;
+  bool tsdOnly = (_borderMode==BORDER_TSD);
 
-  //interpolate around Voxel in x-1 direction
-  neighbor[0] = coord[0] - _voxelSize;
-  //neighbor[1] = coord[1];
-  //neighbor[2] = coord[2];
-  if(interpolateTrilinear(neighbor, &depthVarDec)!=INTERPOLATE_SUCCESS)
-    return false;
+  const TsdVoxel* u = &part->_uniformVoxel;
+  for(int i=1; i<8; i++)
+  {
+    int x = px + (i&1);
+    int y = py + ((i>>1)&1);
+    int z = pz + (i>>2);
+    if(x>=_partitionsInX || y>=_partitionsInY || z>=_partitionsInZ) continue;
+    TsdSpacePartition* neighbor = _partitions[z][y][x];
+    if(!neighbor->isInitialized()) continue;
+    neighbor->touch();
+    if(!neighbor->isUniform()) return false;
+    const TsdVoxel* v = &neighbor->_uniformVoxel;
+    if(memcmp(&v->tsd, &u->tsd, sizeof(obfloat))!=0) return false;
+    if(!tsdOnly && (v->weight!=u->weight || v->rgb[0]!=u->rgb[0] || v->rgb[1]!=u->rgb[1] || v->rgb[2]!=u->rgb[2]))
+      return false;
+  }
+  return true;
+}
 
-  //x-coordinate of normal vector
-  normal[0] = depthVarInc - depthVarDec;
+void TsdSpace::propagateBorders(TsdSpacePartition* partCur)
+{
+  unsigned int width  = partCur->getWidth();
+  unsigned int height = partCur->getHeight();
+  unsigned int depth  = partCur->getDepth();
 
-  //interpolate around Voxel in y+1 direction
-  neighbor[0] = coord[0];
-  neighbor[1] = coord[1] + _voxelSize;
-  //neighbor[2] = coord[2];
-  if(interpolateTrilinear(neighbor, &depthVarInc)!=INTERPOLATE_SUCCESS)
-    return false;
+  int px = partCur->getX() / width;
+  int py = partCur->getY() / height;
+  int pz = partCur->getZ() / depth;
 
-  //interpolate around Voxel in y-1 direction
-  //neighbor[0] = coord[0];
-  neighbor[1] = coord[1] - _voxelSize;
-  //neighbor[2] = coord[2];
-  if(interpolateTrilinear(neighbor, &depthVarDec)!=INTERPOLATE_SUCCESS)
-    return false;
+  bool tsdOnly = (_borderMode==BORDER_TSD);
 
-  //y-coordinate of normal vector
-  normal[1] = depthVarInc - depthVarDec;
+  partCur->touch();
 
-  //interpolate around Voxel in z+1 direction
-  //neighbor[0] = coord[0];
-  neighbor[1] = coord[1];
-  neighbor[2] = coord[2] + _voxelSize;
-  if(interpolateTrilinear(neighbor, &depthVarInc)!=INTERPOLATE_SUCCESS)
-    return false;
+  // Copy valid tsd values of neighbors to borders of partition.
+  if(px<_partitionsInX-1)
+  {
+    TsdSpacePartition* partRight      = _partitions[pz][py][px+1];
+    if(partRight->isInitialized())
+    {
+      partRight->touch();
+      for(unsigned int d=0; d<depth; d++)
+      {
+        for(unsigned int h=0; h<height; h++)
+        {
+          copyVoxel(&partCur->at(d, h, width), partRight->get(d, h, 0), tsdOnly);
+        }
+      }
+    }
+  }
+
+  if(py<_partitionsInY-1)
+  {
+    TsdSpacePartition* partUp      = _partitions[pz][py+1][px];
+    if(partUp->isInitialized())
+    {
+      partUp->touch();
+      for(unsigned int d=0; d<depth; d++)
+      {
+        for(unsigned int w=0; w<width; w++)
+        {
+          copyVoxel(&partCur->at(d, height, w), partUp->get(d, 0, w), tsdOnly);
+        }
+      }
+    }
+  }
+
+  if(pz<_partitionsInZ-1)
+  {
+    TsdSpacePartition* partBack      = _partitions[pz+1][py][px];
+    if(partBack->isInitialized())
+    {
+      partBack->touch();
+      for(unsigned int h=0; h<height; h++)
+      {
+        for(unsigned int w=0; w<width; w++)
+        {
+          copyVoxel(&partCur->at(depth, h, w), partBack->get(0, h, w), tsdOnly);
+        }
+      }
+    }
+  }
 
-  //interpolate around Voxel in z-1 direction
-  //neighbor[0] = coord[0];
-  //neighbor[1] = coord[1];
-  neighbor[2] = coord[2] - _voxelSize;
-  if(interpolateTrilinear(neighbor, &depthVarDec)!=INTERPOLATE_SUCCESS)
+  if(px<_partitionsInX-1 && pz<_partitionsInZ-1)
+  {
+    TsdSpacePartition* partRightBack      = _partitions[pz+1][py][px+1];
+    if(partRightBack->isInitialized())
+    {
+      partRightBack->touch();
+      for(unsigned int h=0; h<height; h++)
+      {
+        copyVoxel(&partCur->at(depth, h, width), partRightBack->get(0, h, 0), tsdOnly);
+      }
+    }
+  }
+
+  if(px<_partitionsInX-1 && py<_partitionsInY-1)
+  {
+    TsdSpacePartition* partRightUp      = _partitions[pz][py+1][px+1];
+    if(partRightUp->isInitialized())
+    {
+      partRightUp->touch();
+      for(unsigned int d=0; d<depth; d++)
+      {
+        copyVoxel(&partCur->at(d, height, width), partRightUp->get(d, 0, 0), tsdOnly);
+      }
+    }
+  }
+
+  if(py<_partitionsInY-1 && pz<_partitionsInZ-1)
+  {
+    TsdSpacePartition* partBackUp      = _partitions[pz+1][py+1][px];
+    if(partBackUp->isInitialized())
+    {
+      partBackUp->touch();
+      for(unsigned int w=0; w<width; w++)
+      {
+        copyVoxel(&partCur->at(depth, height, w), partBackUp->get(0, 0, w), tsdOnly);
+      }
+    }
+  }
+
+  if(px<_partitionsInX-1 && py<_partitionsInY-1 && pz<_partitionsInZ-1 )
+  {
+    TsdSpacePartition* partBackRightUp      = _partitions[pz+1][py+1][px+1];
+    if(partBackRightUp->isInitialized())
+    {
+      partBackRightUp->touch();
+      copyVoxel(&partCur->at(depth, height, width), partBackRightUp->get(0, 0, 0), tsdOnly);
+    }
+  }
+}
+
+bool TsdSpace::interpolateNormal(const obfloat* coord, obfloat* normal, unsigned char* rgb)
+{
+  obfloat c[3] = {coord[0], coord[1], coord[2]};
+  obfloat tsd;
+
+  // Analytic gradient of trilinear interpolation, the voxel neighborhood is resolved once for normal and color
+  if(interpolateTrilinear(c, &tsd, normal, rgb)!=INTERPOLATE_SUCCESS)
     return false;
 
-  //z-coordinate of normal vector
-  normal[2] = depthVarInc - depthVarDec;
+  if(normal[0]==0.0 && normal[1]==0.0 && normal[2]==0.0)
+    return false;
 
   norm3<obfloat>(normal);
 
@@ -733,14 +1307,23 @@ EnumTsdSpaceInterpolate TsdSpace::interpolateTrilinear(obfloat coord[3], obfloat
   obfloat wy = fabs((coord[1] - dy) * _invVoxelSize);
   obfloat wz = fabs((coord[2] - dz) * _invVoxelSize);
 
-  *tsd = part->interpolateTrilinear(x, y, z, wx, wy, wz);
+  bool isBorder = (x+1 >= (int)part->getWidth()) || (y+1 >= (int)part->getHeight()) || (z+1 >= (int)part->getDepth());
+  if(isBorder && _borderMode==BORDER_NONE)
+    *tsd = interpolateTrilinearBorder(xIdx, yIdx, zIdx, wx, wy, wz);
+  else
+    *tsd = part->interpolateTrilinear(x, y, z, wx, wy, wz);
 
   if(isnan(*tsd)) return INTERPOLATE_ISNAN;
 
   return INTERPOLATE_SUCCESS;
 }
 
-EnumTsdSpaceInterpolate TsdSpace::getTsd(obfloat coord[3], obfloat* tsd)
+EnumTsdSpaceInterpolate TsdSpace::interpolateTrilinear(obfloat coord[3], obfloat* tsd, obfloat gradient[3])
+{
+  return interpolateTrilinear(coord, tsd, gradient, NULL);
+}
+
+EnumTsdSpaceInterpolate TsdSpace::interpolateTrilinear(obfloat coord[3], obfloat* tsd, obfloat gradient[3], unsigned char rgb[3])
 {
   obfloat dx;
   obfloat dy;
@@ -751,25 +1334,148 @@ EnumTsdSpaceInterpolate TsdSpace::getTsd(obfloat coord[3], obfloat* tsd)
   int zIdx;
   if(!coord2Index(coord, &xIdx, &yIdx, &zIdx, &dx, &dy, &dz)) return INTERPOLATE_INVALIDINDEX;
 
-  int px = _lutIndex2Partition[xIdx];
-  int py = _lutIndex2Partition[yIdx];
-  int pz = _lutIndex2Partition[zIdx];
+  // Transformed scene points may leave the space, in contrast to raycasting no bounds are ensured by the caller
+  if(xIdx<0 || yIdx<0 || zIdx<0 || xIdx>=(int)_cellsX || yIdx>=(int)_cellsY || zIdx>=(int)_cellsZ) return INTERPOLATE_INVALIDINDEX;
 
-  TsdSpacePartition* part = _partitions[pz][py][px];
+  TsdSpacePartition* part = _partitions[_lutIndex2Partition[zIdx]][_lutIndex2Partition[yIdx]][_lutIndex2Partition[xIdx]];
   if(!part->isInitialized()) return INTERPOLATE_EMPTYPARTITION;
+  part->touch();
 
   int x = _lutIndex2Cell[xIdx];
   int y = _lutIndex2Cell[yIdx];
   int z = _lutIndex2Cell[zIdx];
 
-  *tsd = (*part)(z, y, x);
+  obfloat wx = fabs((coord[0] - dx) * _invVoxelSize);
+  obfloat wy = fabs((coord[1] - dy) * _invVoxelSize);
+  obfloat wz = fabs((coord[2] - dz) * _invVoxelSize);
+
+  // Gather neighborhood, corner (i,j,k) is located at index 4*i+2*j+k.
+  // Ghost borders hold valid colors only in BORDER_FULL mode, otherwise neighbors are accessed (missing voxels are NULL).
+  TsdVoxel* voxel[8];
+  bool isBorder = (x+1 >= (int)part->getWidth()) || (y+1 >= (int)part->getHeight()) || (z+1 >= (int)part->getDepth());
+
+  // Neighborhood within uniform partition is constant
+  if(part->isUniform() && !(isBorder && _borderMode!=BORDER_FULL))
+  {
+    const TsdVoxel* u = &part->_uniformVoxel;
+    if(rgb)
+    {
+      rgb[0] = u->rgb[0];
+      rgb[1] = u->rgb[1];
+      rgb[2] = u->rgb[2];
+    }
+    *tsd = u->tsd;
+    if(isnan(*tsd)) return INTERPOLATE_ISNAN;
+    if(gradient)
+    {
+      gradient[0] = 0.0;
+      gradient[1] = 0.0;
+      gradient[2] = 0.0;
+    }
+    return INTERPOLATE_SUCCESS;
+  }
+
+  if(isBorder && _borderMode!=BORDER_FULL)
+  {
+    for(unsigned int i=0; i<8; i++)
+      voxel[i] = getVoxel(xIdx+(i>>2), yIdx+((i>>1)&1), zIdx+(i&1));
+  }
+  else
+  {
+    for(unsigned int i=0; i<8; i++)
+      voxel[i] = &(part->at(z+(i&1), y+((i>>1)&1), x+(i>>2)));
+  }
+
+  if(rgb)
+  {
+    const obfloat pw[8] = {(1. - wx) * (1. - wy) * (1. - wz),
+                           (1. - wx) * (1. - wy) * wz,
+                           (1. - wx) * wy * (1. - wz),
+                           (1. - wx) * wy * wz,
+                           wx * (1. - wy) * (1. - wz),
+                           wx * (1. - wy) * wz,
+                           wx * wy * (1. - wz),
+                           wx * wy * wz};
+    obfloat color[3] = {0.0, 0.0, 0.0};
+    for(unsigned int i=0; i<8; i++)
+    {
+      // Uninitialized voxels are white
+      if(voxel[i])
+      {
+        color[0] += voxel[i]->rgb[0] * pw[i];
+        color[1] += voxel[i]->rgb[1] * pw[i];
+        color[2] += voxel[i]->rgb[2] * pw[i];
+      }
+      else
+      {
+        color[0] += 255.0 * pw[i];
+        color[1] += 255.0 * pw[i];
+        color[2] += 255.0 * pw[i];
+      }
+    }
+    rgb[0] = static_cast<unsigned char>(color[0] + 0.5);
+    rgb[1] = static_cast<unsigned char>(color[1] + 0.5);
+    rgb[2] = static_cast<unsigned char>(color[2] + 0.5);
+  }
+
+  obfloat c[8];
+  for(unsigned int i=0; i<8; i++)
+    c[i] = voxel[i] ? voxel[i]->tsd : NAN;
+
+  obfloat g[3];
+  *tsd = TsdSpacePartition::interpolateTrilinear(c, wx, wy, wz, g);
 
   if(isnan(*tsd)) return INTERPOLATE_ISNAN;
 
+  if(gradient)
+  {
+    gradient[0] = g[0] * _invVoxelSize;
+    gradient[1] = g[1] * _invVoxelSize;
+    gradient[2] = g[2] * _invVoxelSize;
+  }
+
   return INTERPOLATE_SUCCESS;
 }
 
-EnumTsdSpaceInterpolate TsdSpace::interpolateTrilinearRGB(obfloat coord[3], unsigned char rgb[3])
+void TsdSpace::interpolateTrilinear(obfloat* coords, unsigned int size, obfloat* tsd, obfloat* gradients, unsigned char* rgb, EnumTsdSpaceInterpolate* retval)
+{
+#pragma omp parallel for
+  for(int i=0; i<(int)size; i++)
+    retval[i] = interpolateTrilinear(&coords[3*i], &tsd[i], gradients ? &gradients[3*i] : NULL, rgb ? &rgb[3*i] : NULL);
+}
+
+TsdVoxel* TsdSpace::getVoxel(int x, int y, int z)
+{
+  if(x<0 || y<0 || z<0 || x>=(int)_cellsX || y>=(int)_cellsY || z>=(int)_cellsZ) return NULL;
+
+  TsdSpacePartition* part = _partitions[_lutIndex2Partition[z]][_lutIndex2Partition[y]][_lutIndex2Partition[x]];
+  if(!part->isInitialized()) return NULL;
+  part->touch();
+
+  return part->get(_lutIndex2Cell[z], _lutIndex2Cell[y], _lutIndex2Cell[x]);
+}
+
+obfloat TsdSpace::interpolateTrilinearBorder(int x, int y, int z, obfloat wx, obfloat wy, obfloat wz)
+{
+  // Neighbor-aware variant of TsdSpacePartition::interpolateTrilinear, voxels outside of space or in uninitialized partitions are NAN
+  obfloat tsd[8];
+  for(unsigned int i=0; i<8; i++)
+  {
+    TsdVoxel* voxel = getVoxel(x+(i>>2), y+((i>>1)&1), z+(i&1));
+    tsd[i] = voxel ? voxel->tsd : NAN;
+  }
+
+  return tsd[0] * (1. - wx) * (1. - wy) * (1. - wz)
+      +  tsd[1] * (1. - wx) * (1. - wy) * wz
+      +  tsd[2] * (1. - wx) * wy * (1. - wz)
+      +  tsd[3] * (1. - wx) * wy * wz
+      +  tsd[4] * wx * (1. - wy) * (1. - wz)
+      +  tsd[5] * wx * (1. - wy) * wz
+      +  tsd[6] * wx * wy * (1. - wz)
+      +  tsd[7] * wx * wy * wz;
+}
+
+EnumTsdSpaceInterpolate TsdSpace::getTsd(obfloat coord[3], obfloat* tsd)
 {
   obfloat dx;
   obfloat dy;
@@ -791,42 +1497,24 @@ EnumTsdSpaceInterpolate TsdSpace::interpolateTrilinearRGB(obfloat coord[3], unsi
   int y = _lutIndex2Cell[yIdx];
   int z = _lutIndex2Cell[zIdx];
 
-  double wx = fabs((coord[0] - dx) * _invVoxelSize);
-  double wy = fabs((coord[1] - dy) * _invVoxelSize);
-  double wz = fabs((coord[2] - dz) * _invVoxelSize);
-
-  unsigned char pRGB[8][3];
-
-  part->getRGB(z+0, y+0, x+0, pRGB[0]);
-  part->getRGB(z+1, y+0, x+0, pRGB[1]);
-  part->getRGB(z+0, y+1, x+0, pRGB[2]);
-  part->getRGB(z+1, y+1, x+0, pRGB[3]);
-  part->getRGB(z+0, y+0, x+1, pRGB[4]);
-  part->getRGB(z+1, y+0, x+1, pRGB[5]);
-  part->getRGB(z+0, y+1, x+1, pRGB[6]);
-  part->getRGB(z+1, y+1, x+1, pRGB[7]);
-
-  double pw[8];
-  pw[0] = (1. - wx) * (1. - wy) * (1. - wz);
-  pw[1] = (1. - wx) * (1. - wy) * wz;
-  pw[2] = (1. - wx) * wy * (1. - wz);
-  pw[3] = (1. - wx) * wy * wz;
-  pw[4] = wx * (1. - wy) * (1. - wz);
-  pw[5] = wx * (1. - wy) * wz;
-  pw[6] = wx * wy * (1. - wz);
-  pw[7] = wx * wy * wz;
-
-  memset(rgb,0,3);
-  for(unsigned int i=0; i<8; i++)
-  {
-    rgb[0] += pRGB[i][0] * pw[i];
-    rgb[1] += pRGB[i][1] * pw[i];
-    rgb[2] += pRGB[i][2] * pw[i];
-  }
+  *tsd = (*part)(z, y, x);
+
+  if(isnan(*tsd)) return INTERPOLATE_ISNAN;
 
   return INTERPOLATE_SUCCESS;
 }
 
+EnumTsdSpaceInterpolate TsdSpace::interpolateTrilinearRGB(obfloat coord[3], unsigned char rgb[3])
+{
+  obfloat tsd;
+  EnumTsdSpaceInterpolate retval = interpolateTrilinear(coord, &tsd, NULL, rgb);
+
+  // Color is defined even if TSD is not
+  if(retval==INTERPOLATE_ISNAN) return INTERPOLATE_SUCCESS;
+
+  return retval;
+}
+
 /*bool TsdSpace::buildSliceImage(const unsigned int depthIndex, unsigned char* image)
 {
   unsigned char R[_cellsX * _cellsY];
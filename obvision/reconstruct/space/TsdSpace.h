@@ -27,6 +27,24 @@ enum EnumTsdSpaceInterpolate { INTERPOLATE_SUCCESS=0,
 	INTERPOLATE_EMPTYPARTITION=2,
 	INTERPOLATE_ISNAN=3};
 
+/**
+ * Synchronization of ghost borders, i.e., the additional layer of voxels each partition holds of its neighbors
+ * BORDER_FULL: copy tsd, weight and color
+ * BORDER_TSD: copy tsd only, color is interpolated with neighbor-aware accessors
+ * BORDER_NONE: no ghost borders, interpolation at partition borders uses neighbor-aware accessors
+ */
+enum EnumTsdSpaceBorder { BORDER_FULL=0,
+	BORDER_TSD=1,
+	BORDER_NONE=2};
+
+/**
+ * Integration kernel used for pushing data
+ * INTEGRATION_SCALAR: reference implementation based on Sensor::backProject, applicable to any sensor
+ * INTEGRATION_SIMD: row-wise SSE2 kernel for projective sensors, computes in double precision like the scalar kernel (falls back to scalar for other sensors)
+ */
+enum EnumTsdSpaceIntegration { INTEGRATION_SCALAR=0,
+	INTEGRATION_SIMD=1};
+
 /**
  * @class TsdSpace
  * @brief Space representing a true signed distance function
@@ -150,6 +168,62 @@ enum EnumTsdSpaceInterpolate { INTERPOLATE_SUCCESS=0,
 	 */
 	double getMaxTruncation();
 
+	/**
+	 * Set synchronization mode of partition borders
+	 * @param mode border mode (default: BORDER_FULL)
+	 */
+	void setBorderMode(const EnumTsdSpaceBorder mode);
+
+	/**
+	 * Get synchronization mode of partition borders
+	 * @return border mode
+	 */
+	EnumTsdSpaceBorder getBorderMode();
+
+	/**
+	 * Set integration kernel
+	 * @param integration kernel type (default: INTEGRATION_SIMD)
+	 */
+	void setIntegration(const EnumTsdSpaceIntegration integration);
+
+	/**
+	 * Get integration kernel
+	 * @return kernel type
+	 */
+	EnumTsdSpaceIntegration getIntegration();
+
+	/**
+	 * Limit memory consumed by voxel data. Least recently touched partitions beyond the budget are compressed and moved to a cache file.
+	 * They are reloaded transparently when accessed again, e.g., by push, getTsd or raycasting.
+	 * The budget is enforced after each push and by calling enforceMemoryBudget.
+	 * @param bytes memory budget in bytes, 0 disables the budget and reloads all partitions
+	 * @param filename cache file, removed when space is destroyed
+	 */
+	void setMemoryBudget(size_t bytes, const char* filename="tsdspace.cache");
+
+	/**
+	 * Evict least recently touched partitions exceeding the memory budget
+	 */
+	void enforceMemoryBudget();
+
+	/**
+	 * Get number of accesses to resident partitions, counted once per partition between two enforcements of the budget
+	 * @return number of hits
+	 */
+	unsigned long getCacheHits();
+
+	/**
+	 * Get number of partitions reloaded from cache file
+	 * @return number of misses
+	 */
+	unsigned long getCacheMisses();
+
+	/**
+	 * Get number of partitions moved to cache file
+	 * @return number of evictions
+	 */
+	unsigned long getCacheEvictions();
+
 	/**
 	 * Get pointer to internal partition space
 	 * @return pointer to 3D partition space
@@ -189,6 +263,35 @@ enum EnumTsdSpaceInterpolate { INTERPOLATE_SUCCESS=0,
 	 */
 	EnumTsdSpaceInterpolate interpolateTrilinear(obfloat coord[3], obfloat* tsd);
 
+	/**
+	 * Interpolate TSDF and its gradient trilinearly, e.g., for direct registration against the signed distance field
+	 * @param coord query coordinates, points outside of space are rejected with INTERPOLATE_INVALIDINDEX
+	 * @param[out] tsd interpolated TSD value
+	 * @param[out] gradient gradient of TSD with respect to world coordinates (per meter)
+	 */
+	EnumTsdSpaceInterpolate interpolateTrilinear(obfloat coord[3], obfloat* tsd, obfloat gradient[3]);
+
+	/**
+	 * Sample TSD, its gradient and color at once, i.e., the neighborhood of voxels is resolved only once.
+	 * Used for raycasting, surface extraction and direct registration.
+	 * @param coord query coordinates, points outside of space are rejected with INTERPOLATE_INVALIDINDEX
+	 * @param[out] tsd interpolated TSD value
+	 * @param[out] gradient gradient of TSD with respect to world coordinates (per meter), not normalized, may be NULL
+	 * @param[out] rgb interpolated color, also provided if TSD is undefined (INTERPOLATE_ISNAN), may be NULL
+	 */
+	EnumTsdSpaceInterpolate interpolateTrilinear(obfloat coord[3], obfloat* tsd, obfloat gradient[3], unsigned char rgb[3]);
+
+	/**
+	 * Batched variant of sampler, points are processed in parallel
+	 * @param coords query coordinates (size: 3*size)
+	 * @param size number of query points
+	 * @param[out] tsd interpolated TSD values (size: size)
+	 * @param[out] gradients gradients of TSD (size: 3*size), may be NULL
+	 * @param[out] rgb interpolated colors (size: 3*size), may be NULL
+	 * @param[out] retval result of interpolation per point (size: size)
+	 */
+	void interpolateTrilinear(obfloat* coords, unsigned int size, obfloat* tsd, obfloat* gradients, unsigned char* rgb, EnumTsdSpaceInterpolate* retval);
+
 	/**
 	 * interpolate_trilineary
 	 * Method to interpolate RGB data trilineary
@@ -199,10 +302,11 @@ enum EnumTsdSpaceInterpolate { INTERPOLATE_SUCCESS=0,
 
 	/**
 	 *
-	 * Calculates normal of crossed surface
+	 * Calculates normal of crossed surface, i.e., the normalized TSD gradient
 	 * @param normal Variable to store the components in. Has to be allocated by calling function (3 coordinates)
+	 * @param rgb interpolated color, sampled within the same lookup (optional)
 	 */
-	bool interpolateNormal(const obfloat* coord, obfloat* normal);
+	bool interpolateNormal(const obfloat* coord, obfloat* normal, unsigned char* rgb=NULL);
 
 	EnumTsdSpaceInterpolate getTsd(obfloat coord[3], obfloat* tsd);
 
@@ -221,10 +325,46 @@ enum EnumTsdSpaceInterpolate { INTERPOLATE_SUCCESS=0,
 
  private:
 
+	/**
+	 * Enumerate partitions intersecting with the field of view of a sensor
+	 * @param[in] sensor sensor
+	 * @param[out] partitions partitions to be checked
+	 */
+	void enumeratePartitions(Sensor* sensor, vector<TsdSpacePartition*> &partitions);
+
+	/**
+	 * Integrate measurements of a projective sensor into a partition
+	 * @param[in] part partition
+	 * @param[in] Pgen projection matrix from world coordinates to homogeneous image coordinates, i.e., P * Tinv (row-major 3x4)
+	 * @param[in] tr sensor position
+	 * @param[in] sensor sensor providing measurements
+	 */
+	bool initProjective(Sensor* sensor, double Pgen[12]);
+
+	void pushProjective(TsdSpacePartition* part, const double Pgen[12], const obfloat tr[3], Sensor* sensor);
+
 	void pushRecursion(Sensor* sensor, obfloat pos[3], TsdSpaceComponent* comp, vector<TsdSpacePartition*> &partitionsToCheck);
 
 	void propagateBorders();
 
+	/**
+	 * Copy inner voxels of upper neighbors to ghost borders of a partition, which needs to be expanded
+	 * @param[in] part partition
+	 */
+	void propagateBorders(TsdSpacePartition* part);
+
+	/**
+	 * Check whether a uniform partition and all of its initialized upper neighbors share the same uniform voxel.
+	 * Such a partition does not need explicit borders.
+	 * @param[in] part uniform partition
+	 * @return true, if borders would equal the uniform voxel
+	 */
+	bool isUniformNeighborhood(TsdSpacePartition* part);
+
+	TsdVoxel* getVoxel(int x, int y, int z);
+
+	obfloat interpolateTrilinearBorder(int x, int y, int z, obfloat wx, obfloat wy, obfloat wz);
+
 	void addTsdValue(const unsigned int col, const unsigned int row, const unsigned int z, double sd, unsigned char* rgb);
 
 	bool coord2Index(obfloat coord[3], int* x, int* y, int* z, obfloat* dx, obfloat* dy, obfloat* dz);
@@ -270,6 +410,22 @@ enum EnumTsdSpaceInterpolate { INTERPOLATE_SUCCESS=0,
 
 	EnumTsdSpaceLayout _layoutSpace;
 
+	EnumTsdSpaceBorder _borderMode;
+
+	EnumTsdSpaceIntegration _integration;
+
+	// Partitions modified in current push
+	vector<TsdSpacePartition*> _partitionsModified;
+
+	// Allocator for voxel blocks of partitions
+	SlabAllocator<TsdVoxel>* _pool;
+
+	// Cache for evicted partitions, NULL if no memory budget is set
+	TsdSpaceCache* _cache;
+
+	// Maximum number of resident partitions
+	size_t _budgetPartitions;
+
  };
 
 }
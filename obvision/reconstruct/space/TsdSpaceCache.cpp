@@ -0,0 +1,108 @@
+#include "TsdSpaceCache.h"
+
+#include <cstdio>
+
+#include "obcore/base/Logger.h"
+
+namespace obvious
+{
+
+TsdSpaceCache::TsdSpaceCache(const char* filename)
+{
+  _filename  = filename;
+  _size      = 0;
+  _tick      = 1;
+  _hits      = 0;
+  _misses    = 0;
+  _evictions = 0;
+
+  _file.open(filename, std::ios_base::in | std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+  if(!_file)
+  {
+    LOGMSG(DBG_ERROR, "Cache file " << filename << " could not be opened");
+  }
+}
+
+TsdSpaceCache::~TsdSpaceCache()
+{
+  _file.close();
+  remove(_filename.c_str());
+}
+
+bool TsdSpaceCache::isOpen()
+{
+  return _file.is_open();
+}
+
+bool TsdSpaceCache::write(const char* data, unsigned int bytes, long* offset, unsigned int* capacity)
+{
+  if(*offset < 0 || bytes > *capacity)
+  {
+    *offset   = _size;
+    *capacity = bytes;
+    _size    += bytes;
+  }
+  _file.seekp(*offset);
+  _file.write(data, bytes);
+  _file.flush();
+  if(!_file.good())
+  {
+    LOGMSG(DBG_ERROR, "Writing " << bytes << " bytes at offset " << *offset << " to cache file " << _filename << " failed");
+    _file.clear();
+    return false;
+  }
+  return true;
+}
+
+bool TsdSpaceCache::read(char* data, unsigned int bytes, long offset)
+{
+  _file.seekg(offset);
+  _file.read(data, bytes);
+  if(!_file.good() || _file.gcount()!=(std::streamsize)bytes)
+  {
+    LOGMSG(DBG_ERROR, "Reading " << bytes << " bytes at offset " << offset << " from cache file " << _filename << " failed");
+    _file.clear();
+    return false;
+  }
+  return true;
+}
+
+void TsdSpaceCache::advance()
+{
+  _tick++;
+}
+
+void TsdSpaceCache::countHit()
+{
+#pragma omp atomic
+  _hits++;
+}
+
+void TsdSpaceCache::countMiss()
+{
+#pragma omp atomic
+  _misses++;
+}
+
+void TsdSpaceCache::countEviction()
+{
+#pragma omp atomic
+  _evictions++;
+}
+
+unsigned long TsdSpaceCache::getHits()
+{
+  return _hits;
+}
+
+unsigned long TsdSpaceCache::getMisses()
+{
+  return _misses;
+}
+
+unsigned long TsdSpaceCache::getEvictions()
+{
+  return _evictions;
+}
+
+}
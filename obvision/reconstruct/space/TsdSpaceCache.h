@@ -0,0 +1,111 @@
+#ifndef TSDSPACECACHE_H
+#define TSDSPACECACHE_H
+
+#include <fstream>
+#include <string>
+
+namespace obvious
+{
+
+/**
+ * @class TsdSpaceCache
+ * @brief File cache for voxel data of evicted partitions, see TsdSpace::setMemoryBudget.
+ * Blocks are stored in slots, the slot of a partition is reused as long as its capacity suffices.
+ * Access times of partitions are measured in ticks, i.e., in intervals between two enforcements of the memory budget.
+ * @author Stefan May
+ */
+class TsdSpaceCache
+{
+public:
+
+  /**
+   * Constructor
+   * @param filename cache file, existing content is discarded
+   */
+  TsdSpaceCache(const char* filename);
+
+  /**
+   * Destructor, the cache file is removed
+   */
+  ~TsdSpaceCache();
+
+  /**
+   * Check whether cache file could be opened
+   * @return success
+   */
+  bool isOpen();
+
+  /**
+   * Write block to cache file
+   * @param data block data
+   * @param bytes size of block in bytes
+   * @param[in,out] offset position of slot in file, a negative value requests a new slot
+   * @param[in,out] capacity capacity of slot in bytes
+   * @return success, the slot content is undefined on failure
+   */
+  bool write(const char* data, unsigned int bytes, long* offset, unsigned int* capacity);
+
+  /**
+   * Read block from cache file
+   * @param[out] data block data
+   * @param bytes size of block in bytes
+   * @param offset position of slot in file
+   * @return success
+   */
+  bool read(char* data, unsigned int bytes, long offset);
+
+  /**
+   * Get current tick
+   * @return tick
+   */
+  unsigned long getTick() { return _tick; };
+
+  /**
+   * Start new tick
+   */
+  void advance();
+
+  void countHit();
+
+  void countMiss();
+
+  void countEviction();
+
+  /**
+   * Get number of accesses to resident partitions (counted once per partition and tick)
+   * @return number of hits
+   */
+  unsigned long getHits();
+
+  /**
+   * Get number of partitions reloaded from cache file
+   * @return number of misses
+   */
+  unsigned long getMisses();
+
+  /**
+   * Get number of partitions moved to cache file
+   * @return number of evictions
+   */
+  unsigned long getEvictions();
+
+private:
+
+  std::string _filename;
+
+  std::fstream _file;
+
+  long _size;
+
+  unsigned long _tick;
+
+  unsigned long _hits;
+
+  unsigned long _misses;
+
+  unsigned long _evictions;
+};
+
+}
+
+#endif
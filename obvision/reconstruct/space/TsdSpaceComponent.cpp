@@ -59,11 +59,7 @@ bool TsdSpaceComponent::isInRange(obfloat pos[3], Sensor* sensor, obfloat maxTru
 
   if(_isLeaf)
   {
-    double* data = sensor->getRealMeasurementData();
-    bool* mask = sensor->getRealMeasurementMask();
-
     int width = sensor->getWidth();
-    int height = sensor->getHeight();
 
     // Project back edges of partition
     int idxEdge[8];
@@ -72,7 +68,7 @@ bool TsdSpaceComponent::isInRange(obfloat pos[3], Sensor* sensor, obfloat maxTru
     // Determine outmost projection range
     int x_min = width-1;
     int x_max = -1;
-    int y_min = height-1;
+    int y_min = sensor->getHeight()-1;
     int y_max = -1;
     int validIndices = 0;
     for(int i=0; i<8; i++)
@@ -93,34 +89,17 @@ bool TsdSpaceComponent::isInRange(obfloat pos[3], Sensor* sensor, obfloat maxTru
     if(validIndices==0) return false;
 
     // We might oversee some voxels, if validIndices < 8, but this should be negligible
-    // Verify whether any measurement within the projection range is close enough for pushing data
-    bool isVisible = false;
-    if(x_min<0) x_min = 0;
-    if(y_min<0) y_min = 0;
-    for(int y=y_min; y<=y_max; y++)
-    {
-      for(int x=x_min; x<=x_max; x++)
-      {
-        int idx = y*width+x;
+    // Summarize measurements within the projection range
+    RangeStatistics stats;
+    sensor->getRangePyramid()->query(x_min, x_max, y_min, y_max, &stats);
 
-        if(mask[idx])
-        {
-          isVisible = isVisible || (data[idx] > minDist);
-        }
-      }
-    }
+    // Verify whether any measurement within the projection range is close enough for pushing data
+    bool isVisible = (stats.maxValid > minDist);
 
     if(!isVisible) return false;
 
-    bool isEmpty = true;
-    for(int y=y_min; y<=y_max; y++)
-    {
-      for(int x=x_min; x<=x_max; x++)
-      {
-        int idx = y*width+x;
-        isEmpty = isEmpty && (data[idx] > maxDist) && mask[idx];
-      }
-    }
+    // Partition is empty, if all measurements are valid and behind the partition
+    bool isEmpty = (stats.invalid==0) && (stats.minFinite > maxDist);
 
     if(isEmpty)
     {
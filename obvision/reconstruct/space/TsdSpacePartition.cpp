@@ -4,8 +4,10 @@
 #include "obcore/math/mathbase.h"
 #include "TsdSpacePartition.h"
 
+#include <cstdlib>
 #include <cstring>
 #include <cmath>
+#include <vector>
 
 namespace obvious
 {
@@ -21,7 +23,8 @@ TsdSpacePartition::TsdSpacePartition(const unsigned int x,
     const unsigned int cellsX,
     const unsigned int cellsY,
     const unsigned int cellsZ,
-    const obfloat cellSize) : TsdSpaceComponent(true)
+    const obfloat cellSize,
+    SlabAllocator<TsdVoxel>* pool) : TsdSpaceComponent(true)
 {
   _x = x;
   _y = y;
@@ -34,6 +37,23 @@ TsdSpacePartition::TsdSpacePartition(const unsigned int x,
 
   _initWeight = 0.0;
 
+  _modified = false;
+  _borderPending = false;
+
+  _uniform = false;
+  _uniformVoxel.tsd    = NAN;
+  _uniformVoxel.weight = 0.0;
+  _uniformVoxel.rgb[0] = 255;
+  _uniformVoxel.rgb[1] = 255;
+  _uniformVoxel.rgb[2] = 255;
+
+  _cache = NULL;
+  _evicted = false;
+  _cacheOffset = -1;
+  _cacheCapacity = 0;
+  _cacheBytes = 0;
+  _lastAccess = 0;
+
   _edgeCoordsHom = new Matrix(8, 4);
   (*_edgeCoordsHom)(0, 0) = ((double)x) * _cellSize;
   (*_edgeCoordsHom)(0, 1) = ((double)y) * _cellSize;
@@ -88,6 +108,16 @@ TsdSpacePartition::TsdSpacePartition(const unsigned int x,
   _cellsY = cellsY;
   _cellsZ = cellsZ;
 
+  _strideY = _cellsX+1;
+  _strideZ = (_cellsY+1)*(_cellsX+1);
+
+  _pool = pool;
+  if(_pool && _pool->getBlockSize()!=getBlockSize())
+  {
+    LOGMSG(DBG_ERROR, "Block size of allocator does not match partition size, falling back to heap allocation");
+    _pool = NULL;
+  }
+
   if(!_partCoords)
   {
     _partCoords = new Matrix(cellsX*cellsY*cellsZ, 3);
@@ -146,53 +176,260 @@ void TsdSpacePartition::reset()
 {
   if(_space)
   {
-    System<TsdVoxel>::deallocate(_space); _space = NULL;
+    releaseBlock(_space); _space = NULL;
   }
+  _uniform = false;
+  // Slot in cache file is kept for reuse
+  _evicted = false;
 }
 
 obfloat& TsdSpacePartition::operator () (unsigned int z, unsigned int y, unsigned int x)
 {
-  return _space[z][y][x].tsd;
+  touch();
+  return get(z, y, x)->tsd;
 }
 
 void TsdSpacePartition::getRGB(unsigned int z, unsigned int y, unsigned int x, unsigned char rgb[3])
 {
-  rgb[0] = _space[z][y][x].rgb[0];
-  rgb[1] = _space[z][y][x].rgb[1];
-  rgb[2] = _space[z][y][x].rgb[2];
+  touch();
+  const TsdVoxel* voxel = get(z, y, x);
+  rgb[0] = voxel->rgb[0];
+  rgb[1] = voxel->rgb[1];
+  rgb[2] = voxel->rgb[2];
 }
 
 void TsdSpacePartition::init()
 {
+  touch();
   if(_space) return;
 
+  if(_uniform)
+  {
+    expand();
+    return;
+  }
+
   _initializedPartitions++;
 
-  System<TsdVoxel>::allocate(_cellsZ+1, _cellsY+1, _cellsX+1, _space);
-  for (unsigned int iz = 0; iz < _cellsZ+1; iz++)
+  TsdVoxel* space = allocateBlock();
+  const unsigned int size = getBlockSize();
+  for(unsigned int i=0; i<size; i++)
+  {
+    space[i].tsd    = NAN;
+    space[i].weight = _initWeight;
+    space[i].rgb[0] = 255;
+    space[i].rgb[1] = 255;
+    space[i].rgb[2] = 255;
+  }
+  _space = space;
+}
+
+void TsdSpacePartition::expand()
+{
+  TsdVoxel* space = allocateBlock();
+  const unsigned int size = getBlockSize();
+  for(unsigned int i=0; i<size; i++)
+    space[i] = _uniformVoxel;
+  _space = space;
+  _uniform = false;
+}
+
+bool TsdSpacePartition::collapse(bool borderTsd, bool borderAll)
+{
+  touch();
+  if(!_space) return false;
+
+  const TsdVoxel* ref = &_space[0];
+  for(unsigned int z=0; z<=_cellsZ; z++)
   {
-    for (unsigned int iy = 0; iy < _cellsY+1; iy++)
+    for(unsigned int y=0; y<=_cellsY; y++)
     {
-      for (unsigned int ix = 0; ix < _cellsX+1; ix++)
+      const TsdVoxel* row = &at(z, y, 0);
+      const bool borderRow = (z==_cellsZ || y==_cellsY);
+      for(unsigned int x=0; x<=_cellsX; x++)
       {
-        _space[iz][iy][ix].tsd    = NAN;
-        _space[iz][iy][ix].weight = _initWeight;
-        _space[iz][iy][ix].rgb[0] = 255;
-        _space[iz][iy][ix].rgb[1] = 255;
-        _space[iz][iy][ix].rgb[2] = 255;
+        const TsdVoxel* voxel = &row[x];
+        const bool border = borderRow || x==_cellsX;
+        if(border && !borderTsd && !borderAll) continue;
+        // Compared bitwise in order to match undefined (NAN) values
+        if(memcmp(&voxel->tsd, &ref->tsd, sizeof(obfloat))!=0) return false;
+        if(border && !borderAll) continue;
+        if(voxel->weight!=ref->weight || voxel->rgb[0]!=ref->rgb[0] || voxel->rgb[1]!=ref->rgb[1] || voxel->rgb[2]!=ref->rgb[2]) return false;
       }
     }
   }
+
+  _uniformVoxel = *ref;
+  _uniform = true;
+  releaseBlock(_space); _space = NULL;
+  return true;
+}
+
+unsigned int TsdSpacePartition::getBlockSize()
+{
+  return (_cellsZ+1)*(_cellsY+1)*(_cellsX+1);
+}
+
+TsdVoxel* TsdSpacePartition::allocateBlock()
+{
+  if(_pool) return _pool->allocate();
+  return new TsdVoxel[getBlockSize()];
+}
+
+void TsdSpacePartition::releaseBlock(TsdVoxel* block)
+{
+  if(_pool)
+    _pool->release(block);
+  else
+    delete [] block;
 }
 
 bool TsdSpacePartition::isInitialized()
 {
-  return _space!=NULL;
+  return (_space!=NULL || _uniform || _evicted);
 }
 
 bool TsdSpacePartition::isEmpty()
 {
-  return (_space==NULL && _initWeight > 0.0);
+  return (!isInitialized() && _initWeight > 0.0);
+}
+
+bool TsdSpacePartition::isUniform()
+{
+  return _uniform;
+}
+
+bool TsdSpacePartition::isEvicted()
+{
+  return _evicted;
+}
+
+void TsdSpacePartition::setCache(TsdSpaceCache* cache)
+{
+  // Data of previous cache is invalidated
+  touch();
+  _cache = cache;
+  _cacheOffset = -1;
+  _cacheCapacity = 0;
+}
+
+unsigned long TsdSpacePartition::getLastAccess()
+{
+  return _lastAccess;
+}
+
+void TsdSpacePartition::access()
+{
+  const unsigned long tick = _cache->getTick();
+  if(_lastAccess != tick)
+  {
+    _lastAccess = tick;
+    if(_space) _cache->countHit();
+  }
+
+  if(!_evicted) return;
+
+  // Partitions are reloaded concurrently, e.g., by raycasting threads
+#pragma omp critical(tsdspacecache)
+  {
+    if(_evicted)
+    {
+      char* buffer = new char[_cacheBytes];
+      // Voxel data exists in the cache file only, i.e., it cannot be recovered
+      if(!_cache->read(buffer, _cacheBytes, _cacheOffset))
+      {
+        LOGMSG(DBG_ERROR, "Partition (" << _x << ", " << _y << ", " << _z << ") could not be reloaded from cache");
+        abort();
+      }
+
+      TsdVoxel* space = allocateBlock();
+
+      // Runs of identical voxels: count, tsd, weight, rgb
+      const unsigned int runBytes = sizeof(unsigned int) + 2*sizeof(obfloat) + 3;
+      const char* run = buffer;
+      const char* end = buffer + _cacheBytes;
+      unsigned int count = 0;
+      TsdVoxel voxel;
+      const unsigned int size = getBlockSize();
+      for(unsigned int i=0; i<size; i++)
+      {
+        if(count==0)
+        {
+          if(run+runBytes > end)
+          {
+            LOGMSG(DBG_ERROR, "Cached data of partition (" << _x << ", " << _y << ", " << _z << ") is truncated at voxel " << i);
+            abort();
+          }
+          memcpy(&count, run, sizeof(unsigned int));
+          if(count==0)
+          {
+            LOGMSG(DBG_ERROR, "Cached data of partition (" << _x << ", " << _y << ", " << _z << ") contains empty run at voxel " << i);
+            abort();
+          }
+          memcpy(&voxel.tsd, run+sizeof(unsigned int), sizeof(obfloat));
+          memcpy(&voxel.weight, run+sizeof(unsigned int)+sizeof(obfloat), sizeof(obfloat));
+          memcpy(voxel.rgb, run+sizeof(unsigned int)+2*sizeof(obfloat), 3);
+          run += runBytes;
+        }
+        space[i] = voxel;
+        count--;
+      }
+      delete [] buffer;
+
+      _space = space;
+#pragma omp flush
+      _evicted = false;
+      _cache->countMiss();
+    }
+  }
+}
+
+void TsdSpacePartition::evict()
+{
+  if(!_cache || !_space) return;
+
+  // Runs of identical voxels: count, tsd, weight, rgb
+  const unsigned int runBytes = sizeof(unsigned int) + 2*sizeof(obfloat) + 3;
+  std::vector<char> buffer;
+  buffer.reserve(runBytes * 64);
+  unsigned int count = 0;
+  const TsdVoxel* prev = NULL;
+  const unsigned int size = getBlockSize();
+  for(unsigned int v=0; v<size; v++)
+  {
+    const TsdVoxel* voxel = &_space[v];
+    // Voxels are compared bitwise in order to join undefined (NAN) values
+    bool equal = prev && memcmp(&voxel->tsd, &prev->tsd, sizeof(obfloat))==0 && voxel->weight==prev->weight
+                 && voxel->rgb[0]==prev->rgb[0] && voxel->rgb[1]==prev->rgb[1] && voxel->rgb[2]==prev->rgb[2];
+    if(equal)
+    {
+      count++;
+      memcpy(&buffer[buffer.size()-runBytes], &count, sizeof(unsigned int));
+      continue;
+    }
+    count = 1;
+    prev = voxel;
+    unsigned int i = buffer.size();
+    buffer.resize(i + runBytes);
+    memcpy(&buffer[i], &count, sizeof(unsigned int));
+    memcpy(&buffer[i+sizeof(unsigned int)], &voxel->tsd, sizeof(obfloat));
+    memcpy(&buffer[i+sizeof(unsigned int)+sizeof(obfloat)], &voxel->weight, sizeof(obfloat));
+    memcpy(&buffer[i+sizeof(unsigned int)+2*sizeof(obfloat)], voxel->rgb, 3);
+  }
+
+  // Block stays resident if it could not be written
+  if(!_cache->write(&buffer[0], buffer.size(), &_cacheOffset, &_cacheCapacity))
+    return;
+  _cacheBytes = buffer.size();
+  _cache->countEviction();
+
+  releaseBlock(_space); _space = NULL;
+  _evicted = true;
+}
+
+bool TsdSpacePartition::isModified()
+{
+  return _modified;
 }
 
 obfloat TsdSpacePartition::getInitWeight()
@@ -257,11 +494,11 @@ unsigned int TsdSpacePartition::getSize()
   return _cellsX*_cellsY*_cellsZ;
 }
 
-void TsdSpacePartition::addTsd(const unsigned int x, const unsigned int y, const unsigned int z, const obfloat sd, const obfloat maxTruncation, const unsigned char rgb[3])
+void TsdSpacePartition::addTsd(const unsigned int x, const unsigned int y, const unsigned int z, const obfloat sd, const obfloat maxTruncation, const unsigned char rgb[3], const obfloat weight)
 {
   //if(sd >= -maxTruncation)
   {
-    TsdVoxel* voxel = &_space[z][y][x];
+    TsdVoxel* voxel = &at(z, y, x);
 
     obfloat tsd = min(sd / maxTruncation, TSDINC);
 
@@ -283,7 +520,7 @@ void TsdSpacePartition::addTsd(const unsigned int x, const unsigned int y, const
     }
     voxel->weight += w;*/
 
-    voxel->weight += TSDINC;
+    voxel->weight += weight;
 
     if(isnan(voxel->tsd))
     {
@@ -298,42 +535,49 @@ void TsdSpacePartition::addTsd(const unsigned int x, const unsigned int y, const
     else
     {
       voxel->weight = min(voxel->weight, TSDSPACEMAXWEIGHT);
-      voxel->tsd   = (voxel->tsd * (voxel->weight - TSDINC) + tsd) / voxel->weight;
+      voxel->tsd   = (voxel->tsd * (voxel->weight - weight) + tsd * weight) / voxel->weight;
       if(rgb)
       {
-        voxel->rgb[0] = (voxel->rgb[0] * (voxel->weight - TSDINC) + rgb[0]) / voxel->weight;
-        voxel->rgb[1] = (voxel->rgb[1] * (voxel->weight - TSDINC) + rgb[1]) / voxel->weight;
-        voxel->rgb[2] = (voxel->rgb[2] * (voxel->weight - TSDINC) + rgb[2]) / voxel->weight;
+        voxel->rgb[0] = (voxel->rgb[0] * (voxel->weight - weight) + rgb[0] * weight) / voxel->weight;
+        voxel->rgb[1] = (voxel->rgb[1] * (voxel->weight - weight) + rgb[1] * weight) / voxel->weight;
+        voxel->rgb[2] = (voxel->rgb[2] * (voxel->weight - weight) + rgb[2] * weight) / voxel->weight;
       }
     }
   }
 }
 
-void TsdSpacePartition::increaseEmptiness()
+/**
+ * Blend voxel towards free space, i.e., a tsd of 1
+ */
+static inline void addEmptiness(TsdVoxel* voxel)
 {
-  if(_space)
+  voxel->weight += 1.0;
+
+  if(isnan(voxel->tsd))
   {
-    for(unsigned int z=1; z<=_cellsZ; z++)
-    {
-      for(unsigned int y=1; y<=_cellsY; y++)
-      {
-        for(unsigned int x=1; x<=_cellsX; x++)
-        {
-          TsdVoxel* voxel = &_space[z][y][x];
-          voxel->weight += 1.0;
+    voxel->tsd = 1.0;
+  }
+  else
+  {
+    voxel->weight = min(voxel->weight, TSDSPACEMAXWEIGHT);
+    voxel->tsd    = (voxel->tsd * (voxel->weight - 1.0) + 1.0) / voxel->weight;
+  }
+}
 
-          if(isnan(voxel->tsd))
-          {
-            voxel->tsd = 1.0;
-          }
-          else
-          {
-            voxel->weight = min(voxel->weight, TSDSPACEMAXWEIGHT);
-            voxel->tsd    = (voxel->tsd * (voxel->weight - 1.0) + 1.0) / voxel->weight;
-          }
-        }
-      }
-    }
+void TsdSpacePartition::increaseEmptiness()
+{
+  touch();
+  if(_uniform)
+  {
+    _modified = true;
+    addEmptiness(&_uniformVoxel);
+  }
+  else if(_space)
+  {
+    _modified = true;
+    const unsigned int size = getBlockSize();
+    for(unsigned int i=0; i<size; i++)
+      addEmptiness(&_space[i]);
   }
   else
   {
@@ -344,19 +588,52 @@ void TsdSpacePartition::increaseEmptiness()
 
 obfloat TsdSpacePartition::interpolateTrilinear(int x, int y, int z, obfloat dx, obfloat dy, obfloat dz)
 {
+  touch();
+  if(_uniform) return _uniformVoxel.tsd;
+
   // Interpolate
-  return _space[z][y][x].tsd * (1. - dx) * (1. - dy) * (1. - dz)
-      +  _space[z + 1][y + 0][x + 0].tsd * (1. - dx) * (1. - dy) * dz
-      +  _space[z + 0][y + 1][x + 0].tsd * (1. - dx) * dy * (1. - dz)
-      +  _space[z + 1][y + 1][x + 0].tsd * (1. - dx) * dy * dz
-      +  _space[z + 0][y + 0][x + 1].tsd * dx * (1. - dy) * (1. - dz)
-      +  _space[z + 1][y + 0][x + 1].tsd * dx * (1. - dy) * dz
-      +  _space[z + 0][y + 1][x + 1].tsd * dx * dy * (1. - dz)
-      +  _space[z + 1][y + 1][x + 1].tsd * dx * dy * dz;
+  const TsdVoxel* v = &at(z, y, x);
+  const unsigned int sy = _strideY;
+  const unsigned int sz = _strideZ;
+  return v[0].tsd * (1. - dx) * (1. - dy) * (1. - dz)
+      +  v[sz].tsd * (1. - dx) * (1. - dy) * dz
+      +  v[sy].tsd * (1. - dx) * dy * (1. - dz)
+      +  v[sz+sy].tsd * (1. - dx) * dy * dz
+      +  v[1].tsd * dx * (1. - dy) * (1. - dz)
+      +  v[sz+1].tsd * dx * (1. - dy) * dz
+      +  v[sy+1].tsd * dx * dy * (1. - dz)
+      +  v[sz+sy+1].tsd * dx * dy * dz;
+}
+
+obfloat TsdSpacePartition::interpolateTrilinear(int x, int y, int z, obfloat dx, obfloat dy, obfloat dz, obfloat gradient[3])
+{
+  touch();
+  if(_uniform)
+  {
+    gradient[0] = 0.0;
+    gradient[1] = 0.0;
+    gradient[2] = 0.0;
+    return _uniformVoxel.tsd;
+  }
+
+  const TsdVoxel* v = &at(z, y, x);
+  const unsigned int sy = _strideY;
+  const unsigned int sz = _strideZ;
+  const obfloat c[8] = {v[0].tsd,
+                        v[sz].tsd,
+                        v[sy].tsd,
+                        v[sz+sy].tsd,
+                        v[1].tsd,
+                        v[sz+1].tsd,
+                        v[sy+1].tsd,
+                        v[sz+sy+1].tsd};
+  return interpolateTrilinear(c, dx, dy, dz, gradient);
 }
 
 void TsdSpacePartition::serialize(ofstream* f)
 {
+  touch();
+
   unsigned int initializedCells = 0;
 
   for(unsigned int z=0 ; z<_cellsZ+1; z++)
@@ -365,7 +642,7 @@ void TsdSpacePartition::serialize(ofstream* f)
     {
       for(unsigned int x=0; x<_cellsX+1; x++)
       {
-        if(!isnan(_space[z][y][x].tsd))
+        if(!isnan(get(z, y, x)->tsd))
           initializedCells++;
       }
     }
@@ -379,10 +656,11 @@ void TsdSpacePartition::serialize(ofstream* f)
     {
       for(unsigned int x=0; x<_cellsX+1; x++)
       {
-        obfloat tsd = _space[z][y][x].tsd;
+        const TsdVoxel* voxel = get(z, y, x);
+        obfloat tsd = voxel->tsd;
         if(!isnan(tsd))
         {
-          *f << z << " " << y << " " << x << " " << tsd << " " << _space[z][y][x].weight << " " << (int)_space[z][y][x].rgb[0] << " " << (int)_space[z][y][x].rgb[1] << " " << (int)_space[z][y][x].rgb[2] << endl;
+          *f << z << " " << y << " " << x << " " << tsd << " " << voxel->weight << " " << (int)voxel->rgb[0] << " " << (int)voxel->rgb[1] << " " << (int)voxel->rgb[2] << endl;
         }
       }
     }
@@ -405,7 +683,7 @@ void TsdSpacePartition::load(ifstream* f)
   for(unsigned int i = 0; i<initializedCells; i++)
   {
     *f >> z >> y >> x >> tsd >> weight >> rgb0 >> rgb1 >> rgb2;
-    TsdVoxel* cell = &_space[z][y][x];
+    TsdVoxel* cell = &at(z, y, x);
     cell->tsd      = tsd;
     cell->weight   = weight;
     cell->rgb[0]   = (unsigned char)rgb0;
@@ -3,6 +3,8 @@
 
 #include "obcore/math/linalg/linalg.h"
 #include "obvision/reconstruct/space/TsdSpaceComponent.h"
+#include "obvision/reconstruct/space/TsdSpaceCache.h"
+#include "obcore/base/SlabAllocator.h"
 
 namespace obvious
 {
@@ -40,8 +42,9 @@ public:
    * @param[in] dimY Number of cells in y-dimension
    * @param[in] dimZ Number of cells in z-dimension
    * @param[in] cellSize Size of cell in meters
+   * @param[in] pool allocator for voxel blocks of getBlockSize() voxels, shared among partitions (heap is used if NULL)
    */
-  TsdSpacePartition(const unsigned int x, const unsigned int y, const unsigned int z, const unsigned int dimX, const unsigned int dimY, const unsigned int dimZ, const obfloat cellSize);
+  TsdSpacePartition(const unsigned int x, const unsigned int y, const unsigned int z, const unsigned int dimX, const unsigned int dimY, const unsigned int dimZ, const obfloat cellSize, SlabAllocator<TsdVoxel>* pool=NULL);
 
   ~TsdSpacePartition();
 
@@ -57,10 +60,62 @@ public:
 
   void init();
 
+  /**
+   * Check whether partition holds voxel data, either in memory, in the cache file or in uniform representation
+   * @return initialization state
+   */
   bool isInitialized();
 
   bool isEmpty();
 
+  /**
+   * Check whether all voxels are identical and represented by a single one, see collapse
+   * @return uniform state
+   */
+  bool isUniform();
+
+  /**
+   * Switch to uniform representation, if all voxels are identical. The dense block is released.
+   * Ghost borders are compared as far as they are synchronized with neighbors, i.e., as far as they are accessed by interpolation.
+   * @param borderTsd compare tsd of ghost borders
+   * @param borderAll compare tsd, weight and color of ghost borders
+   * @return true, if partition has been collapsed
+   */
+  bool collapse(bool borderTsd, bool borderAll);
+
+  /**
+   * Check whether voxel data has been moved to the cache file
+   * @return eviction state
+   */
+  bool isEvicted();
+
+  /**
+   * Assign cache for evicted voxel data
+   * @param cache cache instance, NULL disables eviction
+   */
+  void setCache(TsdSpaceCache* cache);
+
+  /**
+   * Register access to voxel data, evicted data is reloaded from the cache file.
+   * Needs to be called before accessing voxel data directly, accessors of this class call it implicitly.
+   */
+  inline void touch()
+  {
+    if(_cache) access();
+  };
+
+  /**
+   * Get tick of last access, see TsdSpaceCache::getTick
+   * @return tick
+   */
+  unsigned long getLastAccess();
+
+  /**
+   * Check whether voxel data has been modified since the last propagation of borders
+   * @return modification flag
+   */
+  bool isModified();
+
   obfloat getInitWeight();
 
   void setInitWeight(obfloat weight);
@@ -85,19 +140,134 @@ public:
 
   unsigned int getSize();
 
-  void addTsd(const unsigned int x, const unsigned int y, const unsigned int z, const obfloat sd, const obfloat maxTruncation, const unsigned char rgb[3]);
+  /**
+   * Get number of voxels allocated per partition, including ghost borders
+   * @return size of voxel block
+   */
+  unsigned int getBlockSize();
+
+  /**
+   * Add signed distance to voxel by weighted running average
+   * @param x x-index of voxel
+   * @param y y-index of voxel
+   * @param z z-index of voxel
+   * @param sd signed distance
+   * @param maxTruncation truncation radius
+   * @param rgb color (may be NULL)
+   * @param weight weight of measurement (see Sensor::getRealMeasurementWeights)
+   */
+  void addTsd(const unsigned int x, const unsigned int y, const unsigned int z, const obfloat sd, const obfloat maxTruncation, const unsigned char rgb[3], const obfloat weight=TSDINC);
 
   virtual void increaseEmptiness();
 
   obfloat interpolateTrilinear(int x, int y, int z, obfloat dx, obfloat dy, obfloat dz);
 
+  /**
+   * Trilinear interpolation of tsd and its gradient
+   * @param[in] x x-index of base voxel
+   * @param[in] y y-index of base voxel
+   * @param[in] z z-index of base voxel
+   * @param[in] dx interpolation weight in x-direction
+   * @param[in] dy interpolation weight in y-direction
+   * @param[in] dz interpolation weight in z-direction
+   * @param[out] gradient partial derivatives with respect to x, y and z (per voxel)
+   * @return interpolated tsd
+   */
+  obfloat interpolateTrilinear(int x, int y, int z, obfloat dx, obfloat dy, obfloat dz, obfloat gradient[3]);
+
+  /**
+   * Trilinear interpolation of value and gradient from the 8 corners of a cell
+   * @param[in] c corner values, corner (i,j,k) is located at c[4*i+2*j+k] for offsets i, j, k in x, y, z
+   * @param[in] dx interpolation weight in x-direction
+   * @param[in] dy interpolation weight in y-direction
+   * @param[in] dz interpolation weight in z-direction
+   * @param[out] gradient partial derivatives with respect to x, y and z (per voxel)
+   * @return interpolated value
+   */
+  static inline obfloat interpolateTrilinear(const obfloat c[8], obfloat dx, obfloat dy, obfloat dz, obfloat gradient[3])
+  {
+    // collapse z-direction
+    const obfloat c00 = c[0] + (c[1]-c[0]) * dz;
+    const obfloat c01 = c[2] + (c[3]-c[2]) * dz;
+    const obfloat c10 = c[4] + (c[5]-c[4]) * dz;
+    const obfloat c11 = c[6] + (c[7]-c[6]) * dz;
+
+    // collapse y-direction
+    const obfloat c0 = c00 + (c01-c00) * dy;
+    const obfloat c1 = c10 + (c11-c10) * dy;
+
+    const obfloat d0 = (c[1]-c[0]) + ((c[3]-c[2]) - (c[1]-c[0])) * dy;
+    const obfloat d1 = (c[5]-c[4]) + ((c[7]-c[6]) - (c[5]-c[4])) * dy;
+
+    gradient[0] = c1 - c0;
+    gradient[1] = (c01-c00) + ((c11-c10) - (c01-c00)) * dx;
+    gradient[2] = d0 + (d1-d0) * dx;
+
+    return c0 + (c1-c0) * dx;
+  };
+
   void serialize(ofstream* f);
 
   void load(ifstream* f);
 
 private:
 
-  TsdVoxel*** _space;
+  /**
+   * Access voxel by flat index arithmetic, voxels are stored contiguously in order z, y, x
+   * @param z z-index
+   * @param y y-index
+   * @param x x-index
+   * @return voxel
+   */
+  inline TsdVoxel& at(unsigned int z, unsigned int y, unsigned int x)
+  {
+    return _space[z*_strideZ + y*_strideY + x];
+  };
+
+  /**
+   * Read access to voxel, considering uniform representation
+   * @param z z-index
+   * @param y y-index
+   * @param x x-index
+   * @return voxel
+   */
+  inline TsdVoxel* get(unsigned int z, unsigned int y, unsigned int x)
+  {
+    return _space ? &_space[z*_strideZ + y*_strideY + x] : &_uniformVoxel;
+  };
+
+  /**
+   * Switch from uniform to dense representation
+   */
+  void expand();
+
+  TsdVoxel* allocateBlock();
+
+  void releaseBlock(TsdVoxel* block);
+
+  /**
+   * Stamp access time and reload evicted voxel data
+   */
+  void access();
+
+  /**
+   * Compress voxel data with run-length encoding and move it to the cache file
+   */
+  void evict();
+
+  TsdVoxel* _space;
+
+  // Offsets between consecutive rows and slices of _space
+  unsigned int _strideY;
+
+  unsigned int _strideZ;
+
+  SlabAllocator<TsdVoxel>* _pool;
+
+  // All voxels, including ghost borders, are represented by _uniformVoxel
+  bool _uniform;
+
+  TsdVoxel _uniformVoxel;
 
   obfloat _cellSize;
 
@@ -116,6 +286,29 @@ private:
   unsigned int _z;
 
   obfloat _initWeight;
+
+  // Voxel data has been modified since last propagation of borders
+  bool _modified;
+
+  // Partition is enqueued for propagation of borders
+  bool _borderPending;
+
+  // Cache for evicted voxel data
+  TsdSpaceCache* _cache;
+
+  // Voxel data resides in cache file
+  bool _evicted;
+
+  // Slot in cache file
+  long _cacheOffset;
+
+  unsigned int _cacheCapacity;
+
+  // Size of compressed voxel data in cache file
+  unsigned int _cacheBytes;
+
+  // Tick of last access
+  unsigned long _lastAccess;
 };
 
 }
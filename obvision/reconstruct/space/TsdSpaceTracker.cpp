@@ -0,0 +1,251 @@
+#include "TsdSpaceTracker.h"
+
+#include <string.h>
+#include <cmath>
+
+#include "obcore/base/Logger.h"
+#include "obcore/base/Timer.h"
+#include "obcore/math/linalg/LinalgBackend.h"
+
+namespace obvious
+{
+
+TsdSpaceTracker::TsdSpaceTracker(TsdSpace* space)
+{
+  _space         = space;
+  _maxIterations = 20;
+  _eps           = 1e-4;
+  _subsampling   = 4;
+  _huber         = 0.3;
+  _minValid      = 100;
+  _damping       = 1e-4;
+  _iterations    = 0;
+  _valid         = 0;
+  _rms           = 0.0;
+}
+
+TsdSpaceTracker::~TsdSpaceTracker()
+{
+
+}
+
+void TsdSpaceTracker::setMaxIterations(unsigned int iterations)
+{
+  _maxIterations = iterations;
+}
+
+void TsdSpaceTracker::setConvergenceThreshold(double eps)
+{
+  _eps = eps;
+}
+
+void TsdSpaceTracker::setSubsampling(unsigned int step)
+{
+  _subsampling = (step > 0) ? step : 1;
+}
+
+void TsdSpaceTracker::setHuberThreshold(double threshold)
+{
+  _huber = threshold;
+}
+
+void TsdSpaceTracker::setDamping(double lambda)
+{
+  _damping = lambda;
+}
+
+void TsdSpaceTracker::setMinValidPoints(unsigned int points)
+{
+  _minValid = points;
+}
+
+unsigned int TsdSpaceTracker::getIterations()
+{
+  return _iterations;
+}
+
+unsigned int TsdSpaceTracker::getValidPoints()
+{
+  return _valid;
+}
+
+double TsdSpaceTracker::getRMS()
+{
+  return _rms;
+}
+
+unsigned int TsdSpaceTracker::accumulate(const Transform3D& T, double* coords, unsigned int size, double A[36], double b[6], double* err)
+{
+  unsigned int valid = 0;
+  memset(A, 0, 36*sizeof(double));
+  memset(b, 0, 6*sizeof(double));
+  *err = 0.0;
+
+#pragma omp parallel
+  {
+    double A_tmp[36];
+    double b_tmp[6];
+    double err_tmp = 0.0;
+    unsigned int valid_tmp = 0;
+    memset(A_tmp, 0, 36*sizeof(double));
+    memset(b_tmp, 0, 6*sizeof(double));
+
+#pragma omp for schedule(dynamic, 256)
+    for(unsigned int i=0; i<size; i++)
+    {
+      obfloat q[3];
+      T.transform(&coords[3*i], q);
+
+      obfloat r;
+      obfloat g[3];
+      if(_space->interpolateTrilinear(q, &r, g)!=INTERPOLATE_SUCCESS) continue;
+
+      // Saturated values lie outside of the truncation band and carry no gradient information
+      if(fabs(r) > 0.99) continue;
+
+      // Derivative of r(exp(xi) * q) at xi=0 for xi = (omega, v): [q x g, g]
+      double J[6];
+      J[0] = q[1]*g[2] - q[2]*g[1];
+      J[1] = q[2]*g[0] - q[0]*g[2];
+      J[2] = q[0]*g[1] - q[1]*g[0];
+      J[3] = g[0];
+      J[4] = g[1];
+      J[5] = g[2];
+
+      const double w = (fabs(r) <= _huber) ? 1.0 : _huber / fabs(r);
+
+      for(unsigned int j=0; j<6; j++)
+      {
+        const double wJ = w * J[j];
+        for(unsigned int k=j; k<6; k++)
+          A_tmp[j*6+k] += wJ * J[k];
+        b_tmp[j] += wJ * r;
+      }
+      err_tmp += r*r;
+      valid_tmp++;
+    }
+
+#pragma omp critical
+    {
+      for(unsigned int j=0; j<36; j++) A[j] += A_tmp[j];
+      for(unsigned int j=0; j<6; j++) b[j] += b_tmp[j];
+      *err += err_tmp;
+      valid += valid_tmp;
+    }
+  }
+
+  // Normal equations are symmetric, only the upper triangle has been accumulated
+  for(unsigned int j=0; j<6; j++)
+    for(unsigned int k=0; k<j; k++)
+      A[j*6+k] = A[k*6+j];
+
+  return valid;
+}
+
+bool TsdSpaceTracker::track(Sensor* sensor)
+{
+  Timer t;
+  t.start();
+
+  _iterations = 0;
+  _valid      = 0;
+  _rms        = 0.0;
+
+  // Scene points in sensor coordinate system
+  double* coords = new double[sensor->getRealMeasurementSize()*3];
+  unsigned int size = sensor->dataToCartesianVector(coords) / 3;
+
+  // Subsample in place
+  unsigned int points = 0;
+  for(unsigned int i=0; i<size; i+=_subsampling, points++)
+  {
+    coords[3*points]   = coords[3*i];
+    coords[3*points+1] = coords[3*i+1];
+    coords[3*points+2] = coords[3*i+2];
+  }
+
+  Matrix Tsensor = sensor->getTransformation();
+  Transform3D T0(Tsensor);
+  Transform3D T = T0;
+
+  bool success = true;
+  double A[36];
+  double b[6];
+  double err;
+  for(_iterations=0; _iterations<_maxIterations; )
+  {
+    _valid = accumulate(T, coords, points, A, b, &err);
+    if(_valid < _minValid)
+    {
+      LOGMSG(DBG_DEBUG, "Too few valid points for tracking: " << _valid);
+      success = false;
+      break;
+    }
+    _rms = sqrt(err / (double)_valid);
+    _iterations++;
+
+    // Directions without any constraint, e.g., when observing a single plane, render the normal equations singular.
+    // Such directions need not be axis-aligned, hence the smallest eigenvalue is checked, i.e., singular value of symmetric A.
+    double U[36], s[6], V[36];
+    LinalgBackend::svd(A, 6, 6, U, s, V);
+    if(s[5] <= 1e-12 * s[0])
+    {
+      LOGMSG(DBG_DEBUG, "Pose is not constrained by scene");
+      success = false;
+      break;
+    }
+
+    // Solve (A + lambda*diag(A)) xi = -b, Levenberg-Marquardt damping shortens steps along weakly constrained directions
+    for(unsigned int j=0; j<6; j++)
+    {
+      A[j*6+j] += _damping * A[j*6+j];
+      b[j] = -b[j];
+    }
+    Matrix M(6, 6, A);
+    double xi[6];
+    M.solve(b, xi);
+
+    // Exponential map of rotational part (Rodrigues), translational part is applied to first order
+    const double theta = sqrt(xi[0]*xi[0] + xi[1]*xi[1] + xi[2]*xi[2]);
+    Transform3D dT;
+    if(theta > 1e-12)
+    {
+      const double k[3] = {xi[0]/theta, xi[1]/theta, xi[2]/theta};
+      const double s = sin(theta);
+      const double c = 1.0 - cos(theta);
+      dT(0,0) = 1.0 - c*(k[1]*k[1] + k[2]*k[2]);
+      dT(0,1) = -s*k[2] + c*k[0]*k[1];
+      dT(0,2) =  s*k[1] + c*k[0]*k[2];
+      dT(1,0) =  s*k[2] + c*k[0]*k[1];
+      dT(1,1) = 1.0 - c*(k[0]*k[0] + k[2]*k[2]);
+      dT(1,2) = -s*k[0] + c*k[1]*k[2];
+      dT(2,0) = -s*k[1] + c*k[0]*k[2];
+      dT(2,1) =  s*k[0] + c*k[1]*k[2];
+      dT(2,2) = 1.0 - c*(k[0]*k[0] + k[1]*k[1]);
+    }
+    dT(0,3) = xi[3];
+    dT(1,3) = xi[4];
+    dT(2,3) = xi[5];
+    T = dT * T;
+
+    double norm = 0.0;
+    for(unsigned int j=0; j<6; j++) norm += xi[j]*xi[j];
+    if(sqrt(norm) < _eps) break;
+  }
+
+  delete [] coords;
+
+  if(success)
+  {
+    // Correct sensor pose with increment in sensor coordinate system, i.e., P' = P * (P^-1 * T)
+    Transform3D dT = T0.getInverse() * T;
+    Matrix Tinc = dT.toMatrix();
+    sensor->transform(&Tinc);
+  }
+
+  LOGMSG(DBG_DEBUG, "Elapsed tracking: " << t.elapsed() << "s, iterations: " << _iterations << ", valid points: " << _valid << ", rms: " << _rms);
+
+  return success;
+}
+
+}
@@ -0,0 +1,129 @@
+#ifndef TSDSPACETRACKER_H
+#define TSDSPACETRACKER_H
+
+#include "obcore/math/linalg/linalg.h"
+#include "obcore/math/linalg/Transform.h"
+#include "obvision/reconstruct/Sensor.h"
+#include "TsdSpace.h"
+
+namespace obvious
+{
+
+/**
+ * @class TsdSpaceTracker
+ * @brief Direct scan-to-TSDF registration, i.e., without raycasting a model and without explicit correspondences.
+ * Measurements of a sensor are transformed with its current pose and aligned with the zero crossing of the signed distance field.
+ * The sum of squared interpolated TSD values at scene points is minimized with Gauss-Newton iterations, the Jacobian is built
+ * from the trilinear TSD gradient. Residuals are weighted robustly (Huber).
+ * Inspired by E. Bylow, J. Sturm, C. Kerl, F. Kahl, and D. Cremers.
+ * Real-time camera tracking and 3d reconstruction using signed distance functions. RSS 2013.
+ * @author Stefan May
+ */
+class TsdSpaceTracker
+{
+public:
+
+  /**
+   * Constructor
+   * @param space space to track against
+   */
+  TsdSpaceTracker(TsdSpace* space);
+
+  /**
+   * Destructor
+   */
+  virtual ~TsdSpaceTracker();
+
+  /**
+   * Set maximum number of Gauss-Newton iterations
+   * @param iterations maximum number of iterations (default: 20)
+   */
+  void setMaxIterations(unsigned int iterations);
+
+  /**
+   * Set convergence threshold, iterations stop if the norm of the pose update falls below
+   * @param eps threshold (default: 1e-4)
+   */
+  void setConvergenceThreshold(double eps);
+
+  /**
+   * Set subsampling of measurements
+   * @param step use every step-th valid measurement (default: 4)
+   */
+  void setSubsampling(unsigned int step);
+
+  /**
+   * Set threshold of robust weighting
+   * @param threshold residuals above are down-weighted, residuals are normalized by the truncation radius (default: 0.3)
+   */
+  void setHuberThreshold(double threshold);
+
+  /**
+   * Set Levenberg-Marquardt damping, i.e., lambda*diag(A) is added to the normal equations A
+   * @param lambda damping factor, larger values result in shorter but more robust steps (default: 1e-4)
+   */
+  void setDamping(double lambda);
+
+  /**
+   * Set minimum number of scene points with valid TSD needed for a pose update
+   * @param points number of points (default: 100)
+   */
+  void setMinValidPoints(unsigned int points);
+
+  /**
+   * Align current measurements of sensor to space. On success, the sensor pose is corrected with Sensor::transform.
+   * @param sensor sensor providing measurements and initial pose
+   * @return success, i.e., enough valid points in every iteration
+   */
+  bool track(Sensor* sensor);
+
+  /**
+   * Get number of iterations performed in last call of track
+   * @return number of iterations
+   */
+  unsigned int getIterations();
+
+  /**
+   * Get number of points with valid TSD in last iteration
+   * @return number of points
+   */
+  unsigned int getValidPoints();
+
+  /**
+   * Get root mean square of TSD residuals in last iteration
+   * @return rms (normalized by truncation radius)
+   */
+  double getRMS();
+
+private:
+
+  /**
+   * Accumulate normal equations of Gauss-Newton step for scene points transformed with pose T
+   * @return number of points with valid TSD
+   */
+  unsigned int accumulate(const Transform3D& T, double* coords, unsigned int size, double A[36], double b[6], double* err);
+
+  TsdSpace* _space;
+
+  unsigned int _maxIterations;
+
+  double _eps;
+
+  unsigned int _subsampling;
+
+  double _huber;
+
+  unsigned int _minValid;
+
+  double _damping;
+
+  unsigned int _iterations;
+
+  unsigned int _valid;
+
+  double _rms;
+};
+
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include <iostream>
+
+#include "gtest/gtest.h"
+
+#include "obcore/base/CompactCloud3D.h"
+#include "obcore/math/linalg/linalg.h"
+#include "obcore/math/mathbase.h"
+
+using namespace obvious;
+
+// Odd number of points in order to cover remainders of vectorized kernels
+const unsigned int points = 37;
+
+static void fillCloud(double* coords, double* normals, unsigned char* rgb, bool* mask)
+{
+  for(unsigned int i=0; i<points; i++)
+  {
+    coords[3*i]    = 0.1*i;
+    coords[3*i+1]  = -0.05*i + 1.0;
+    coords[3*i+2]  = 2.0 + 0.01*i*i;
+    normals[3*i]   = 0.0;
+    normals[3*i+1] = (i%2) ? 1.0 : 0.0;
+    normals[3*i+2] = (i%2) ? 0.0 : 1.0;
+    rgb[3*i]       = i;
+    rgb[3*i+1]     = 2*i;
+    rgb[3*i+2]     = 3*i;
+    mask[i]        = (i%3)!=0;
+  }
+}
+
+TEST(compactcloud3d_test_compact, compactcloud3d_test)
+{
+  double coords[3*points];
+  double normals[3*points];
+  unsigned char rgb[3*points];
+  bool mask[points];
+  fillCloud(coords, normals, rgb, mask);
+
+  CompactCloud3D<double> cloud(points, true, true);
+  cloud.copyFrom(coords, normals, rgb);
+  unsigned int cnt = cloud.compact(mask);
+
+  // AoS reference
+  unsigned int j = 0;
+  for(unsigned int i=0; i<points; i++)
+  {
+    if(!mask[i]) continue;
+    for(unsigned int k=0; k<3; k++)
+    {
+      coords[3*j+k]  = coords[3*i+k];
+      normals[3*j+k] = normals[3*i+k];
+      rgb[3*j+k]     = rgb[3*i+k];
+    }
+    j++;
+  }
+
+  EXPECT_EQ(cnt, j);
+  EXPECT_EQ(cloud.size(), j);
+
+  double coords2[3*points];
+  double normals2[3*points];
+  unsigned char rgb2[3*points];
+  cloud.copyTo(coords2, normals2, rgb2);
+  for(unsigned int i=0; i<3*cnt; i++)
+  {
+    EXPECT_EQ(coords2[i], coords[i]);
+    EXPECT_EQ(normals2[i], normals[i]);
+    EXPECT_EQ(rgb2[i], rgb[i]);
+  }
+}
+
+TEST(compactcloud3d_test_compact_view, compactcloud3d_test)
+{
+  double coords[3*points];
+  double normals[3*points];
+  unsigned char rgb[3*points];
+  bool mask[points];
+  fillCloud(coords, normals, rgb, mask);
+
+  double view[3*points];
+  for(unsigned int i=0; i<3*points; i++)
+    view[i] = coords[i];
+
+  CompactCloud3D<double> cloud(view, points);
+  unsigned int cnt = cloud.compact(mask);
+
+  unsigned int j = 0;
+  for(unsigned int i=0; i<points; i++)
+  {
+    if(!mask[i]) continue;
+    for(unsigned int k=0; k<3; k++)
+      EXPECT_EQ(view[3*j+k], coords[3*i+k]);
+    j++;
+  }
+  EXPECT_EQ(cnt, j);
+}
+
+TEST(compactcloud3d_test_transform, compactcloud3d_test)
+{
+  double coords[3*points];
+  double normals[3*points];
+  unsigned char rgb[3*points];
+  bool mask[points];
+  fillCloud(coords, normals, rgb, mask);
+
+  Matrix T = MatrixFactory::TransformationMatrix44(deg2rad(10.0), deg2rad(20.0), deg2rad(30.0), 0.5, -1.5, 2.5);
+  double tf[16];
+  T.getData(tf);
+
+  CompactCloud3D<double> cloud(points, true);
+  cloud.copyFrom(coords, normals);
+  cloud.transform(tf);
+
+  CompactCloud3D<float> cloudf(points, true);
+  cloudf.copyFrom(coords, normals);
+  cloudf.transform(tf);
+
+  // AoS reference
+  Matrix C(points, 3, coords);
+  C.transform(T);
+  Matrix R(3, 3);
+  for(unsigned int r=0; r<3; r++)
+    for(unsigned int c=0; c<3; c++)
+      R(r, c) = T(r, c);
+  Matrix::multiply(R, normals, points, 3);
+
+  double coords2[3*points];
+  double normals2[3*points];
+  cloud.copyTo(coords2, normals2);
+  double coordsf[3*points];
+  double normalsf[3*points];
+  cloudf.copyTo(coordsf, normalsf);
+  for(unsigned int i=0; i<points; i++)
+  {
+    for(unsigned int k=0; k<3; k++)
+    {
+      EXPECT_NEAR(coords2[3*i+k], C(i, k), 1e-12);
+      EXPECT_NEAR(normals2[3*i+k], normals[3*i+k], 1e-12);
+      EXPECT_NEAR(coordsf[3*i+k], C(i, k), 1e-5);
+      EXPECT_NEAR(normalsf[3*i+k], normals[3*i+k], 1e-5);
+    }
+  }
+}
+
+TEST(compactcloud3d_test_transform_view, compactcloud3d_test)
+{
+  double coords[3*points];
+  double normals[3*points];
+  unsigned char rgb[3*points];
+  bool mask[points];
+  fillCloud(coords, normals, rgb, mask);
+
+  Matrix T = MatrixFactory::TransformationMatrix44(deg2rad(-45.0), deg2rad(5.0), deg2rad(60.0), -1.0, 0.2, 0.3);
+  double tf[16];
+  T.getData(tf);
+
+  double view[3*points];
+  for(unsigned int i=0; i<3*points; i++)
+    view[i] = coords[i];
+  CompactCloud3D<double> cloud(view, points);
+  cloud.transform(tf);
+
+  Matrix C(points, 3, coords);
+  C.transform(T);
+  for(unsigned int i=0; i<points; i++)
+    for(unsigned int k=0; k<3; k++)
+      EXPECT_NEAR(view[3*i+k], C(i, k), 1e-12);
+}
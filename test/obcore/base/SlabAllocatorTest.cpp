@@ -0,0 +1,94 @@
+#include <iostream>
+
+#include "gtest/gtest.h"
+
+#include "obcore/base/SlabAllocator.h"
+#include <vector>
+
+using namespace obvious;
+
+TEST(slaballocator_test_blocks_in_use, slaballocator_test)
+{
+  SlabAllocator<double> pool(16, 4);
+  EXPECT_EQ(pool.getBlockSize(), 16u);
+  EXPECT_EQ(pool.getBlocksInUse(), 0u);
+
+  std::vector<double*> blocks;
+  for(int i=0; i<10; i++)
+    blocks.push_back(pool.allocate());
+  EXPECT_EQ(pool.getBlocksInUse(), 10u);
+  EXPECT_EQ(pool.getBlocksReserved(), 12u);
+
+  for(int i=0; i<10; i++)
+    pool.release(blocks[i]);
+  EXPECT_EQ(pool.getBlocksInUse(), 0u);
+  EXPECT_EQ(pool.getBlocksReserved(), 12u);
+}
+
+TEST(slaballocator_test_distinct_blocks, slaballocator_test)
+{
+  SlabAllocator<double> pool(16, 4);
+
+  std::vector<double*> blocks;
+  for(int i=0; i<9; i++)
+    blocks.push_back(pool.allocate());
+
+  // Blocks must not overlap
+  for(int i=0; i<9; i++)
+    for(int j=0; j<16; j++)
+      blocks[i][j] = i;
+  for(int i=0; i<9; i++)
+    for(int j=0; j<16; j++)
+      EXPECT_EQ(blocks[i][j], i);
+
+  for(int i=0; i<9; i++)
+    pool.release(blocks[i]);
+}
+
+TEST(slaballocator_test_reuse, slaballocator_test)
+{
+  SlabAllocator<double> pool(16, 4);
+
+  double* block = pool.allocate();
+  pool.release(block);
+  EXPECT_EQ(pool.allocate(), block);
+  pool.release(block);
+
+  // Released blocks are recycled, no further slabs are needed
+  for(int r=0; r<100; r++)
+  {
+    std::vector<double*> blocks;
+    for(int i=0; i<8; i++)
+      blocks.push_back(pool.allocate());
+    for(int i=0; i<8; i++)
+      pool.release(blocks[i]);
+  }
+  EXPECT_EQ(pool.getBlocksReserved(), 8u);
+  EXPECT_EQ(pool.getBlocksInUse(), 0u);
+}
+
+TEST(slaballocator_test_parallel, slaballocator_test)
+{
+  SlabAllocator<double> pool(16, 4);
+
+  // Blocks allocated outside of the parallel region are released by team threads and vice versa
+  std::vector<double*> blocks;
+  for(int i=0; i<64; i++)
+    blocks.push_back(pool.allocate());
+
+#pragma omp parallel for
+  for(int i=0; i<64; i++)
+  {
+    pool.release(blocks[i]);
+    blocks[i] = pool.allocate();
+    blocks[i][0] = i;
+  }
+  EXPECT_EQ(pool.getBlocksInUse(), 64u);
+
+  for(int i=0; i<64; i++)
+  {
+    EXPECT_EQ(blocks[i][0], i);
+    pool.release(blocks[i]);
+  }
+  EXPECT_EQ(pool.getBlocksInUse(), 0u);
+}
@@ -0,0 +1,128 @@
+#include <iostream>
+
+#include "gtest/gtest.h"
+
+#include "obcore/math/linalg/LinalgBackend.h"
+#include <math.h>
+#include <string.h>
+
+using namespace obvious;
+
+const double eps = 1e-10;
+
+double A[] = {4.0, 1.0, -2.0, 0.5,
+              1.0, 5.0, 0.3, -1.0,
+              -2.0, 0.3, 6.0, 2.0,
+              0.5, -1.0, 2.0, 7.0,
+              1.5, 2.5, -0.5, 3.0,
+              -3.0, 0.1, 1.2, 0.7};
+
+// Results of the Eigen kernels serve as reference, GSL is checked for agreement if it is compiled
+
+TEST(linalgbackend_test_multiply, linalgbackend_test)
+{
+  double M[] = {0.36, -0.48, 0.8, 0.8, 0.6, 0.0, -0.48, 0.64, 0.6};
+  double points[] = {1.0, 2.0, 3.0, -4.0, 5.0, 6.0, 7.0, -8.0, 0.5, 0.1, 0.2, 0.3};
+
+  double eigen[12];
+  memcpy(eigen, points, sizeof(points));
+  LinalgBackend::multiply(M, eigen, 4, 3, LINALG_EIGEN);
+
+  for(int i=0; i<4; i++)
+    for(int j=0; j<3; j++)
+      EXPECT_NEAR(eigen[i*3+j], M[j*3]*points[i*3] + M[j*3+1]*points[i*3+1] + M[j*3+2]*points[i*3+2], eps);
+
+  if(!LinalgBackend::isAvailable(LINALG_GSL)) return;
+
+  double gsl[12];
+  memcpy(gsl, points, sizeof(points));
+  LinalgBackend::multiply(M, gsl, 4, 3, LINALG_GSL);
+  for(int i=0; i<12; i++)
+    EXPECT_NEAR(gsl[i], eigen[i], eps);
+}
+
+TEST(linalgbackend_test_invert, linalgbackend_test)
+{
+  double eigen[16];
+  memcpy(eigen, A, sizeof(eigen));
+  LinalgBackend::invert(eigen, 4, LINALG_EIGEN);
+
+  for(int r=0; r<4; r++)
+  {
+    for(int c=0; c<4; c++)
+    {
+      double sum = 0.0;
+      for(int k=0; k<4; k++)
+        sum += A[r*4+k]*eigen[k*4+c];
+      EXPECT_NEAR(sum, (r==c) ? 1.0 : 0.0, eps);
+    }
+  }
+
+  if(!LinalgBackend::isAvailable(LINALG_GSL)) return;
+
+  double gsl[16];
+  memcpy(gsl, A, sizeof(gsl));
+  LinalgBackend::invert(gsl, 4, LINALG_GSL);
+  for(int i=0; i<16; i++)
+    EXPECT_NEAR(gsl[i], eigen[i], eps);
+}
+
+TEST(linalgbackend_test_svd, linalgbackend_test)
+{
+  const unsigned int rows = 6;
+  const unsigned int cols = 4;
+
+  double U[rows*cols];
+  double s[cols];
+  double V[cols*cols];
+  LinalgBackend::svd(A, rows, cols, U, s, V, LINALG_EIGEN);
+
+  // A = U * diag(s) * V^T
+  for(unsigned int r=0; r<rows; r++)
+  {
+    for(unsigned int c=0; c<cols; c++)
+    {
+      double sum = 0.0;
+      for(unsigned int k=0; k<cols; k++)
+        sum += U[r*cols+k]*s[k]*V[c*cols+k];
+      EXPECT_NEAR(sum, A[r*cols+c], eps);
+    }
+  }
+  for(unsigned int k=1; k<cols; k++)
+    EXPECT_GE(s[k-1], s[k]);
+
+  if(!LinalgBackend::isAvailable(LINALG_GSL)) return;
+
+  double Ug[rows*cols];
+  double sg[cols];
+  double Vg[cols*cols];
+  LinalgBackend::svd(A, rows, cols, Ug, sg, Vg, LINALG_GSL);
+
+  for(unsigned int k=0; k<cols; k++)
+  {
+    EXPECT_NEAR(sg[k], s[k], eps);
+
+    // Singular vectors are unique up to their sign
+    double dot = 0.0;
+    for(unsigned int r=0; r<rows; r++)
+      dot += Ug[r*cols+k]*U[r*cols+k];
+    double sign = (dot < 0.0) ? -1.0 : 1.0;
+    for(unsigned int r=0; r<rows; r++)
+      EXPECT_NEAR(Ug[r*cols+k], sign*U[r*cols+k], eps);
+    for(unsigned int r=0; r<cols; r++)
+      EXPECT_NEAR(Vg[r*cols+k], sign*V[r*cols+k], eps);
+  }
+}
+
+TEST(linalgbackend_test_select, linalgbackend_test)
+{
+  unsigned int threshold = LinalgBackend::getThreshold(LINALG_INVERT);
+  LinalgBackend::setThreshold(LINALG_INVERT, 16);
+  EXPECT_EQ(LinalgBackend::select(LINALG_INVERT, 4), LINALG_EIGEN);
+  EXPECT_EQ(LinalgBackend::select(LINALG_INVERT, 16), LINALG_GSL);
+
+  LinalgBackend::setBackend(LINALG_EIGEN);
+  EXPECT_EQ(LinalgBackend::select(LINALG_INVERT, 16), LINALG_EIGEN);
+  LinalgBackend::setBackend(LINALG_AUTO);
+  LinalgBackend::setThreshold(LINALG_INVERT, threshold);
+}
@@ -0,0 +1,138 @@
+#include <iostream>
+
+#include "gtest/gtest.h"
+
+#include "obcore/math/linalg/linalg.h"
+#include "obcore/math/linalg/Transform.h"
+#include "obcore/math/mathbase.h"
+
+using namespace obvious;
+
+const double eps = 1e-12;
+
+TEST(transform_test_2d_constructor, transform_test)
+{
+  Transform2D T = MatrixFactory::Transformation2D(deg2rad(30.0), 0.5, -1.5);
+  Matrix M = MatrixFactory::TransformationMatrix33(deg2rad(30.0), 0.5, -1.5);
+
+  for(int r=0; r<2; r++)
+    for(int c=0; c<3; c++)
+      EXPECT_NEAR(T(r,c), M(r,c), eps);
+
+  Matrix M2 = T.toMatrix();
+  for(int r=0; r<3; r++)
+    for(int c=0; c<3; c++)
+      EXPECT_NEAR(M2(r,c), M(r,c), eps);
+}
+
+TEST(transform_test_2d_multiply, transform_test)
+{
+  Transform2D T1(deg2rad(30.0), 0.5, -1.5);
+  Transform2D T2(deg2rad(-75.0), 2.0, 0.25);
+  Matrix M1 = MatrixFactory::TransformationMatrix33(deg2rad(30.0), 0.5, -1.5);
+  Matrix M2 = MatrixFactory::TransformationMatrix33(deg2rad(-75.0), 2.0, 0.25);
+
+  Transform2D T = T1 * T2;
+  Matrix M = M1 * M2;
+
+  for(int r=0; r<2; r++)
+    for(int c=0; c<3; c++)
+      EXPECT_NEAR(T(r,c), M(r,c), eps);
+}
+
+TEST(transform_test_2d_inverse, transform_test)
+{
+  Transform2D T(deg2rad(130.0), -0.7, 3.1);
+  Matrix M = MatrixFactory::TransformationMatrix33(deg2rad(130.0), -0.7, 3.1);
+
+  Transform2D Ti = T.getInverse();
+  Matrix Mi = M.getInverse();
+
+  for(int r=0; r<2; r++)
+    for(int c=0; c<3; c++)
+      EXPECT_NEAR(Ti(r,c), Mi(r,c), eps);
+}
+
+TEST(transform_test_2d_transform, transform_test)
+{
+  Transform2D T(deg2rad(130.0), -0.7, 3.1);
+  Matrix M = MatrixFactory::TransformationMatrix33(deg2rad(130.0), -0.7, 3.1);
+
+  double data[] = {1.0, 2.0, -3.0, 4.0, 0.5, -6.0};
+  Matrix coords(3, 2, data);
+  coords.transform(M);
+
+  for(int i=0; i<3; i++)
+  {
+    double p[2];
+    T.transform(&data[2*i], p);
+    EXPECT_NEAR(p[0], coords(i,0), eps);
+    EXPECT_NEAR(p[1], coords(i,1), eps);
+  }
+}
+
+TEST(transform_test_3d_constructor, transform_test)
+{
+  Transform3D T = MatrixFactory::Transformation3D(deg2rad(10.0), deg2rad(20.0), deg2rad(30.0), 0.5, -1.5, 2.5);
+  Matrix M = MatrixFactory::TransformationMatrix44(deg2rad(10.0), deg2rad(20.0), deg2rad(30.0), 0.5, -1.5, 2.5);
+
+  for(int r=0; r<3; r++)
+    for(int c=0; c<4; c++)
+      EXPECT_NEAR(T(r,c), M(r,c), eps);
+
+  Transform3D T2(M);
+  Matrix M2 = T2.toMatrix();
+  for(int r=0; r<4; r++)
+    for(int c=0; c<4; c++)
+      EXPECT_NEAR(M2(r,c), M(r,c), eps);
+}
+
+TEST(transform_test_3d_multiply, transform_test)
+{
+  Transform3D T1 = MatrixFactory::Transformation3D(deg2rad(10.0), deg2rad(20.0), deg2rad(30.0), 0.5, -1.5, 2.5);
+  Transform3D T2 = MatrixFactory::Transformation3D(deg2rad(-45.0), deg2rad(5.0), deg2rad(60.0), -1.0, 0.2, 0.3);
+  Matrix M1 = MatrixFactory::TransformationMatrix44(deg2rad(10.0), deg2rad(20.0), deg2rad(30.0), 0.5, -1.5, 2.5);
+  Matrix M2 = MatrixFactory::TransformationMatrix44(deg2rad(-45.0), deg2rad(5.0), deg2rad(60.0), -1.0, 0.2, 0.3);
+
+  Transform3D T = T1 * T2;
+  Matrix M = M1 * M2;
+
+  for(int r=0; r<3; r++)
+    for(int c=0; c<4; c++)
+      EXPECT_NEAR(T(r,c), M(r,c), eps);
+}
+
+TEST(transform_test_3d_inverse, transform_test)
+{
+  Transform3D T = MatrixFactory::Transformation3D(deg2rad(-45.0), deg2rad(5.0), deg2rad(60.0), -1.0, 0.2, 0.3);
+  Matrix M = MatrixFactory::TransformationMatrix44(deg2rad(-45.0), deg2rad(5.0), deg2rad(60.0), -1.0, 0.2, 0.3);
+
+  Transform3D Ti = T.getInverse();
+  Matrix Mi = M.getInverse();
+
+  for(int r=0; r<3; r++)
+    for(int c=0; c<4; c++)
+      EXPECT_NEAR(Ti(r,c), Mi(r,c), eps);
+}
+
+TEST(transform_test_3d_transform, transform_test)
+{
+  Transform3D T = MatrixFactory::Transformation3D(deg2rad(10.0), deg2rad(20.0), deg2rad(30.0), 0.5, -1.5, 2.5);
+  Matrix M = MatrixFactory::TransformationMatrix44(deg2rad(10.0), deg2rad(20.0), deg2rad(30.0), 0.5, -1.5, 2.5);
+
+  double data[] = {1.0, 2.0, 3.0, -4.0, 5.0, 6.0, 7.0, -8.0, 0.5};
+  Matrix coords(3, 3, data);
+  coords.transform(M);
+
+  for(int i=0; i<3; i++)
+  {
+    double p[3];
+    T.transform(&data[3*i], p);
+    Vec3 v = T * Vec3(data[3*i], data[3*i+1], data[3*i+2]);
+    for(int j=0; j<3; j++)
+    {
+      EXPECT_NEAR(p[j], coords(i,j), eps);
+      EXPECT_NEAR(v[j], coords(i,j), eps);
+    }
+  }
+}